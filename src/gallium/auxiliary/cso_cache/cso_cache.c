@@ -31,6 +31,7 @@
 #include "util/u_debug.h"
 
 #include "util/u_memory.h"
+#include "util/u_math.h"
 
 #include "cso_cache.h"
 #include "cso_hash.h"
@@ -39,6 +40,7 @@
 struct cso_cache {
    struct cso_hash *hashes[CSO_CACHE_MAX];
    int    max_size;
+   unsigned max_memory;
 
    cso_sanitize_callback sanitize_cb;
    void                 *sanitize_data;
@@ -80,6 +82,32 @@ unsigned cso_construct_key(void *item, int item_size)
    return hash_key((item), item_size);
 }
 
+/**
+ * Size of the objects stored in the hash of each type.
+ */
+static const unsigned cso_object_size[CSO_CACHE_MAX] = {
+   sizeof(struct cso_rasterizer),
+   sizeof(struct cso_blend),
+   sizeof(struct cso_depth_stencil_alpha),
+   sizeof(struct cso_sampler),
+   sizeof(struct cso_velements),
+};
+
+/**
+ * Memory used by the cached objects of all types.  This doesn't account
+ * for what the drivers allocate, but that's usually proportional.
+ */
+static unsigned cso_cache_memory(const struct cso_cache *sc)
+{
+   unsigned memory = 0;
+   int i;
+
+   for (i = 0; i < CSO_CACHE_MAX; i++)
+      memory += cso_hash_size(sc->hashes[i]) * cso_object_size[i];
+
+   return memory;
+}
+
 static INLINE struct cso_hash *_cso_hash_for_type(struct cso_cache *sc, enum cso_cache_type type)
 {
    struct cso_hash *hash;
@@ -172,6 +200,7 @@ static INLINE void sanitize_cb(struct cso_hash *hash, enum cso_cache_type type,
    int to_remove =  (max_size < max_entries) * max_entries/4;
    if (hash_size > max_size)
       to_remove += hash_size - max_size;
+   to_remove = MIN2(to_remove, hash_size);
    while (to_remove) {
       /*remove elements until we're good */
       /*fixme: currently we pick the nodes to remove at random*/
@@ -188,8 +217,21 @@ cso_insert_state(struct cso_cache *sc,
                  void *state)
 {
    struct cso_hash *hash = _cso_hash_for_type(sc, type);
+   unsigned memory;
+
    sanitize_hash(sc, hash, type, sc->max_size);
 
+   /* The memory budget is shared by all the types: when over it, make
+    * room by evicting objects of the type being inserted.
+    */
+   memory = cso_cache_memory(sc) + cso_object_size[type];
+   if (memory > sc->max_memory) {
+      int size = cso_hash_size(hash);
+      int excess = (memory - sc->max_memory + cso_object_size[type] - 1) /
+                   cso_object_size[type];
+      sanitize_hash(sc, hash, type, MAX2(size - excess, 0));
+   }
+
    return cso_hash_insert(hash, hash_key, state);
 }
 
@@ -251,6 +293,7 @@ struct cso_cache *cso_cache_create(void)
       return NULL;
 
    sc->max_size           = 4096;
+   sc->max_memory         = 4 * 1024 * 1024;
    for (i = 0; i < CSO_CACHE_MAX; i++)
       sc->hashes[i] = cso_hash_create();
 
@@ -312,6 +355,11 @@ int cso_maximum_cache_size(const struct cso_cache *sc)
    return sc->max_size;
 }
 
+void cso_set_maximum_cache_memory(struct cso_cache *sc, unsigned bytes)
+{
+   sc->max_memory = bytes;
+}
+
 void cso_cache_set_sanitize_callback(struct cso_cache *sc,
                                      cso_sanitize_callback cb,
                                      void *user_data)
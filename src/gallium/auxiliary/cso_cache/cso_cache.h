@@ -168,6 +168,12 @@ void * cso_take_state(struct cso_cache *sc, unsigned hash_key,
 void cso_set_maximum_cache_size(struct cso_cache *sc, int number);
 int cso_maximum_cache_size(const struct cso_cache *sc);
 
+/**
+ * Bound the memory used by the objects of all types together; objects of
+ * the type being inserted are evicted to stay under it.
+ */
+void cso_set_maximum_cache_memory(struct cso_cache *sc, unsigned bytes);
+
 #ifdef	__cplusplus
 }
 #endif
@@ -76,9 +76,22 @@ struct sampler_info
 
 
 
+/**
+ * Number of the most recently set states of each CSO type remembered by
+ * the context, so that setting one of them again skips the hashing.
+ */
+#define CSO_LOOKASIDE_SIZE 4
+
+struct cso_lookaside {
+   const void *cso[CSO_LOOKASIDE_SIZE];   /**< cso_blend, etc, most recent first */
+   void *data[CSO_LOOKASIDE_SIZE];        /**< their driver handles */
+};
+
+
 struct cso_context {
    struct pipe_context *pipe;
    struct cso_cache *cache;
+   struct cso_lookaside lookaside[CSO_CACHE_MAX];
    struct u_vbuf *vbuf;
 
    boolean has_geometry_shader;
@@ -151,6 +164,18 @@ static boolean delete_depth_stencil_state(struct cso_context *ctx, void *state)
 static boolean delete_sampler_state(struct cso_context *ctx, void *state)
 {
    struct cso_sampler *cso = (struct cso_sampler *)state;
+   unsigned shader, i;
+
+   for (shader = 0; shader < Elements(ctx->samplers); shader++) {
+      struct sampler_info *info = &ctx->samplers[shader];
+      for (i = 0; i < PIPE_MAX_SAMPLERS; i++) {
+         if (info->samplers[i] == cso->data ||
+             info->hw.samplers[i] == cso->data ||
+             info->samplers_saved[i] == cso->data)
+            return FALSE;
+      }
+   }
+
    if (cso->delete_state)
       cso->delete_state(cso->context, cso->data);
    FREE(state);
@@ -205,6 +230,56 @@ static INLINE boolean delete_cso(struct cso_context *ctx,
    return FALSE;
 }
 
+/**
+ * Move lookaside entry i to the front and return its driver handle.
+ */
+static INLINE void *
+lookaside_use(struct cso_lookaside *la, unsigned i)
+{
+   const void *cso = la->cso[i];
+   void *data = la->data[i];
+
+   for (; i > 0; i--) {
+      la->cso[i] = la->cso[i - 1];
+      la->data[i] = la->data[i - 1];
+   }
+   la->cso[0] = cso;
+   la->data[0] = data;
+
+   return data;
+}
+
+/**
+ * Look for a state whose first key_size bytes match the template.
+ */
+static INLINE boolean
+lookaside_find(struct cso_lookaside *la, const void *templ, unsigned key_size,
+               void **handle)
+{
+   unsigned i;
+
+   for (i = 0; i < CSO_LOOKASIDE_SIZE && la->cso[i]; i++) {
+      if (!memcmp(la->cso[i], templ, key_size)) {
+         *handle = lookaside_use(la, i);
+         return TRUE;
+      }
+   }
+   return FALSE;
+}
+
+static INLINE void
+lookaside_add(struct cso_lookaside *la, const void *cso, void *data)
+{
+   unsigned i;
+
+   for (i = CSO_LOOKASIDE_SIZE - 1; i > 0; i--) {
+      la->cso[i] = la->cso[i - 1];
+      la->data[i] = la->data[i - 1];
+   }
+   la->cso[0] = cso;
+   la->data[0] = data;
+}
+
 static INLINE void
 sanitize_hash(struct cso_hash *hash, enum cso_cache_type type,
               int max_size, void *user_data)
@@ -218,7 +293,12 @@ sanitize_hash(struct cso_hash *hash, enum cso_cache_type type,
    struct cso_hash_iter iter = cso_hash_first_node(hash);
    if (hash_size > max_size)
       to_remove += hash_size - max_size;
-   while (to_remove) {
+
+   /* the states about to be deleted may be in the lookaside */
+   if (to_remove)
+      memset(&ctx->lookaside[type], 0, sizeof ctx->lookaside[type]);
+
+   while (to_remove && !cso_hash_iter_is_null(iter)) {
       /*remove elements until we're good */
       /*fixme: currently we pick the nodes to remove at random*/
       void *cso = cso_hash_iter_data(iter);
@@ -338,6 +418,7 @@ void cso_release_all( struct cso_context *ctx )
    if (ctx->cache) {
       cso_cache_delete( ctx->cache );
       ctx->cache = NULL;
+      memset(ctx->lookaside, 0, sizeof ctx->lookaside);
    }
 }
 
@@ -376,6 +457,10 @@ enum pipe_error cso_set_blend(struct cso_context *ctx,
    key_size = templ->independent_blend_enable ?
       sizeof(struct pipe_blend_state) :
       (char *)&(templ->rt[1]) - (char *)templ;
+
+   if (lookaside_find(&ctx->lookaside[CSO_BLEND], templ, key_size, &handle))
+      goto bind;
+
    hash_key = cso_construct_key((void*)templ, key_size);
    iter = cso_find_state_template(ctx->cache, hash_key, CSO_BLEND,
                                   (void*)templ, key_size);
@@ -403,6 +488,9 @@ enum pipe_error cso_set_blend(struct cso_context *ctx,
       handle = ((struct cso_blend *)cso_hash_iter_data(iter))->data;
    }
 
+   lookaside_add(&ctx->lookaside[CSO_BLEND], cso_hash_iter_data(iter), handle);
+
+bind:
    if (ctx->blend != handle) {
       ctx->blend = handle;
       ctx->pipe->bind_blend_state(ctx->pipe, handle);
@@ -432,13 +520,19 @@ cso_set_depth_stencil_alpha(struct cso_context *ctx,
                             const struct pipe_depth_stencil_alpha_state *templ)
 {
    unsigned key_size = sizeof(struct pipe_depth_stencil_alpha_state);
-   unsigned hash_key = cso_construct_key((void*)templ, key_size);
-   struct cso_hash_iter iter = cso_find_state_template(ctx->cache,
-                                                       hash_key,
-                                                       CSO_DEPTH_STENCIL_ALPHA,
-                                                       (void*)templ, key_size);
+   unsigned hash_key;
+   struct cso_hash_iter iter;
    void *handle;
 
+   if (lookaside_find(&ctx->lookaside[CSO_DEPTH_STENCIL_ALPHA],
+                      templ, key_size, &handle))
+      goto bind;
+
+   hash_key = cso_construct_key((void*)templ, key_size);
+   iter = cso_find_state_template(ctx->cache, hash_key,
+                                  CSO_DEPTH_STENCIL_ALPHA,
+                                  (void*)templ, key_size);
+
    if (cso_hash_iter_is_null(iter)) {
       struct cso_depth_stencil_alpha *cso =
          MALLOC(sizeof(struct cso_depth_stencil_alpha));
@@ -466,6 +560,10 @@ cso_set_depth_stencil_alpha(struct cso_context *ctx,
                 cso_hash_iter_data(iter))->data;
    }
 
+   lookaside_add(&ctx->lookaside[CSO_DEPTH_STENCIL_ALPHA],
+                 cso_hash_iter_data(iter), handle);
+
+bind:
    if (ctx->depth_stencil != handle) {
       ctx->depth_stencil = handle;
       ctx->pipe->bind_depth_stencil_alpha_state(ctx->pipe, handle);
@@ -495,13 +593,18 @@ enum pipe_error cso_set_rasterizer(struct cso_context *ctx,
                                    const struct pipe_rasterizer_state *templ)
 {
    unsigned key_size = sizeof(struct pipe_rasterizer_state);
-   unsigned hash_key = cso_construct_key((void*)templ, key_size);
-   struct cso_hash_iter iter = cso_find_state_template(ctx->cache,
-                                                       hash_key,
-                                                       CSO_RASTERIZER,
-                                                       (void*)templ, key_size);
+   unsigned hash_key;
+   struct cso_hash_iter iter;
    void *handle = NULL;
 
+   if (lookaside_find(&ctx->lookaside[CSO_RASTERIZER],
+                      templ, key_size, &handle))
+      goto bind;
+
+   hash_key = cso_construct_key((void*)templ, key_size);
+   iter = cso_find_state_template(ctx->cache, hash_key, CSO_RASTERIZER,
+                                  (void*)templ, key_size);
+
    if (cso_hash_iter_is_null(iter)) {
       struct cso_rasterizer *cso = MALLOC(sizeof(struct cso_rasterizer));
       if (!cso)
@@ -525,6 +628,10 @@ enum pipe_error cso_set_rasterizer(struct cso_context *ctx,
       handle = ((struct cso_rasterizer *)cso_hash_iter_data(iter))->data;
    }
 
+   lookaside_add(&ctx->lookaside[CSO_RASTERIZER],
+                 cso_hash_iter_data(iter), handle);
+
+bind:
    if (ctx->rasterizer != handle) {
       ctx->rasterizer = handle;
       ctx->pipe->bind_rasterizer_state(ctx->pipe, handle);
@@ -818,35 +925,52 @@ cso_set_vertex_elements(struct cso_context *ctx,
                         const struct pipe_vertex_element *states)
 {
    struct u_vbuf *vbuf = ctx->vbuf;
-   unsigned key_size, hash_key;
+   struct cso_lookaside *la = &ctx->lookaside[CSO_VELEMENTS];
+   const unsigned velems_size = sizeof(struct pipe_vertex_element) * count;
+   unsigned hash_key, i;
    struct cso_hash_iter iter;
+   const struct cso_velements *match;
    void *handle;
-   struct cso_velems_state velems_state;
 
    if (vbuf) {
       u_vbuf_set_vertex_elements(vbuf, count, states);
       return PIPE_OK;
    }
 
+   for (i = 0; i < CSO_LOOKASIDE_SIZE && la->cso[i]; i++) {
+      match = (const struct cso_velements *) la->cso[i];
+      if (match->state.count == count &&
+          !memcmp(match->state.velems, states, velems_size)) {
+         handle = lookaside_use(la, i);
+         goto bind;
+      }
+   }
+
    /* Need to include the count into the stored state data too.
     * Otherwise first few count pipe_vertex_elements could be identical
     * even if count is different, and there's no guarantee the hash would
     * be different in that case neither.
+    *
+    * The elements are hashed and compared where they are, rather than
+    * copied into a cso_velems_state first.
     */
-   key_size = sizeof(struct pipe_vertex_element) * count + sizeof(unsigned);
-   velems_state.count = count;
-   memcpy(velems_state.velems, states,
-          sizeof(struct pipe_vertex_element) * count);
-   hash_key = cso_construct_key((void*)&velems_state, key_size);
-   iter = cso_find_state_template(ctx->cache, hash_key, CSO_VELEMENTS,
-                                  (void*)&velems_state, key_size);
+   hash_key = cso_construct_key((void*)states, velems_size) ^ count;
+   iter = cso_find_state(ctx->cache, hash_key, CSO_VELEMENTS);
+   while (!cso_hash_iter_is_null(iter)) {
+      match = (const struct cso_velements *) cso_hash_iter_data(iter);
+      if (match->state.count == count &&
+          !memcmp(match->state.velems, states, velems_size))
+         break;
+      iter = cso_hash_iter_next(iter);
+   }
 
    if (cso_hash_iter_is_null(iter)) {
       struct cso_velements *cso = MALLOC(sizeof(struct cso_velements));
       if (!cso)
          return PIPE_ERROR_OUT_OF_MEMORY;
 
-      memcpy(&cso->state, &velems_state, key_size);
+      cso->state.count = count;
+      memcpy(cso->state.velems, states, velems_size);
       cso->data = ctx->pipe->create_vertex_elements_state(ctx->pipe, count,
                                                       &cso->state.velems[0]);
       cso->delete_state =
@@ -865,6 +989,9 @@ cso_set_vertex_elements(struct cso_context *ctx,
       handle = ((struct cso_velements *)cso_hash_iter_data(iter))->data;
    }
 
+   lookaside_add(la, cso_hash_iter_data(iter), handle);
+
+bind:
    if (ctx->velements != handle) {
       ctx->velements = handle;
       ctx->pipe->bind_vertex_elements_state(ctx->pipe, handle);
@@ -973,7 +1100,9 @@ single_sampler(struct cso_context *ctx,
 {
    void *handle = NULL;
 
-   if (templ != NULL) {
+   if (templ != NULL &&
+       !lookaside_find(&ctx->lookaside[CSO_SAMPLER], templ,
+                       sizeof(struct pipe_sampler_state), &handle)) {
       unsigned key_size = sizeof(struct pipe_sampler_state);
       unsigned hash_key = cso_construct_key((void*)templ, key_size);
       struct cso_hash_iter iter =
@@ -1003,6 +1132,9 @@ single_sampler(struct cso_context *ctx,
       else {
          handle = ((struct cso_sampler *)cso_hash_iter_data(iter))->data;
       }
+
+      lookaside_add(&ctx->lookaside[CSO_SAMPLER],
+                    cso_hash_iter_data(iter), handle);
    }
 
    info->samplers[idx] = handle;
@@ -253,6 +253,22 @@ draw_arrays_instanced(struct draw_context *draw,
                       unsigned startInstance,
                       unsigned instanceCount);
 
+/**
+ * Post-transform vertex cache statistics of the indexed draws since the
+ * context was created.  The average cache miss ratio (ACMR) is
+ * vertices / primitives.
+ */
+struct draw_vertex_cache_stats
+{
+   uint64_t indices;       /**< indices consumed */
+   uint64_t vertices;      /**< vertices fetched and shaded */
+   uint64_t primitives;    /**< primitives drawn */
+};
+
+void
+draw_get_vertex_cache_stats(const struct draw_context *draw,
+                            struct draw_vertex_cache_stats *stats);
+
 
 /*******************************************************************************
  * Driver backend interface 
@@ -46,6 +46,8 @@
 
 #include "tgsi/tgsi_scan.h"
 
+#include "draw_context.h"
+
 #ifdef HAVE_LLVM
 struct draw_llvm;
 struct gallivm_state;
@@ -195,6 +197,8 @@ struct draw_context
 
       boolean test_fse;         /* enable FSE even though its not correct (eg for softpipe) */
       boolean no_fse;           /* disable FSE even when it is correct */
+
+      struct draw_vertex_cache_stats vcache_stats;
    } pt;
 
    struct {
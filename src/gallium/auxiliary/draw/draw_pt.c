@@ -71,6 +71,10 @@ draw_pt_arrays(struct draw_context *draw,
          return TRUE;
    }
 
+   if (draw->pt.user.eltSize)
+      draw->pt.vcache_stats.primitives +=
+         u_decomposed_prims_for_vertices(prim, count);
+
    if (!draw->force_passthrough) {
       unsigned gs_out_prim = (draw->gs.geometry_shader ? 
                               draw->gs.geometry_shader->output_primitive :
@@ -440,6 +444,14 @@ draw_arrays_instanced(struct draw_context *draw,
 }
 
 
+void
+draw_get_vertex_cache_stats(const struct draw_context *draw,
+                            struct draw_vertex_cache_stats *stats)
+{
+   *stats = draw->pt.vcache_stats;
+}
+
+
 /**
  * Draw vertex arrays.
  * This is the main entrypoint into the drawing module.  If drawing an indexed
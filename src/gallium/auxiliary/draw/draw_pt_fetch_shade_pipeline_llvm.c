@@ -32,6 +32,7 @@
 #include "draw/draw_vbuf.h"
 #include "draw/draw_vertex.h"
 #include "draw/draw_pt.h"
+#include "draw/draw_pt_threads.h"
 #include "draw/draw_vs.h"
 #include "draw/draw_llvm.h"
 #include "gallivm/lp_bld_init.h"
@@ -54,6 +55,30 @@ struct llvm_middle_end {
 
    struct draw_llvm *llvm;
    struct draw_llvm_variant *current_variant;
+
+   struct draw_pt_threads *threads;
+};
+
+
+/**
+ * Don't bother waking up other threads for fewer vertices than this
+ * per thread.
+ */
+#define LLVM_VS_MIN_JOB_VERTICES 512
+
+
+/**
+ * The fetch + vertex shader + cliptest stage, split in contiguous slices
+ * of the fetch range.  Each slice writes its own part of the output
+ * vertex array, so the vertices come out in the original order no matter
+ * which thread shaded them.
+ */
+struct llvm_vs_jobs {
+   struct llvm_middle_end *fpme;
+   const struct draw_fetch_info *fetch_info;
+   struct vertex_header *verts;
+   unsigned job_vertices;
+   unsigned clipped[DRAW_MAX_THREADS];
 };
 
 
@@ -210,6 +235,85 @@ static void emit(struct pt_emit *emit,
    }
 }
 
+static void
+llvm_run_vs_job(void *data, unsigned job)
+{
+   struct llvm_vs_jobs *jobs = (struct llvm_vs_jobs *)data;
+   struct llvm_middle_end *fpme = jobs->fpme;
+   struct draw_context *draw = fpme->draw;
+   const struct draw_fetch_info *fetch_info = jobs->fetch_info;
+   unsigned first = job * jobs->job_vertices;
+   unsigned count = MIN2(jobs->job_vertices, fetch_info->count - first);
+   struct vertex_header *verts = (struct vertex_header *)
+      ((char *)jobs->verts + first * fpme->vertex_size);
+
+   if (fetch_info->linear)
+      jobs->clipped[job] =
+         fpme->current_variant->jit_func( &fpme->llvm->jit_context,
+                                          verts,
+                                          (const char **)draw->pt.user.vbuffer,
+                                          fetch_info->start + first,
+                                          count,
+                                          fpme->vertex_size,
+                                          draw->pt.vertex_buffer,
+                                          draw->instance_id);
+   else
+      jobs->clipped[job] =
+         fpme->current_variant->jit_func_elts( &fpme->llvm->jit_context,
+                                               verts,
+                                               (const char **)draw->pt.user.vbuffer,
+                                               fetch_info->elts + first,
+                                               count,
+                                               fpme->vertex_size,
+                                               draw->pt.vertex_buffer,
+                                               draw->instance_id);
+}
+
+
+/**
+ * Fetch and shade all the vertices of fetch_info into verts, using the
+ * worker threads for large enough batches.  Returns non-zero if any
+ * vertex needs clipping.
+ */
+static unsigned
+llvm_run_vs( struct llvm_middle_end *fpme,
+             const struct draw_fetch_info *fetch_info,
+             struct vertex_header *verts )
+{
+   const unsigned vector_length = lp_native_vector_width / 32;
+   struct llvm_vs_jobs jobs;
+   unsigned nr_jobs;
+   unsigned clipped = 0;
+   unsigned i;
+
+   nr_jobs = MIN2(draw_pt_threads_max_jobs(fpme->threads),
+                  fetch_info->count / LLVM_VS_MIN_JOB_VERTICES);
+   nr_jobs = MAX2(nr_jobs, 1);
+
+   jobs.fpme = fpme;
+   jobs.fetch_info = fetch_info;
+   jobs.verts = verts;
+
+   /* The generated code always writes whole vectors of vertices, so all
+    * slices but the last must be a multiple of the vector length or
+    * neighbouring slices would overwrite each other's first vertices.
+    */
+   jobs.job_vertices = align((fetch_info->count + nr_jobs - 1) / nr_jobs,
+                             vector_length);
+   if (nr_jobs > 1)
+      nr_jobs = (fetch_info->count + jobs.job_vertices - 1) / jobs.job_vertices;
+   else
+      jobs.job_vertices = fetch_info->count;
+
+   draw_pt_threads_run(fpme->threads, nr_jobs, llvm_run_vs_job, &jobs);
+
+   for (i = 0; i < nr_jobs; i++)
+      clipped |= jobs.clipped[i];
+
+   return clipped;
+}
+
+
 static void
 llvm_pipeline_generic( struct draw_pt_middle_end *middle,
                        const struct draw_fetch_info *fetch_info,
@@ -236,24 +340,7 @@ llvm_pipeline_generic( struct draw_pt_middle_end *middle,
       return;
    }
 
-   if (fetch_info->linear)
-      clipped = fpme->current_variant->jit_func( &fpme->llvm->jit_context,
-                                       llvm_vert_info.verts,
-                                       (const char **)draw->pt.user.vbuffer,
-                                       fetch_info->start,
-                                       fetch_info->count,
-                                       fpme->vertex_size,
-                                       draw->pt.vertex_buffer,
-                                       draw->instance_id);
-   else
-      clipped = fpme->current_variant->jit_func_elts( &fpme->llvm->jit_context,
-                                            llvm_vert_info.verts,
-                                            (const char **)draw->pt.user.vbuffer,
-                                            fetch_info->elts,
-                                            fetch_info->count,
-                                            fpme->vertex_size,
-                                            draw->pt.vertex_buffer,
-                                            draw->instance_id);
+   clipped = llvm_run_vs( fpme, fetch_info, llvm_vert_info.verts );
 
    /* Finished with fetch and vs:
     */
@@ -414,6 +501,8 @@ static void llvm_middle_end_destroy( struct draw_pt_middle_end *middle )
    if (fpme->post_vs)
       draw_pt_post_vs_destroy( fpme->post_vs );
 
+   draw_pt_threads_destroy( fpme->threads );
+
    FREE(middle);
 }
 
@@ -461,6 +550,8 @@ draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
 
    fpme->current_variant = NULL;
 
+   fpme->threads = draw_pt_threads_create();
+
    return &fpme->base;
 
  fail:
@@ -0,0 +1,202 @@
+/**************************************************************************
+ *
+ * Copyright 2013 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * Worker threads for the draw module.
+ *
+ * The pool is deliberately simple: every worker owns one job slot and
+ * a pair of semaphores, and draw_pt_threads_run() hands out at most one
+ * job per worker, runs job 0 itself and waits for the others to finish.
+ * There is no queueing; the caller is blocked for the duration, so the
+ * order in which results are consumed is entirely up to the caller.
+ */
+
+#include "pipe/p_config.h"
+#include "os/os_thread.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_debug.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "draw/draw_pt_threads.h"
+
+
+struct draw_pt_worker
+{
+   struct draw_pt_threads *pool;
+   unsigned job;
+
+   pipe_semaphore work_ready;
+   pipe_semaphore work_done;
+   pipe_thread thread;
+};
+
+
+struct draw_pt_threads
+{
+   unsigned num_threads;      /**< worker threads, not counting the caller */
+   boolean exit_flag;
+
+   /* current job, valid between signalling work_ready and work_done */
+   draw_pt_thread_func func;
+   void *data;
+
+   struct draw_pt_worker workers[DRAW_MAX_THREADS - 1];
+};
+
+
+static PIPE_THREAD_ROUTINE( worker_function, init_data )
+{
+   struct draw_pt_worker *worker = (struct draw_pt_worker *) init_data;
+   struct draw_pt_threads *pool = worker->pool;
+
+   while (1) {
+      pipe_semaphore_wait(&worker->work_ready);
+
+      if (pool->exit_flag)
+         break;
+
+      pool->func(pool->data, worker->job);
+
+      pipe_semaphore_signal(&worker->work_done);
+   }
+
+   return NULL;
+}
+
+
+/**
+ * Create the worker threads.  Returns NULL if threading is disabled
+ * (single CPU, or DRAW_NUM_THREADS=0), in which case callers should do
+ * all the work on the calling thread.
+ */
+struct draw_pt_threads *
+draw_pt_threads_create(void)
+{
+   struct draw_pt_threads *pool;
+   unsigned num_threads;
+   unsigned i;
+
+   util_cpu_detect();
+
+   num_threads = util_cpu_caps.nr_cpus > 1 ? util_cpu_caps.nr_cpus - 1 : 0;
+#ifdef PIPE_SUBSYSTEM_EMBEDDED
+   num_threads = 0;
+#endif
+   num_threads = debug_get_num_option("DRAW_NUM_THREADS", num_threads);
+   num_threads = MIN2(num_threads, DRAW_MAX_THREADS - 1);
+
+   if (num_threads == 0)
+      return NULL;
+
+   pool = CALLOC_STRUCT(draw_pt_threads);
+   if (!pool)
+      return NULL;
+
+   pool->num_threads = num_threads;
+
+   for (i = 0; i < num_threads; i++) {
+      struct draw_pt_worker *worker = &pool->workers[i];
+
+      worker->pool = pool;
+      worker->job = i + 1;
+      pipe_semaphore_init(&worker->work_ready, 0);
+      pipe_semaphore_init(&worker->work_done, 0);
+      worker->thread = pipe_thread_create(worker_function, (void *) worker);
+   }
+
+   return pool;
+}
+
+
+void
+draw_pt_threads_destroy(struct draw_pt_threads *pool)
+{
+   unsigned i;
+
+   if (!pool)
+      return;
+
+   pool->exit_flag = TRUE;
+   for (i = 0; i < pool->num_threads; i++)
+      pipe_semaphore_signal(&pool->workers[i].work_ready);
+
+   for (i = 0; i < pool->num_threads; i++)
+      pipe_thread_wait(pool->workers[i].thread);
+
+   for (i = 0; i < pool->num_threads; i++) {
+      pipe_semaphore_destroy(&pool->workers[i].work_ready);
+      pipe_semaphore_destroy(&pool->workers[i].work_done);
+   }
+
+   FREE(pool);
+}
+
+
+/**
+ * Maximum number of jobs draw_pt_threads_run() will run concurrently.
+ * A NULL pool means no threading.
+ */
+unsigned
+draw_pt_threads_max_jobs(const struct draw_pt_threads *pool)
+{
+   return pool ? pool->num_threads + 1 : 1;
+}
+
+
+/**
+ * Run func(data, job) for every job in [0, nr_jobs), and return once
+ * all of them are done.  nr_jobs must not exceed
+ * draw_pt_threads_max_jobs().
+ */
+void
+draw_pt_threads_run(struct draw_pt_threads *pool,
+                    unsigned nr_jobs,
+                    draw_pt_thread_func func,
+                    void *data)
+{
+   unsigned i;
+
+   assert(nr_jobs >= 1);
+   assert(nr_jobs <= draw_pt_threads_max_jobs(pool));
+
+   if (nr_jobs == 1) {
+      func(data, 0);
+      return;
+   }
+
+   pool->func = func;
+   pool->data = data;
+
+   for (i = 0; i < nr_jobs - 1; i++)
+      pipe_semaphore_signal(&pool->workers[i].work_ready);
+
+   func(data, 0);
+
+   for (i = 0; i < nr_jobs - 1; i++)
+      pipe_semaphore_wait(&pool->workers[i].work_done);
+}
@@ -0,0 +1,70 @@
+/**************************************************************************
+ *
+ * Copyright 2013 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * A small pool of worker threads used by the draw module to spread
+ * independent pieces of work, such as running the vertex shader over
+ * disjoint ranges of a vertex buffer, across several CPUs.
+ */
+
+#ifndef DRAW_PT_THREADS_H
+#define DRAW_PT_THREADS_H
+
+#include "pipe/p_compiler.h"
+
+
+/** Upper bound on the jobs run concurrently, including the caller's */
+#define DRAW_MAX_THREADS 8
+
+
+struct draw_pt_threads;
+
+/**
+ * Job callback.  \p job is in [0, nr_jobs) and identifies the slice of
+ * the work to do; job 0 always runs on the calling thread.
+ */
+typedef void (*draw_pt_thread_func)(void *data, unsigned job);
+
+
+struct draw_pt_threads *
+draw_pt_threads_create(void);
+
+void
+draw_pt_threads_destroy(struct draw_pt_threads *threads);
+
+unsigned
+draw_pt_threads_max_jobs(const struct draw_pt_threads *threads);
+
+void
+draw_pt_threads_run(struct draw_pt_threads *threads,
+                    unsigned nr_jobs,
+                    draw_pt_thread_func func,
+                    void *data);
+
+
+#endif /* DRAW_PT_THREADS_H */
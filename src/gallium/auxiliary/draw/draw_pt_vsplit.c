@@ -31,8 +31,26 @@
 #include "draw/draw_private.h"
 #include "draw/draw_pt.h"
 
-#define SEGMENT_SIZE 1024
-#define MAP_SIZE     256
+/**
+ * Maximum number of indices per segment.  Segments are shaded
+ * independently, so vertices shared between two segments get shaded
+ * twice; large segments keep that to a minimum.
+ */
+#define SEGMENT_SIZE 4096
+
+/**
+ * The fetch -> draw element map is an open-addressed hash table at most
+ * half full, so that every repeated fetch element within a segment is
+ * found and no vertex is shaded twice for the same segment.
+ */
+#define MAP_ORDER    13
+#define MAP_SIZE     (1 << MAP_ORDER)
+
+struct vsplit_cache_entry {
+   unsigned fetch;
+   ushort draw;
+   ushort stamp;     /**< entry is valid if equal to the cache stamp */
+};
 
 struct vsplit_frontend {
    struct draw_pt_front_end base;
@@ -52,9 +70,8 @@ struct vsplit_frontend {
 
    struct {
       /* map a fetch element to a draw element */
-      unsigned fetches[MAP_SIZE];
-      ushort draws[MAP_SIZE];
-      boolean has_max_fetch;
+      struct vsplit_cache_entry map[MAP_SIZE];
+      ushort stamp;
 
       ushort num_fetch_elts;
       ushort num_draw_elts;
@@ -65,8 +82,13 @@ struct vsplit_frontend {
 static void
 vsplit_clear_cache(struct vsplit_frontend *vsplit)
 {
-   memset(vsplit->cache.fetches, 0xff, sizeof(vsplit->cache.fetches));
-   vsplit->cache.has_max_fetch = FALSE;
+   /* Invalidate all the entries at once by bumping the stamp, the table
+    * is only really cleared when the stamp wraps around.
+    */
+   if (++vsplit->cache.stamp == 0) {
+      memset(vsplit->cache.map, 0, sizeof(vsplit->cache.map));
+      vsplit->cache.stamp = 1;
+   }
    vsplit->cache.num_fetch_elts = 0;
    vsplit->cache.num_draw_elts = 0;
 }
@@ -74,6 +96,11 @@ vsplit_clear_cache(struct vsplit_frontend *vsplit)
 static void
 vsplit_flush_cache(struct vsplit_frontend *vsplit, unsigned flags)
 {
+   struct draw_vertex_cache_stats *stats = &vsplit->draw->pt.vcache_stats;
+
+   stats->indices += vsplit->cache.num_draw_elts;
+   stats->vertices += vsplit->cache.num_fetch_elts;
+
    vsplit->middle->run(vsplit->middle,
          vsplit->fetch_elts, vsplit->cache.num_fetch_elts,
          vsplit->draw_elts, vsplit->cache.num_draw_elts, flags);
@@ -86,41 +113,32 @@ static INLINE void
 vsplit_add_cache(struct vsplit_frontend *vsplit, unsigned fetch)
 {
    struct draw_context *draw = vsplit->draw;
+   const ushort stamp = vsplit->cache.stamp;
+   struct vsplit_cache_entry *entry;
    unsigned hash;
 
    fetch = MIN2(fetch, draw->pt.max_index);
 
-   hash = fetch % MAP_SIZE;
+   /* Fibonacci hashing, then linear probing */
+   hash = (fetch * 0x9e3779b1) >> (32 - MAP_ORDER);
+   entry = &vsplit->cache.map[hash];
+   while (entry->stamp == stamp && entry->fetch != fetch) {
+      hash = (hash + 1) & (MAP_SIZE - 1);
+      entry = &vsplit->cache.map[hash];
+   }
 
-   if (vsplit->cache.fetches[hash] != fetch) {
+   if (entry->stamp != stamp) {
       /* update cache */
-      vsplit->cache.fetches[hash] = fetch;
-      vsplit->cache.draws[hash] = vsplit->cache.num_fetch_elts;
+      entry->stamp = stamp;
+      entry->fetch = fetch;
+      entry->draw = vsplit->cache.num_fetch_elts;
 
       /* add fetch */
       assert(vsplit->cache.num_fetch_elts < vsplit->segment_size);
       vsplit->fetch_elts[vsplit->cache.num_fetch_elts++] = fetch;
    }
 
-   vsplit->draw_elts[vsplit->cache.num_draw_elts++] = vsplit->cache.draws[hash];
-}
-
-
-/**
- * Add a fetch element and add it to the draw elements.  The fetch element is
- * in full range (uint).
- */
-static INLINE void
-vsplit_add_cache_uint(struct vsplit_frontend *vsplit, unsigned fetch)
-{
-   /* special care for 0xffffffff */
-   if (fetch == 0xffffffff && !vsplit->cache.has_max_fetch) {
-      unsigned hash = fetch % MAP_SIZE;
-      vsplit->cache.fetches[hash] = fetch - 1; /* force update */
-      vsplit->cache.has_max_fetch = TRUE;
-   }
-
-   vsplit_add_cache(vsplit, fetch);
+   vsplit->draw_elts[vsplit->cache.num_draw_elts++] = entry->draw;
 }
 
 
@@ -139,7 +157,7 @@ vsplit_add_cache_uint(struct vsplit_frontend *vsplit, unsigned fetch)
 
 #define FUNC vsplit_run_uint
 #define ELT_TYPE uint
-#define ADD_CACHE(vsplit, fetch) vsplit_add_cache_uint(vsplit, fetch)
+#define ADD_CACHE(vsplit, fetch) vsplit_add_cache(vsplit, fetch)
 #include "draw_pt_vsplit_tmp.h"
 
 
@@ -108,6 +108,9 @@ CONCAT(vsplit_primitive_, ELT_TYPE)(struct vsplit_frontend *vsplit,
       draw_elts = vsplit->draw_elts;
    }
 
+   draw->pt.vcache_stats.indices += icount;
+   draw->pt.vcache_stats.vertices += fetch_count;
+
    return vsplit->middle->run_linear_elts(vsplit->middle,
                                           fetch_start, fetch_count,
                                           draw_elts, icount, 0x0);
@@ -158,10 +158,13 @@ pb_slab_range_manager_create(struct pb_manager *provider,
  * Time-based buffer cache.
  *
  * This manager keeps a cache of destroyed buffers during a time interval. 
+ * When maximum_cache_size is not zero, the least recently destroyed buffers
+ * are freed early to keep the total size of the cached buffers under it.
  */
 struct pb_manager *
 pb_cache_manager_create(struct pb_manager *provider, 
-                     	unsigned usecs); 
+                     	unsigned usecs,
+                        pb_size maximum_cache_size); 
 
 
 struct pb_fence_ops;
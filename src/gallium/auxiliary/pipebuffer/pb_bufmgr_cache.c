@@ -38,6 +38,7 @@
 #include "util/u_debug.h"
 #include "os/os_thread.h"
 #include "util/u_memory.h"
+#include "util/u_math.h"
 #include "util/u_double_list.h"
 #include "util/u_time.h"
 
@@ -51,6 +52,15 @@
 #define SUPER(__derived) (&(__derived)->base)
 
 
+/**
+ * Size classes: four per power of two, so that a buffer of a given class
+ * is never more than 25% bigger than the smallest one of the class.
+ */
+#define PB_CACHE_CLASSES_PER_POT_LOG2 2
+#define PB_CACHE_CLASSES_PER_POT (1 << PB_CACHE_CLASSES_PER_POT_LOG2)
+#define PB_CACHE_NUM_BUCKETS (32 * PB_CACHE_CLASSES_PER_POT)
+
+
 struct pb_cache_manager;
 
 
@@ -67,7 +77,26 @@ struct pb_cache_buffer
    /** Caching time interval */
    int64_t start, end;
 
+   /** Position in the manager's delayed list, oldest first */
+   struct list_head head;
+
+   /** Position in the size class bucket, oldest first */
+   struct list_head bucket_head;
+};
+
+
+/**
+ * The cached buffers with a given usage and alignment, sorted by size
+ * class.
+ */
+struct pb_cache_group
+{
    struct list_head head;
+
+   unsigned usage;
+   pb_size alignment;
+
+   struct list_head buckets[PB_CACHE_NUM_BUCKETS];
 };
 
 
@@ -77,11 +106,19 @@ struct pb_cache_manager
 
    struct pb_manager *provider;
    unsigned usecs;
+
+   /** Cap on the total size of the cached buffers, zero for no cap */
+   pb_size maximum_cache_size;
    
    pipe_mutex mutex;
    
+   /** All the cached buffers, in the order they were released */
    struct list_head delayed;
    pb_size numDelayed;
+   uint64_t cache_size;
+
+   /** List of pb_cache_group */
+   struct list_head groups;
 };
 
 
@@ -101,6 +138,57 @@ pb_cache_manager(struct pb_manager *mgr)
 }
 
 
+/**
+ * Size class of a buffer size.
+ */
+static INLINE unsigned
+pb_cache_size_class(pb_size size)
+{
+   unsigned log2, sub;
+
+   if (size < PB_CACHE_CLASSES_PER_POT)
+      return size;
+
+   log2 = util_logbase2(size);
+   sub = (size >> (log2 - PB_CACHE_CLASSES_PER_POT_LOG2)) &
+         (PB_CACHE_CLASSES_PER_POT - 1);
+
+   return (log2 << PB_CACHE_CLASSES_PER_POT_LOG2) + sub;
+}
+
+
+/**
+ * Find the group of the buffers with the given usage and alignment,
+ * creating it if needed.
+ */
+static struct pb_cache_group *
+pb_cache_get_group(struct pb_cache_manager *mgr,
+                   unsigned usage,
+                   pb_size alignment)
+{
+   struct pb_cache_group *group;
+   unsigned i;
+
+   LIST_FOR_EACH_ENTRY(group, &mgr->groups, head) {
+      if (group->usage == usage && group->alignment == alignment)
+         return group;
+   }
+
+   group = CALLOC_STRUCT(pb_cache_group);
+   if (!group)
+      return NULL;
+
+   group->usage = usage;
+   group->alignment = alignment;
+   for (i = 0; i < PB_CACHE_NUM_BUCKETS; i++)
+      LIST_INITHEAD(&group->buckets[i]);
+
+   LIST_ADDTAIL(&group->head, &mgr->groups);
+
+   return group;
+}
+
+
 /**
  * Actually destroy the buffer.
  */
@@ -110,8 +198,10 @@ _pb_cache_buffer_destroy(struct pb_cache_buffer *buf)
    struct pb_cache_manager *mgr = buf->mgr;
 
    LIST_DEL(&buf->head);
+   LIST_DEL(&buf->bucket_head);
    assert(mgr->numDelayed);
    --mgr->numDelayed;
+   mgr->cache_size -= buf->base.size;
    assert(!pipe_is_referenced(&buf->base.reference));
    pb_reference(&buf->buffer, NULL);
    FREE(buf);
@@ -151,16 +241,40 @@ pb_cache_buffer_destroy(struct pb_buffer *_buf)
 {
    struct pb_cache_buffer *buf = pb_cache_buffer(_buf);   
    struct pb_cache_manager *mgr = buf->mgr;
+   struct pb_cache_group *group;
 
    pipe_mutex_lock(mgr->mutex);
    assert(!pipe_is_referenced(&buf->base.reference));
    
    _pb_cache_buffer_list_check_free(mgr);
+
+   group = pb_cache_get_group(mgr, buf->base.usage, buf->base.alignment);
+
+   if (!group ||
+       (mgr->maximum_cache_size &&
+        buf->base.size > mgr->maximum_cache_size)) {
+      pipe_mutex_unlock(mgr->mutex);
+      pb_reference(&buf->buffer, NULL);
+      FREE(buf);
+      return;
+   }
+
+   /* Make room by evicting the least recently released buffers */
+   if (mgr->maximum_cache_size) {
+      while (mgr->cache_size + buf->base.size > mgr->maximum_cache_size) {
+         assert(!LIST_IS_EMPTY(&mgr->delayed));
+         _pb_cache_buffer_destroy(LIST_ENTRY(struct pb_cache_buffer,
+                                             mgr->delayed.next, head));
+      }
+   }
    
    buf->start = os_time_get();
    buf->end = buf->start + mgr->usecs;
    LIST_ADDTAIL(&buf->head, &mgr->delayed);
+   LIST_ADDTAIL(&buf->bucket_head,
+                &group->buckets[pb_cache_size_class(buf->base.size)]);
    ++mgr->numDelayed;
+   mgr->cache_size += buf->base.size;
    pipe_mutex_unlock(mgr->mutex);
 }
 
@@ -256,6 +370,47 @@ pb_cache_is_buffer_compat(struct pb_cache_buffer *buf,
 }
 
 
+/**
+ * Look for a compatible buffer in the cache.
+ *
+ * Only the size classes which can hold buffers between the requested size
+ * and twice that are searched, smallest class and oldest buffers first.
+ * As in the linear search this replaces, a busy buffer ends the search,
+ * since the buffers released after it are likely to be busy too.
+ */
+static struct pb_cache_buffer *
+pb_cache_find_buffer(struct pb_cache_manager *mgr,
+                     pb_size size,
+                     const struct pb_desc *desc)
+{
+   const unsigned first = pb_cache_size_class(size);
+   const unsigned last = MIN2(first + PB_CACHE_CLASSES_PER_POT,
+                              PB_CACHE_NUM_BUCKETS - 1);
+   struct pb_cache_group *group;
+   struct pb_cache_buffer *buf;
+   unsigned i;
+   int ret;
+
+   LIST_FOR_EACH_ENTRY(group, &mgr->groups, head) {
+      if(!pb_check_alignment(desc->alignment, group->alignment) ||
+         !pb_check_usage(desc->usage, group->usage))
+         continue;
+
+      for (i = first; i <= last; i++) {
+         LIST_FOR_EACH_ENTRY(buf, &group->buckets[i], bucket_head) {
+            ret = pb_cache_is_buffer_compat(buf, size, desc);
+            if (ret > 0)
+               return buf;
+            if (ret == -1)
+               return NULL;
+         }
+      }
+   }
+
+   return NULL;
+}
+
+
 static struct pb_buffer *
 pb_cache_manager_create_buffer(struct pb_manager *_mgr, 
                                pb_size size,
@@ -263,54 +418,18 @@ pb_cache_manager_create_buffer(struct pb_manager *_mgr,
 {
    struct pb_cache_manager *mgr = pb_cache_manager(_mgr);
    struct pb_cache_buffer *buf;
-   struct pb_cache_buffer *curr_buf;
-   struct list_head *curr, *next;
-   int64_t now;
-   int ret = 0;
 
    pipe_mutex_lock(mgr->mutex);
 
-   buf = NULL;
-   curr = mgr->delayed.next;
-   next = curr->next;
-   
-   /* search in the expired buffers, freeing them in the process */
-   now = os_time_get();
-   while(curr != &mgr->delayed) {
-      curr_buf = LIST_ENTRY(struct pb_cache_buffer, curr, head);
-      if(!buf && (ret = pb_cache_is_buffer_compat(curr_buf, size, desc) > 0))
-         buf = curr_buf;
-      else if(os_time_timeout(curr_buf->start, curr_buf->end, now))
-         _pb_cache_buffer_destroy(curr_buf);
-      else
-         /* This buffer (and all hereafter) are still hot in cache */
-         break;
-      if (ret == -1)
-         break;
-      curr = next; 
-      next = curr->next;
-   }
-
-   /* keep searching in the hot buffers */
-   if(!buf && ret != -1) {
-      while(curr != &mgr->delayed) {
-         curr_buf = LIST_ENTRY(struct pb_cache_buffer, curr, head);
-         ret = pb_cache_is_buffer_compat(curr_buf, size, desc);
-         if (ret > 0) {
-            buf = curr_buf;
-            break;
-         }
-         if (ret == -1)
-            break;
-         /* no need to check the timeout here */
-         curr = next;
-         next = curr->next;
-      }
-   }
+   /* free the expired buffers, then search in the remaining ones */
+   _pb_cache_buffer_list_check_free(mgr);
+   buf = pb_cache_find_buffer(mgr, size, desc);
    
    if(buf) {
       LIST_DEL(&buf->head);
+      LIST_DEL(&buf->bucket_head);
       --mgr->numDelayed;
+      mgr->cache_size -= buf->base.size;
       pipe_mutex_unlock(mgr->mutex);
       /* Increase refcount */
       pipe_reference_init(&buf->base.reference, 1);
@@ -378,16 +497,26 @@ pb_cache_manager_flush(struct pb_manager *_mgr)
 
 
 static void
-pb_cache_manager_destroy(struct pb_manager *mgr)
+pb_cache_manager_destroy(struct pb_manager *_mgr)
 {
-   pb_cache_manager_flush(mgr);
+   struct pb_cache_manager *mgr = pb_cache_manager(_mgr);
+   struct pb_cache_group *group, *next;
+
+   pb_cache_manager_flush(_mgr);
+
+   LIST_FOR_EACH_ENTRY_SAFE(group, next, &mgr->groups, head) {
+      FREE(group);
+   }
+
+   pipe_mutex_destroy(mgr->mutex);
    FREE(mgr);
 }
 
 
 struct pb_manager *
 pb_cache_manager_create(struct pb_manager *provider, 
-                     	unsigned usecs) 
+                     	unsigned usecs,
+                        pb_size maximum_cache_size) 
 {
    struct pb_cache_manager *mgr;
 
@@ -403,8 +532,11 @@ pb_cache_manager_create(struct pb_manager *provider,
    mgr->base.flush = pb_cache_manager_flush;
    mgr->provider = provider;
    mgr->usecs = usecs;
+   mgr->maximum_cache_size = maximum_cache_size;
    LIST_INITHEAD(&mgr->delayed);
    mgr->numDelayed = 0;
+   mgr->cache_size = 0;
+   LIST_INITHEAD(&mgr->groups);
    pipe_mutex_init(mgr->mutex);
       
    return &mgr->base;
@@ -48,6 +48,24 @@
 #include "pb_bufmgr.h"
 
 
+/**
+ * Free buffers are cached per thread in magazines, so that most
+ * allocations and destructions don't need to take the manager mutex.
+ * Only available where there is thread-specific data.
+ */
+#if defined(PIPE_OS_LINUX) || defined(PIPE_OS_BSD) || defined(PIPE_OS_SOLARIS) || defined(PIPE_OS_APPLE) || defined(PIPE_OS_HAIKU) || defined(PIPE_OS_CYGWIN)
+#define PB_SLAB_MAGAZINES 1
+#else
+#define PB_SLAB_MAGAZINES 0
+#endif
+
+/**
+ * Magazine capacity.  Empty magazines are refilled, and full ones
+ * drained, by half of it at a time.
+ */
+#define PB_SLAB_MAGAZINE_SIZE 32
+
+
 struct pb_slab;
 
 
@@ -95,6 +113,21 @@ struct pb_slab
 };
 
 
+/**
+ * Free buffers owned by a thread.
+ */
+struct pb_slab_magazine
+{
+   /** Position in pb_slab_manager::magazines */
+   struct list_head head;
+
+   struct pb_slab_manager *mgr;
+
+   unsigned count;
+   struct pb_slab_buffer *buffers[PB_SLAB_MAGAZINE_SIZE];
+};
+
+
 /**
  * It adds/removes slabs as needed in order to meet the allocation/destruction 
  * of individual buffers.
@@ -127,6 +160,22 @@ struct pb_slab_manager
     * immediatly.
     */
    struct list_head slabs;
+
+#if PB_SLAB_MAGAZINES
+   /** The calling thread's pb_slab_magazine */
+   pipe_tsd magazine_tsd;
+
+   /** All the magazines, so that they can be freed with the manager */
+   struct list_head magazines;
+
+   /**
+    * One reference for the manager itself, and one for each magazine.
+    * Threads may exit, and free their magazine, while or after the
+    * manager is destroyed, so its memory is freed with the last reference.
+    * Protected by the mutex.
+    */
+   unsigned refcount;
+#endif
    
    pipe_mutex mutex;
 };
@@ -188,19 +237,16 @@ pb_slab_range_manager(struct pb_manager *mgr)
 
 
 /**
- * Delete a buffer from the slab delayed list and put
- * it on the slab FREE list.
+ * Put a buffer back on its slab FREE list.
+ * Called with the manager mutex held.
  */
 static void
-pb_slab_buffer_destroy(struct pb_buffer *_buf)
+pb_slab_buffer_free_locked(struct pb_slab_buffer *buf)
 {
-   struct pb_slab_buffer *buf = pb_slab_buffer(_buf);
    struct pb_slab *slab = buf->slab;
    struct pb_slab_manager *mgr = slab->mgr;
    struct list_head *list = &buf->head;
 
-   pipe_mutex_lock(mgr->mutex);
-   
    assert(!pipe_is_referenced(&buf->base.reference));
    
    buf->mapCount = 0;
@@ -220,7 +266,127 @@ pb_slab_buffer_destroy(struct pb_buffer *_buf)
       FREE(slab->buffers);
       FREE(slab);
    }
+}
+
+
+#if PB_SLAB_MAGAZINES
+
+/**
+ * Get the calling thread's magazine, creating it if needed.
+ */
+static struct pb_slab_magazine *
+pb_slab_get_magazine(struct pb_slab_manager *mgr)
+{
+   struct pb_slab_magazine *mag;
+
+   mag = (struct pb_slab_magazine *) pipe_tsd_get(&mgr->magazine_tsd);
+   if (mag)
+      return mag;
+
+   mag = CALLOC_STRUCT(pb_slab_magazine);
+   if (!mag)
+      return NULL;
+
+   mag->mgr = mgr;
 
+   pipe_mutex_lock(mgr->mutex);
+   LIST_ADDTAIL(&mag->head, &mgr->magazines);
+   mgr->refcount++;
+   pipe_mutex_unlock(mgr->mutex);
+
+   pipe_tsd_set(&mgr->magazine_tsd, mag);
+
+   return mag;
+}
+
+
+/**
+ * Drop a reference to the manager, and free it with the last one.
+ * Called with the mutex held, which is released.
+ */
+static void
+pb_slab_manager_release_locked(struct pb_slab_manager *mgr)
+{
+   boolean last;
+
+   assert(mgr->refcount);
+   last = --mgr->refcount == 0;
+   pipe_mutex_unlock(mgr->mutex);
+
+   if (last) {
+      pipe_tsd_destroy(&mgr->magazine_tsd);
+      pipe_mutex_destroy(mgr->mutex);
+      FREE(mgr);
+   }
+}
+
+
+/**
+ * Give the buffers of an exiting thread's magazine back to their slabs,
+ * so that they don't keep the slabs alive until the manager is destroyed.
+ * Called through the thread-specific data destructor.
+ *
+ * Once the manager is destroyed, its magazines are empty, and only hold
+ * on to the manager's memory.
+ */
+static void
+pb_slab_magazine_destroy(void *data)
+{
+   struct pb_slab_magazine *mag = (struct pb_slab_magazine *) data;
+   struct pb_slab_manager *mgr = mag->mgr;
+   unsigned i;
+
+   pipe_mutex_lock(mgr->mutex);
+   for (i = 0; i < mag->count; i++)
+      pb_slab_buffer_free_locked(mag->buffers[i]);
+   LIST_DEL(&mag->head);
+   pb_slab_manager_release_locked(mgr);
+
+   FREE(mag);
+}
+
+#endif /* PB_SLAB_MAGAZINES */
+
+
+/**
+ * Delete a buffer from the slab delayed list and put
+ * it on the slab FREE list, or in the thread's magazine.
+ */
+static void
+pb_slab_buffer_destroy(struct pb_buffer *_buf)
+{
+   struct pb_slab_buffer *buf = pb_slab_buffer(_buf);
+   struct pb_slab_manager *mgr = buf->slab->mgr;
+#if PB_SLAB_MAGAZINES
+   struct pb_slab_magazine *mag = pb_slab_get_magazine(mgr);
+
+   if (mag) {
+      assert(!pipe_is_referenced(&buf->base.reference));
+
+      buf->mapCount = 0;
+
+      if (mag->count == PB_SLAB_MAGAZINE_SIZE) {
+         /* Full: give the older half back to the slabs */
+         const unsigned n = PB_SLAB_MAGAZINE_SIZE / 2;
+         unsigned i;
+
+         pipe_mutex_lock(mgr->mutex);
+         for (i = 0; i < n; i++)
+            pb_slab_buffer_free_locked(mag->buffers[i]);
+         pipe_mutex_unlock(mgr->mutex);
+
+         memmove(mag->buffers, mag->buffers + n,
+                 (mag->count - n) * sizeof mag->buffers[0]);
+         mag->count -= n;
+      }
+
+      mag->buffers[mag->count++] = buf;
+      return;
+   }
+#endif
+
+   pipe_mutex_lock(mgr->mutex);
+   pb_slab_buffer_free_locked(buf);
    pipe_mutex_unlock(mgr->mutex);
 }
 
@@ -369,15 +535,48 @@ out_err0:
 }
 
 
+/**
+ * Take a buffer from a partial slab, creating a new slab if needed.
+ * Called with the manager mutex held.
+ */
+static struct pb_slab_buffer *
+pb_slab_buffer_alloc_locked(struct pb_slab_manager *mgr)
+{
+   struct pb_slab *slab;
+   struct list_head *list;
+
+   /* Create a new slab, if we run out of partial slabs */
+   if (mgr->slabs.next == &mgr->slabs) {
+      (void) pb_slab_create(mgr);
+      if (mgr->slabs.next == &mgr->slabs)
+	 return NULL;
+   }
+   
+   /* Allocate the buffer from a partial (or just created) slab */
+   list = mgr->slabs.next;
+   slab = LIST_ENTRY(struct pb_slab, list, head);
+   
+   /* If totally full remove from the partial slab list */
+   if (--slab->numFree == 0)
+      LIST_DELINIT(list);
+
+   list = slab->freeBuffers.next;
+   LIST_DELINIT(list);
+
+   return LIST_ENTRY(struct pb_slab_buffer, list, head);
+}
+
+
 static struct pb_buffer *
 pb_slab_manager_create_buffer(struct pb_manager *_mgr,
                               pb_size size,
                               const struct pb_desc *desc)
 {
    struct pb_slab_manager *mgr = pb_slab_manager(_mgr);
-   static struct pb_slab_buffer *buf;
-   struct pb_slab *slab;
-   struct list_head *list;
+   struct pb_slab_buffer *buf;
+#if PB_SLAB_MAGAZINES
+   struct pb_slab_magazine *mag;
+#endif
 
    /* check size */
    assert(size <= mgr->bufSize);
@@ -396,30 +595,37 @@ pb_slab_manager_create_buffer(struct pb_manager *_mgr,
    if(!pb_check_usage(desc->usage, mgr->desc.usage))
       return NULL;
 
-   pipe_mutex_lock(mgr->mutex);
-   
-   /* Create a new slab, if we run out of partial slabs */
-   if (mgr->slabs.next == &mgr->slabs) {
-      (void) pb_slab_create(mgr);
-      if (mgr->slabs.next == &mgr->slabs) {
-	 pipe_mutex_unlock(mgr->mutex);
-	 return NULL;
+#if PB_SLAB_MAGAZINES
+   mag = pb_slab_get_magazine(mgr);
+   if (mag) {
+      if (!mag->count) {
+         /* Empty: refill half of it from the slabs */
+         pipe_mutex_lock(mgr->mutex);
+         while (mag->count < PB_SLAB_MAGAZINE_SIZE / 2) {
+            buf = pb_slab_buffer_alloc_locked(mgr);
+            if (!buf)
+               break;
+            mag->buffers[mag->count++] = buf;
+         }
+         pipe_mutex_unlock(mgr->mutex);
+
+         if (!mag->count)
+            return NULL;
       }
-   }
-   
-   /* Allocate the buffer from a partial (or just created) slab */
-   list = mgr->slabs.next;
-   slab = LIST_ENTRY(struct pb_slab, list, head);
-   
-   /* If totally full remove from the partial slab list */
-   if (--slab->numFree == 0)
-      LIST_DELINIT(list);
 
-   list = slab->freeBuffers.next;
-   LIST_DELINIT(list);
-
-   pipe_mutex_unlock(mgr->mutex);
-   buf = LIST_ENTRY(struct pb_slab_buffer, list, head);
+      /* The most recently freed buffer is the likeliest to be cached */
+      buf = mag->buffers[--mag->count];
+   }
+   else
+#endif
+   {
+      pipe_mutex_lock(mgr->mutex);
+      buf = pb_slab_buffer_alloc_locked(mgr);
+      pipe_mutex_unlock(mgr->mutex);
+
+      if (!buf)
+         return NULL;
+   }
    
    pipe_reference_init(&buf->base.reference, 1);
    buf->base.alignment = desc->alignment;
@@ -444,9 +650,37 @@ static void
 pb_slab_manager_destroy(struct pb_manager *_mgr)
 {
    struct pb_slab_manager *mgr = pb_slab_manager(_mgr);
+#if PB_SLAB_MAGAZINES
+   struct pb_slab_magazine *own, *mag;
+   unsigned i;
+
+   own = (struct pb_slab_magazine *) pipe_tsd_get(&mgr->magazine_tsd);
+   if (own)
+      pipe_tsd_set(&mgr->magazine_tsd, NULL);
+
+   /* Give the buffers cached by all the threads back to their slabs.  The
+    * magazines of the other threads are freed when they exit, which may be
+    * happening right now.
+    */
+   pipe_mutex_lock(mgr->mutex);
+   LIST_FOR_EACH_ENTRY(mag, &mgr->magazines, head) {
+      for (i = 0; i < mag->count; i++)
+         pb_slab_buffer_free_locked(mag->buffers[i]);
+      mag->count = 0;
+   }
+   if (own) {
+      LIST_DEL(&own->head);
+      mgr->refcount--;
+      FREE(own);
+   }
 
    /* TODO: cleanup all allocated buffers */
+   pb_slab_manager_release_locked(mgr);
+#else
+   /* TODO: cleanup all allocated buffers */
+   pipe_mutex_destroy(mgr->mutex);
    FREE(mgr);
+#endif
 }
 
 
@@ -472,6 +706,12 @@ pb_slab_manager_create(struct pb_manager *provider,
    mgr->desc = *desc;
 
    LIST_INITHEAD(&mgr->slabs);
+
+#if PB_SLAB_MAGAZINES
+   pipe_tsd_init_destructor(&mgr->magazine_tsd, pb_slab_magazine_destroy);
+   LIST_INITHEAD(&mgr->magazines);
+   mgr->refcount = 1;
+#endif
    
    pipe_mutex_init(mgr->mutex);
 
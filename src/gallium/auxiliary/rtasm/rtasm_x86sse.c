@@ -1507,6 +1507,47 @@ void sse2_rcpss( struct x86_function *p,
    emit_modrm( p, dst, src );
 }
 
+/***********************************************************************
+ * SSE4.1 instructions
+ */
+
+static void emit_sse41_pmov( struct x86_function *p,
+                             unsigned char op,
+                             struct x86_reg dst,
+                             struct x86_reg src )
+{
+   emit_2ub(p, 0x66, X86_TWOB);
+   emit_2ub(p, 0x38, op);
+   emit_modrm( p, dst, src );
+}
+
+/* Zero/sign-extend the low 4 bytes or 4 words of src, which may also be a
+ * 32-bit or 64-bit memory operand, to 4 dwords.
+ */
+void sse41_pmovzxbd( struct x86_function *p, struct x86_reg dst, struct x86_reg src )
+{
+   DUMP_RR( dst, src );
+   emit_sse41_pmov(p, 0x31, dst, src);
+}
+
+void sse41_pmovzxwd( struct x86_function *p, struct x86_reg dst, struct x86_reg src )
+{
+   DUMP_RR( dst, src );
+   emit_sse41_pmov(p, 0x33, dst, src);
+}
+
+void sse41_pmovsxbd( struct x86_function *p, struct x86_reg dst, struct x86_reg src )
+{
+   DUMP_RR( dst, src );
+   emit_sse41_pmov(p, 0x21, dst, src);
+}
+
+void sse41_pmovsxwd( struct x86_function *p, struct x86_reg dst, struct x86_reg src )
+{
+   DUMP_RR( dst, src );
+   emit_sse41_pmov(p, 0x23, dst, src);
+}
+
 /***********************************************************************
  * x87 instructions
  */
@@ -269,6 +269,11 @@ void sse2_pshuflw( struct x86_function *p, struct x86_reg dst, struct x86_reg sr
 void sse2_pshufhw( struct x86_function *p, struct x86_reg dst, struct x86_reg src, uint8_t imm );
 void sse2_pshufd( struct x86_function *p, struct x86_reg dst, struct x86_reg src, uint8_t imm );
 
+void sse41_pmovzxbd( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
+void sse41_pmovzxwd( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
+void sse41_pmovsxbd( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
+void sse41_pmovsxwd( struct x86_function *p, struct x86_reg dst, struct x86_reg src );
+
 void sse_prefetchnta( struct x86_function *p, struct x86_reg ptr);
 void sse_prefetch0( struct x86_function *p, struct x86_reg ptr);
 void sse_prefetch1( struct x86_function *p, struct x86_reg ptr);
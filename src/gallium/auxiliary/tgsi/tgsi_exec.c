@@ -61,9 +61,51 @@
 #include "util/u_memory.h"
 #include "util/u_math.h"
 
+#if defined(PIPE_ARCH_SSE)
+#include "util/u_sse.h"
+#endif
+
 
 #define FAST_MATH 0
 
+#if defined(PIPE_ARCH_SSE)
+
+/*
+ * A channel holds the four lanes of a quad, which is exactly one SSE
+ * register, so the simple float micro ops below are done with a single
+ * vector instruction.  The machine registers are not necessarily 16-byte
+ * aligned, hence the unaligned loads/stores.
+ */
+#define CHAN_LOAD(c)      _mm_loadu_ps((c)->f)
+#define CHAN_STORE(c, v)  _mm_storeu_ps((c)->f, (v))
+
+#define SSE_SIGN_MASK     _mm_castsi128_ps(_mm_set1_epi32(0x80000000))
+#define SSE_ONE           _mm_set1_ps(1.0f)
+
+/** Store the lanes of v selected by mask, keep the others. */
+static INLINE void
+chan_store_masked(union tgsi_exec_channel *dst, __m128 v, __m128 mask)
+{
+   CHAN_STORE(dst, _mm_or_ps(_mm_and_ps(mask, v),
+                             _mm_andnot_ps(mask, CHAN_LOAD(dst))));
+}
+
+/** Lane masks for each of the 16 possible values of a 4-bit exec mask */
+static const union {
+   uint u[4];
+   __m128 m;
+} ExecMaskTable[16] = {
+#define M(i) (((i) & 1) ? ~0u : 0), (((i) & 2) ? ~0u : 0), \
+             (((i) & 4) ? ~0u : 0), (((i) & 8) ? ~0u : 0)
+   { { M(0) } },  { { M(1) } },  { { M(2) } },  { { M(3) } },
+   { { M(4) } },  { { M(5) } },  { { M(6) } },  { { M(7) } },
+   { { M(8) } },  { { M(9) } },  { { M(10) } }, { { M(11) } },
+   { { M(12) } }, { { M(13) } }, { { M(14) } }, { { M(15) } }
+#undef M
+};
+
+#endif /* PIPE_ARCH_SSE */
+
 #define TILE_TOP_LEFT     0
 #define TILE_TOP_RIGHT    1
 #define TILE_BOTTOM_LEFT  2
@@ -73,10 +115,14 @@ static void
 micro_abs(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
+#if defined(PIPE_ARCH_SSE)
+   CHAN_STORE(dst, _mm_andnot_ps(SSE_SIGN_MASK, CHAN_LOAD(src)));
+#else
    dst->f[0] = fabsf(src->f[0]);
    dst->f[1] = fabsf(src->f[1]);
    dst->f[2] = fabsf(src->f[2]);
    dst->f[3] = fabsf(src->f[3]);
+#endif
 }
 
 static void
@@ -127,10 +173,16 @@ micro_cmp(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src1,
           const union tgsi_exec_channel *src2)
 {
+#if defined(PIPE_ARCH_SSE)
+   const __m128 mask = _mm_cmplt_ps(CHAN_LOAD(src0), _mm_setzero_ps());
+   CHAN_STORE(dst, _mm_or_ps(_mm_and_ps(mask, CHAN_LOAD(src1)),
+                             _mm_andnot_ps(mask, CHAN_LOAD(src2))));
+#else
    dst->f[0] = src0->f[0] < 0.0f ? src1->f[0] : src2->f[0];
    dst->f[1] = src0->f[1] < 0.0f ? src1->f[1] : src2->f[1];
    dst->f[2] = src0->f[2] < 0.0f ? src1->f[2] : src2->f[2];
    dst->f[3] = src0->f[3] < 0.0f ? src1->f[3] : src2->f[3];
+#endif
 }
 
 static void
@@ -272,10 +324,17 @@ micro_lrp(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src1,
           const union tgsi_exec_channel *src2)
 {
+#if defined(PIPE_ARCH_SSE)
+   const __m128 a = CHAN_LOAD(src0);
+   const __m128 b = CHAN_LOAD(src1);
+   const __m128 c = CHAN_LOAD(src2);
+   CHAN_STORE(dst, _mm_add_ps(_mm_mul_ps(a, _mm_sub_ps(b, c)), c));
+#else
    dst->f[0] = src0->f[0] * (src1->f[0] - src2->f[0]) + src2->f[0];
    dst->f[1] = src0->f[1] * (src1->f[1] - src2->f[1]) + src2->f[1];
    dst->f[2] = src0->f[2] * (src1->f[2] - src2->f[2]) + src2->f[2];
    dst->f[3] = src0->f[3] * (src1->f[3] - src2->f[3]) + src2->f[3];
+#endif
 }
 
 static void
@@ -284,20 +343,29 @@ micro_mad(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src1,
           const union tgsi_exec_channel *src2)
 {
+#if defined(PIPE_ARCH_SSE)
+   CHAN_STORE(dst, _mm_add_ps(_mm_mul_ps(CHAN_LOAD(src0), CHAN_LOAD(src1)),
+                              CHAN_LOAD(src2)));
+#else
    dst->f[0] = src0->f[0] * src1->f[0] + src2->f[0];
    dst->f[1] = src0->f[1] * src1->f[1] + src2->f[1];
    dst->f[2] = src0->f[2] * src1->f[2] + src2->f[2];
    dst->f[3] = src0->f[3] * src1->f[3] + src2->f[3];
+#endif
 }
 
 static void
 micro_mov(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src)
 {
+#if defined(PIPE_ARCH_SSE)
+   CHAN_STORE(dst, CHAN_LOAD(src));
+#else
    dst->u[0] = src->u[0];
    dst->u[1] = src->u[1];
    dst->u[2] = src->u[2];
    dst->u[3] = src->u[3];
+#endif
 }
 
 static void
@@ -310,10 +378,14 @@ micro_rcp(union tgsi_exec_channel *dst,
    assert(src->f[2] != 0.0f);
    assert(src->f[3] != 0.0f);
 #endif
+#if defined(PIPE_ARCH_SSE)
+   CHAN_STORE(dst, _mm_div_ps(SSE_ONE, CHAN_LOAD(src)));
+#else
    dst->f[0] = 1.0f / src->f[0];
    dst->f[1] = 1.0f / src->f[1];
    dst->f[2] = 1.0f / src->f[2];
    dst->f[3] = 1.0f / src->f[3];
+#endif
 }
 
 static void
@@ -336,10 +408,15 @@ micro_rsq(union tgsi_exec_channel *dst,
    assert(src->f[2] != 0.0f);
    assert(src->f[3] != 0.0f);
 #endif
+#if defined(PIPE_ARCH_SSE)
+   const __m128 a = _mm_andnot_ps(SSE_SIGN_MASK, CHAN_LOAD(src));
+   CHAN_STORE(dst, _mm_div_ps(SSE_ONE, _mm_sqrt_ps(a)));
+#else
    dst->f[0] = 1.0f / sqrtf(fabsf(src->f[0]));
    dst->f[1] = 1.0f / sqrtf(fabsf(src->f[1]));
    dst->f[2] = 1.0f / sqrtf(fabsf(src->f[2]));
    dst->f[3] = 1.0f / sqrtf(fabsf(src->f[3]));
+#endif
 }
 
 static void
@@ -347,10 +424,15 @@ micro_seq(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   CHAN_STORE(dst, _mm_and_ps(_mm_cmpeq_ps(CHAN_LOAD(src0), CHAN_LOAD(src1)),
+                              SSE_ONE));
+#else
    dst->f[0] = src0->f[0] == src1->f[0] ? 1.0f : 0.0f;
    dst->f[1] = src0->f[1] == src1->f[1] ? 1.0f : 0.0f;
    dst->f[2] = src0->f[2] == src1->f[2] ? 1.0f : 0.0f;
    dst->f[3] = src0->f[3] == src1->f[3] ? 1.0f : 0.0f;
+#endif
 }
 
 static void
@@ -358,10 +440,15 @@ micro_sge(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   CHAN_STORE(dst, _mm_and_ps(_mm_cmpge_ps(CHAN_LOAD(src0), CHAN_LOAD(src1)),
+                              SSE_ONE));
+#else
    dst->f[0] = src0->f[0] >= src1->f[0] ? 1.0f : 0.0f;
    dst->f[1] = src0->f[1] >= src1->f[1] ? 1.0f : 0.0f;
    dst->f[2] = src0->f[2] >= src1->f[2] ? 1.0f : 0.0f;
    dst->f[3] = src0->f[3] >= src1->f[3] ? 1.0f : 0.0f;
+#endif
 }
 
 static void
@@ -389,10 +476,15 @@ micro_sgt(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   CHAN_STORE(dst, _mm_and_ps(_mm_cmpgt_ps(CHAN_LOAD(src0), CHAN_LOAD(src1)),
+                              SSE_ONE));
+#else
    dst->f[0] = src0->f[0] > src1->f[0] ? 1.0f : 0.0f;
    dst->f[1] = src0->f[1] > src1->f[1] ? 1.0f : 0.0f;
    dst->f[2] = src0->f[2] > src1->f[2] ? 1.0f : 0.0f;
    dst->f[3] = src0->f[3] > src1->f[3] ? 1.0f : 0.0f;
+#endif
 }
 
 static void
@@ -410,10 +502,15 @@ micro_sle(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   CHAN_STORE(dst, _mm_and_ps(_mm_cmple_ps(CHAN_LOAD(src0), CHAN_LOAD(src1)),
+                              SSE_ONE));
+#else
    dst->f[0] = src0->f[0] <= src1->f[0] ? 1.0f : 0.0f;
    dst->f[1] = src0->f[1] <= src1->f[1] ? 1.0f : 0.0f;
    dst->f[2] = src0->f[2] <= src1->f[2] ? 1.0f : 0.0f;
    dst->f[3] = src0->f[3] <= src1->f[3] ? 1.0f : 0.0f;
+#endif
 }
 
 static void
@@ -421,10 +518,15 @@ micro_slt(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   CHAN_STORE(dst, _mm_and_ps(_mm_cmplt_ps(CHAN_LOAD(src0), CHAN_LOAD(src1)),
+                              SSE_ONE));
+#else
    dst->f[0] = src0->f[0] < src1->f[0] ? 1.0f : 0.0f;
    dst->f[1] = src0->f[1] < src1->f[1] ? 1.0f : 0.0f;
    dst->f[2] = src0->f[2] < src1->f[2] ? 1.0f : 0.0f;
    dst->f[3] = src0->f[3] < src1->f[3] ? 1.0f : 0.0f;
+#endif
 }
 
 static void
@@ -432,10 +534,15 @@ micro_sne(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   CHAN_STORE(dst, _mm_and_ps(_mm_cmpneq_ps(CHAN_LOAD(src0), CHAN_LOAD(src1)),
+                              SSE_ONE));
+#else
    dst->f[0] = src0->f[0] != src1->f[0] ? 1.0f : 0.0f;
    dst->f[1] = src0->f[1] != src1->f[1] ? 1.0f : 0.0f;
    dst->f[2] = src0->f[2] != src1->f[2] ? 1.0f : 0.0f;
    dst->f[3] = src0->f[3] != src1->f[3] ? 1.0f : 0.0f;
+#endif
 }
 
 static void
@@ -619,6 +726,9 @@ tgsi_check_soa_dependencies(const struct tgsi_full_instruction *inst)
 }
 
 
+static void
+decode_instructions(struct tgsi_exec_machine *mach);
+
 /**
  * Initialize machine state by expanding tokens to full instructions,
  * allocating temporary storage, setting up constants, etc.
@@ -661,6 +771,9 @@ tgsi_exec_machine_bind_shader(
       mach->Instructions = NULL;
       mach->NumInstructions = 0;
 
+      FREE(mach->Code);
+      mach->Code = NULL;
+
       return;
    }
 
@@ -807,6 +920,8 @@ tgsi_exec_machine_bind_shader(
    FREE(mach->Instructions);
    mach->Instructions = instructions;
    mach->NumInstructions = numInstructions;
+
+   decode_instructions(mach);
 }
 
 
@@ -869,6 +984,7 @@ tgsi_exec_machine_destroy(struct tgsi_exec_machine *mach)
    if (mach) {
       FREE(mach->Instructions);
       FREE(mach->Declarations);
+      FREE(mach->Code);
 
       align_free(mach->Inputs);
       align_free(mach->Outputs);
@@ -882,10 +998,14 @@ micro_add(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   CHAN_STORE(dst, _mm_add_ps(CHAN_LOAD(src0), CHAN_LOAD(src1)));
+#else
    dst->f[0] = src0->f[0] + src1->f[0];
    dst->f[1] = src0->f[1] + src1->f[1];
    dst->f[2] = src0->f[2] + src1->f[2];
    dst->f[3] = src0->f[3] + src1->f[3];
+#endif
 }
 
 static void
@@ -961,10 +1081,14 @@ micro_max(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   CHAN_STORE(dst, _mm_max_ps(CHAN_LOAD(src0), CHAN_LOAD(src1)));
+#else
    dst->f[0] = src0->f[0] > src1->f[0] ? src0->f[0] : src1->f[0];
    dst->f[1] = src0->f[1] > src1->f[1] ? src0->f[1] : src1->f[1];
    dst->f[2] = src0->f[2] > src1->f[2] ? src0->f[2] : src1->f[2];
    dst->f[3] = src0->f[3] > src1->f[3] ? src0->f[3] : src1->f[3];
+#endif
 }
 
 static void
@@ -972,10 +1096,14 @@ micro_min(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   CHAN_STORE(dst, _mm_min_ps(CHAN_LOAD(src0), CHAN_LOAD(src1)));
+#else
    dst->f[0] = src0->f[0] < src1->f[0] ? src0->f[0] : src1->f[0];
    dst->f[1] = src0->f[1] < src1->f[1] ? src0->f[1] : src1->f[1];
    dst->f[2] = src0->f[2] < src1->f[2] ? src0->f[2] : src1->f[2];
    dst->f[3] = src0->f[3] < src1->f[3] ? src0->f[3] : src1->f[3];
+#endif
 }
 
 static void
@@ -983,10 +1111,14 @@ micro_mul(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   CHAN_STORE(dst, _mm_mul_ps(CHAN_LOAD(src0), CHAN_LOAD(src1)));
+#else
    dst->f[0] = src0->f[0] * src1->f[0];
    dst->f[1] = src0->f[1] * src1->f[1];
    dst->f[2] = src0->f[2] * src1->f[2];
    dst->f[3] = src0->f[3] * src1->f[3];
+#endif
 }
 
 static void
@@ -994,10 +1126,14 @@ micro_neg(
    union tgsi_exec_channel *dst,
    const union tgsi_exec_channel *src )
 {
+#if defined(PIPE_ARCH_SSE)
+   CHAN_STORE(dst, _mm_xor_ps(CHAN_LOAD(src), SSE_SIGN_MASK));
+#else
    dst->f[0] = -src->f[0];
    dst->f[1] = -src->f[1];
    dst->f[2] = -src->f[2];
    dst->f[3] = -src->f[3];
+#endif
 }
 
 static void
@@ -1024,10 +1160,14 @@ micro_sub(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1)
 {
+#if defined(PIPE_ARCH_SSE)
+   CHAN_STORE(dst, _mm_sub_ps(CHAN_LOAD(src0), CHAN_LOAD(src1)));
+#else
    dst->f[0] = src0->f[0] - src1->f[0];
    dst->f[1] = src0->f[1] - src1->f[1];
    dst->f[2] = src0->f[2] - src1->f[2];
    dst->f[3] = src0->f[3] - src1->f[3];
+#endif
 }
 
 static void
@@ -1169,6 +1309,92 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
    }
 }
 
+/**
+ * Fetch a directly addressed register, which is by far the most common
+ * case: all four lanes read the same register, so the channel is copied
+ * or broadcast at once instead of being resolved lane by lane.
+ * Returns FALSE if the register file must go through the generic path.
+ */
+static INLINE boolean
+fetch_source_direct(const struct tgsi_exec_machine *mach,
+                    union tgsi_exec_channel *chan,
+                    const struct tgsi_full_src_register *reg,
+                    const uint swizzle)
+{
+   const int index = reg->Register.Index;
+   uint value;
+
+   assert(swizzle < 4);
+
+   switch (reg->Register.File) {
+   case TGSI_FILE_TEMPORARY:
+      assert(index < TGSI_EXEC_NUM_TEMPS);
+      micro_mov(chan, &mach->Temps[index].xyzw[swizzle]);
+      return TRUE;
+
+   case TGSI_FILE_INPUT:
+      assert(index >= 0 && index < TGSI_EXEC_MAX_INPUT_ATTRIBS);
+      micro_mov(chan, &mach->Inputs[index].xyzw[swizzle]);
+      return TRUE;
+
+   case TGSI_FILE_OUTPUT:
+      assert(index >= 0);
+      micro_mov(chan, &mach->Outputs[index].xyzw[swizzle]);
+      return TRUE;
+
+   case TGSI_FILE_IMMEDIATE:
+      assert(index >= 0 && index < (int)mach->ImmLimit);
+      chan->f[0] =
+      chan->f[1] =
+      chan->f[2] =
+      chan->f[3] = mach->Imms[index][swizzle];
+      return TRUE;
+
+   case TGSI_FILE_CONSTANT:
+      assert(mach->Consts[0]);
+      if (index < 0) {
+         value = 0;
+      } else {
+         const int pos = index * 4 + swizzle;
+         /* const buffer bounds check */
+         if (pos >= mach->ConstsSize[0])
+            value = 0;
+         else
+            value = ((const uint *)mach->Consts[0])[pos];
+      }
+      chan->u[0] =
+      chan->u[1] =
+      chan->u[2] =
+      chan->u[3] = value;
+      return TRUE;
+
+   default:
+      return FALSE;
+   }
+}
+
+static void
+apply_source_modifiers(union tgsi_exec_channel *chan,
+                       const struct tgsi_full_src_register *reg,
+                       enum tgsi_exec_datatype src_datatype)
+{
+   if (reg->Register.Absolute) {
+      if (src_datatype == TGSI_EXEC_DATA_FLOAT) {
+         micro_abs(chan, chan);
+      } else {
+         micro_iabs(chan, chan);
+      }
+   }
+
+   if (reg->Register.Negate) {
+      if (src_datatype == TGSI_EXEC_DATA_FLOAT) {
+         micro_neg(chan, chan);
+      } else {
+         micro_ineg(chan, chan);
+      }
+   }
+}
+
 static void
 fetch_source(const struct tgsi_exec_machine *mach,
              union tgsi_exec_channel *chan,
@@ -1180,6 +1406,14 @@ fetch_source(const struct tgsi_exec_machine *mach,
    union tgsi_exec_channel index2D;
    uint swizzle;
 
+   if (!reg->Register.Indirect && !reg->Register.Dimension) {
+      swizzle = tgsi_util_get_full_src_register_swizzle(reg, chan_index);
+      if (fetch_source_direct(mach, chan, reg, swizzle)) {
+         apply_source_modifiers(chan, reg, src_datatype);
+         return;
+      }
+   }
+
    /* We start with a direct index into a register file.
     *
     *    file[1],
@@ -1319,21 +1553,81 @@ fetch_source(const struct tgsi_exec_machine *mach,
                           &index2D,
                           chan);
 
-   if (reg->Register.Absolute) {
-      if (src_datatype == TGSI_EXEC_DATA_FLOAT) {
-         micro_abs(chan, chan);
-      } else {
-         micro_iabs(chan, chan);
-      }
+   apply_source_modifiers(chan, reg, src_datatype);
+}
+
+/**
+ * Write the lanes of chan enabled in execmask to dst, applying the
+ * instruction saturation mode.
+ */
+static INLINE void
+store_dest_channel(union tgsi_exec_channel *dst,
+                   const union tgsi_exec_channel *chan,
+                   uint execmask,
+                   uint saturate)
+{
+#if defined(PIPE_ARCH_SSE)
+   __m128 value = CHAN_LOAD(chan);
+
+   /* The clamp constant goes first so that NaNs are passed through,
+    * like the scalar comparisons do.
+    */
+   switch (saturate) {
+   case TGSI_SAT_NONE:
+      break;
+   case TGSI_SAT_ZERO_ONE:
+      value = _mm_min_ps(SSE_ONE, _mm_max_ps(_mm_setzero_ps(), value));
+      break;
+   case TGSI_SAT_MINUS_PLUS_ONE:
+      value = _mm_min_ps(SSE_ONE, _mm_max_ps(_mm_set1_ps(-1.0f), value));
+      break;
+   default:
+      assert( 0 );
    }
 
-   if (reg->Register.Negate) {
-      if (src_datatype == TGSI_EXEC_DATA_FLOAT) {
-         micro_neg(chan, chan);
-      } else {
-         micro_ineg(chan, chan);
-      }
+   execmask &= 0xf;
+   if (execmask == 0xf)
+      CHAN_STORE(dst, value);
+   else if (execmask)
+      chan_store_masked(dst, value, ExecMaskTable[execmask].m);
+#else
+   uint i;
+
+   switch (saturate) {
+   case TGSI_SAT_NONE:
+      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+         if (execmask & (1 << i))
+            dst->i[i] = chan->i[i];
+      break;
+
+   case TGSI_SAT_ZERO_ONE:
+      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+         if (execmask & (1 << i)) {
+            if (chan->f[i] < 0.0f)
+               dst->f[i] = 0.0f;
+            else if (chan->f[i] > 1.0f)
+               dst->f[i] = 1.0f;
+            else
+               dst->i[i] = chan->i[i];
+         }
+      break;
+
+   case TGSI_SAT_MINUS_PLUS_ONE:
+      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+         if (execmask & (1 << i)) {
+            if (chan->f[i] < -1.0f)
+               dst->f[i] = -1.0f;
+            else if (chan->f[i] > 1.0f)
+               dst->f[i] = 1.0f;
+            else
+               dst->i[i] = chan->i[i];
+         }
+      break;
+
+   default:
+      assert( 0 );
    }
+#endif
 }
 
 static void
@@ -1559,40 +1853,7 @@ store_dest(struct tgsi_exec_machine *mach,
       }
    }
 
-   switch (inst->Instruction.Saturate) {
-   case TGSI_SAT_NONE:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
-         if (execmask & (1 << i))
-            dst->i[i] = chan->i[i];
-      break;
-
-   case TGSI_SAT_ZERO_ONE:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
-         if (execmask & (1 << i)) {
-            if (chan->f[i] < 0.0f)
-               dst->f[i] = 0.0f;
-            else if (chan->f[i] > 1.0f)
-               dst->f[i] = 1.0f;
-            else
-               dst->i[i] = chan->i[i];
-         }
-      break;
-
-   case TGSI_SAT_MINUS_PLUS_ONE:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
-         if (execmask & (1 << i)) {
-            if (chan->f[i] < -1.0f)
-               dst->f[i] = -1.0f;
-            else if (chan->f[i] > 1.0f)
-               dst->f[i] = 1.0f;
-            else
-               dst->i[i] = chan->i[i];
-         }
-      break;
-
-   default:
-      assert( 0 );
-   }
+   store_dest_channel(dst, chan, execmask, inst->Instruction.Saturate);
 }
 
 #define FETCH(VAL,INDEX,CHAN)\
@@ -4217,6 +4478,536 @@ exec_instruction(
 #define DEBUG_EXECUTION 0
 
 
+/*
+ * Pre-decoded instructions.
+ *
+ * exec_instruction() decodes the register files, swizzles and modifiers of
+ * an instruction every time a quad goes through it.  When a shader is
+ * bound, the plain float arithmetic on directly addressed registers, which
+ * makes up most shaders, is lowered into tgsi_exec_decoded_inst records.
+ * These hold the channel pointers of the operands with the swizzles already
+ * applied, the immediates already splatted and the handler to run.  Runs of
+ * such instructions are then executed by exec_decoded() with a threaded
+ * dispatch.  Everything else (flow control, texturing, indirect addressing,
+ * predication, integer ops...) goes through exec_instruction() as before.
+ */
+
+enum exec_op {
+   EXEC_OP_GENERIC = 0,    /**< not decoded, use exec_instruction() */
+   EXEC_OP_MOV,
+   EXEC_OP_ADD,
+   EXEC_OP_MUL,
+   EXEC_OP_MAD,
+   EXEC_OP_DP3,
+   EXEC_OP_DP4,
+   EXEC_OP_UNARY,          /**< micro.unary over each channel */
+   EXEC_OP_BINARY,         /**< micro.binary over each channel */
+   EXEC_OP_TRINARY,        /**< micro.trinary over each channel */
+   EXEC_OP_SCALAR_UNARY,   /**< micro.unary on src.x, replicated */
+   EXEC_OP_COUNT
+};
+
+struct tgsi_exec_decoded_src
+{
+   /** Swizzled source channel, or NULL for constants */
+   const union tgsi_exec_channel *chan[TGSI_NUM_CHANNELS];
+
+   /** Position in constant buffer 0, for constants */
+   int const_pos[TGSI_NUM_CHANNELS];
+
+   /** Splatted immediate values, which chan[] points to */
+   union tgsi_exec_channel imm[TGSI_NUM_CHANNELS];
+
+   boolean absolute;
+   boolean negate;
+};
+
+struct tgsi_exec_decoded_inst
+{
+   enum exec_op op;
+   union {
+      micro_unary_op unary;
+      micro_binary_op binary;
+      micro_trinary_op trinary;
+   } micro;
+   uint writemask;
+   uint saturate;
+   union tgsi_exec_channel *dst[TGSI_NUM_CHANNELS];
+   struct tgsi_exec_decoded_src src[3];
+};
+
+
+static boolean
+decode_src(const struct tgsi_exec_machine *mach,
+           struct tgsi_exec_decoded_src *src,
+           const struct tgsi_full_src_register *reg)
+{
+   const int index = reg->Register.Index;
+   uint chan;
+
+   if (reg->Register.Indirect || reg->Register.Dimension || index < 0)
+      return FALSE;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      const uint swizzle = tgsi_util_get_full_src_register_swizzle(reg, chan);
+
+      switch (reg->Register.File) {
+      case TGSI_FILE_TEMPORARY:
+         if (index >= TGSI_EXEC_NUM_TEMPS)
+            return FALSE;
+         src->chan[chan] = &mach->Temps[index].xyzw[swizzle];
+         break;
+
+      case TGSI_FILE_INPUT:
+         if (index >= PIPE_MAX_ATTRIBS)
+            return FALSE;
+         src->chan[chan] = &mach->Inputs[index].xyzw[swizzle];
+         break;
+
+      case TGSI_FILE_OUTPUT:
+         if (index >= PIPE_MAX_ATTRIBS)
+            return FALSE;
+         src->chan[chan] = &mach->Outputs[index].xyzw[swizzle];
+         break;
+
+      case TGSI_FILE_IMMEDIATE:
+         if (index >= (int) mach->ImmLimit)
+            return FALSE;
+         src->imm[chan].f[0] =
+         src->imm[chan].f[1] =
+         src->imm[chan].f[2] =
+         src->imm[chan].f[3] = mach->Imms[index][swizzle];
+         src->chan[chan] = &src->imm[chan];
+         break;
+
+      case TGSI_FILE_CONSTANT:
+         /* the buffer may change after the shader is bound */
+         src->chan[chan] = NULL;
+         src->const_pos[chan] = index * 4 + swizzle;
+         break;
+
+      default:
+         return FALSE;
+      }
+   }
+
+   src->absolute = reg->Register.Absolute;
+   src->negate = reg->Register.Negate;
+   return TRUE;
+}
+
+static boolean
+decode_dst(struct tgsi_exec_machine *mach,
+           struct tgsi_exec_decoded_inst *code,
+           const struct tgsi_full_dst_register *reg)
+{
+   const int index = reg->Register.Index;
+   uint chan;
+
+   if (reg->Register.Indirect || reg->Register.Dimension || index < 0)
+      return FALSE;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      switch (reg->Register.File) {
+      case TGSI_FILE_TEMPORARY:
+         if (index >= TGSI_EXEC_NUM_TEMPS)
+            return FALSE;
+         code->dst[chan] = &mach->Temps[index].xyzw[chan];
+         break;
+
+      case TGSI_FILE_OUTPUT:
+         /* geometry shaders offset the outputs by the emitted vertices */
+         if (mach->Processor == TGSI_PROCESSOR_GEOMETRY ||
+             index >= PIPE_MAX_ATTRIBS)
+            return FALSE;
+         code->dst[chan] = &mach->Outputs[index].xyzw[chan];
+         break;
+
+      default:
+         return FALSE;
+      }
+   }
+
+   code->writemask = reg->Register.WriteMask;
+   return TRUE;
+}
+
+static void
+decode_instruction(struct tgsi_exec_machine *mach,
+                   struct tgsi_exec_decoded_inst *code,
+                   const struct tgsi_full_instruction *inst)
+{
+   enum exec_op op;
+   uint num_src, i;
+
+   code->op = EXEC_OP_GENERIC;
+
+   switch (inst->Instruction.Opcode) {
+   case TGSI_OPCODE_MOV:
+      op = EXEC_OP_MOV;
+      break;
+   case TGSI_OPCODE_ADD:
+      op = EXEC_OP_ADD;
+      break;
+   case TGSI_OPCODE_MUL:
+      op = EXEC_OP_MUL;
+      break;
+   case TGSI_OPCODE_MAD:
+      op = EXEC_OP_MAD;
+      break;
+   case TGSI_OPCODE_DP3:
+      op = EXEC_OP_DP3;
+      break;
+   case TGSI_OPCODE_DP4:
+      op = EXEC_OP_DP4;
+      break;
+   case TGSI_OPCODE_ABS:
+      op = EXEC_OP_UNARY;
+      code->micro.unary = micro_abs;
+      break;
+   case TGSI_OPCODE_FLR:
+      op = EXEC_OP_UNARY;
+      code->micro.unary = micro_flr;
+      break;
+   case TGSI_OPCODE_FRC:
+      op = EXEC_OP_UNARY;
+      code->micro.unary = micro_frc;
+      break;
+   case TGSI_OPCODE_SUB:
+      op = EXEC_OP_BINARY;
+      code->micro.binary = micro_sub;
+      break;
+   case TGSI_OPCODE_MIN:
+      op = EXEC_OP_BINARY;
+      code->micro.binary = micro_min;
+      break;
+   case TGSI_OPCODE_MAX:
+      op = EXEC_OP_BINARY;
+      code->micro.binary = micro_max;
+      break;
+   case TGSI_OPCODE_SLT:
+      op = EXEC_OP_BINARY;
+      code->micro.binary = micro_slt;
+      break;
+   case TGSI_OPCODE_SGE:
+      op = EXEC_OP_BINARY;
+      code->micro.binary = micro_sge;
+      break;
+   case TGSI_OPCODE_SEQ:
+      op = EXEC_OP_BINARY;
+      code->micro.binary = micro_seq;
+      break;
+   case TGSI_OPCODE_SNE:
+      op = EXEC_OP_BINARY;
+      code->micro.binary = micro_sne;
+      break;
+   case TGSI_OPCODE_LRP:
+      op = EXEC_OP_TRINARY;
+      code->micro.trinary = micro_lrp;
+      break;
+   case TGSI_OPCODE_CMP:
+      op = EXEC_OP_TRINARY;
+      code->micro.trinary = micro_cmp;
+      break;
+   case TGSI_OPCODE_RCP:
+      op = EXEC_OP_SCALAR_UNARY;
+      code->micro.unary = micro_rcp;
+      break;
+   case TGSI_OPCODE_RSQ:
+      op = EXEC_OP_SCALAR_UNARY;
+      code->micro.unary = micro_rsq;
+      break;
+   default:
+      return;
+   }
+
+   num_src = inst->Instruction.NumSrcRegs;
+   if (inst->Instruction.NumDstRegs != 1 ||
+       num_src > Elements(code->src) ||
+       inst->Instruction.Predicate)
+      return;
+
+   if (!decode_dst(mach, code, &inst->Dst[0]))
+      return;
+
+   for (i = 0; i < num_src; i++) {
+      if (!decode_src(mach, &code->src[i], &inst->Src[i]))
+         return;
+   }
+
+   code->saturate = inst->Instruction.Saturate;
+   code->op = op;
+}
+
+/**
+ * Decode the instructions of the bound shader, see above.  An extra
+ * generic entry terminates the array.
+ */
+static void
+decode_instructions(struct tgsi_exec_machine *mach)
+{
+   uint i;
+
+   FREE(mach->Code);
+   mach->Code = NULL;
+
+#if DEBUG_EXECUTION
+   /* instructions are traced one by one by tgsi_exec_machine_run() */
+   return;
+#endif
+
+   if (!mach->NumInstructions)
+      return;
+
+   mach->Code = CALLOC(mach->NumInstructions + 1, sizeof(*mach->Code));
+   if (!mach->Code)
+      return;
+
+   for (i = 0; i < mach->NumInstructions; i++)
+      decode_instruction(mach, &mach->Code[i], &mach->Instructions[i]);
+}
+
+
+static INLINE const union tgsi_exec_channel *
+fetch_decoded(const struct tgsi_exec_machine *mach,
+              const struct tgsi_exec_decoded_src *src,
+              uint chan,
+              union tgsi_exec_channel *tmp)
+{
+   const union tgsi_exec_channel *val = src->chan[chan];
+
+   if (!val) {
+      const int pos = src->const_pos[chan];
+      uint value = 0;
+
+      assert(mach->Consts[0]);
+      /* const buffer bounds check */
+      if (pos < mach->ConstsSize[0])
+         value = ((const uint *) mach->Consts[0])[pos];
+
+      tmp->u[0] =
+      tmp->u[1] =
+      tmp->u[2] =
+      tmp->u[3] = value;
+      val = tmp;
+   }
+
+   if (src->absolute) {
+      micro_abs(tmp, val);
+      val = tmp;
+   }
+   if (src->negate) {
+      micro_neg(tmp, val);
+      val = tmp;
+   }
+
+   return val;
+}
+
+static INLINE void
+store_decoded(struct tgsi_exec_machine *mach,
+              const struct tgsi_exec_decoded_inst *code,
+              const struct tgsi_exec_vector *result)
+{
+   uint chan;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (code->writemask & (1 << chan)) {
+         store_dest_channel(code->dst[chan], &result->xyzw[chan],
+                            mach->ExecMask, code->saturate);
+      }
+   }
+}
+
+static INLINE void
+store_decoded_scalar(struct tgsi_exec_machine *mach,
+                     const struct tgsi_exec_decoded_inst *code,
+                     const union tgsi_exec_channel *result)
+{
+   uint chan;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (code->writemask & (1 << chan)) {
+         store_dest_channel(code->dst[chan], result,
+                            mach->ExecMask, code->saturate);
+      }
+   }
+}
+
+
+/*
+ * With GCC the handlers jump straight to each other through a table of
+ * label addresses, otherwise they are the cases of a switch in a loop.
+ */
+#if defined(PIPE_CC_GCC)
+#define EXEC_DISPATCH_GOTO 1
+#else
+#define EXEC_DISPATCH_GOTO 0
+#endif
+
+/**
+ * Execute the decoded instructions starting at pc, until reaching one that
+ * was not decoded.  Returns the pc of that instruction.
+ */
+static int
+exec_decoded(struct tgsi_exec_machine *mach, int pc)
+{
+   const struct tgsi_exec_decoded_inst *code = &mach->Code[pc];
+   struct tgsi_exec_vector result;
+   union tgsi_exec_channel tmp[3];
+   const union tgsi_exec_channel *a, *b, *c;
+   uint chan;
+
+#if EXEC_DISPATCH_GOTO
+   static const void *const dispatch[EXEC_OP_COUNT] = {
+      &&L_EXEC_OP_GENERIC,
+      &&L_EXEC_OP_MOV,
+      &&L_EXEC_OP_ADD,
+      &&L_EXEC_OP_MUL,
+      &&L_EXEC_OP_MAD,
+      &&L_EXEC_OP_DP3,
+      &&L_EXEC_OP_DP4,
+      &&L_EXEC_OP_UNARY,
+      &&L_EXEC_OP_BINARY,
+      &&L_EXEC_OP_TRINARY,
+      &&L_EXEC_OP_SCALAR_UNARY
+   };
+#define OP(op)      L_##op
+#define NEXT()      do { code++; pc++; goto *dispatch[code->op]; } while (0)
+
+   goto *dispatch[code->op];
+#else
+#define OP(op)      case op
+#define NEXT()      do { code++; pc++; } while (0); continue
+
+   for (;;) switch (code->op) {
+#endif
+
+   OP(EXEC_OP_GENERIC):
+      return pc;
+
+   OP(EXEC_OP_MOV):
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         if (code->writemask & (1 << chan)) {
+            a = fetch_decoded(mach, &code->src[0], chan, &tmp[0]);
+            micro_mov(&result.xyzw[chan], a);
+         }
+      }
+      store_decoded(mach, code, &result);
+      NEXT();
+
+   OP(EXEC_OP_ADD):
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         if (code->writemask & (1 << chan)) {
+            a = fetch_decoded(mach, &code->src[0], chan, &tmp[0]);
+            b = fetch_decoded(mach, &code->src[1], chan, &tmp[1]);
+            micro_add(&result.xyzw[chan], a, b);
+         }
+      }
+      store_decoded(mach, code, &result);
+      NEXT();
+
+   OP(EXEC_OP_MUL):
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         if (code->writemask & (1 << chan)) {
+            a = fetch_decoded(mach, &code->src[0], chan, &tmp[0]);
+            b = fetch_decoded(mach, &code->src[1], chan, &tmp[1]);
+            micro_mul(&result.xyzw[chan], a, b);
+         }
+      }
+      store_decoded(mach, code, &result);
+      NEXT();
+
+   OP(EXEC_OP_MAD):
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         if (code->writemask & (1 << chan)) {
+            a = fetch_decoded(mach, &code->src[0], chan, &tmp[0]);
+            b = fetch_decoded(mach, &code->src[1], chan, &tmp[1]);
+            c = fetch_decoded(mach, &code->src[2], chan, &tmp[2]);
+            micro_mad(&result.xyzw[chan], a, b, c);
+         }
+      }
+      store_decoded(mach, code, &result);
+      NEXT();
+
+   OP(EXEC_OP_DP3):
+      a = fetch_decoded(mach, &code->src[0], TGSI_CHAN_X, &tmp[0]);
+      b = fetch_decoded(mach, &code->src[1], TGSI_CHAN_X, &tmp[1]);
+      micro_mul(&result.xyzw[0], a, b);
+      for (chan = TGSI_CHAN_Y; chan <= TGSI_CHAN_Z; chan++) {
+         a = fetch_decoded(mach, &code->src[0], chan, &tmp[0]);
+         b = fetch_decoded(mach, &code->src[1], chan, &tmp[1]);
+         micro_mad(&result.xyzw[0], a, b, &result.xyzw[0]);
+      }
+      store_decoded_scalar(mach, code, &result.xyzw[0]);
+      NEXT();
+
+   OP(EXEC_OP_DP4):
+      a = fetch_decoded(mach, &code->src[0], TGSI_CHAN_X, &tmp[0]);
+      b = fetch_decoded(mach, &code->src[1], TGSI_CHAN_X, &tmp[1]);
+      micro_mul(&result.xyzw[0], a, b);
+      for (chan = TGSI_CHAN_Y; chan <= TGSI_CHAN_W; chan++) {
+         a = fetch_decoded(mach, &code->src[0], chan, &tmp[0]);
+         b = fetch_decoded(mach, &code->src[1], chan, &tmp[1]);
+         micro_mad(&result.xyzw[0], a, b, &result.xyzw[0]);
+      }
+      store_decoded_scalar(mach, code, &result.xyzw[0]);
+      NEXT();
+
+   OP(EXEC_OP_UNARY):
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         if (code->writemask & (1 << chan)) {
+            a = fetch_decoded(mach, &code->src[0], chan, &tmp[0]);
+            code->micro.unary(&result.xyzw[chan], a);
+         }
+      }
+      store_decoded(mach, code, &result);
+      NEXT();
+
+   OP(EXEC_OP_BINARY):
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         if (code->writemask & (1 << chan)) {
+            a = fetch_decoded(mach, &code->src[0], chan, &tmp[0]);
+            b = fetch_decoded(mach, &code->src[1], chan, &tmp[1]);
+            code->micro.binary(&result.xyzw[chan], a, b);
+         }
+      }
+      store_decoded(mach, code, &result);
+      NEXT();
+
+   OP(EXEC_OP_TRINARY):
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         if (code->writemask & (1 << chan)) {
+            a = fetch_decoded(mach, &code->src[0], chan, &tmp[0]);
+            b = fetch_decoded(mach, &code->src[1], chan, &tmp[1]);
+            c = fetch_decoded(mach, &code->src[2], chan, &tmp[2]);
+            code->micro.trinary(&result.xyzw[chan], a, b, c);
+         }
+      }
+      store_decoded(mach, code, &result);
+      NEXT();
+
+   OP(EXEC_OP_SCALAR_UNARY):
+      a = fetch_decoded(mach, &code->src[0], TGSI_CHAN_X, &tmp[0]);
+      code->micro.unary(&result.xyzw[0], a);
+      store_decoded_scalar(mach, code, &result.xyzw[0]);
+      NEXT();
+
+#if !EXEC_DISPATCH_GOTO
+   OP(EXEC_OP_COUNT):
+   default:
+      assert(0);
+      return pc;
+   }
+#endif
+
+#undef OP
+#undef NEXT
+}
+
+
+
+
 /**
  * Run TGSI interpreter.
  * \return bitmask of "alive" quad components
@@ -4275,6 +5066,12 @@ tgsi_exec_machine_run( struct tgsi_exec_machine *mach )
 #endif
 
          assert(pc < (int) mach->NumInstructions);
+
+         if (mach->Code && mach->Code[pc].op != EXEC_OP_GENERIC) {
+            pc = exec_decoded(mach, pc);
+            continue;
+         }
+
          exec_instruction(mach, mach->Instructions + pc, &pc);
 
 #if DEBUG_EXECUTION
@@ -28,6 +28,7 @@
 
 #include "pipe/p_config.h"
 #include "pipe/p_compiler.h"
+#include "os/os_thread.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
 #include "util/u_format.h"
@@ -87,13 +88,33 @@ static float consts[NUM_CONSTS][4] = {
 };
 #undef C
 
-struct translate_sse {
-   struct translate translate;
+/**
+ * Generated code.  It only addresses the translate_sse struct it is given
+ * relative to the struct's start, so the code built for a key is shared
+ * by all the translate_sse objects with that key, whatever context they
+ * belong to.
+ */
+struct translate_sse_code {
+   struct translate_key key;
+   unsigned refcount;
 
    struct x86_function linear_func;
    struct x86_function elt_func;
    struct x86_function elt16_func;
    struct x86_function elt8_func;
+
+   struct translate_sse_code *next;
+};
+
+/** All the live translate_sse_code objects, protected by code_mutex */
+static struct translate_sse_code *code_list = NULL;
+pipe_static_mutex(code_mutex);
+
+
+struct translate_sse {
+   struct translate translate;
+
+   struct translate_sse_code *code;
    struct x86_function *func;
 
    PIPE_ALIGN_VAR(16) float consts[NUM_CONSTS][4];
@@ -214,6 +235,42 @@ static boolean emit_load_sse2( struct translate_sse *p,
    return TRUE;
 }
 
+/* Load 8 or 16-bit channels and zero- or sign-extend them to 32 bits with
+ * the SSE4.1 pmovzx/pmovsx instructions.  These read exactly 4 bytes or 8
+ * bytes from memory, other sizes are loaded with emit_load_sse2 first.
+ */
+static void emit_load_extend_sse41( struct translate_sse *p,
+                                    struct x86_reg data,
+                                    struct x86_reg src,
+                                    unsigned chan_size,
+                                    unsigned nr_chans,
+                                    boolean is_signed )
+{
+   unsigned size = chan_size * nr_chans >> 3;
+
+   /* less than four channels */
+   if(size != (4 * chan_size >> 3))
+   {
+      emit_load_sse2(p, data, src, size);
+      src = data;
+   }
+
+   if(chan_size == 8)
+   {
+      if(is_signed)
+         sse41_pmovsxbd(p->func, data, src);
+      else
+         sse41_pmovzxbd(p->func, data, src);
+   }
+   else
+   {
+      if(is_signed)
+         sse41_pmovsxwd(p->func, data, src);
+      else
+         sse41_pmovzxwd(p->func, data, src);
+   }
+}
+
 /* this value can be passed for the out_chans argument */
 #define CHANNELS_0001 5
 
@@ -510,24 +567,30 @@ static boolean translate_attr_convert( struct translate_sse *p,
          case UTIL_FORMAT_TYPE_UNSIGNED:
             if(!(x86_target_caps(p->func) & X86_SSE2))
                return FALSE;
-            emit_load_sse2(p, dataXMM, src, input_desc->channel[0].size * input_desc->nr_channels >> 3);
-
-            /* TODO: add support for SSE4.1 pmovzx */
-            switch(input_desc->channel[0].size)
+            if((x86_target_caps(p->func) & X86_SSE4_1) &&
+               (input_desc->channel[0].size == 8 || input_desc->channel[0].size == 16))
+               emit_load_extend_sse41(p, dataXMM, src, input_desc->channel[0].size,
+                                      input_desc->nr_channels, FALSE);
+            else
             {
-            case 8:
-               /* TODO: this may be inefficient due to get_identity() being used both as a float and integer register */
-               sse2_punpcklbw(p->func, dataXMM, get_const(p, CONST_IDENTITY));
-               sse2_punpcklbw(p->func, dataXMM, get_const(p, CONST_IDENTITY));
-               break;
-            case 16:
-               sse2_punpcklwd(p->func, dataXMM, get_const(p, CONST_IDENTITY));
-               break;
-            case 32: /* we lose precision here */
-               sse2_psrld_imm(p->func, dataXMM, 1);
-               break;
-            default:
-               return FALSE;
+               emit_load_sse2(p, dataXMM, src, input_desc->channel[0].size * input_desc->nr_channels >> 3);
+
+               switch(input_desc->channel[0].size)
+               {
+               case 8:
+                  /* TODO: this may be inefficient due to get_identity() being used both as a float and integer register */
+                  sse2_punpcklbw(p->func, dataXMM, get_const(p, CONST_IDENTITY));
+                  sse2_punpcklbw(p->func, dataXMM, get_const(p, CONST_IDENTITY));
+                  break;
+               case 16:
+                  sse2_punpcklwd(p->func, dataXMM, get_const(p, CONST_IDENTITY));
+                  break;
+               case 32: /* we lose precision here */
+                  sse2_psrld_imm(p->func, dataXMM, 1);
+                  break;
+               default:
+                  return FALSE;
+               }
             }
             sse2_cvtdq2ps(p->func, dataXMM, dataXMM);
             if(input_desc->channel[0].normalized)
@@ -560,24 +623,30 @@ static boolean translate_attr_convert( struct translate_sse *p,
          case UTIL_FORMAT_TYPE_SIGNED:
             if(!(x86_target_caps(p->func) & X86_SSE2))
                return FALSE;
-            emit_load_sse2(p, dataXMM, src, input_desc->channel[0].size * input_desc->nr_channels >> 3);
-
-            /* TODO: add support for SSE4.1 pmovsx */
-            switch(input_desc->channel[0].size)
+            if((x86_target_caps(p->func) & X86_SSE4_1) &&
+               (input_desc->channel[0].size == 8 || input_desc->channel[0].size == 16))
+               emit_load_extend_sse41(p, dataXMM, src, input_desc->channel[0].size,
+                                      input_desc->nr_channels, TRUE);
+            else
             {
-            case 8:
-               sse2_punpcklbw(p->func, dataXMM, dataXMM);
-               sse2_punpcklbw(p->func, dataXMM, dataXMM);
-               sse2_psrad_imm(p->func, dataXMM, 24);
-               break;
-            case 16:
-               sse2_punpcklwd(p->func, dataXMM, dataXMM);
-               sse2_psrad_imm(p->func, dataXMM, 16);
-               break;
-            case 32: /* we lose precision here */
-               break;
-            default:
-               return FALSE;
+               emit_load_sse2(p, dataXMM, src, input_desc->channel[0].size * input_desc->nr_channels >> 3);
+
+               switch(input_desc->channel[0].size)
+               {
+               case 8:
+                  sse2_punpcklbw(p->func, dataXMM, dataXMM);
+                  sse2_punpcklbw(p->func, dataXMM, dataXMM);
+                  sse2_psrad_imm(p->func, dataXMM, 24);
+                  break;
+               case 16:
+                  sse2_punpcklwd(p->func, dataXMM, dataXMM);
+                  sse2_psrad_imm(p->func, dataXMM, 16);
+                  break;
+               case 32: /* we lose precision here */
+                  break;
+               default:
+                  return FALSE;
+               }
             }
             sse2_cvtdq2ps(p->func, dataXMM, dataXMM);
             if(input_desc->channel[0].normalized)
@@ -1251,6 +1320,53 @@ static boolean incr_inputs( struct translate_sse *p,
 }
 
 
+/* Number of vertices translated per iteration of the main loop */
+#define UNROLL_VERTICES 4
+
+
+/* Translate one vertex and advance to the next one.
+ */
+static boolean build_vertex( struct translate_sse *p,
+                             unsigned index_size )
+{
+   struct x86_reg elt = !index_size ? p->idx_ESI : x86_deref(p->idx_ESI);
+   int last_variant = -1;
+   struct x86_reg vb;
+   unsigned j;
+
+   for (j = 0; j < p->translate.key.nr_elements; j++) {
+      const struct translate_element *a = &p->translate.key.element[j];
+      unsigned variant = p->element_to_buffer_variant[j];
+
+      /* Figure out source pointer address:
+       */
+      if (variant != last_variant) {
+         last_variant = variant;
+         vb = get_buffer_ptr(p, index_size, variant, elt);
+      }
+
+      if (!translate_attr( p, a,
+                           x86_make_disp(vb, a->input_offset),
+                           x86_make_disp(p->outbuf_EBX, a->output_offset)))
+         return FALSE;
+   }
+
+   /* Next output vertex:
+    */
+   x64_rexw(p->func);
+   x86_lea(p->func,
+           p->outbuf_EBX,
+           x86_make_disp(p->outbuf_EBX,
+                         p->translate.key.output_stride));
+
+   /* Incr index
+    */
+   incr_inputs( p, index_size );
+
+   return TRUE;
+}
+
+
 /* Build run( struct translate *machine,
  *            unsigned start,
  *            unsigned count,
@@ -1271,7 +1387,7 @@ static boolean build_vertex_emit( struct translate_sse *p,
 				  struct x86_function *func,
 				  unsigned index_size )
 {
-   int fixup, label;
+   int fixup, fixup_unrolled, fixup_done, label;
    unsigned j;
 
    memset(p->reg_to_const, 0xff, sizeof(p->reg_to_const));
@@ -1337,49 +1453,46 @@ static boolean build_vertex_emit( struct translate_sse *p,
     */
    init_inputs(p, index_size);
 
-   /* Note address for loop jump
+   /* Four vertices per iteration while there are at least four left.
     */
+   x86_cmp_imm(p->func, p->count_EBP, UNROLL_VERTICES);
+   fixup_unrolled = x86_jcc_forward(p->func, cc_NAE);
+
    label = x86_get_label(p->func);
-   {
-      struct x86_reg elt = !index_size ? p->idx_ESI : x86_deref(p->idx_ESI);
-      int last_variant = -1;
-      struct x86_reg vb;
+   for (j = 0; j < UNROLL_VERTICES; j++) {
+      if (!build_vertex(p, index_size))
+         return FALSE;
+   }
 
-      for (j = 0; j < p->translate.key.nr_elements; j++) {
-         const struct translate_element *a = &p->translate.key.element[j];
-         unsigned variant = p->element_to_buffer_variant[j];
+   x86_sub_imm(p->func, p->count_EBP, UNROLL_VERTICES);
+   x86_cmp_imm(p->func, p->count_EBP, UNROLL_VERTICES);
+   x86_jcc(p->func, cc_AE, label);
 
-         /* Figure out source pointer address:
-          */
-         if (variant != last_variant) {
-            last_variant = variant;
-            vb = get_buffer_ptr(p, index_size, variant, elt);
-         }
-         
-         if (!translate_attr( p, a, 
-                              x86_make_disp(vb, a->input_offset), 
-                              x86_make_disp(p->outbuf_EBX, a->output_offset)))
-            return FALSE;
-      }
+   x86_fixup_fwd_jump(p->func, fixup_unrolled);
 
-      /* Next output vertex:
-       */
-      x64_rexw(p->func);
-      x86_lea(p->func, 
-              p->outbuf_EBX,
-              x86_make_disp(p->outbuf_EBX,
-                            p->translate.key.output_stride));
-
-      /* Incr index
-       */ 
-      incr_inputs( p, index_size );
-   }
+   /* Then one at a time.  This loop can be entered without running the
+    * one above, so constants have to be loaded again.
+    */
+   x86_xor(p->func, p->tmp_EAX, p->tmp_EAX);
+   x86_cmp(p->func, p->count_EBP, p->tmp_EAX);
+   fixup_done = x86_jcc_forward(p->func, cc_E);
+
+   memset(p->reg_to_const, 0xff, sizeof(p->reg_to_const));
+   memset(p->const_to_reg, 0xff, sizeof(p->const_to_reg));
+
+   /* Note address for loop jump
+    */
+   label = x86_get_label(p->func);
+   if (!build_vertex(p, index_size))
+      return FALSE;
 
    /* decr count, loop if not zero
     */
    x86_dec(p->func, p->count_EBP);
    x86_jcc(p->func, cc_NZ, label);
 
+   x86_fixup_fwd_jump(p->func, fixup_done);
+
    /* Exit mmx state?
     */
    if (p->func->need_emms)
@@ -1438,19 +1551,79 @@ static void translate_sse_set_buffer( struct translate *translate,
 }
 
 
+static void release_code( struct translate_sse_code *code )
+{
+   x86_release_func( &code->elt8_func );
+   x86_release_func( &code->elt16_func );
+   x86_release_func( &code->elt_func );
+   x86_release_func( &code->linear_func );
+
+   FREE(code);
+}
+
+
 static void translate_sse_release( struct translate *translate )
 {
    struct translate_sse *p = (struct translate_sse *)translate;
-
-   x86_release_func( &p->elt8_func );
-   x86_release_func( &p->elt16_func );
-   x86_release_func( &p->elt_func );
-   x86_release_func( &p->linear_func );
+   struct translate_sse_code *code = p->code;
+
+   if (code) {
+      pipe_mutex_lock(code_mutex);
+      if (--code->refcount == 0) {
+         struct translate_sse_code **prev = &code_list;
+         while (*prev != code)
+            prev = &(*prev)->next;
+         *prev = code->next;
+         release_code(code);
+      }
+      pipe_mutex_unlock(code_mutex);
+   }
 
    os_free_aligned(p);
 }
 
 
+/**
+ * Find the code for p's key, or generate it.  Must be called with
+ * code_mutex held.
+ */
+static struct translate_sse_code *get_code( struct translate_sse *p )
+{
+   struct translate_sse_code *code;
+
+   for (code = code_list; code; code = code->next) {
+      if (translate_key_compare(&code->key, &p->translate.key) == 0) {
+         code->refcount++;
+         return code;
+      }
+   }
+
+   code = CALLOC_STRUCT(translate_sse_code);
+   if (code == NULL)
+      return NULL;
+
+   code->key = p->translate.key;
+
+   if (!build_vertex_emit(p, &code->linear_func, 0) ||
+       !build_vertex_emit(p, &code->elt_func, 4) ||
+       !build_vertex_emit(p, &code->elt16_func, 2) ||
+       !build_vertex_emit(p, &code->elt8_func, 1) ||
+       !x86_get_func(&code->linear_func) ||
+       !x86_get_func(&code->elt_func) ||
+       !x86_get_func(&code->elt16_func) ||
+       !x86_get_func(&code->elt8_func)) {
+      release_code(code);
+      return NULL;
+   }
+
+   code->refcount = 1;
+   code->next = code_list;
+   code_list = code;
+
+   return code;
+}
+
+
 struct translate *translate_sse2_create( const struct translate_key *key )
 {
    struct translate_sse *p = NULL;
@@ -1504,33 +1677,17 @@ struct translate *translate_sse2_create( const struct translate_key *key )
 
    if (0) debug_printf("nr_buffers: %d\n", p->nr_buffers);
 
-   if (!build_vertex_emit(p, &p->linear_func, 0))
-      goto fail;
-
-   if (!build_vertex_emit(p, &p->elt_func, 4))
-      goto fail;
-
-   if (!build_vertex_emit(p, &p->elt16_func, 2))
-      goto fail;
+   pipe_mutex_lock(code_mutex);
+   p->code = get_code(p);
+   pipe_mutex_unlock(code_mutex);
 
-   if (!build_vertex_emit(p, &p->elt8_func, 1))
+   if (p->code == NULL)
       goto fail;
 
-   p->translate.run = (run_func) x86_get_func(&p->linear_func);
-   if (p->translate.run == NULL)
-      goto fail;
-
-   p->translate.run_elts = (run_elts_func) x86_get_func(&p->elt_func);
-   if (p->translate.run_elts == NULL)
-      goto fail;
-
-   p->translate.run_elts16 = (run_elts16_func) x86_get_func(&p->elt16_func);
-   if (p->translate.run_elts16 == NULL)
-      goto fail;
-
-   p->translate.run_elts8 = (run_elts8_func) x86_get_func(&p->elt8_func);
-   if (p->translate.run_elts8 == NULL)
-      goto fail;
+   p->translate.run = (run_func) x86_get_func(&p->code->linear_func);
+   p->translate.run_elts = (run_elts_func) x86_get_func(&p->code->elt_func);
+   p->translate.run_elts16 = (run_elts16_func) x86_get_func(&p->code->elt16_func);
+   p->translate.run_elts8 = (run_elts8_func) x86_get_func(&p->code->elt8_func);
 
    return &p->translate;
 
@@ -211,6 +211,71 @@ cpuid(uint32_t ax, uint32_t *p)
    p[3] = 0;
 #endif
 }
+
+
+/**
+ * Like cpuid(), but also sets the sub-leaf in ecx, as needed by the
+ * structured extended feature flags leaf (0x7).
+ */
+static INLINE void
+cpuid_count(uint32_t ax, uint32_t cx, uint32_t *p)
+{
+#if (defined(PIPE_CC_GCC) || defined(PIPE_CC_SUNPRO)) && defined(PIPE_ARCH_X86)
+   __asm __volatile (
+     "xchgl %%ebx, %1\n\t"
+     "cpuid\n\t"
+     "xchgl %%ebx, %1"
+     : "=a" (p[0]),
+       "=S" (p[1]),
+       "=c" (p[2]),
+       "=d" (p[3])
+     : "0" (ax), "2" (cx)
+   );
+#elif (defined(PIPE_CC_GCC) || defined(PIPE_CC_SUNPRO)) && defined(PIPE_ARCH_X86_64)
+   __asm __volatile (
+     "cpuid\n\t"
+     : "=a" (p[0]),
+       "=b" (p[1]),
+       "=c" (p[2]),
+       "=d" (p[3])
+     : "0" (ax), "2" (cx)
+   );
+#elif defined(PIPE_CC_MSVC)
+   __cpuidex(p, ax, cx);
+#else
+   p[0] = 0;
+   p[1] = 0;
+   p[2] = 0;
+   p[3] = 0;
+#endif
+}
+
+
+/**
+ * Read the XCR0 register, which tells which register states the OS saves
+ * on context switches.  Only valid when cpuid reports OSXSAVE.
+ */
+static INLINE uint64_t
+xgetbv(void)
+{
+#if defined(PIPE_CC_GCC)
+   uint32_t eax, edx;
+
+   /* xgetbv, spelled out for older assemblers */
+   __asm __volatile (
+     ".byte 0x0f, 0x01, 0xd0"
+     : "=a" (eax),
+       "=d" (edx)
+     : "c" (0)
+   );
+
+   return ((uint64_t) edx << 32) | eax;
+#elif defined(PIPE_CC_MSVC) && defined(_MSC_FULL_VER) && (_MSC_FULL_VER >= 160040219)
+   return _xgetbv(0);
+#else
+   return 0;
+#endif
+}
 #endif /* X86 or X86_64 */
 
 void
@@ -281,11 +346,25 @@ util_cpu_detect(void)
          util_cpu_caps.has_avx    = (regs2[2] >> 28) & 1;
          util_cpu_caps.has_mmx2   = util_cpu_caps.has_sse; /* SSE cpus supports mmxext too */
 
+         /* AVX needs the OS to save the upper halves of the ymm registers
+          * (XCR0 bits 1 and 2), which in turn requires OSXSAVE.
+          */
+         if (util_cpu_caps.has_avx &&
+             (!((regs2[2] >> 27) & 1) || (xgetbv() & 0x6) != 0x6)) {
+            util_cpu_caps.has_avx = 0;
+         }
+
          cacheline = ((regs2[1] >> 8) & 0xFF) * 8;
          if (cacheline > 0)
             util_cpu_caps.cacheline = cacheline;
       }
 
+      if (regs[0] >= 0x00000007 && util_cpu_caps.has_avx) {
+         cpuid_count(0x00000007, 0x00000000, regs2);
+
+         util_cpu_caps.has_avx2 = (regs2[1] >> 5) & 1;
+      }
+
       if (regs[1] == 0x756e6547 && regs[2] == 0x6c65746e && regs[3] == 0x49656e69) {
          /* GenuineIntel */
          util_cpu_caps.has_intel = 1;
@@ -338,6 +417,7 @@ util_cpu_detect(void)
       debug_printf("util_cpu_caps.has_sse4_1 = %u\n", util_cpu_caps.has_sse4_1);
       debug_printf("util_cpu_caps.has_sse4_2 = %u\n", util_cpu_caps.has_sse4_2);
       debug_printf("util_cpu_caps.has_avx = %u\n", util_cpu_caps.has_avx);
+      debug_printf("util_cpu_caps.has_avx2 = %u\n", util_cpu_caps.has_avx2);
       debug_printf("util_cpu_caps.has_3dnow = %u\n", util_cpu_caps.has_3dnow);
       debug_printf("util_cpu_caps.has_3dnow_ext = %u\n", util_cpu_caps.has_3dnow_ext);
       debug_printf("util_cpu_caps.has_altivec = %u\n", util_cpu_caps.has_altivec);
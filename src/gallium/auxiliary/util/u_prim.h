@@ -206,6 +206,47 @@ u_gs_prims_for_vertices(int primitive, int vertices)
    }
 }
 
+/**
+ * Returns the number of primitives a primitive of the given type and
+ * vertex count decomposes to, i.e. triangles for quads and polygons.
+ * Unlike u_gs_prims_for_vertices() all primitive types are handled.
+ */
+static INLINE unsigned
+u_decomposed_prims_for_vertices(int primitive, int vertices)
+{
+   switch (primitive) {
+   case PIPE_PRIM_POINTS:
+      return vertices;
+   case PIPE_PRIM_LINES:
+      return vertices / 2;
+   case PIPE_PRIM_LINE_LOOP:
+      return (vertices >= 2) ? vertices : 0;
+   case PIPE_PRIM_LINE_STRIP:
+      return (vertices >= 2) ? vertices - 1 : 0;
+   case PIPE_PRIM_TRIANGLES:
+      return vertices / 3;
+   case PIPE_PRIM_TRIANGLE_STRIP:
+   case PIPE_PRIM_TRIANGLE_FAN:
+   case PIPE_PRIM_POLYGON:
+      return (vertices >= 3) ? vertices - 2 : 0;
+   case PIPE_PRIM_QUADS:
+      return (vertices / 4) * 2;
+   case PIPE_PRIM_QUAD_STRIP:
+      return (vertices >= 4) ? ((vertices - 2) / 2) * 2 : 0;
+   case PIPE_PRIM_LINES_ADJACENCY:
+      return vertices / 4;
+   case PIPE_PRIM_LINE_STRIP_ADJACENCY:
+      return (vertices >= 4) ? vertices - 3 : 0;
+   case PIPE_PRIM_TRIANGLES_ADJACENCY:
+      return vertices / 6;
+   case PIPE_PRIM_TRIANGLE_STRIP_ADJACENCY:
+      return (vertices >= 6) ? 1 + (vertices - 6) / 2 : 0;
+   default:
+      assert(0);
+      return 0;
+   }
+}
+
 const char *u_prim_name( unsigned pipe_prim );
 
 #endif
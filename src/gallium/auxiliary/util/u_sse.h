@@ -162,12 +162,48 @@ static INLINE void u_print_ps(const char *name, __m128 r)
 
 
 
+/*
+ * AVX2 code paths are compiled on a per-function basis (mark them with
+ * U_AVX2_FUNC) so that the rest of the code doesn't need -mavx2.  They must
+ * only be called after checking util_cpu_caps.has_avx2.
+ */
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+#define U_HAVE_AVX2_INTRINSICS
+#define U_AVX2_FUNC
+
+#elif defined(PIPE_CC_GCC) && !defined(__clang__) && \
+      (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+
+#include <immintrin.h>
+#define U_HAVE_AVX2_INTRINSICS
+#define U_AVX2_FUNC __attribute__((target("avx2")))
+
+#elif defined(PIPE_CC_MSVC) && _MSC_VER >= 1700
+
+#include <immintrin.h>
+#define U_HAVE_AVX2_INTRINSICS
+#define U_AVX2_FUNC
+
+#endif
+
+
 #if defined(PIPE_ARCH_SSSE3)
 
 #include <tmmintrin.h>
 
 #else /* !PIPE_ARCH_SSSE3 */
 
+#if defined(U_HAVE_AVX2_INTRINSICS)
+/* <immintrin.h> already declares the _mm_shuffle_epi8() intrinsic, which
+ * can only be used in U_AVX2_FUNC functions.  Rename the fallback below so
+ * that the rest of the code gets it instead.  U_AVX2_FUNC functions can
+ * still call the intrinsic as (_mm_shuffle_epi8)(a, mask).
+ */
+#define _mm_shuffle_epi8(a, mask) u_mm_shuffle_epi8(a, mask)
+#endif
+
 /**
  * Describe _mm_shuffle_epi8() with gcc extended inline assembly, for cases
  * where -mssse3 is not supported/enabled.
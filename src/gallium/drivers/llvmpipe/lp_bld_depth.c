@@ -511,6 +511,107 @@ lp_build_occlusion_count(struct gallivm_state *gallivm,
 
 
 
+/**
+ * Load the depth/stencil values of n 2x2 quads from the (linear)
+ * depth/stencil buffer.
+ *
+ * The quads lie side by side, so the values come from two consecutive
+ * rows, and are shuffled into the quad order used by the fragment shader.
+ *
+ * \param z_type  type of the depth/stencil vector (4 or 8 elements)
+ * \param zs_dst_ptr  pointer to the top-left pixel of the first quad
+ * \param zs_dst_stride  row stride of the depth/stencil buffer in bytes
+ */
+static LLVMValueRef
+lp_build_depth_stencil_load_swizzled(struct gallivm_state *gallivm,
+                                     struct lp_type z_type,
+                                     LLVMValueRef zs_dst_ptr,
+                                     LLVMValueRef zs_dst_stride)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef shuffles[LP_MAX_VECTOR_LENGTH];
+   LLVMValueRef zs_dst_ptr1;
+   LLVMValueRef zs_dst0, zs_dst1;
+   LLVMTypeRef row_ptr_type;
+   struct lp_type row_type = z_type;
+   unsigned i;
+
+   assert(z_type.length == 4 || z_type.length == 8);
+
+   row_type.length = z_type.length / 2;
+   row_ptr_type = LLVMPointerType(lp_build_vec_type(gallivm, row_type), 0);
+
+   zs_dst_ptr1 = LLVMBuildGEP(builder, zs_dst_ptr, &zs_dst_stride, 1, "");
+
+   zs_dst_ptr = LLVMBuildBitCast(builder, zs_dst_ptr, row_ptr_type, "");
+   zs_dst_ptr1 = LLVMBuildBitCast(builder, zs_dst_ptr1, row_ptr_type, "");
+
+   zs_dst0 = LLVMBuildLoad(builder, zs_dst_ptr, "");
+   zs_dst1 = LLVMBuildLoad(builder, zs_dst_ptr1, "");
+
+   for (i = 0; i < z_type.length / 4; i++) {
+      shuffles[i*4 + 0] = lp_build_const_int32(gallivm, i*2);
+      shuffles[i*4 + 1] = lp_build_const_int32(gallivm, i*2 + 1);
+      shuffles[i*4 + 2] = lp_build_const_int32(gallivm, row_type.length + i*2);
+      shuffles[i*4 + 3] = lp_build_const_int32(gallivm, row_type.length + i*2 + 1);
+   }
+
+   return LLVMBuildShuffleVector(builder, zs_dst0, zs_dst1,
+                                 LLVMConstVector(shuffles, z_type.length), "");
+}
+
+
+/**
+ * Store the depth/stencil values of n 2x2 quads to the (linear)
+ * depth/stencil buffer.  This is the inverse of
+ * lp_build_depth_stencil_load_swizzled().
+ */
+static void
+lp_build_depth_stencil_write_swizzled(struct gallivm_state *gallivm,
+                                      struct lp_type z_type,
+                                      LLVMValueRef zs_dst_ptr,
+                                      LLVMValueRef zs_dst_stride,
+                                      LLVMValueRef zs_value)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef shuffles0[LP_MAX_VECTOR_LENGTH / 2];
+   LLVMValueRef shuffles1[LP_MAX_VECTOR_LENGTH / 2];
+   LLVMValueRef zs_dst_ptr1;
+   LLVMValueRef zs_dst0, zs_dst1;
+   LLVMValueRef undef;
+   LLVMTypeRef row_ptr_type;
+   struct lp_type row_type = z_type;
+   unsigned i;
+
+   assert(z_type.length == 4 || z_type.length == 8);
+
+   row_type.length = z_type.length / 2;
+   row_ptr_type = LLVMPointerType(lp_build_vec_type(gallivm, row_type), 0);
+
+   for (i = 0; i < z_type.length / 4; i++) {
+      shuffles0[i*2 + 0] = lp_build_const_int32(gallivm, i*4);
+      shuffles0[i*2 + 1] = lp_build_const_int32(gallivm, i*4 + 1);
+      shuffles1[i*2 + 0] = lp_build_const_int32(gallivm, i*4 + 2);
+      shuffles1[i*2 + 1] = lp_build_const_int32(gallivm, i*4 + 3);
+   }
+
+   undef = LLVMGetUndef(LLVMTypeOf(zs_value));
+   zs_dst0 = LLVMBuildShuffleVector(builder, zs_value, undef,
+                                    LLVMConstVector(shuffles0, row_type.length), "");
+   zs_dst1 = LLVMBuildShuffleVector(builder, zs_value, undef,
+                                    LLVMConstVector(shuffles1, row_type.length), "");
+
+   zs_dst_ptr1 = LLVMBuildGEP(builder, zs_dst_ptr, &zs_dst_stride, 1, "");
+
+   zs_dst_ptr = LLVMBuildBitCast(builder, zs_dst_ptr, row_ptr_type, "");
+   zs_dst_ptr1 = LLVMBuildBitCast(builder, zs_dst_ptr1, row_ptr_type, "");
+
+   LLVMBuildStore(builder, zs_dst0, zs_dst_ptr);
+   LLVMBuildStore(builder, zs_dst1, zs_dst_ptr1);
+}
+
+
+
 /**
  * Generate code for performing depth and/or stencil tests.
  * We operate on a vector of values (typically n 2x2 quads).
@@ -523,6 +624,7 @@ lp_build_occlusion_count(struct gallivm_state *gallivm,
  * \param stencil_refs  the front/back stencil ref values (scalar)
  * \param z_src  the incoming depth/stencil values (n 2x2 quad values, float32)
  * \param zs_dst_ptr  pointer to depth/stencil values in framebuffer
+ * \param zs_dst_stride  row stride of the depth/stencil buffer, in bytes
  * \param face  contains boolean value indicating front/back facing polygon
  */
 void
@@ -535,6 +637,7 @@ lp_build_depth_stencil_test(struct gallivm_state *gallivm,
                             LLVMValueRef stencil_refs[2],
                             LLVMValueRef z_src,
                             LLVMValueRef zs_dst_ptr,
+                            LLVMValueRef zs_dst_stride,
                             LLVMValueRef face,
                             LLVMValueRef *zs_value,
                             boolean do_branch)
@@ -625,10 +728,8 @@ lp_build_depth_stencil_test(struct gallivm_state *gallivm,
    lp_build_context_init(&s_bld, gallivm, s_type);
 
    /* Load current z/stencil value from z/stencil buffer */
-   zs_dst_ptr = LLVMBuildBitCast(builder,
-                                 zs_dst_ptr,
-                                 LLVMPointerType(z_bld.vec_type, 0), "");
-   zs_dst = LLVMBuildLoad(builder, zs_dst_ptr, "");
+   zs_dst = lp_build_depth_stencil_load_swizzled(gallivm, z_type,
+                                                 zs_dst_ptr, zs_dst_stride);
 
    lp_build_name(zs_dst, "zs_dst");
 
@@ -844,15 +945,19 @@ lp_build_depth_stencil_test(struct gallivm_state *gallivm,
 
 
 void
-lp_build_depth_write(LLVMBuilderRef builder,
+lp_build_depth_write(struct gallivm_state *gallivm,
+                     struct lp_type z_src_type,
                      const struct util_format_description *format_desc,
                      LLVMValueRef zs_dst_ptr,
+                     LLVMValueRef zs_dst_stride,
                      LLVMValueRef zs_value)
 {
-   zs_dst_ptr = LLVMBuildBitCast(builder, zs_dst_ptr,
-                                 LLVMPointerType(LLVMTypeOf(zs_value), 0), "");
+   struct lp_type z_type;
 
-   LLVMBuildStore(builder, zs_value, zs_dst_ptr);
+   z_type = lp_depth_type(format_desc, z_src_type.width*z_src_type.length);
+
+   lp_build_depth_stencil_write_swizzled(gallivm, z_type,
+                                         zs_dst_ptr, zs_dst_stride, zs_value);
 }
 
 
@@ -862,23 +967,22 @@ lp_build_deferred_depth_write(struct gallivm_state *gallivm,
                               const struct util_format_description *format_desc,
                               struct lp_build_mask_context *mask,
                               LLVMValueRef zs_dst_ptr,
+                              LLVMValueRef zs_dst_stride,
                               LLVMValueRef zs_value)
 {
    struct lp_type z_type;
    struct lp_build_context z_bld;
    LLVMValueRef z_dst;
-   LLVMBuilderRef builder = gallivm->builder;
 
    /* XXX: pointlessly redo type logic:
     */
    z_type = lp_depth_type(format_desc, z_src_type.width*z_src_type.length);
    lp_build_context_init(&z_bld, gallivm, z_type);
 
-   zs_dst_ptr = LLVMBuildBitCast(builder, zs_dst_ptr,
-                                 LLVMPointerType(z_bld.vec_type, 0), "");
-
-   z_dst = LLVMBuildLoad(builder, zs_dst_ptr, "zsbufval");
+   z_dst = lp_build_depth_stencil_load_swizzled(gallivm, z_type,
+                                                zs_dst_ptr, zs_dst_stride);
    z_dst = lp_build_select(&z_bld, lp_build_mask_value(mask), zs_value, z_dst);
 
-   LLVMBuildStore(builder, z_dst, zs_dst_ptr);
+   lp_build_depth_stencil_write_swizzled(gallivm, z_type,
+                                         zs_dst_ptr, zs_dst_stride, z_dst);
 }
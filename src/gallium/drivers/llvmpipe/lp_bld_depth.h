@@ -64,14 +64,17 @@ lp_build_depth_stencil_test(struct gallivm_state *gallivm,
                             LLVMValueRef stencil_refs[2],
                             LLVMValueRef zs_src,
                             LLVMValueRef zs_dst_ptr,
+                            LLVMValueRef zs_dst_stride,
                             LLVMValueRef facing,
                             LLVMValueRef *zs_value,
                             boolean do_branch);
 
 void
-lp_build_depth_write(LLVMBuilderRef builder,
+lp_build_depth_write(struct gallivm_state *gallivm,
+                     struct lp_type z_src_type,
                      const struct util_format_description *format_desc,
                      LLVMValueRef zs_dst_ptr,
+                     LLVMValueRef zs_dst_stride,
                      LLVMValueRef zs_value);
 
 void
@@ -80,6 +83,7 @@ lp_build_deferred_depth_write(struct gallivm_state *gallivm,
                               const struct util_format_description *format_desc,
                               struct lp_build_mask_context *mask,
                               LLVMValueRef zs_dst_ptr,
+                              LLVMValueRef zs_dst_stride,
                               LLVMValueRef zs_value);
 
 void
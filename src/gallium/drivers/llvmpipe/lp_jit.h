@@ -153,6 +153,7 @@ typedef void
                     const void *dady,
                     uint8_t **color,
                     void *depth,
+                    uint32_t depth_stride,
                     uint32_t mask,
                     uint32_t *counter);
 
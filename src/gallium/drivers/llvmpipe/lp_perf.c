@@ -98,7 +98,13 @@ lp_print_counters(void)
       debug_printf("llvmpipe:   nr_empty_4x4:               %9u (%3.0f%% of %u)\n", lp_count.nr_empty_4, p1, total_4);
       debug_printf("llvmpipe:   nr_non_empty_4x4:           %9u (%3.0f%% of %u)\n", lp_count.nr_non_empty_4, p4, total_4);
 
+      debug_printf("llvmpipe: nr_hiz_reject_64x64:          %9u\n", lp_count.nr_hiz_reject_64);
+      debug_printf("llvmpipe: nr_hiz_reject_16x16:          %9u\n", lp_count.nr_hiz_reject_16);
+      debug_printf("llvmpipe: nr_hiz_reject_4x4:            %9u\n", lp_count.nr_hiz_reject_4);
+
       debug_printf("llvmpipe: nr_color_tile_clear:          %9u\n", lp_count.nr_color_tile_clear);
+      debug_printf("llvmpipe: nr_fast_clear_tile:           %9u\n", lp_count.nr_fast_clear_tile);
+      debug_printf("llvmpipe: nr_fast_clear_resolve:        %9u\n", lp_count.nr_fast_clear_resolve);
       debug_printf("llvmpipe: nr_color_tile_load:           %9u\n", lp_count.nr_color_tile_load);
       debug_printf("llvmpipe: nr_color_tile_store:          %9u\n", lp_count.nr_color_tile_store);
 
@@ -56,10 +56,15 @@ struct lp_counters
    unsigned nr_fully_covered_4;
    unsigned nr_partially_covered_4;
    unsigned nr_non_empty_4;
+   unsigned nr_hiz_reject_64;
+   unsigned nr_hiz_reject_16;
+   unsigned nr_hiz_reject_4;
    unsigned nr_llvm_compiles;
    int64_t llvm_compile_time;  /**< total, in microseconds */
 
    unsigned nr_color_tile_clear;
+   unsigned nr_fast_clear_tile;
+   unsigned nr_fast_clear_resolve;
    unsigned nr_color_tile_load;
    unsigned nr_color_tile_store;
 };
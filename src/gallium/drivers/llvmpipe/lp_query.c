@@ -33,10 +33,13 @@
 #include "draw/draw_context.h"
 #include "pipe/p_defines.h"
 #include "util/u_memory.h"
+#include "util/u_string.h"
 #include "lp_context.h"
 #include "lp_flush.h"
 #include "lp_fence.h"
 #include "lp_query.h"
+#include "lp_rast.h"
+#include "lp_screen.h"
 #include "lp_state.h"
 
 
@@ -45,15 +48,174 @@ static struct llvmpipe_query *llvmpipe_query( struct pipe_query *p )
    return (struct llvmpipe_query *)p;
 }
 
+
+static INLINE boolean
+is_driver_query(unsigned type)
+{
+   return type >= PIPE_QUERY_DRIVER_SPECIFIC && type < LP_QUERY_END;
+}
+
+
+/**
+ * Number of threads whose statistics are kept by the rasterizer.
+ */
+static unsigned
+rast_num_tasks(struct llvmpipe_screen *screen)
+{
+   return MAX2(1, lp_rast_get_num_threads(screen->rast));
+}
+
+
+/**
+ * Read the current value of the rasterizer counter for a driver query.
+ * The rasterizer is shared by all the contexts of the screen, so the
+ * counters include the work of all of them.
+ */
+static uint64_t
+read_rast_counter(struct llvmpipe_screen *screen, unsigned type)
+{
+   struct lp_rast_counters counters;
+   int thread = -1;
+
+   if (type >= LP_QUERY_RAST_THREAD_TIMES) {
+      thread = (type - LP_QUERY_RAST_THREAD_TIMES) / 2;
+      if (thread >= (int) rast_num_tasks(screen))
+         return 0;
+   }
+
+   pipe_mutex_lock(screen->rast_mutex);
+   lp_rast_get_counters(screen->rast, thread, &counters);
+   pipe_mutex_unlock(screen->rast_mutex);
+
+   switch (type) {
+   case LP_QUERY_RAST_BINS:
+      return counters.nr_bins;
+   case LP_QUERY_RAST_FRAGMENTS:
+      return counters.nr_fragments;
+   case LP_QUERY_RAST_BUSY_TIME:
+      return counters.busy_time;
+   case LP_QUERY_RAST_WAIT_TIME:
+      return counters.wait_time;
+   default:
+      if (type < LP_QUERY_RAST_THREAD_TIMES)
+         return counters.nr_ops[type - LP_QUERY_RAST_OPS];
+      else if ((type - LP_QUERY_RAST_THREAD_TIMES) % 2 == 0)
+         return counters.busy_time;
+      else
+         return counters.wait_time;
+   }
+}
+
+
+/**
+ * Read the current value of the counter for a driver query.  Unlike the
+ * rasterizer's, the draw module counters are per context.
+ */
+static uint64_t
+read_driver_counter(struct llvmpipe_context *llvmpipe, unsigned type)
+{
+   struct draw_vertex_cache_stats stats;
+
+   switch (type) {
+   case LP_QUERY_DRAW_INDICES:
+   case LP_QUERY_DRAW_VERTICES:
+   case LP_QUERY_DRAW_PRIMITIVES:
+      draw_get_vertex_cache_stats(llvmpipe->draw, &stats);
+      if (type == LP_QUERY_DRAW_INDICES)
+         return stats.indices;
+      else if (type == LP_QUERY_DRAW_VERTICES)
+         return stats.vertices;
+      else
+         return stats.primitives;
+   default:
+      return read_rast_counter(llvmpipe_screen(llvmpipe->pipe.screen), type);
+   }
+}
+
+
+/**
+ * Build the names of the driver queries, once at screen creation, so that
+ * describing them doesn't write to memory shared by the callers.
+ */
+void
+llvmpipe_init_driver_query_names(struct llvmpipe_screen *screen)
+{
+   static const char *names[] = {
+      "rast-bins",
+      "rast-fragments",
+      "rast-busy-us",
+      "rast-wait-us",
+      "draw-indices",
+      "draw-vertices-shaded",
+      "draw-primitives"
+   };
+   unsigned i;
+
+   STATIC_ASSERT(Elements(names) ==
+                 LP_QUERY_RAST_OPS - PIPE_QUERY_DRIVER_SPECIFIC);
+
+   for (i = 0; i < Elements(screen->driver_query_names); i++) {
+      const unsigned type = PIPE_QUERY_DRIVER_SPECIFIC + i;
+      char *name = screen->driver_query_names[i];
+      const size_t size = sizeof screen->driver_query_names[i];
+
+      if (type < LP_QUERY_RAST_OPS) {
+         util_snprintf(name, size, "%s", names[i]);
+      }
+      else if (type < LP_QUERY_RAST_THREAD_TIMES) {
+         util_snprintf(name, size, "rast-op-%s",
+                       lp_rast_cmd_name(type - LP_QUERY_RAST_OPS));
+      }
+      else {
+         unsigned j = type - LP_QUERY_RAST_THREAD_TIMES;
+         util_snprintf(name, size, "rast-thread%u-%s-us", j / 2,
+                       j % 2 ? "wait" : "busy");
+      }
+   }
+}
+
+
+/**
+ * Describe the driver queries.  The per-thread queries are only listed for
+ * the threads that actually exist.
+ */
+int
+llvmpipe_get_driver_query_info(struct pipe_screen *_screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
+   const unsigned num_queries = LP_QUERY_RAST_THREAD_TIMES -
+                                PIPE_QUERY_DRIVER_SPECIFIC +
+                                2 * rast_num_tasks(screen);
+
+   if (!info)
+      return num_queries;
+
+   if (index >= num_queries)
+      return 0;
+
+   info->query_type = PIPE_QUERY_DRIVER_SPECIFIC + index;
+   info->max_value = 0;
+   info->uses_byte_units = FALSE;
+   info->name = screen->driver_query_names[index];
+
+   return 1;
+}
+
+
 static struct pipe_query *
 llvmpipe_create_query(struct pipe_context *pipe, 
                       unsigned type)
 {
    struct llvmpipe_query *pq;
 
-   assert(type == PIPE_QUERY_OCCLUSION_COUNTER);
+   assert(type == PIPE_QUERY_OCCLUSION_COUNTER ||
+          is_driver_query(type));
 
    pq = CALLOC_STRUCT( llvmpipe_query );
+   if (pq)
+      pq->type = type;
 
    return (struct pipe_query *) pq;
 }
@@ -91,6 +253,12 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
    uint64_t *result = (uint64_t *)vresult;
    int i;
 
+   if (is_driver_query(pq->type)) {
+      /* computed at end_query time */
+      *result = pq->result;
+      return TRUE;
+   }
+
    if (!pq->fence) {
       /* no fence because there was no scene, so results is zero */
       *result = 0;
@@ -124,6 +292,14 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   if (is_driver_query(pq->type)) {
+      /* Rasterize what was drawn so far so that it doesn't count */
+      llvmpipe_finish(pipe, __FUNCTION__);
+      pq->start_value = read_driver_counter(llvmpipe, pq->type);
+      pq->result = 0;
+      return;
+   }
+
    /* Check if the query is already in the scene.  If so, we need to
     * flush the scene now.  Real apps shouldn't re-use a query in a
     * frame of rendering.
@@ -147,6 +323,13 @@ llvmpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   if (is_driver_query(pq->type)) {
+      llvmpipe_finish(pipe, __FUNCTION__);
+      pq->result = read_driver_counter(llvmpipe, pq->type) -
+                   pq->start_value;
+      return;
+   }
+
    lp_setup_end_query(llvmpipe->setup, pq);
 
    assert(llvmpipe->active_query_count);
@@ -35,20 +35,56 @@
 
 #include <limits.h>
 #include "os/os_thread.h"
+#include "pipe/p_defines.h"
 #include "lp_limits.h"
+#include "lp_rast.h"
 
 
 struct llvmpipe_context;
+struct llvmpipe_screen;
+struct pipe_screen;
+struct pipe_driver_query_info;
+
+
+/**
+ * Driver-specific queries, reporting the rasterizer statistics (see
+ * lp_rast_counters) and the draw module's vertex cache statistics (see
+ * draw_vertex_cache_stats).
+ */
+#define LP_QUERY_RAST_BINS         (PIPE_QUERY_DRIVER_SPECIFIC + 0)
+#define LP_QUERY_RAST_FRAGMENTS    (PIPE_QUERY_DRIVER_SPECIFIC + 1)
+#define LP_QUERY_RAST_BUSY_TIME    (PIPE_QUERY_DRIVER_SPECIFIC + 2)
+#define LP_QUERY_RAST_WAIT_TIME    (PIPE_QUERY_DRIVER_SPECIFIC + 3)
+#define LP_QUERY_DRAW_INDICES      (PIPE_QUERY_DRIVER_SPECIFIC + 4)
+#define LP_QUERY_DRAW_VERTICES     (PIPE_QUERY_DRIVER_SPECIFIC + 5)
+#define LP_QUERY_DRAW_PRIMITIVES   (PIPE_QUERY_DRIVER_SPECIFIC + 6)
+/** Number of bin commands of each kind, LP_RAST_OP_MAX queries */
+#define LP_QUERY_RAST_OPS          (PIPE_QUERY_DRIVER_SPECIFIC + 7)
+/** Busy and wait time of each thread, 2 * LP_MAX_THREADS queries */
+#define LP_QUERY_RAST_THREAD_TIMES (LP_QUERY_RAST_OPS + LP_RAST_OP_MAX)
+#define LP_QUERY_END               (LP_QUERY_RAST_THREAD_TIMES + 2 * LP_MAX_THREADS)
 
 
 struct llvmpipe_query {
    uint64_t count[LP_MAX_THREADS];  /**< a counter for each thread */
    struct lp_fence *fence;      /* fence from last scene this was binned in */
+
+   unsigned type;               /**< PIPE_QUERY_x or LP_QUERY_x */
+   uint64_t start_value;        /**< LP_QUERY_x: counter value at begin */
+   uint64_t result;             /**< LP_QUERY_x: result */
 };
 
 
 extern void llvmpipe_init_query_funcs(struct llvmpipe_context * );
 
+extern void
+llvmpipe_init_driver_query_names(struct llvmpipe_screen *screen);
+
+extern int
+llvmpipe_get_driver_query_info(struct pipe_screen *screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info);
+
 extern boolean llvmpipe_check_render_cond(struct llvmpipe_context *);
 
 #endif /* LP_QUERY_H */
@@ -26,11 +26,14 @@
  **************************************************************************/
 
 #include <limits.h>
+#include "os/os_time.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
 #include "util/u_rect.h"
 #include "util/u_surface.h"
 #include "util/u_pack_color.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_sse.h"
 
 #include "lp_scene_queue.h"
 #include "lp_debug.h"
@@ -94,9 +97,6 @@ static void
 lp_rast_tile_begin(struct lp_rasterizer_task *task,
                    const struct cmd_bin *bin)
 {
-   const struct lp_scene *scene = task->scene;
-   enum lp_texture_usage usage;
-
    LP_DBG(DEBUG_RAST, "%s %d,%d\n", __FUNCTION__, bin->x, bin->y);
 
    task->bin = bin;
@@ -106,28 +106,28 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
    /* reset pointers to color tile(s) */
    memset(task->color_tiles, 0, sizeof(task->color_tiles));
 
+   /* find the fast clear state of the tile in each buffer */
+   {
+      const struct lp_scene *scene = task->scene;
+      unsigned i;
+
+      for (i = 0; i < scene->fb.nr_cbufs; i++) {
+         task->color_clear[i] = scene->cbufs[i].tile_clear ?
+            &scene->cbufs[i].tile_clear[bin->y * scene->cbufs[i].tile_clear_stride +
+                                        bin->x] : NULL;
+      }
+
+      task->zs_clear = scene->zsbuf.tile_clear ?
+         &scene->zsbuf.tile_clear[bin->y * scene->zsbuf.tile_clear_stride +
+                                  bin->x] : NULL;
+   }
+
    /* get pointer to depth/stencil tile */
    {
       struct pipe_surface *zsbuf = task->scene->fb.zsbuf;
       if (zsbuf) {
-         struct llvmpipe_resource *lpt = llvmpipe_resource(zsbuf->texture);
-
-         if (scene->has_depthstencil_clear)
-            usage = LP_TEX_USAGE_WRITE_ALL;
-         else
-            usage = LP_TEX_USAGE_READ_WRITE;
-
-         /* "prime" the tile: convert data from linear to tiled if necessary
-          * and update the tile's layout info.
-          */
-         (void) llvmpipe_get_texture_tile(lpt,
-                                          zsbuf->u.tex.first_layer,
-                                          zsbuf->u.tex.level,
-                                          usage,
-                                          task->x,
-                                          task->y);
-         /* Get actual pointer to the tile data.  Note that depth/stencil
-          * data is tiled differently than color data.
+         /* The depth/stencil data is kept in linear layout, so this is
+          * just the address of the tile's top-left pixel.
           */
          task->depth_tile = lp_rast_get_depth_block_pointer(task,
                                                             task->x,
@@ -139,12 +139,61 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
          task->depth_tile = NULL;
       }
    }
+
+   lp_rast_hiz_tile_begin(task);
+
+   /* the depth bounds of a tile still cleared from a previous scene are
+    * known too
+    */
+   if (task->zs_clear && task->zs_clear->cleared)
+      lp_rast_hiz_clear(task, task->zs_clear->zs, ~0);
+}
+
+
+/**
+ * Fill a swizzled color tile with a clear color.
+ */
+void
+lp_rast_fill_color_tile(uint8_t *tile, const uint8_t *clear_color)
+{
+   if (clear_color[0] == clear_color[1] &&
+       clear_color[1] == clear_color[2] &&
+       clear_color[2] == clear_color[3]) {
+      /* clear to grayscale value {x, x, x, x} */
+      memset(tile, clear_color[0], TILE_SIZE * TILE_SIZE * 4);
+   }
+   else {
+      /* Non-gray color.
+       * Note: if the swizzled tile layout changes (see TILE_PIXEL) this code
+       * will need to change.  It'll be pretty obvious when clearing no longer
+       * works.
+       */
+      const unsigned chunk = TILE_SIZE / 4;
+      uint8_t *c = tile;
+      unsigned j;
+
+      for (j = 0; j < 4 * TILE_SIZE; j++) {
+         memset(c, clear_color[0], chunk);
+         c += chunk;
+         memset(c, clear_color[1], chunk);
+         c += chunk;
+         memset(c, clear_color[2], chunk);
+         c += chunk;
+         memset(c, clear_color[3], chunk);
+         c += chunk;
+      }
+   }
 }
 
 
 /**
  * Clear the rasterizer's current color tile.
  * This is a bin command called during bin processing.
+ *
+ * Unless the tile has already been loaded for rendering, this only records
+ * the clear color in the fast clear state of the tile, and the clear color
+ * gets written when the tile contents are first needed (see
+ * lp_rast_get_color_tile_pointer and llvmpipe_resolve_tile_clears).
  */
 static void
 lp_rast_clear_color(struct lp_rasterizer_task *task,
@@ -161,76 +210,44 @@ lp_rast_clear_color(struct lp_rasterizer_task *task,
               clear_color[2],
               clear_color[3]);
 
-   if (clear_color[0] == clear_color[1] &&
-       clear_color[1] == clear_color[2] &&
-       clear_color[2] == clear_color[3]) {
-      /* clear to grayscale value {x, x, x, x} */
-      for (i = 0; i < scene->fb.nr_cbufs; i++) {
-         uint8_t *ptr =
-            lp_rast_get_color_tile_pointer(task, i, LP_TEX_USAGE_WRITE_ALL);
-	 memset(ptr, clear_color[0], TILE_SIZE * TILE_SIZE * 4);
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      struct llvmpipe_tile_clear *tile_clear = task->color_clear[i];
+
+      if (tile_clear && !task->color_tiles[i]) {
+         tile_clear->cleared = TRUE;
+         memcpy(tile_clear->color, clear_color, sizeof tile_clear->color);
+         LP_COUNT(nr_fast_clear_tile);
       }
-   }
-   else {
-      /* Non-gray color.
-       * Note: if the swizzled tile layout changes (see TILE_PIXEL) this code
-       * will need to change.  It'll be pretty obvious when clearing no longer
-       * works.
-       */
-      const unsigned chunk = TILE_SIZE / 4;
-      for (i = 0; i < scene->fb.nr_cbufs; i++) {
-         uint8_t *c =
+      else {
+         uint8_t *ptr =
             lp_rast_get_color_tile_pointer(task, i, LP_TEX_USAGE_WRITE_ALL);
-         unsigned j;
-
-         for (j = 0; j < 4 * TILE_SIZE; j++) {
-            memset(c, clear_color[0], chunk);
-            c += chunk;
-            memset(c, clear_color[1], chunk);
-            c += chunk;
-            memset(c, clear_color[2], chunk);
-            c += chunk;
-            memset(c, clear_color[3], chunk);
-            c += chunk;
-         }
+         lp_rast_fill_color_tile(ptr, clear_color);
+         LP_COUNT(nr_color_tile_clear);
       }
    }
-
-   LP_COUNT(nr_color_tile_clear);
 }
 
 
 
 
-
-
 /**
- * Clear the rasterizer's current z/stencil tile.
- * This is a bin command called during bin processing.
+ * Write a clear value into the current z/stencil tile.
  */
 static void
-lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
-                       const union lp_rast_cmd_arg arg)
+clear_zstencil_tile(struct lp_rasterizer_task *task,
+                    uint32_t clear_value, uint32_t clear_mask)
 {
    const struct lp_scene *scene = task->scene;
-   uint32_t clear_value = arg.clear_zstencil.value;
-   uint32_t clear_mask = arg.clear_zstencil.mask;
-   const unsigned height = TILE_SIZE / TILE_VECTOR_HEIGHT;
-   const unsigned width = TILE_SIZE * TILE_VECTOR_HEIGHT;
+   const unsigned height = TILE_SIZE;
+   const unsigned width = TILE_SIZE;
    const unsigned block_size = scene->zsbuf.blocksize;
-   const unsigned dst_stride = scene->zsbuf.stride * TILE_VECTOR_HEIGHT;
+   const unsigned dst_stride = scene->zsbuf.stride;
    uint8_t *dst;
    unsigned i, j;
 
-   LP_DBG(DEBUG_RAST, "%s: value=0x%08x, mask=0x%08x\n",
-           __FUNCTION__, clear_value, clear_mask);
-
    /*
-    * Clear the area of the swizzled depth/depth buffer matching this tile, in
-    * stripes of TILE_VECTOR_HEIGHT x TILE_SIZE at a time.
-    *
-    * The swizzled depth format is such that the depths for
-    * TILE_VECTOR_HEIGHT x TILE_VECTOR_WIDTH pixels have consecutive offsets.
+    * Clear the area of the linear depth/stencil buffer matching this tile,
+    * one row at a time.
     */
 
    dst = task->depth_tile;
@@ -239,11 +256,14 @@ lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
 
    switch (block_size) {
    case 1:
-      assert(clear_mask == 0xff);
-      memset(dst, (uint8_t) clear_value, height * width);
+      assert((clear_mask & 0xff) == 0xff);
+      for (i = 0; i < height; i++) {
+         memset(dst, (uint8_t) clear_value, width);
+         dst += dst_stride;
+      }
       break;
    case 2:
-      if (clear_mask == 0xffff) {
+      if ((clear_mask & 0xffff) == 0xffff) {
          for (i = 0; i < height; i++) {
             uint16_t *row = (uint16_t *)dst;
             for (j = 0; j < width; j++)
@@ -289,6 +309,65 @@ lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
 }
 
 
+/**
+ * Write out the fast clear value of the current z/stencil tile, before
+ * the depth/stencil values are accessed for the first time.
+ */
+void
+lp_rast_resolve_zs_clear(struct lp_rasterizer_task *task)
+{
+   assert(task->zs_clear && task->zs_clear->cleared);
+
+   clear_zstencil_tile(task, task->zs_clear->zs, ~0);
+   task->zs_clear->cleared = FALSE;
+
+   LP_COUNT(nr_fast_clear_resolve);
+}
+
+
+/**
+ * Clear the rasterizer's current z/stencil tile.
+ * This is a bin command called during bin processing.
+ *
+ * Clears of all the bits of the tile, or of tiles which are still fast
+ * cleared, only update the fast clear state.
+ */
+static void
+lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
+                       const union lp_rast_cmd_arg arg)
+{
+   const struct lp_scene *scene = task->scene;
+   struct llvmpipe_tile_clear *tile_clear = task->zs_clear;
+   uint32_t clear_value = arg.clear_zstencil.value;
+   uint32_t clear_mask = arg.clear_zstencil.mask;
+
+   LP_DBG(DEBUG_RAST, "%s: value=0x%08x, mask=0x%08x\n",
+           __FUNCTION__, clear_value, clear_mask);
+
+   if (tile_clear && !tile_clear->cleared) {
+      /* Bits not present in the format (e.g. the X in Z24X8) don't count */
+      const uint32_t format_mask =
+         util_pack_mask_z_stencil(scene->fb.zsbuf->format, ~0, ~0);
+
+      if ((clear_mask & format_mask) == format_mask) {
+         tile_clear->cleared = TRUE;
+         tile_clear->zs = 0;
+      }
+   }
+
+   if (tile_clear && tile_clear->cleared) {
+      tile_clear->zs = (tile_clear->zs & ~clear_mask) |
+                       (clear_value & clear_mask);
+      LP_COUNT(nr_fast_clear_tile);
+   }
+   else {
+      clear_zstencil_tile(task, clear_value, clear_mask);
+   }
+
+   lp_rast_hiz_clear(task, arg.clear_zstencil.value, clear_mask);
+}
+
+
 
 /**
  * Convert the color tile from tiled to linear layout.
@@ -338,7 +417,7 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
    const struct lp_rast_state *state;
    struct lp_fragment_shader_variant *variant;
    const unsigned tile_x = task->x, tile_y = task->y;
-   unsigned x, y;
+   unsigned x, y, bx, by;
 
    if (inputs->disable) {
       /* This command was partially binned and has been disabled */
@@ -354,34 +433,57 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
    }
    variant = state->variant;
 
-   /* render the whole 64x64 tile in 4x4 chunks */
-   for (y = 0; y < TILE_SIZE; y += 4){
-      for (x = 0; x < TILE_SIZE; x += 4) {
-         uint8_t *color[PIPE_MAX_COLOR_BUFS];
-         uint32_t *depth;
-         unsigned i;
-
-         /* color buffer */
-         for (i = 0; i < scene->fb.nr_cbufs; i++)
-            color[i] = lp_rast_get_color_block_pointer(task, i,
-                                                       tile_x + x, tile_y + y);
-
-         /* depth buffer */
-         depth = lp_rast_get_depth_block_pointer(task, tile_x + x, tile_y + y);
-
-         /* run shader on 4x4 block */
-         BEGIN_JIT_CALL(state, task);
-         variant->jit_function[RAST_WHOLE]( &state->jit_context,
-                                            tile_x + x, tile_y + y,
-                                            inputs->frontfacing,
-                                            GET_A0(inputs),
-                                            GET_DADX(inputs),
-                                            GET_DADY(inputs),
-                                            color,
-                                            depth,
-                                            0xffff,
-                                            &task->vis_counter);
-         END_JIT_CALL();
+   if (lp_rast_hiz_reject(task, inputs, tile_x, tile_y, TILE_SIZE))
+      return;
+
+   lp_rast_prepare_depth_tile(task);
+
+   /* render the whole 64x64 tile in 4x4 chunks, skipping the 16x16
+    * blocks which are known to fail the depth test
+    */
+   for (by = 0; by < TILE_SIZE; by += LP_HIZ_BLOCK_SIZE) {
+      for (bx = 0; bx < TILE_SIZE; bx += LP_HIZ_BLOCK_SIZE) {
+         if (lp_rast_hiz_reject(task, inputs, tile_x + bx, tile_y + by,
+                                LP_HIZ_BLOCK_SIZE))
+            continue;
+
+         for (y = by; y < by + LP_HIZ_BLOCK_SIZE; y += 4) {
+            for (x = bx; x < bx + LP_HIZ_BLOCK_SIZE; x += 4) {
+               uint8_t *color[PIPE_MAX_COLOR_BUFS];
+               uint32_t *depth;
+               unsigned i;
+
+               /* color buffer */
+               for (i = 0; i < scene->fb.nr_cbufs; i++)
+                  color[i] = lp_rast_get_color_block_pointer(task, i,
+                                                             tile_x + x,
+                                                             tile_y + y);
+
+               /* depth buffer */
+               depth = lp_rast_get_depth_block_pointer(task, tile_x + x,
+                                                       tile_y + y);
+
+               /* run shader on 4x4 block */
+               BEGIN_JIT_CALL(state, task);
+               variant->jit_function[RAST_WHOLE]( &state->jit_context,
+                                                  tile_x + x, tile_y + y,
+                                                  inputs->frontfacing,
+                                                  GET_A0(inputs),
+                                                  GET_DADX(inputs),
+                                                  GET_DADY(inputs),
+                                                  color,
+                                                  depth,
+                                                  scene->zsbuf.stride,
+                                                  0xffff,
+                                                  &task->vis_counter);
+               END_JIT_CALL();
+            }
+         }
+
+         task->counters.nr_fragments += LP_HIZ_BLOCK_SIZE * LP_HIZ_BLOCK_SIZE;
+
+         lp_rast_hiz_update(task, inputs, tile_x + bx, tile_y + by,
+                            LP_HIZ_BLOCK_SIZE, TRUE);
       }
    }
 }
@@ -406,7 +508,7 @@ lp_rast_shade_tile_opaque(struct lp_rasterizer_task *task,
       return;
    }
 
-   /* this will prevent converting the layout from tiled to linear */
+   /* this will prevent loading the old contents into the swizzled tile */
    for (i = 0; i < scene->fb.nr_cbufs; i++) {
       (void)lp_rast_get_color_tile_pointer(task, i, LP_TEX_USAGE_WRITE_ALL);
    }
@@ -452,8 +554,10 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
    }
 
    /* depth buffer */
+   lp_rast_prepare_depth_tile(task);
    depth = lp_rast_get_depth_block_pointer(task, x, y);
 
+   task->counters.nr_fragments += util_bitcount(mask);
 
    assert(lp_check_alignment(state->jit_context.blend_color, 16));
 
@@ -467,6 +571,7 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
                                          GET_DADY(inputs),
                                          color,
                                          depth,
+                                         scene->zsbuf.stride,
                                          mask,
                                          &task->vis_counter);
    END_JIT_CALL();
@@ -604,7 +709,9 @@ lp_rast_tile_end(struct lp_rasterizer_task *task)
 
    /* debug */
    memset(task->color_tiles, 0, sizeof(task->color_tiles));
+   memset(task->color_clear, 0, sizeof(task->color_clear));
    task->depth_tile = NULL;
+   task->zs_clear = NULL;
 
    task->bin = NULL;
 }
@@ -644,7 +751,8 @@ do_rasterize_bin(struct lp_rasterizer_task *task,
 
    for (block = bin->head; block; block = block->next) {
       for (k = 0; k < block->count; k++) {
-         dispatch[block->cmd[k]]( task, block->arg[k] );
+         task->counters.nr_ops[block->cmd[k]]++;
+         task->rast->dispatch[block->cmd[k]]( task, block->arg[k] );
       }
    }
 }
@@ -661,12 +769,22 @@ static void
 rasterize_bin(struct lp_rasterizer_task *task,
               const struct cmd_bin *bin )
 {
+   int64_t start, end;
+
+   start = os_time_get();
+
    lp_rast_tile_begin( task, bin );
 
    do_rasterize_bin(task, bin);
 
    lp_rast_tile_end(task);
 
+   end = os_time_get();
+
+   task->counters.nr_bins++;
+   task->counters.busy_time += end - start;
+   lp_rast_trace_event(task, "bin", start, end, bin->x, bin->y);
+
 
    /* Debug/Perf flags:
     */
@@ -787,6 +905,27 @@ lp_rast_finish( struct lp_rasterizer *rast )
          pipe_semaphore_wait(&rast->tasks[i].work_done);
       }
    }
+
+   if (rast->trace)
+      lp_rast_trace_flush(rast);
+}
+
+
+/**
+ * Wait for all the rasterizer threads to get to this point, keeping track
+ * of the time spent waiting.
+ */
+static void
+rast_barrier_wait(struct lp_rasterizer_task *task)
+{
+   int64_t start, end;
+
+   start = os_time_get();
+   pipe_barrier_wait( &task->rast->barrier );
+   end = os_time_get();
+
+   task->counters.wait_time += end - start;
+   lp_rast_trace_event(task, "wait", start, end, -1, -1);
 }
 
 
@@ -824,7 +963,7 @@ static PIPE_THREAD_ROUTINE( thread_function, init_data )
       /* Wait for all threads to get here so that threads[1+] don't
        * get a null rast->curr_scene pointer.
        */
-      pipe_barrier_wait( &rast->barrier );
+      rast_barrier_wait(task);
 
       /* do work */
       if (debug)
@@ -834,7 +973,7 @@ static PIPE_THREAD_ROUTINE( thread_function, init_data )
                       rast->curr_scene);
       
       /* wait for all threads to finish with this scene */
-      pipe_barrier_wait( &rast->barrier );
+      rast_barrier_wait(task);
 
       /* XXX: shouldn't be necessary:
        */
@@ -902,6 +1041,18 @@ lp_rast_create( unsigned num_threads )
    rast->num_threads = num_threads;
 
    rast->no_rast = debug_get_bool_option("LP_NO_RAST", FALSE);
+   rast->no_hiz = debug_get_bool_option("LP_NO_HIZ", FALSE);
+
+   memcpy(rast->dispatch, dispatch, sizeof rast->dispatch);
+#if defined(U_HAVE_AVX2_INTRINSICS)
+   if (util_cpu_caps.has_avx2) {
+      rast->dispatch[LP_RAST_OP_TRIANGLE_3_4] = lp_rast_triangle_3_4_avx2;
+      rast->dispatch[LP_RAST_OP_TRIANGLE_3_16] = lp_rast_triangle_3_16_avx2;
+      rast->dispatch[LP_RAST_OP_TRIANGLE_4_16] = lp_rast_triangle_4_16_avx2;
+   }
+#endif
+
+   lp_rast_trace_init(rast);
 
    create_rast_threads(rast);
 
@@ -952,6 +1103,8 @@ void lp_rast_destroy( struct lp_rasterizer *rast )
 
    lp_scene_queue_destroy(rast->full_scenes);
 
+   lp_rast_trace_destroy(rast);
+
    FREE(rast);
 }
 
@@ -964,3 +1117,37 @@ lp_rast_get_num_threads( struct lp_rasterizer *rast )
 }
 
 
+/**
+ * Get the statistics of one rasterizer thread, or the sum over all the
+ * threads if thread is negative.
+ * Should only be called while the rasterizer is idle.
+ */
+void
+lp_rast_get_counters( struct lp_rasterizer *rast,
+                      int thread,
+                      struct lp_rast_counters *counters )
+{
+   const unsigned num_tasks = MAX2(1, rast->num_threads);
+   unsigned i, j;
+
+   if (thread >= 0) {
+      assert(thread < (int) num_tasks);
+      *counters = rast->tasks[thread].counters;
+      return;
+   }
+
+   memset(counters, 0, sizeof *counters);
+
+   for (i = 0; i < num_tasks; i++) {
+      const struct lp_rast_counters *c = &rast->tasks[i].counters;
+
+      counters->nr_bins += c->nr_bins;
+      counters->nr_fragments += c->nr_fragments;
+      counters->busy_time += c->busy_time;
+      counters->wait_time += c->wait_time;
+      for (j = 0; j < LP_RAST_OP_MAX; j++)
+         counters->nr_ops[j] += c->nr_ops[j];
+   }
+}
+
+
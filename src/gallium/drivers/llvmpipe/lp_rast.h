@@ -270,6 +270,29 @@ lp_rast_arg_null( void )
 #define LP_RAST_OP_MAX               0x12
 #define LP_RAST_OP_MASK              0xff
 
+
+/**
+ * Rasterizer statistics.  These are always collected, per thread, and
+ * only ever increase.  They're only stable while no scene is being
+ * rasterized (e.g. after lp_rast_finish()).
+ */
+struct lp_rast_counters
+{
+   uint64_t nr_bins;        /**< number of bins rasterized */
+   uint64_t nr_fragments;   /**< fragments passed to the fragment shader */
+   uint64_t busy_time;      /**< usecs spent rasterizing bins */
+   uint64_t wait_time;      /**< usecs spent waiting for the other threads */
+   uint64_t nr_ops[LP_RAST_OP_MAX];  /**< bin commands executed, per op */
+};
+
+void
+lp_rast_get_counters( struct lp_rasterizer *rast,
+                      int thread,
+                      struct lp_rast_counters *counters );
+
+const char *
+lp_rast_cmd_name( unsigned cmd );
+
 void
 lp_debug_bins( struct lp_scene *scene );
 void
@@ -44,7 +44,8 @@ static const char *cmd_names[LP_RAST_OP_MAX] =
    "set_state",
 };
 
-static const char *cmd_name(unsigned cmd)
+const char *
+lp_rast_cmd_name(unsigned cmd)
 {
    assert(Elements(cmd_names) > cmd);
    return cmd_names[cmd];
@@ -103,7 +104,7 @@ debug_bin( const struct cmd_bin *bin )
             state = head->arg[i].state;
 
          debug_printf("%d: %s %s\n", j,
-                      cmd_name(head->cmd[i]),
+                      lp_rast_cmd_name(head->cmd[i]),
                       is_blend(state, head, i) ? "blended" : "");
       }
       head = head->next;
@@ -250,7 +251,7 @@ do_debug_bin( struct tile *tile,
          int count = 0;
             
          if (print_cmds)
-            debug_printf("%c: %15s", val, cmd_name(block->cmd[k]));
+            debug_printf("%c: %15s", val, lp_rast_cmd_name(block->cmd[k]));
 
          if (block->cmd[k] == LP_RAST_OP_SET_STATE)
             tile->state = block->arg[k].state;
@@ -0,0 +1,359 @@
+/**************************************************************************
+ *
+ * Copyright 2012 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * Hierarchical depth ("hi-z") for the rasterizer.
+ *
+ * Each rasterizer task keeps conservative min/max depth bounds for every
+ * LP_HIZ_BLOCK_SIZE x LP_HIZ_BLOCK_SIZE block of the tile it is working
+ * on.  The bounds are established by depth clears, tightened when a block
+ * is fully covered by a triangle whose fragments are all guaranteed to be
+ * depth tested and written, and loosened otherwise.
+ *
+ * Before running the fragment shader on a block we compare the depth range
+ * of the triangle's plane over the block against those bounds, and skip
+ * the block entirely when no fragment could possibly pass the depth test.
+ */
+
+#include <float.h>
+#include "util/u_math.h"
+#include "util/u_format.h"
+#include "util/u_pack_color.h"
+#include "lp_debug.h"
+#include "lp_perf.h"
+#include "lp_rast_priv.h"
+
+
+/**
+ * Slack added on either side of the triangle depth range.  Covers the
+ * differences between our scalar plane evaluation and the jitted
+ * interpolation, as well as the rounding of depth values to unorm.
+ */
+#define LP_HIZ_EPSILON (1.0f / 16384.0f)
+
+
+static INLINE void
+hiz_set_unknown(struct lp_rast_hiz *hiz,
+                unsigned bx0, unsigned by0,
+                unsigned bx1, unsigned by1)
+{
+   unsigned bx, by;
+
+   for (by = by0; by <= by1; by++) {
+      for (bx = bx0; bx <= bx1; bx++) {
+         hiz->zmin[by][bx] = -FLT_MAX;
+         hiz->zmax[by][bx] = FLT_MAX;
+      }
+   }
+}
+
+
+/**
+ * Compute the range of depth values the triangle's depth plane takes over
+ * the size x size block of pixels at x, y (window coords).
+ */
+static INLINE void
+hiz_tri_depth_range(const struct lp_rast_hiz *hiz,
+                    const struct lp_rast_shader_inputs *inputs,
+                    int x, int y, unsigned size,
+                    float *zlo, float *zhi)
+{
+   const float a0 = GET_A0(inputs)[0][2];
+   const float dzdx = GET_DADX(inputs)[0][2];
+   const float dzdy = GET_DADY(inputs)[0][2];
+   const float ex = dzdx * (float)(size - 1);
+   const float ey = dzdy * (float)(size - 1);
+   const float z = a0 + dzdx * (float)x + dzdy * (float)y;
+   float lo = z + MIN2(ex, 0.0f) + MIN2(ey, 0.0f) - LP_HIZ_EPSILON;
+   float hi = z + MAX2(ex, 0.0f) + MAX2(ey, 0.0f) + LP_HIZ_EPSILON;
+
+   if (!(lo <= hi)) {
+      /* NaN or inf in the coefficients, don't draw any conclusions */
+      lo = -FLT_MAX;
+      hi = FLT_MAX;
+   }
+   else if (hiz->clamp) {
+      /* Unorm depth buffers see the depth value clamped to [0, 1] */
+      lo = CLAMP(lo, 0.0f, 1.0f);
+      hi = CLAMP(hi, 0.0f, 1.0f);
+   }
+
+   *zlo = lo;
+   *zhi = hi;
+}
+
+
+/**
+ * Setup the hi-z state at the beginning of a tile.  Nothing is known about
+ * the contents of the depth buffer until it gets cleared or written.
+ */
+void
+lp_rast_hiz_tile_begin(struct lp_rasterizer_task *task)
+{
+   const struct lp_scene *scene = task->scene;
+   struct lp_rast_hiz *hiz = &task->hiz;
+   const struct util_format_description *desc;
+
+   hiz->enabled = FALSE;
+
+   if (task->rast->no_hiz || !scene->fb.zsbuf || !scene->zsbuf.map)
+      return;
+
+   desc = util_format_description(scene->fb.zsbuf->format);
+   if (!desc || !util_format_has_depth(desc))
+      return;
+
+   hiz->enabled = TRUE;
+   hiz->clamp = desc->channel[desc->swizzle[0]].type != UTIL_FORMAT_TYPE_FLOAT;
+
+   hiz_set_unknown(hiz, 0, 0, LP_HIZ_BLOCKS - 1, LP_HIZ_BLOCKS - 1);
+}
+
+
+/**
+ * Update the bounds after the current tile's depth/stencil buffer has been
+ * cleared with the given packed value and mask.
+ */
+void
+lp_rast_hiz_clear(struct lp_rasterizer_task *task,
+                  uint32_t value, uint32_t mask)
+{
+   const struct lp_scene *scene = task->scene;
+   struct lp_rast_hiz *hiz = &task->hiz;
+   const struct util_format_description *desc;
+   enum pipe_format format;
+   uint32_t zmask;
+   unsigned bx, by;
+   float z;
+
+   if (!hiz->enabled)
+      return;
+
+   format = scene->fb.zsbuf->format;
+   zmask = util_pack_mask_z_stencil(format, ~0, 0);
+
+   if ((mask & zmask) == 0) {
+      /* stencil only clear */
+      return;
+   }
+
+   if ((mask & zmask) != zmask) {
+      hiz_set_unknown(hiz, 0, 0, LP_HIZ_BLOCKS - 1, LP_HIZ_BLOCKS - 1);
+      return;
+   }
+
+   desc = util_format_description(format);
+
+   switch (scene->zsbuf.blocksize) {
+   case 2:
+      {
+         uint16_t packed = (uint16_t) value;
+         desc->unpack_z_float(&z, 0, (const uint8_t *) &packed, 0, 1, 1);
+      }
+      break;
+   case 4:
+      desc->unpack_z_float(&z, 0, (const uint8_t *) &value, 0, 1, 1);
+      break;
+   default:
+      hiz_set_unknown(hiz, 0, 0, LP_HIZ_BLOCKS - 1, LP_HIZ_BLOCKS - 1);
+      return;
+   }
+
+   for (by = 0; by < LP_HIZ_BLOCKS; by++) {
+      for (bx = 0; bx < LP_HIZ_BLOCKS; bx++) {
+         hiz->zmin[by][bx] = z;
+         hiz->zmax[by][bx] = z;
+      }
+   }
+}
+
+
+/**
+ * Determine whether all fragments of the triangle in the size x size block
+ * at x, y (window coords) are known to fail the depth test.
+ */
+boolean
+lp_rast_hiz_reject(struct lp_rasterizer_task *task,
+                   const struct lp_rast_shader_inputs *inputs,
+                   int x, int y, unsigned size)
+{
+   const struct lp_rast_hiz *hiz = &task->hiz;
+   const struct lp_fragment_shader_variant *variant = task->state->variant;
+   unsigned bx0, by0, bx1, by1, bx, by;
+   float zmin = FLT_MAX, zmax = -FLT_MAX;
+   float lo, hi;
+   boolean reject;
+
+   if (!hiz->enabled || !variant->hiz_test)
+      return FALSE;
+
+   bx0 = (x - task->x) / LP_HIZ_BLOCK_SIZE;
+   by0 = (y - task->y) / LP_HIZ_BLOCK_SIZE;
+   bx1 = (x - task->x + size - 1) / LP_HIZ_BLOCK_SIZE;
+   by1 = (y - task->y + size - 1) / LP_HIZ_BLOCK_SIZE;
+
+   assert(bx1 < LP_HIZ_BLOCKS);
+   assert(by1 < LP_HIZ_BLOCKS);
+
+   for (by = by0; by <= by1; by++) {
+      for (bx = bx0; bx <= bx1; bx++) {
+         zmin = MIN2(zmin, hiz->zmin[by][bx]);
+         zmax = MAX2(zmax, hiz->zmax[by][bx]);
+      }
+   }
+
+   hiz_tri_depth_range(hiz, inputs, x, y, size, &lo, &hi);
+
+   switch (variant->key.depth.func) {
+   case PIPE_FUNC_NEVER:
+      reject = TRUE;
+      break;
+   case PIPE_FUNC_LESS:
+      reject = lo >= zmax;
+      break;
+   case PIPE_FUNC_LEQUAL:
+      reject = lo > zmax;
+      break;
+   case PIPE_FUNC_GREATER:
+      reject = hi <= zmin;
+      break;
+   case PIPE_FUNC_GEQUAL:
+      reject = hi < zmin;
+      break;
+   case PIPE_FUNC_EQUAL:
+      reject = lo > zmax || hi < zmin;
+      break;
+   default:
+      reject = FALSE;
+      break;
+   }
+
+   if (reject) {
+      if (size == TILE_SIZE)
+         LP_COUNT(nr_hiz_reject_64);
+      else if (size == 16)
+         LP_COUNT(nr_hiz_reject_16);
+      else
+         LP_COUNT(nr_hiz_reject_4);
+   }
+
+   return reject;
+}
+
+
+/**
+ * Account for the depth writes done by shading the triangle in the
+ * size x size block at x, y (window coords).
+ * \param full  whether the triangle covers every pixel of the block
+ */
+void
+lp_rast_hiz_update(struct lp_rasterizer_task *task,
+                   const struct lp_rast_shader_inputs *inputs,
+                   int x, int y, unsigned size,
+                   boolean full)
+{
+   struct lp_rast_hiz *hiz = &task->hiz;
+   const struct lp_fragment_shader_variant *variant = task->state->variant;
+   const int tx0 = x - task->x;
+   const int ty0 = y - task->y;
+   const int tx1 = tx0 + size;
+   const int ty1 = ty0 + size;
+   unsigned bx0, by0, bx1, by1, bx, by;
+   float lo, hi;
+
+   if (!hiz->enabled ||
+       !variant->key.depth.enabled ||
+       !variant->key.depth.writemask ||
+       variant->key.depth.func == PIPE_FUNC_NEVER)
+      return;
+
+   bx0 = tx0 / LP_HIZ_BLOCK_SIZE;
+   by0 = ty0 / LP_HIZ_BLOCK_SIZE;
+   bx1 = (tx1 - 1) / LP_HIZ_BLOCK_SIZE;
+   by1 = (ty1 - 1) / LP_HIZ_BLOCK_SIZE;
+
+   assert(bx1 < LP_HIZ_BLOCKS);
+   assert(by1 < LP_HIZ_BLOCKS);
+
+   if (variant->shader->info.base.writes_z) {
+      /* Depth comes from the shader, we know nothing about it */
+      hiz_set_unknown(hiz, bx0, by0, bx1, by1);
+      return;
+   }
+
+   hiz_tri_depth_range(hiz, inputs, x, y, size, &lo, &hi);
+
+   for (by = by0; by <= by1; by++) {
+      for (bx = bx0; bx <= bx1; bx++) {
+         const int bx_start = bx * LP_HIZ_BLOCK_SIZE;
+         const int by_start = by * LP_HIZ_BLOCK_SIZE;
+         boolean covered = (full &&
+                            variant->hiz_exact &&
+                            bx_start >= tx0 &&
+                            by_start >= ty0 &&
+                            bx_start + LP_HIZ_BLOCK_SIZE <= tx1 &&
+                            by_start + LP_HIZ_BLOCK_SIZE <= ty1);
+         float *zmin = &hiz->zmin[by][bx];
+         float *zmax = &hiz->zmax[by][bx];
+
+         if (covered) {
+            /* Every pixel of the block gets depth tested against the
+             * triangle, so the new contents are bounded by the result of
+             * the depth function.
+             */
+            switch (variant->key.depth.func) {
+            case PIPE_FUNC_LESS:
+            case PIPE_FUNC_LEQUAL:
+               *zmin = MIN2(*zmin, lo);
+               *zmax = MIN2(*zmax, hi);
+               break;
+            case PIPE_FUNC_GREATER:
+            case PIPE_FUNC_GEQUAL:
+               *zmin = MAX2(*zmin, lo);
+               *zmax = MAX2(*zmax, hi);
+               break;
+            case PIPE_FUNC_ALWAYS:
+               *zmin = lo;
+               *zmax = hi;
+               break;
+            default:
+               covered = FALSE;
+               break;
+            }
+         }
+
+         if (!covered) {
+            /* Some pixels may keep their old value, others take the
+             * triangle's.
+             */
+            *zmin = MIN2(*zmin, lo);
+            *zmax = MAX2(*zmax, hi);
+         }
+      }
+   }
+}
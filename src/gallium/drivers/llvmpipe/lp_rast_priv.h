@@ -32,6 +32,7 @@
 #include "util/u_format.h"
 #include "gallivm/lp_bld_debug.h"
 #include "lp_memory.h"
+#include "lp_perf.h"
 #include "lp_rast.h"
 #include "lp_scene.h"
 #include "lp_state.h"
@@ -74,6 +75,42 @@ extern const struct lp_rasterizer_task *jit_task;
 struct lp_rasterizer;
 struct cmd_bin;
 
+
+/** Size of the blocks tracked by the hierarchical depth bounds */
+#define LP_HIZ_BLOCK_SIZE 16
+#define LP_HIZ_BLOCKS (TILE_SIZE / LP_HIZ_BLOCK_SIZE)
+
+/**
+ * Conservative depth bounds for the blocks of the tile being rasterized.
+ * See lp_rast_hiz.c
+ */
+struct lp_rast_hiz
+{
+   boolean enabled;   /**< depth buffer present and bounds maintained */
+   boolean clamp;     /**< depth values are clamped to [0,1] (unorm) */
+
+   float zmin[LP_HIZ_BLOCKS][LP_HIZ_BLOCKS];
+   float zmax[LP_HIZ_BLOCKS][LP_HIZ_BLOCKS];
+};
+
+
+/**
+ * A timed event, for the trace of the rasterizer activity (see
+ * lp_rast_trace.c).
+ */
+struct lp_rast_trace_event
+{
+   const char *name;
+   int64_t start, end;   /**< os_time_get() timestamps */
+   int x, y;             /**< tile position, or -1 */
+};
+
+/** Max number of trace events buffered per thread between flushes */
+#define LP_RAST_TRACE_EVENTS 8192
+
+struct lp_rast_trace;
+
+
 /**
  * Per-thread rasterization state
  */
@@ -88,6 +125,12 @@ struct lp_rasterizer_task
    uint8_t *color_tiles[PIPE_MAX_COLOR_BUFS];
    uint8_t *depth_tile;
 
+   /** Fast clear state of this tile in each buffer (may be NULL) */
+   struct llvmpipe_tile_clear *color_clear[PIPE_MAX_COLOR_BUFS];
+   struct llvmpipe_tile_clear *zs_clear;
+
+   struct lp_rast_hiz hiz;
+
    /** "back" pointer */
    struct lp_rasterizer *rast;
 
@@ -98,6 +141,13 @@ struct lp_rasterizer_task
    uint32_t vis_counter;
    struct llvmpipe_query *query;
 
+   /** statistics, see lp_rast_get_counters() */
+   struct lp_rast_counters counters;
+
+   /** trace events recorded since the last flush, NULL if not tracing */
+   struct lp_rast_trace_event *trace_events;
+   unsigned nr_trace_events;
+
    pipe_semaphore work_ready;
    pipe_semaphore work_done;
 };
@@ -112,6 +162,7 @@ struct lp_rasterizer
 {
    boolean exit_flag;
    boolean no_rast;  /**< For debugging/profiling */
+   boolean no_hiz;   /**< Disable hierarchical depth rejection */
 
    /** The incoming queue of scenes ready to rasterize */
    struct lp_scene_queue *full_scenes;
@@ -127,6 +178,12 @@ struct lp_rasterizer
 
    /** For synchronizing the rasterization threads */
    pipe_barrier barrier;
+
+   /** Command functions, with the best variants for this CPU */
+   lp_rast_cmd_func dispatch[LP_RAST_OP_MAX];
+
+   /** Trace output (LP_TRACE=<file>), or NULL */
+   struct lp_rast_trace *trace;
 };
 
 
@@ -136,6 +193,56 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
                          unsigned x, unsigned y,
                          unsigned mask);
 
+void
+lp_rast_fill_color_tile(uint8_t *tile, const uint8_t *clear_color);
+
+
+void
+lp_rast_trace_init(struct lp_rasterizer *rast);
+
+void
+lp_rast_trace_flush(struct lp_rasterizer *rast);
+
+void
+lp_rast_trace_destroy(struct lp_rasterizer *rast);
+
+
+/**
+ * Record a trace event for the current thread, if tracing.
+ */
+static INLINE void
+lp_rast_trace_event(struct lp_rasterizer_task *task,
+                    const char *name,
+                    int64_t start, int64_t end,
+                    int x, int y)
+{
+   if (task->trace_events &&
+       task->nr_trace_events < LP_RAST_TRACE_EVENTS) {
+      struct lp_rast_trace_event *event =
+         &task->trace_events[task->nr_trace_events++];
+      event->name = name;
+      event->start = start;
+      event->end = end;
+      event->x = x;
+      event->y = y;
+   }
+}
+
+void
+lp_rast_resolve_zs_clear(struct lp_rasterizer_task *task);
+
+
+/**
+ * Make sure the depth/stencil values of the current tile are in memory,
+ * prior to running the fragment shader on it.
+ */
+static INLINE void
+lp_rast_prepare_depth_tile(struct lp_rasterizer_task *task)
+{
+   if (task->zs_clear && task->zs_clear->cleared)
+      lp_rast_resolve_zs_clear(task);
+}
+
 
 
 /**
@@ -168,7 +275,7 @@ lp_rast_get_depth_block_pointer(struct lp_rasterizer_task *task,
 
    depth = (scene->zsbuf.map +
             scene->zsbuf.stride * y +
-            scene->zsbuf.blocksize * x * TILE_VECTOR_HEIGHT);
+            scene->zsbuf.blocksize * x);
 
    assert(lp_check_alignment(depth, 16));
    return depth;
@@ -197,7 +304,16 @@ lp_rast_get_color_tile_pointer(struct lp_rasterizer_task *task,
       lpt = llvmpipe_resource(cbuf->texture);
       task->color_tiles[buf] = lp_swizzled_cbuf[task->thread_index][buf];
 
-      if (usage != LP_TEX_USAGE_WRITE_ALL) {
+      if (task->color_clear[buf] && task->color_clear[buf]->cleared) {
+         /* fast cleared tile - no need to load the old contents */
+         if (usage != LP_TEX_USAGE_WRITE_ALL) {
+            lp_rast_fill_color_tile(task->color_tiles[buf],
+                                    task->color_clear[buf]->color);
+            LP_COUNT(nr_fast_clear_resolve);
+         }
+         task->color_clear[buf]->cleared = FALSE;
+      }
+      else if (usage != LP_TEX_USAGE_WRITE_ALL) {
          llvmpipe_swizzle_cbuf_tile(lpt,
                                     cbuf->u.tex.first_layer,
                                     cbuf->u.tex.level,
@@ -265,8 +381,11 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
    for (i = 0; i < scene->fb.nr_cbufs; i++)
       color[i] = lp_rast_get_color_block_pointer(task, i, x, y);
 
+   lp_rast_prepare_depth_tile(task);
    depth = lp_rast_get_depth_block_pointer(task, x, y);
 
+   task->counters.nr_fragments += 16;
+
    /* run shader on 4x4 block */
    BEGIN_JIT_CALL(state, task);
    variant->jit_function[RAST_WHOLE]( &state->jit_context,
@@ -277,6 +396,7 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
                                       GET_DADY(inputs),
                                       color,
                                       depth,
+                                      scene->zsbuf.stride,
                                       0xffff,
                                       &task->vis_counter );
    END_JIT_CALL();
@@ -308,10 +428,39 @@ void lp_rast_triangle_3_16( struct lp_rasterizer_task *,
 void lp_rast_triangle_4_16( struct lp_rasterizer_task *, 
                             const union lp_rast_cmd_arg );
 
+void lp_rast_triangle_3_4_avx2(struct lp_rasterizer_task *,
+                               const union lp_rast_cmd_arg );
+
+void lp_rast_triangle_3_16_avx2( struct lp_rasterizer_task *,
+                                 const union lp_rast_cmd_arg );
+
+void lp_rast_triangle_4_16_avx2( struct lp_rasterizer_task *,
+                                 const union lp_rast_cmd_arg );
+
 void
 lp_rast_set_state(struct lp_rasterizer_task *task,
                   const union lp_rast_cmd_arg arg);
- 
+
+
+void
+lp_rast_hiz_tile_begin(struct lp_rasterizer_task *task);
+
+void
+lp_rast_hiz_clear(struct lp_rasterizer_task *task,
+                  uint32_t value, uint32_t mask);
+
+boolean
+lp_rast_hiz_reject(struct lp_rasterizer_task *task,
+                   const struct lp_rast_shader_inputs *inputs,
+                   int x, int y, unsigned size);
+
+void
+lp_rast_hiz_update(struct lp_rasterizer_task *task,
+                   const struct lp_rast_shader_inputs *inputs,
+                   int x, int y, unsigned size,
+                   boolean full);
+
+
 void
 lp_debug_bin( const struct cmd_bin *bin );
 
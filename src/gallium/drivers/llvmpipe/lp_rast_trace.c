@@ -0,0 +1,186 @@
+/**************************************************************************
+ *
+ * Copyright 2013 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * Timeline trace of the rasterizer threads.
+ *
+ * When the LP_TRACE environment variable names a file, every rasterizer
+ * thread records when it rasterized each bin and how long it waited for
+ * the other threads.  The events are buffered per thread and written out
+ * whenever the rasterizer goes idle, in the Chrome trace event format
+ * (load the file in chrome://tracing), which makes load imbalance between
+ * the threads easy to spot.
+ */
+
+#include <stdio.h>
+#include "util/u_debug.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "lp_rast_priv.h"
+
+
+struct lp_rast_trace
+{
+   FILE *file;
+   boolean first;          /**< no event written yet */
+   unsigned nr_dropped;    /**< events lost because a buffer was full */
+};
+
+
+static void
+trace_write_thread_name(struct lp_rast_trace *trace, unsigned thread)
+{
+   fprintf(trace->file,
+           "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,"
+           "\"args\":{\"name\":\"llvmpipe rasterizer %u\"}}",
+           trace->first ? "" : ",\n", thread, thread);
+   trace->first = FALSE;
+}
+
+
+/**
+ * Open the trace file, if requested, and allocate the per-thread event
+ * buffers.  Called when creating the rasterizer, before starting the
+ * threads.
+ */
+void
+lp_rast_trace_init(struct lp_rasterizer *rast)
+{
+   const char *filename = debug_get_option("LP_TRACE", NULL);
+   const unsigned num_tasks = MAX2(1, rast->num_threads);
+   struct lp_rast_trace *trace;
+   unsigned i;
+
+   if (!filename)
+      return;
+
+   trace = CALLOC_STRUCT(lp_rast_trace);
+   if (!trace)
+      return;
+
+   trace->file = fopen(filename, "w");
+   if (!trace->file) {
+      debug_printf("llvmpipe: couldn't open trace file %s\n", filename);
+      FREE(trace);
+      return;
+   }
+
+   for (i = 0; i < num_tasks; i++) {
+      rast->tasks[i].trace_events =
+         MALLOC(LP_RAST_TRACE_EVENTS * sizeof(struct lp_rast_trace_event));
+      rast->tasks[i].nr_trace_events = 0;
+   }
+
+   /* The JSON array form of the format, so that events can be appended
+    * as they come.  The closing bracket is optional.
+    */
+   trace->first = TRUE;
+   fprintf(trace->file, "[\n");
+   for (i = 0; i < num_tasks; i++)
+      trace_write_thread_name(trace, i);
+
+   rast->trace = trace;
+}
+
+
+/**
+ * Write out the events recorded by all the threads.
+ * Must only be called while the rasterizer threads are idle.
+ */
+void
+lp_rast_trace_flush(struct lp_rasterizer *rast)
+{
+   struct lp_rast_trace *trace = rast->trace;
+   const unsigned num_tasks = MAX2(1, rast->num_threads);
+   unsigned i, j;
+
+   if (!trace)
+      return;
+
+   for (i = 0; i < num_tasks; i++) {
+      struct lp_rasterizer_task *task = &rast->tasks[i];
+
+      if (!task->trace_events)
+         continue;
+
+      for (j = 0; j < task->nr_trace_events; j++) {
+         const struct lp_rast_trace_event *event = &task->trace_events[j];
+
+         fprintf(trace->file,
+                 ",\n{\"name\":\"%s\",\"cat\":\"llvmpipe\",\"ph\":\"X\","
+                 "\"pid\":0,\"tid\":%u,\"ts\":%lld,\"dur\":%lld",
+                 event->name, i,
+                 (long long) event->start,
+                 (long long) (event->end - event->start));
+
+         if (event->x >= 0)
+            fprintf(trace->file, ",\"args\":{\"x\":%d,\"y\":%d}}",
+                    event->x, event->y);
+         else
+            fprintf(trace->file, "}");
+      }
+
+      if (task->nr_trace_events == LP_RAST_TRACE_EVENTS)
+         trace->nr_dropped++;
+
+      task->nr_trace_events = 0;
+   }
+
+   fflush(trace->file);
+}
+
+
+/**
+ * Flush the remaining events and close the trace file.
+ */
+void
+lp_rast_trace_destroy(struct lp_rasterizer *rast)
+{
+   struct lp_rast_trace *trace = rast->trace;
+   unsigned i;
+
+   if (!trace)
+      return;
+
+   lp_rast_trace_flush(rast);
+
+   fprintf(trace->file, "\n]\n");
+   fclose(trace->file);
+
+   if (trace->nr_dropped)
+      debug_printf("llvmpipe: trace event buffer overflowed %u times\n",
+                   trace->nr_dropped);
+
+   for (i = 0; i < Elements(rast->tasks); i++) {
+      FREE(rast->tasks[i].trace_events);
+      rast->tasks[i].trace_events = NULL;
+   }
+
+   FREE(trace);
+   rast->trace = NULL;
+}
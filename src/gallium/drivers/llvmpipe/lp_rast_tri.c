@@ -278,7 +278,10 @@ lp_rast_triangle_3_16(struct lp_rasterizer_task *task,
    __m128i span_1;                /* 0,dcdx,2dcdx,3dcdx for plane 1 */
    __m128i span_2;                /* 0,dcdx,2dcdx,3dcdx for plane 2 */
    __m128i unused;
-   
+
+   if (lp_rast_hiz_reject(task, &tri->inputs, x, y, 16))
+      return;
+
    transpose4_epi32(&p0, &p1, &p2, &zero,
                     &c, &dcdx, &dcdy, &rej4);
 
@@ -356,6 +359,9 @@ lp_rast_triangle_3_16(struct lp_rasterizer_task *task,
                                x + 4 * out[i].j,
                                y + 4 * out[i].i,
                                0xffff & ~out[i].mask);
+
+   if (nr)
+      lp_rast_hiz_update(task, &tri->inputs, x, y, 16, FALSE);
 }
 
 
@@ -388,6 +394,9 @@ lp_rast_triangle_3_4(struct lp_rasterizer_task *task,
    __m128i span_2;                /* 0,dcdx,2dcdx,3dcdx for plane 2 */
    __m128i unused;
 
+   if (lp_rast_hiz_reject(task, &tri->inputs, x, y, 4))
+      return;
+
    transpose4_epi32(&p0, &p1, &p2, &zero,
                     &c, &dcdx, &dcdy, &unused);
 
@@ -438,15 +447,288 @@ lp_rast_triangle_3_4(struct lp_rasterizer_task *task,
 
       unsigned mask = _mm_movemask_epi8(c_0123);
 
-      if (mask != 0xffff)
+      if (mask != 0xffff) {
+         lp_rast_shade_quads_mask(task,
+                                  &tri->inputs,
+                                  x,
+                                  y,
+                                  0xffff & ~mask);
+         lp_rast_hiz_update(task, &tri->inputs, x, y, 4, FALSE);
+      }
+   }
+}
+
+
+#if defined(U_HAVE_AVX2_INTRINSICS)
+
+/*
+ * AVX2 variants of the small triangle rasterization functions.  These
+ * evaluate two rows of a 4x4 block (or the same row of two horizontally
+ * adjacent 4x4 blocks) per instruction, and are only put in the dispatch
+ * table when util_cpu_caps.has_avx2 is set, see lp_rast_create().
+ */
+
+
+/** Duplicate a 128-bit value into both lanes of a 256-bit register */
+static INLINE U_AVX2_FUNC __m256i
+mm256_dup_si128(__m128i a)
+{
+   return _mm256_inserti128_si256(_mm256_castsi128_si256(a), a, 1);
+}
+
+
+/** Put a into the low lane and b into the high lane */
+static INLINE U_AVX2_FUNC __m256i
+mm256_set_m128i(__m128i b, __m128i a)
+{
+   return _mm256_inserti128_si256(_mm256_castsi128_si256(a), b, 1);
+}
+
+
+/**
+ * Like sign_bits4(), but cstep[0] holds rows 0,1 and cstep[1] rows 2,3.
+ */
+static INLINE U_AVX2_FUNC unsigned
+sign_bits4_avx2(const __m256i *cstep, int cdiff)
+{
+   __m256i cio8 = _mm256_set1_epi32(cdiff);
+   __m256i cstep01 = _mm256_add_epi32(cstep[0], cio8);
+   __m256i cstep23 = _mm256_add_epi32(cstep[1], cio8);
+
+   return (_mm256_movemask_ps(_mm256_castsi256_ps(cstep01)) |
+           _mm256_movemask_ps(_mm256_castsi256_ps(cstep23)) << 8);
+}
+
+
+U_AVX2_FUNC void
+lp_rast_triangle_3_16_avx2(struct lp_rasterizer_task *task,
+                           const union lp_rast_cmd_arg arg)
+{
+   const struct lp_rast_triangle *tri = arg.triangle.tri;
+   const struct lp_rast_plane *plane = GET_PLANES(tri);
+   int x = (arg.triangle.plane_mask & 0xff) + task->x;
+   int y = (arg.triangle.plane_mask >> 8) + task->y;
+   unsigned i, j;
+
+   struct { unsigned mask:16; unsigned i:8; unsigned j:8; } out[16];
+   unsigned nr = 0;
+
+   __m128i p0 = _mm_load_si128((__m128i *)&plane[0]); /* c, dcdx, dcdy, eo */
+   __m128i p1 = _mm_load_si128((__m128i *)&plane[1]); /* c, dcdx, dcdy, eo */
+   __m128i p2 = _mm_load_si128((__m128i *)&plane[2]); /* c, dcdx, dcdy, eo */
+   __m128i zero = _mm_setzero_si128();
+
+   __m128i c;
+   __m128i dcdx;
+   __m128i dcdy;
+   __m128i rej4;
+
+   __m128i dcdx2;
+   __m128i dcdx3;
+
+   __m128i span_0;                /* 0,dcdx,2dcdx,3dcdx for plane 0 */
+   __m128i span_1;                /* 0,dcdx,2dcdx,3dcdx for plane 1 */
+   __m128i span_2;                /* 0,dcdx,2dcdx,3dcdx for plane 2 */
+   __m128i unused;
+
+   __m256i c_blk;                 /* c of blocks j (low lane) and j+1 */
+   __m256i rej8, dcdx8, dcdy8;
+   __m256i span8_0, span8_1, span8_2;
+   __m256i dcdy8_0, dcdy8_1, dcdy8_2;
+
+   if (lp_rast_hiz_reject(task, &tri->inputs, x, y, 16))
+      return;
+
+   transpose4_epi32(&p0, &p1, &p2, &zero,
+                    &c, &dcdx, &dcdy, &rej4);
+
+   /* Adjust dcdx;
+    */
+   dcdx = _mm_sub_epi32(zero, dcdx);
+
+   c = _mm_add_epi32(c, _mm_mullo_epi32(dcdx, _mm_set1_epi32(x)));
+   c = _mm_add_epi32(c, _mm_mullo_epi32(dcdy, _mm_set1_epi32(y)));
+   rej4 = _mm_slli_epi32(rej4, 2);
+
+   /* Adjust so we can just check the sign bit (< 0 comparison), instead of having to do a less efficient <= 0 comparison */
+   c = _mm_sub_epi32(c, _mm_set1_epi32(1));
+   rej4 = _mm_add_epi32(rej4, _mm_set1_epi32(1));
+
+   dcdx2 = _mm_add_epi32(dcdx, dcdx);
+   dcdx3 = _mm_add_epi32(dcdx2, dcdx);
+
+   transpose4_epi32(&zero, &dcdx, &dcdx2, &dcdx3,
+                    &span_0, &span_1, &span_2, &unused);
+
+   c_blk = mm256_set_m128i(_mm_add_epi32(c, _mm_slli_epi32(dcdx, 2)), c);
+   rej8 = mm256_dup_si128(rej4);
+   dcdx8 = mm256_dup_si128(_mm_slli_epi32(dcdx, 3));
+   dcdy8 = mm256_dup_si128(dcdy);
+
+   span8_0 = mm256_dup_si128(span_0);
+   span8_1 = mm256_dup_si128(span_1);
+   span8_2 = mm256_dup_si128(span_2);
+
+   dcdy8_0 = _mm256_shuffle_epi32(dcdy8, _MM_SHUFFLE(0,0,0,0));
+   dcdy8_1 = _mm256_shuffle_epi32(dcdy8, _MM_SHUFFLE(1,1,1,1));
+   dcdy8_2 = _mm256_shuffle_epi32(dcdy8, _MM_SHUFFLE(2,2,2,2));
+
+   for (i = 0; i < 4; i++) {
+      __m256i cx = c_blk;
+
+      for (j = 0; j < 4; j += 2) {
+         __m256i c8rej = _mm256_add_epi32(cx, rej8);
+         unsigned rej = _mm256_movemask_ps(_mm256_castsi256_ps(c8rej));
+
+         /* if either of the two blocks is not trivially rejected */
+         if ((rej & 0x0f) == 0 || (rej & 0xf0) == 0) {
+            __m256i c0_0 = _mm256_add_epi32(_mm256_shuffle_epi32(cx, _MM_SHUFFLE(0,0,0,0)), span8_0);
+            __m256i c1_0 = _mm256_add_epi32(_mm256_shuffle_epi32(cx, _MM_SHUFFLE(1,1,1,1)), span8_1);
+            __m256i c2_0 = _mm256_add_epi32(_mm256_shuffle_epi32(cx, _MM_SHUFFLE(2,2,2,2)), span8_2);
+
+            __m256i c_0 = _mm256_or_si256(_mm256_or_si256(c0_0, c1_0), c2_0);
+
+            __m256i c0_1 = _mm256_add_epi32(c0_0, dcdy8_0);
+            __m256i c1_1 = _mm256_add_epi32(c1_0, dcdy8_1);
+            __m256i c2_1 = _mm256_add_epi32(c2_0, dcdy8_2);
+
+            __m256i c_1 = _mm256_or_si256(_mm256_or_si256(c0_1, c1_1), c2_1);
+            __m256i c_01 = _mm256_packs_epi32(c_0, c_1);
+
+            __m256i c0_2 = _mm256_add_epi32(c0_1, dcdy8_0);
+            __m256i c1_2 = _mm256_add_epi32(c1_1, dcdy8_1);
+            __m256i c2_2 = _mm256_add_epi32(c2_1, dcdy8_2);
+
+            __m256i c_2 = _mm256_or_si256(_mm256_or_si256(c0_2, c1_2), c2_2);
+
+            __m256i c0_3 = _mm256_add_epi32(c0_2, dcdy8_0);
+            __m256i c1_3 = _mm256_add_epi32(c1_2, dcdy8_1);
+            __m256i c2_3 = _mm256_add_epi32(c2_2, dcdy8_2);
+
+            __m256i c_3 = _mm256_or_si256(_mm256_or_si256(c0_3, c1_3), c2_3);
+            __m256i c_23 = _mm256_packs_epi32(c_2, c_3);
+
+            /* The packs work within each 128-bit lane, so the low 16 bits
+             * of the mask are block j and the high 16 bits block j+1.
+             */
+            __m256i c_0123 = _mm256_packs_epi16(c_01, c_23);
+            unsigned mask = _mm256_movemask_epi8(c_0123);
+
+            if ((rej & 0x0f) == 0 && (mask & 0xffff) != 0xffff) {
+               out[nr].i = i;
+               out[nr].j = j;
+               out[nr].mask = mask & 0xffff;
+               nr++;
+            }
+
+            if ((rej & 0xf0) == 0 && (mask >> 16) != 0xffff) {
+               out[nr].i = i;
+               out[nr].j = j + 1;
+               out[nr].mask = mask >> 16;
+               nr++;
+            }
+         }
+         cx = _mm256_add_epi32(cx, dcdx8);
+      }
+
+      c_blk = _mm256_add_epi32(c_blk, _mm256_slli_epi32(dcdy8, 2));
+   }
+
+   for (i = 0; i < nr; i++)
+      lp_rast_shade_quads_mask(task,
+                               &tri->inputs,
+                               x + 4 * out[i].j,
+                               y + 4 * out[i].i,
+                               0xffff & ~out[i].mask);
+
+   if (nr)
+      lp_rast_hiz_update(task, &tri->inputs, x, y, 16, FALSE);
+}
+
+
+U_AVX2_FUNC void
+lp_rast_triangle_3_4_avx2(struct lp_rasterizer_task *task,
+                          const union lp_rast_cmd_arg arg)
+{
+   const struct lp_rast_triangle *tri = arg.triangle.tri;
+   const struct lp_rast_plane *plane = GET_PLANES(tri);
+   unsigned x = (arg.triangle.plane_mask & 0xff) + task->x;
+   unsigned y = (arg.triangle.plane_mask >> 8) + task->y;
+
+   __m128i p0 = _mm_load_si128((__m128i *)&plane[0]); /* c, dcdx, dcdy, eo */
+   __m128i p1 = _mm_load_si128((__m128i *)&plane[1]); /* c, dcdx, dcdy, eo */
+   __m128i p2 = _mm_load_si128((__m128i *)&plane[2]); /* c, dcdx, dcdy, eo */
+   __m128i zero = _mm_setzero_si128();
+
+   __m128i c;
+   __m128i dcdx;
+   __m128i dcdy;
+
+   __m128i dcdx2;
+   __m128i dcdx3;
+
+   __m128i span_0;                /* 0,dcdx,2dcdx,3dcdx for plane 0 */
+   __m128i span_1;                /* 0,dcdx,2dcdx,3dcdx for plane 1 */
+   __m128i span_2;                /* 0,dcdx,2dcdx,3dcdx for plane 2 */
+   __m128i unused;
+
+   if (lp_rast_hiz_reject(task, &tri->inputs, x, y, 4))
+      return;
+
+   transpose4_epi32(&p0, &p1, &p2, &zero,
+                    &c, &dcdx, &dcdy, &unused);
+
+   /* Adjust dcdx;
+    */
+   dcdx = _mm_sub_epi32(zero, dcdx);
+
+   c = _mm_add_epi32(c, _mm_mullo_epi32(dcdx, _mm_set1_epi32(x)));
+   c = _mm_add_epi32(c, _mm_mullo_epi32(dcdy, _mm_set1_epi32(y)));
+
+   /* Adjust so we can just check the sign bit (< 0 comparison), instead of having to do a less efficient <= 0 comparison */
+   c = _mm_sub_epi32(c, _mm_set1_epi32(1));
+
+   dcdx2 = _mm_add_epi32(dcdx, dcdx);
+   dcdx3 = _mm_add_epi32(dcdx2, dcdx);
+
+   transpose4_epi32(&zero, &dcdx, &dcdx2, &dcdx3,
+                    &span_0, &span_1, &span_2, &unused);
+
+   {
+      /* rows 0 and 1 of each plane, then rows 2 and 3 */
+      __m128i c0_0 = _mm_add_epi32(SCALAR_EPI32(c, 0), span_0);
+      __m128i c1_0 = _mm_add_epi32(SCALAR_EPI32(c, 1), span_1);
+      __m128i c2_0 = _mm_add_epi32(SCALAR_EPI32(c, 2), span_2);
+
+      __m256i c0_01 = mm256_set_m128i(_mm_add_epi32(c0_0, SCALAR_EPI32(dcdy, 0)), c0_0);
+      __m256i c1_01 = mm256_set_m128i(_mm_add_epi32(c1_0, SCALAR_EPI32(dcdy, 1)), c1_0);
+      __m256i c2_01 = mm256_set_m128i(_mm_add_epi32(c2_0, SCALAR_EPI32(dcdy, 2)), c2_0);
+
+      __m256i dcdy8 = mm256_dup_si128(_mm_slli_epi32(dcdy, 1));
+
+      __m256i c0_23 = _mm256_add_epi32(c0_01, _mm256_shuffle_epi32(dcdy8, _MM_SHUFFLE(0,0,0,0)));
+      __m256i c1_23 = _mm256_add_epi32(c1_01, _mm256_shuffle_epi32(dcdy8, _MM_SHUFFLE(1,1,1,1)));
+      __m256i c2_23 = _mm256_add_epi32(c2_01, _mm256_shuffle_epi32(dcdy8, _MM_SHUFFLE(2,2,2,2)));
+
+      __m256i c_01 = _mm256_or_si256(_mm256_or_si256(c0_01, c1_01), c2_01);
+      __m256i c_23 = _mm256_or_si256(_mm256_or_si256(c0_23, c1_23), c2_23);
+
+      unsigned mask = (_mm256_movemask_ps(_mm256_castsi256_ps(c_01)) |
+                       _mm256_movemask_ps(_mm256_castsi256_ps(c_23)) << 8);
+
+      if (mask != 0xffff) {
          lp_rast_shade_quads_mask(task,
                                   &tri->inputs,
                                   x,
                                   y,
                                   0xffff & ~mask);
+         lp_rast_hiz_update(task, &tri->inputs, x, y, 4, FALSE);
+      }
    }
 }
 
+#endif /* U_HAVE_AVX2_INTRINSICS */
+
 #undef NR_PLANES
 #endif
 
@@ -470,6 +752,7 @@ lp_rast_triangle_3_4(struct lp_rasterizer_task *task,
 #define TAG(x) x##_4
 #define NR_PLANES 4
 #define TRI_16 lp_rast_triangle_4_16
+#define TRI_16_AVX2 lp_rast_triangle_4_16_avx2
 #include "lp_rast_tri_tmp.h"
 
 #define TAG(x) x##_5
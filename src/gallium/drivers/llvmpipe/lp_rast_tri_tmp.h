@@ -169,6 +169,9 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
       return;
    }
 
+   if (lp_rast_hiz_reject(task, &tri->inputs, x, y, TILE_SIZE))
+      return;
+
    outmask = 0;                 /* outside one or more trivial reject planes */
    partmask = 0;                /* outside one or more trivial accept planes */
 
@@ -229,7 +232,12 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
       partial_mask &= ~(1 << i);
 
       LP_COUNT(nr_partially_covered_16);
+
+      if (lp_rast_hiz_reject(task, &tri->inputs, px, py, 16))
+         continue;
+
       TAG(do_block_16)(task, tri, plane, px, py, cx);
+      lp_rast_hiz_update(task, &tri->inputs, px, py, 16, FALSE);
    }
 
    /* Iterate over fulls: 
@@ -244,7 +252,12 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
       inmask &= ~(1 << i);
 
       LP_COUNT(nr_fully_covered_16);
+
+      if (lp_rast_hiz_reject(task, &tri->inputs, px, py, 16))
+         continue;
+
       block_full_16(task, tri, px, py);
+      lp_rast_hiz_update(task, &tri->inputs, px, py, 16, TRUE);
    }
 }
 
@@ -272,6 +285,9 @@ TRI_16(struct lp_rasterizer_task *task,
    x += task->x;
    y += task->y;
 
+   if (lp_rast_hiz_reject(task, &tri->inputs, x, y, 16))
+      return;
+
    for (j = 0; j < NR_PLANES; j++) {
       const int dcdx = -plane[j].dcdx * 4;
       const int dcdy = plane[j].dcdy * 4;
@@ -322,6 +338,87 @@ TRI_16(struct lp_rasterizer_task *task,
       if (mask)
 	 lp_rast_shade_quads_mask(task, &tri->inputs, px, py, mask);
    }
+
+   lp_rast_hiz_update(task, &tri->inputs, x, y, 16, FALSE);
+}
+#endif
+
+#if defined(U_HAVE_AVX2_INTRINSICS) && defined(TRI_16_AVX2)
+/* As TRI_16, but with two rows of 4x4 blocks evaluated per instruction.
+ */
+U_AVX2_FUNC void
+TRI_16_AVX2(struct lp_rasterizer_task *task,
+            const union lp_rast_cmd_arg arg)
+{
+   const struct lp_rast_triangle *tri = arg.triangle.tri;
+   const struct lp_rast_plane *plane = GET_PLANES(tri);
+   unsigned mask = arg.triangle.plane_mask;
+   unsigned outmask, partial_mask;
+   unsigned j;
+   __m256i cstep4[NR_PLANES][2];
+
+   int x = (mask & 0xff);
+   int y = (mask >> 8);
+
+   outmask = 0;                 /* outside one or more trivial reject planes */
+
+   x += task->x;
+   y += task->y;
+
+   if (lp_rast_hiz_reject(task, &tri->inputs, x, y, 16))
+      return;
+
+   for (j = 0; j < NR_PLANES; j++) {
+      const int dcdx = -plane[j].dcdx * 4;
+      const int dcdy = plane[j].dcdy * 4;
+      __m128i cstep0 = _mm_setr_epi32(0, dcdx, dcdx*2, dcdx*3);
+
+      cstep4[j][0] = mm256_set_m128i(_mm_add_epi32(cstep0, _mm_set1_epi32(dcdy)),
+                                     cstep0);
+      cstep4[j][1] = _mm256_add_epi32(cstep4[j][0], _mm256_set1_epi32(dcdy*2));
+
+      {
+	 const int c = plane[j].c + plane[j].dcdy * y - plane[j].dcdx * x;
+	 const int cox = plane[j].eo * 4;
+
+	 outmask |= sign_bits4_avx2(cstep4[j], c + cox);
+      }
+   }
+
+   if (outmask == 0xffff)
+      return;
+
+
+   /* Mask of sub-blocks which are inside all trivial reject planes,
+    * but outside at least one trivial accept plane:
+    */
+   partial_mask = 0xffff & ~outmask;
+
+   /* Iterate over partials:
+    */
+   while (partial_mask) {
+      int i = ffs(partial_mask) - 1;
+      int ix = (i & 3) * 4;
+      int iy = (i >> 2) * 4;
+      int px = x + ix;
+      int py = y + iy; 
+      unsigned mask = 0xffff;
+
+      partial_mask &= ~(1 << i);
+
+      for (j = 0; j < NR_PLANES; j++) {
+         const int cx = (plane[j].c - 1
+			 - plane[j].dcdx * px
+			 + plane[j].dcdy * py) * 4;
+
+	 mask &= ~sign_bits4_avx2(cstep4[j], cx);
+      }
+
+      if (mask)
+	 lp_rast_shade_quads_mask(task, &tri->inputs, px, py, mask);
+   }
+
+   lp_rast_hiz_update(task, &tri->inputs, x, y, 16, FALSE);
 }
 #endif
 
@@ -337,6 +434,9 @@ TRI_4(struct lp_rasterizer_task *task,
    const int y = task->y + (mask >> 8);
    unsigned j;
 
+   if (lp_rast_hiz_reject(task, &tri->inputs, x, y, 4))
+      return;
+
    /* Iterate over partials:
     */
    {
@@ -368,6 +468,8 @@ TRI_4(struct lp_rasterizer_task *task,
       if (mask)
 	 lp_rast_shade_quads_mask(task, &tri->inputs, x, y, mask);
    }
+
+   lp_rast_hiz_update(task, &tri->inputs, x, y, 4, FALSE);
 }
 #endif
 
@@ -376,5 +478,6 @@ TRI_4(struct lp_rasterizer_task *task,
 #undef TAG
 #undef TRI_4
 #undef TRI_16
+#undef TRI_16_AVX2
 #undef NR_PLANES
 
@@ -131,6 +131,25 @@ lp_scene_bin_reset(struct lp_scene *scene, unsigned x, unsigned y)
 }
 
 
+/**
+ * Get the per-tile fast clear state of a framebuffer surface.
+ */
+static void
+scene_map_tile_clear_state(struct llvmpipe_tile_clear **tile_clear,
+                           unsigned *tiles_per_row,
+                           struct pipe_surface *surf)
+{
+   struct llvmpipe_resource *lpr = llvmpipe_resource(surf->texture);
+   const unsigned level = surf->u.tex.level;
+
+   *tile_clear = llvmpipe_get_tile_clear_state(lpr,
+                                               surf->u.tex.first_layer,
+                                               level);
+   *tiles_per_row = align(u_minify(lpr->base.width0, level), TILE_SIZE) /
+                    TILE_SIZE;
+}
+
+
 void
 lp_scene_begin_rasterization(struct lp_scene *scene)
 {
@@ -148,8 +167,11 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
       scene->cbufs[i].map = llvmpipe_resource_map(cbuf->texture,
                                                   cbuf->u.tex.level,
                                                   cbuf->u.tex.first_layer,
-                                                  LP_TEX_USAGE_READ_WRITE,
-                                                  LP_TEX_LAYOUT_LINEAR);
+                                                  LP_TEX_USAGE_READ_WRITE);
+
+      scene_map_tile_clear_state(&scene->cbufs[i].tile_clear,
+                                 &scene->cbufs[i].tile_clear_stride,
+                                 cbuf);
    }
 
    if (fb->zsbuf) {
@@ -162,8 +184,11 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
       scene->zsbuf.map = llvmpipe_resource_map(zsbuf->texture,
                                                zsbuf->u.tex.level,
                                                zsbuf->u.tex.first_layer,
-                                               LP_TEX_USAGE_READ_WRITE,
-                                               LP_TEX_LAYOUT_NONE);
+                                               LP_TEX_USAGE_READ_WRITE);
+
+      scene_map_tile_clear_state(&scene->zsbuf.tile_clear,
+                                 &scene->zsbuf.tile_clear_stride,
+                                 zsbuf);
    }
 }
 
@@ -180,6 +205,7 @@ lp_scene_end_rasterization(struct lp_scene *scene )
 
    /* Unmap color buffers */
    for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      scene->cbufs[i].tile_clear = NULL;
       if (scene->cbufs[i].map) {
          struct pipe_surface *cbuf = scene->fb.cbufs[i];
          llvmpipe_resource_unmap(cbuf->texture,
@@ -190,6 +216,7 @@ lp_scene_end_rasterization(struct lp_scene *scene )
    }
 
    /* Unmap z/stencil buffer */
+   scene->zsbuf.tile_clear = NULL;
    if (scene->zsbuf.map) {
       struct pipe_surface *zsbuf = scene->fb.zsbuf;
       llvmpipe_resource_unmap(zsbuf->texture,
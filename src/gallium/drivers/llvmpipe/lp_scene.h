@@ -117,6 +117,7 @@ struct data_block_list {
 };
 
 struct resource_ref;
+struct llvmpipe_tile_clear;
 
 /**
  * All bins and bin data are contained here.
@@ -137,6 +138,8 @@ struct lp_scene {
       uint8_t *map;
       unsigned stride;
       unsigned blocksize;
+      struct llvmpipe_tile_clear *tile_clear; /**< fast clear state, or NULL */
+      unsigned tile_clear_stride;             /**< tiles per row */
    } zsbuf, cbufs[PIPE_MAX_COLOR_BUFS];
    
    /** the framebuffer to render the scene into */
@@ -44,6 +44,7 @@
 #include "lp_context.h"
 #include "lp_debug.h"
 #include "lp_public.h"
+#include "lp_query.h"
 #include "lp_limits.h"
 #include "lp_rast.h"
 
@@ -375,8 +376,10 @@ llvmpipe_flush_frontbuffer(struct pipe_screen *_screen,
    struct llvmpipe_resource *texture = llvmpipe_resource(resource);
 
    assert(texture->dt);
-   if (texture->dt)
+   if (texture->dt) {
+      llvmpipe_resolve_tile_clears(texture, level);
       winsys->displaytarget_display(winsys, texture->dt, context_private);
+   }
 }
 
 
@@ -487,6 +490,7 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.fence_reference = llvmpipe_fence_reference;
    screen->base.fence_signalled = llvmpipe_fence_signalled;
    screen->base.fence_finish = llvmpipe_fence_finish;
+   screen->base.get_driver_query_info = llvmpipe_get_driver_query_info;
 
    llvmpipe_init_screen_resource_funcs(&screen->base);
 
@@ -507,6 +511,8 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    }
    pipe_mutex_init(screen->rast_mutex);
 
+   llvmpipe_init_driver_query_names(screen);
+
    util_format_s3tc_init();
 
    return &screen->base;
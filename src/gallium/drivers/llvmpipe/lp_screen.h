@@ -38,6 +38,7 @@
 #include "pipe/p_defines.h"
 #include "os/os_thread.h"
 #include "gallivm/lp_bld.h"
+#include "lp_query.h"
 
 
 struct sw_winsys;
@@ -57,6 +58,9 @@ struct llvmpipe_screen
 
    struct lp_rasterizer *rast;
    pipe_mutex rast_mutex;
+
+   /** Names of the driver queries, see llvmpipe_get_driver_query_info() */
+   char driver_query_names[LP_QUERY_END - PIPE_QUERY_DRIVER_SPECIFIC][32];
 };
 
 
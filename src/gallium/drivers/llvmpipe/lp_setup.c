@@ -666,9 +666,7 @@ lp_setup_set_fragment_sampler_views(struct lp_setup_context *setup,
             /* regular texture - setup array of mipmap level pointers */
             int j;
             for (j = view->u.tex.first_level; j <= tex->last_level; j++) {
-               jit_tex->data[j] =
-                  llvmpipe_get_texture_image_all(lp_tex, j, LP_TEX_USAGE_READ,
-                                                 LP_TEX_LAYOUT_LINEAR);
+               jit_tex->data[j] = llvmpipe_get_texture_image_all(lp_tex, j);
                jit_tex->row_stride[j] = lp_tex->row_stride[j];
                jit_tex->img_stride[j] = lp_tex->img_stride[j];
 
@@ -693,6 +691,7 @@ lp_setup_set_fragment_sampler_views(struct lp_setup_context *setup,
              */
             struct llvmpipe_screen *screen = llvmpipe_screen(tex->screen);
             struct sw_winsys *winsys = screen->winsys;
+            llvmpipe_resolve_tile_clears(lp_tex, 0);
             jit_tex->data[0] = winsys->displaytarget_map(winsys, lp_tex->dt,
 							 PIPE_TRANSFER_READ);
             jit_tex->row_stride[0] = lp_tex->row_stride[0];
@@ -895,6 +894,29 @@ try_update_scene_state( struct lp_setup_context *setup )
    return TRUE;
 }
 
+/**
+ * Write the pending fast clears of the textures bound for fragment
+ * sampling.  The textures may have been rendered to and cleared since
+ * their sampler views were set, which doesn't rebind them.
+ */
+static void
+resolve_sampler_tile_clears( struct lp_setup_context *setup )
+{
+   unsigned i, level;
+
+   for (i = 0; i < Elements(setup->fs.current_tex); i++) {
+      struct pipe_resource *tex = setup->fs.current_tex[i];
+
+      if (tex) {
+         struct llvmpipe_resource *lp_tex = llvmpipe_resource(tex);
+
+         for (level = 0; level <= tex->last_level; level++)
+            llvmpipe_resolve_tile_clears(lp_tex, level);
+      }
+   }
+}
+
+
 boolean
 lp_setup_update_state( struct lp_setup_context *setup,
                        boolean update_scene )
@@ -932,6 +954,9 @@ lp_setup_update_state( struct lp_setup_context *setup,
 		    setup->setup.variant->key.size) == 0);
    }
 
+   if (update_scene)
+      resolve_sampler_tile_clears(setup);
+
    if (update_scene && setup->state != SETUP_ACTIVE) {
       if (!set_scene_state( setup, SETUP_ACTIVE, __FUNCTION__ ))
          return FALSE;
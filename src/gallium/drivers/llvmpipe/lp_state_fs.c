@@ -208,6 +208,48 @@ find_output_by_semantic( const struct tgsi_shader_info *info,
 }
 
 
+/**
+ * Compute the address of the first quad handled by a fragment shader
+ * iteration in the linear depth/stencil buffer.
+ *
+ * Each iteration covers type.length/4 quads of the 4x4 block; these are
+ * numbered left to right, top to bottom.
+ *
+ * \param depth_ptr  address of the 4x4 block's top-left pixel
+ * \param depth_stride  row stride of the depth/stencil buffer, in bytes
+ * \param depth_bytes  size of a depth/stencil pixel, in bytes
+ * \param index  the iteration (may be a loop counter)
+ */
+static LLVMValueRef
+generate_quad_depth_ptr(struct gallivm_state *gallivm,
+                        struct lp_type type,
+                        LLVMValueRef depth_ptr,
+                        LLVMValueRef depth_stride,
+                        unsigned depth_bytes,
+                        LLVMValueRef index)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef quad, quad_x, quad_y, offset;
+
+   quad = LLVMBuildMul(builder, index,
+                       lp_build_const_int32(gallivm, type.length / 4), "");
+
+   /* byte offset of the quad column */
+   quad_x = LLVMBuildAnd(builder, quad, lp_build_const_int32(gallivm, 1), "");
+   quad_x = LLVMBuildMul(builder, quad_x,
+                         lp_build_const_int32(gallivm, 2 * depth_bytes), "");
+
+   /* row of the quad */
+   quad_y = LLVMBuildLShr(builder, quad, lp_build_const_int32(gallivm, 1), "");
+   quad_y = LLVMBuildMul(builder, quad_y, lp_build_const_int32(gallivm, 2), "");
+
+   offset = LLVMBuildMul(builder, quad_y, depth_stride, "");
+   offset = LLVMBuildAdd(builder, offset, quad_x, "");
+
+   return LLVMBuildGEP(builder, depth_ptr, &offset, 1, "");
+}
+
+
 /**
  * Generate the fragment shader, depth/stencil test, and alpha tests.
  * \param i  which quad in the tile, in range [0,3]
@@ -226,6 +268,7 @@ generate_fs(struct gallivm_state *gallivm,
             LLVMValueRef *pmask,
             LLVMValueRef (*color)[4],
             LLVMValueRef depth_ptr,
+            LLVMValueRef depth_stride,
             LLVMValueRef facing,
             unsigned partial_mask,
             LLVMValueRef mask_input,
@@ -326,12 +369,13 @@ generate_fs(struct gallivm_state *gallivm,
                                   &mask,
                                   stencil_refs,
                                   z,
-                                  depth_ptr, facing,
+                                  depth_ptr, depth_stride, facing,
                                   &zs_value,
                                   !simple_shader);
 
       if (depth_mode & EARLY_DEPTH_WRITE) {
-         lp_build_depth_write(builder, zs_format_desc, depth_ptr, zs_value);
+         lp_build_depth_write(gallivm, type, zs_format_desc,
+                              depth_ptr, depth_stride, zs_value);
       }
    }
 
@@ -383,12 +427,13 @@ generate_fs(struct gallivm_state *gallivm,
                                   &mask,
                                   stencil_refs,
                                   z,
-                                  depth_ptr, facing,
+                                  depth_ptr, depth_stride, facing,
                                   &zs_value,
                                   !simple_shader);
       /* Late Z write */
       if (depth_mode & LATE_DEPTH_WRITE) {
-         lp_build_depth_write(builder, zs_format_desc, depth_ptr, zs_value);
+         lp_build_depth_write(gallivm, type, zs_format_desc,
+                              depth_ptr, depth_stride, zs_value);
       }
    }
    else if ((depth_mode & EARLY_DEPTH_TEST) &&
@@ -403,6 +448,7 @@ generate_fs(struct gallivm_state *gallivm,
                                     zs_format_desc,
                                     &mask,
                                     depth_ptr,
+                                    depth_stride,
                                     zs_value);
    }
 
@@ -451,6 +497,7 @@ generate_fs_loop(struct gallivm_state *gallivm,
                  LLVMValueRef mask_store,
                  LLVMValueRef (*out_color)[4],
                  LLVMValueRef depth_ptr,
+                 LLVMValueRef depth_stride,
                  unsigned depth_bits,
                  LLVMValueRef facing,
                  LLVMValueRef counter)
@@ -464,7 +511,6 @@ generate_fs_loop(struct gallivm_state *gallivm,
    LLVMValueRef zs_value = NULL;
    LLVMValueRef stencil_refs[2];
    LLVMValueRef depth_ptr_i;
-   LLVMValueRef depth_offset;
    LLVMValueRef outputs[PIPE_MAX_SHADER_OUTPUTS][TGSI_NUM_CHANNELS];
    struct lp_build_for_loop_state loop_state;
    struct lp_build_mask_context mask;
@@ -528,11 +574,9 @@ generate_fs_loop(struct gallivm_state *gallivm,
                            &loop_state.counter, 1, "mask_ptr");
    mask_val = LLVMBuildLoad(builder, mask_ptr, "");
 
-   depth_offset = LLVMBuildMul(builder, loop_state.counter,
-                               lp_build_const_int32(gallivm, depth_bits * type.length),
-                               "");
-
-   depth_ptr_i = LLVMBuildGEP(builder, depth_ptr, &depth_offset, 1, "");
+   depth_ptr_i = generate_quad_depth_ptr(gallivm, type,
+                                         depth_ptr, depth_stride, depth_bits,
+                                         loop_state.counter);
 
    memset(outputs, 0, sizeof outputs);
 
@@ -565,12 +609,13 @@ generate_fs_loop(struct gallivm_state *gallivm,
                                   &mask,
                                   stencil_refs,
                                   z,
-                                  depth_ptr_i, facing,
+                                  depth_ptr_i, depth_stride, facing,
                                   &zs_value,
                                   !simple_shader);
 
       if (depth_mode & EARLY_DEPTH_WRITE) {
-         lp_build_depth_write(builder, zs_format_desc, depth_ptr_i, zs_value);
+         lp_build_depth_write(gallivm, type, zs_format_desc,
+                              depth_ptr_i, depth_stride, zs_value);
       }
    }
 
@@ -622,12 +667,13 @@ generate_fs_loop(struct gallivm_state *gallivm,
                                   &mask,
                                   stencil_refs,
                                   z,
-                                  depth_ptr_i, facing,
+                                  depth_ptr_i, depth_stride, facing,
                                   &zs_value,
                                   !simple_shader);
       /* Late Z write */
       if (depth_mode & LATE_DEPTH_WRITE) {
-         lp_build_depth_write(builder, zs_format_desc, depth_ptr_i, zs_value);
+         lp_build_depth_write(gallivm, type, zs_format_desc,
+                              depth_ptr_i, depth_stride, zs_value);
       }
    }
    else if ((depth_mode & EARLY_DEPTH_TEST) &&
@@ -642,6 +688,7 @@ generate_fs_loop(struct gallivm_state *gallivm,
                                     zs_format_desc,
                                     &mask,
                                     depth_ptr_i,
+                                    depth_stride,
                                     zs_value);
    }
 
@@ -771,7 +818,7 @@ generate_fragment(struct llvmpipe_context *lp,
    struct lp_type blend_type;
    LLVMTypeRef fs_elem_type;
    LLVMTypeRef blend_vec_type;
-   LLVMTypeRef arg_types[11];
+   LLVMTypeRef arg_types[12];
    LLVMTypeRef func_type;
    LLVMTypeRef int32_type = LLVMInt32TypeInContext(gallivm->context);
    LLVMTypeRef int8_type = LLVMInt8TypeInContext(gallivm->context);
@@ -783,6 +830,7 @@ generate_fragment(struct llvmpipe_context *lp,
    LLVMValueRef dady_ptr;
    LLVMValueRef color_ptr_ptr;
    LLVMValueRef depth_ptr;
+   LLVMValueRef depth_stride;
    LLVMValueRef mask_input;
    LLVMValueRef counter = NULL;
    LLVMBasicBlockRef block;
@@ -865,8 +913,9 @@ generate_fragment(struct llvmpipe_context *lp,
    arg_types[6] = LLVMPointerType(fs_elem_type, 0);    /* dady */
    arg_types[7] = LLVMPointerType(LLVMPointerType(blend_vec_type, 0), 0);  /* color */
    arg_types[8] = LLVMPointerType(int8_type, 0);       /* depth */
-   arg_types[9] = int32_type;                          /* mask_input */
-   arg_types[10] = LLVMPointerType(int32_type, 0);     /* counter */
+   arg_types[9] = int32_type;                          /* depth_stride */
+   arg_types[10] = int32_type;                         /* mask_input */
+   arg_types[11] = LLVMPointerType(int32_type, 0);     /* counter */
 
    func_type = LLVMFunctionType(LLVMVoidTypeInContext(gallivm->context),
                                 arg_types, Elements(arg_types), 0);
@@ -892,7 +941,8 @@ generate_fragment(struct llvmpipe_context *lp,
    dady_ptr     = LLVMGetParam(function, 6);
    color_ptr_ptr = LLVMGetParam(function, 7);
    depth_ptr    = LLVMGetParam(function, 8);
-   mask_input   = LLVMGetParam(function, 9);
+   depth_stride = LLVMGetParam(function, 9);
+   mask_input   = LLVMGetParam(function, 10);
 
    lp_build_name(context_ptr, "context");
    lp_build_name(x, "x");
@@ -902,10 +952,11 @@ generate_fragment(struct llvmpipe_context *lp,
    lp_build_name(dady_ptr, "dady");
    lp_build_name(color_ptr_ptr, "color_ptr_ptr");
    lp_build_name(depth_ptr, "depth");
+   lp_build_name(depth_stride, "depth_stride");
    lp_build_name(mask_input, "mask_input");
 
    if (key->occlusion_count) {
-      counter = LLVMGetParam(function, 10);
+      counter = LLVMGetParam(function, 11);
       lp_build_name(counter, "counter");
    }
 
@@ -940,13 +991,13 @@ generate_fragment(struct llvmpipe_context *lp,
 
       /* loop over quads in the block */
       for(i = 0; i < num_fs; ++i) {
-         LLVMValueRef depth_offset = LLVMConstInt(int32_type,
-                                                  i*fs_type.length*zs_format_desc->block.bits/8,
-                                                  0);
          LLVMValueRef out_color[PIPE_MAX_COLOR_BUFS][TGSI_NUM_CHANNELS];
          LLVMValueRef depth_ptr_i;
 
-         depth_ptr_i = LLVMBuildGEP(builder, depth_ptr, &depth_offset, 1, "");
+         depth_ptr_i = generate_quad_depth_ptr(gallivm, fs_type,
+                                               depth_ptr, depth_stride,
+                                               zs_format_desc->block.bits/8,
+                                               lp_build_const_int32(gallivm, i));
 
          generate_fs(gallivm,
                      shader, key,
@@ -959,6 +1010,7 @@ generate_fragment(struct llvmpipe_context *lp,
                      &fs_mask[i], /* output */
                      out_color,
                      depth_ptr_i,
+                     depth_stride,
                      facing,
                      partial_mask,
                      mask_input,
@@ -1019,6 +1071,7 @@ generate_fragment(struct llvmpipe_context *lp,
                        mask_store, /* output */
                        color_store,
                        depth_ptr,
+                       depth_stride,
                        depth_bits,
                        facing,
                        counter);
@@ -1205,6 +1258,8 @@ lp_debug_fs_variant(const struct lp_fragment_shader_variant *variant)
    tgsi_dump(variant->shader->base.tokens, 0);
    dump_fs_variant_key(&variant->key);
    debug_printf("variant->opaque = %u\n", variant->opaque);
+   debug_printf("variant->hiz_test = %u\n", variant->hiz_test);
+   debug_printf("variant->hiz_exact = %u\n", variant->hiz_exact);
    debug_printf("\n");
 }
 
@@ -1258,6 +1313,22 @@ generate_variant(struct llvmpipe_context *lp,
          !shader->info.base.uses_kill
          ? TRUE : FALSE;
 
+   /*
+    * Determine whether the rasterizer may skip blocks of pixels based on
+    * its hierarchical depth bounds.  Stencil ops and shader computed depth
+    * make the outcome of the depth test unpredictable.
+    */
+   variant->hiz_test =
+         key->depth.enabled &&
+         !key->stencil[0].enabled &&
+         !shader->info.base.writes_z
+         ? TRUE : FALSE;
+
+   variant->hiz_exact =
+         variant->hiz_test &&
+         !key->alpha.enabled &&
+         !shader->info.base.uses_kill
+         ? TRUE : FALSE;
 
    if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
       lp_debug_fs_variant(variant);
@@ -84,6 +84,11 @@ struct lp_fragment_shader_variant
 
    boolean opaque;
 
+   /** Whole blocks may be depth tested against the rasterizer's hi-z */
+   boolean hiz_test;
+   /** Every covered fragment is guaranteed to reach the depth test */
+   boolean hiz_exact;
+
    struct gallivm_state *gallivm;
 
    LLVMTypeRef jit_context_ptr_type;
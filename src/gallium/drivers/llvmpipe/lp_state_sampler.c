@@ -277,9 +277,7 @@ llvmpipe_prepare_vertex_sampling(struct llvmpipe_context *lp,
             /* regular texture - setup array of mipmap level pointers */
             int j;
             for (j = view->u.tex.first_level; j <= tex->last_level; j++) {
-               data[j] =
-                  llvmpipe_get_texture_image_all(lp_tex, j, LP_TEX_USAGE_READ,
-                                                 LP_TEX_LAYOUT_LINEAR);
+               data[j] = llvmpipe_get_texture_image_all(lp_tex, j);
                row_stride[j] = lp_tex->row_stride[j];
                img_stride[j] = lp_tex->img_stride[j];
             }
@@ -34,22 +34,6 @@
 #include "lp_texture.h"
 
 
-/**
- * Adjust x, y, width, height to lie on tile bounds.
- */
-static void
-adjust_to_tile_bounds(unsigned x, unsigned y, unsigned width, unsigned height,
-                      unsigned *x_tile, unsigned *y_tile,
-                      unsigned *w_tile, unsigned *h_tile)
-{
-   *x_tile = x & ~(TILE_SIZE - 1);
-   *y_tile = y & ~(TILE_SIZE - 1);
-   *w_tile = ((x + width + TILE_SIZE - 1) & ~(TILE_SIZE - 1)) - *x_tile;
-   *h_tile = ((y + height + TILE_SIZE - 1) & ~(TILE_SIZE - 1)) - *y_tile;
-}
-
-
-
 static void
 lp_resource_copy(struct pipe_context *pipe,
                  struct pipe_resource *dst, unsigned dst_level,
@@ -95,69 +79,16 @@ lp_resource_copy(struct pipe_context *pipe,
           src_box->width, src_box->height, src_box->depth);
    */
 
-   /* set src tiles to linear layout */
-   {
-      unsigned tx, ty, tw, th;
-      unsigned x, y;
-
-      adjust_to_tile_bounds(src_box->x, src_box->y, width, height,
-                            &tx, &ty, &tw, &th);
-
-      for (y = 0; y < th; y += TILE_SIZE) {
-         for (x = 0; x < tw; x += TILE_SIZE) {
-            (void) llvmpipe_get_texture_tile_linear(src_tex,
-                                                    src_box->z, src_level,
-                                                    LP_TEX_USAGE_READ,
-                                                    tx + x, ty + y);
-         }
-      }
-   }
-
-   /* set dst tiles to linear layout */
-   {
-      unsigned tx, ty, tw, th;
-      unsigned x, y;
-      enum lp_texture_usage usage;
-
-      adjust_to_tile_bounds(dstx, dsty, width, height, &tx, &ty, &tw, &th);
-
-      for (y = 0; y < th; y += TILE_SIZE) {
-         boolean contained_y = ty + y >= dsty &&
-                               ty + y + TILE_SIZE <= dsty + height ?
-                               TRUE : FALSE;
-
-         for (x = 0; x < tw; x += TILE_SIZE) {
-            boolean contained_x = tx + x >= dstx &&
-                                  tx + x + TILE_SIZE <= dstx + width ?
-                                  TRUE : FALSE;
-
-            /*
-             * Set the usage mode to WRITE_ALL for the tiles which are
-             * completely contained by the dest rectangle.
-             */
-            if (contained_y && contained_x)
-               usage = LP_TEX_USAGE_WRITE_ALL;
-            else
-               usage = LP_TEX_USAGE_READ_WRITE;
-
-            (void) llvmpipe_get_texture_tile_linear(dst_tex,
-                                                    dstz, dst_level,
-                                                    usage,
-                                                    tx + x, ty + y);
-         }
-      }
-   }
+   /* make sure fast cleared tiles have been written out */
+   llvmpipe_resolve_tile_clears(src_tex, src_level);
+   llvmpipe_resolve_tile_clears(dst_tex, dst_level);
 
    /* copy */
    {
       const ubyte *src_linear_ptr
-         = llvmpipe_get_texture_image_address(src_tex, src_box->z,
-                                              src_level,
-                                              LP_TEX_LAYOUT_LINEAR);
+         = llvmpipe_get_texture_image(src_tex, src_box->z, src_level);
       ubyte *dst_linear_ptr
-         = llvmpipe_get_texture_image_address(dst_tex, dstz,
-                                              dst_level,
-                                              LP_TEX_LAYOUT_LINEAR);
+         = llvmpipe_get_texture_image(dst_tex, dstz, dst_level);
 
       if (dst_linear_ptr && src_linear_ptr) {
          util_copy_rect(dst_linear_ptr, format,
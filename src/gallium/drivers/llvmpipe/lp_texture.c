@@ -40,6 +40,8 @@
 #include "util/u_format.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
+#include "util/u_pack_color.h"
+#include "util/u_rect.h"
 #include "util/u_simple_list.h"
 #include "util/u_transfer.h"
 
@@ -80,33 +82,13 @@ resource_is_texture(const struct pipe_resource *resource)
 
 
 
-/**
- * Allocate storage for llvmpipe_texture::layout array.
- * The number of elements is width_in_tiles * height_in_tiles.
- */
-static enum lp_texture_layout *
-alloc_layout_array(unsigned num_slices, unsigned width, unsigned height)
-{
-   const unsigned tx = align(width, TILE_SIZE) / TILE_SIZE;
-   const unsigned ty = align(height, TILE_SIZE) / TILE_SIZE;
-
-   assert(num_slices * tx * ty > 0);
-   assert(LP_TEX_LAYOUT_NONE == 0); /* calloc'ing LP_TEX_LAYOUT_NONE here */
-
-   return (enum lp_texture_layout *)
-      CALLOC(num_slices * tx * ty, sizeof(enum lp_texture_layout));
-}
-
-
-
 /**
  * Conventional allocation path for non-display textures:
  * Just compute row strides here.  Storage is allocated on demand later.
  */
 static boolean
 llvmpipe_texture_layout(struct llvmpipe_screen *screen,
-                        struct llvmpipe_resource *lpr,
-                        boolean allocate)
+                        struct llvmpipe_resource *lpr)
 {
    struct pipe_resource *pt = &lpr->base;
    unsigned level;
@@ -120,7 +102,7 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
 
    for (level = 0; level <= pt->last_level; level++) {
 
-      /* Row stride and image stride (for linear layout) */
+      /* Row stride and image stride */
       {
          unsigned alignment, nblocksx, nblocksy, block_size;
 
@@ -149,14 +131,6 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
          lpr->img_stride[level] = lpr->row_stride[level] * nblocksy;
       }
 
-      /* Size of the image in tiles (for tiled layout) */
-      {
-         const unsigned width_t = align(width, TILE_SIZE) / TILE_SIZE;
-         const unsigned height_t = align(height, TILE_SIZE) / TILE_SIZE;
-         lpr->tiles_per_row[level] = width_t;
-         lpr->tiles_per_image[level] = width_t * height_t;
-      }
-
       /* Number of 3D image slices or cube faces */
       {
          unsigned num_slices;
@@ -169,13 +143,6 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
             num_slices = 1;
 
          lpr->num_slices_faces[level] = num_slices;
-
-         if (allocate) {
-            lpr->layout[level] = alloc_layout_array(num_slices, width, height);
-            if (!lpr->layout[level]) {
-               goto fail;
-            }
-         }
       }
 
       /* if img_stride * num_slices_faces > LP_MAX_TEXTURE_SIZE */
@@ -200,10 +167,6 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
    return TRUE;
 
 fail:
-   for (level = 0; level <= pt->last_level; level++) {
-      FREE(lpr->layout[level]);
-   }
-
    return FALSE;
 }
 
@@ -219,7 +182,7 @@ llvmpipe_can_create_resource(struct pipe_screen *screen,
    struct llvmpipe_resource lpr;
    memset(&lpr, 0, sizeof(lpr));
    lpr.base = *res;
-   return llvmpipe_texture_layout(llvmpipe_screen(screen), &lpr, FALSE);
+   return llvmpipe_texture_layout(llvmpipe_screen(screen), &lpr);
 }
 
 
@@ -234,19 +197,10 @@ llvmpipe_displaytarget_layout(struct llvmpipe_screen *screen,
     */
    const unsigned width = align(lpr->base.width0, TILE_SIZE);
    const unsigned height = align(lpr->base.height0, TILE_SIZE);
-   const unsigned width_t = width / TILE_SIZE;
-   const unsigned height_t = height / TILE_SIZE;
 
-   lpr->tiles_per_row[0] = width_t;
-   lpr->tiles_per_image[0] = width_t * height_t;
    lpr->num_slices_faces[0] = 1;
    lpr->img_stride[0] = 0;
 
-   lpr->layout[0] = alloc_layout_array(1, width, height);
-   if (!lpr->layout[0]) {
-      return FALSE;
-   }
-
    lpr->dt = winsys->displaytarget_create(winsys,
                                           lpr->base.bind,
                                           lpr->base.format,
@@ -291,15 +245,12 @@ llvmpipe_resource_create(struct pipe_screen *_screen,
          /* displayable surface */
          if (!llvmpipe_displaytarget_layout(screen, lpr))
             goto fail;
-         assert(lpr->layout[0][0] == LP_TEX_LAYOUT_NONE);
       }
       else {
          /* texture map */
-         if (!llvmpipe_texture_layout(screen, lpr, TRUE))
+         if (!llvmpipe_texture_layout(screen, lpr))
             goto fail;
-         assert(lpr->layout[0][0] == LP_TEX_LAYOUT_NONE);
       }
-      assert(lpr->layout[0]);
    }
    else {
       /* other data (vertex buffer, const buffer, etc) */
@@ -341,38 +292,26 @@ llvmpipe_resource_destroy(struct pipe_screen *pscreen,
       /* display target */
       struct sw_winsys *winsys = screen->winsys;
       winsys->displaytarget_destroy(winsys, lpr->dt);
-
-      if (lpr->tiled[0].data) {
-         align_free(lpr->tiled[0].data);
-         lpr->tiled[0].data = NULL;
-      }
-
-      FREE(lpr->layout[0]);
    }
    else if (resource_is_texture(pt)) {
       /* regular texture */
       uint level;
 
-      /* free linear image data */
+      /* free image data */
       for (level = 0; level < Elements(lpr->linear); level++) {
          if (lpr->linear[level].data) {
             align_free(lpr->linear[level].data);
             lpr->linear[level].data = NULL;
          }
       }
+   }
 
-      /* free tiled image data */
-      for (level = 0; level < Elements(lpr->tiled); level++) {
-         if (lpr->tiled[level].data) {
-            align_free(lpr->tiled[level].data);
-            lpr->tiled[level].data = NULL;
-         }
-      }
+   if (resource_is_texture(pt)) {
+      uint level;
 
-      /* free layout flag arrays */
-      for (level = 0; level < Elements(lpr->tiled); level++) {
-         FREE(lpr->layout[level]);
-         lpr->layout[level] = NULL;
+      /* free fast clear state */
+      for (level = 0; level < Elements(lpr->tile_clear); level++) {
+         FREE(lpr->tile_clear[level]);
       }
    }
    else if (!lpr->userBuffer) {
@@ -396,8 +335,7 @@ void *
 llvmpipe_resource_map(struct pipe_resource *resource,
                       unsigned level,
                       unsigned layer,
-                      enum lp_texture_usage tex_usage,
-                      enum lp_texture_layout layout)
+                      enum lp_texture_usage tex_usage)
 {
    struct llvmpipe_resource *lpr = llvmpipe_resource(resource);
    uint8_t *map;
@@ -409,16 +347,11 @@ llvmpipe_resource_map(struct pipe_resource *resource,
           tex_usage == LP_TEX_USAGE_READ_WRITE ||
           tex_usage == LP_TEX_USAGE_WRITE_ALL);
 
-   assert(layout == LP_TEX_LAYOUT_NONE ||
-          layout == LP_TEX_LAYOUT_TILED ||
-          layout == LP_TEX_LAYOUT_LINEAR);
-
    if (lpr->dt) {
       /* display target */
       struct llvmpipe_screen *screen = llvmpipe_screen(resource->screen);
       struct sw_winsys *winsys = screen->winsys;
       unsigned dt_usage;
-      uint8_t *map2;
 
       if (tex_usage == LP_TEX_USAGE_READ) {
          dt_usage = PIPE_TRANSFER_READ;
@@ -436,17 +369,11 @@ llvmpipe_resource_map(struct pipe_resource *resource,
       /* install this linear image in texture data structure */
       lpr->linear[level].data = map;
 
-      /* make sure tiled data gets converted to linear data */
-      map2 = llvmpipe_get_texture_image(lpr, 0, 0, tex_usage, layout);
-      if (layout == LP_TEX_LAYOUT_LINEAR)
-         assert(map == map2);
-
-      return map2;
+      return map;
    }
    else if (resource_is_texture(resource)) {
 
-      map = llvmpipe_get_texture_image(lpr, layer, level,
-                                       tex_usage, layout);
+      map = llvmpipe_get_texture_image(lpr, layer, level);
       return map;
    }
    else {
@@ -473,11 +400,6 @@ llvmpipe_resource_unmap(struct pipe_resource *resource,
       assert(level == 0);
       assert(layer == 0);
 
-      /* make sure linear image is up to date */
-      (void) llvmpipe_get_texture_image(lpr, layer, level,
-                                        LP_TEX_USAGE_READ,
-                                        LP_TEX_LAYOUT_LINEAR);
-
       winsys->displaytarget_unmap(winsys, lpr->dt);
    }
 }
@@ -501,7 +423,6 @@ llvmpipe_resource_from_handle(struct pipe_screen *screen,
 {
    struct sw_winsys *winsys = llvmpipe_screen(screen)->winsys;
    struct llvmpipe_resource *lpr;
-   unsigned width, height, width_t, height_t;
 
    /* XXX Seems like from_handled depth textures doesn't work that well */
 
@@ -514,22 +435,15 @@ llvmpipe_resource_from_handle(struct pipe_screen *screen,
    pipe_reference_init(&lpr->base.reference, 1);
    lpr->base.screen = screen;
 
-   width = align(lpr->base.width0, TILE_SIZE);
-   height = align(lpr->base.height0, TILE_SIZE);
-   width_t = width / TILE_SIZE;
-   height_t = height / TILE_SIZE;
-
    /*
     * Looks like unaligned displaytargets work just fine,
     * at least sampler/render ones.
     */
 #if 0
-   assert(lpr->base.width0 == width);
-   assert(lpr->base.height0 == height);
+   assert(lpr->base.width0 == align(lpr->base.width0, TILE_SIZE));
+   assert(lpr->base.height0 == align(lpr->base.height0, TILE_SIZE));
 #endif
 
-   lpr->tiles_per_row[0] = width_t;
-   lpr->tiles_per_image[0] = width_t * height_t;
    lpr->num_slices_faces[0] = 1;
    lpr->img_stride[0] = 0;
 
@@ -541,13 +455,6 @@ llvmpipe_resource_from_handle(struct pipe_screen *screen,
       goto no_dt;
    }
 
-   lpr->layout[0] = alloc_layout_array(1, lpr->base.width0, lpr->base.height0);
-   if (!lpr->layout[0]) {
-      goto no_layout_0;
-   }
-
-   assert(lpr->layout[0][0] == LP_TEX_LAYOUT_NONE);
-
    lpr->id = id_counter++;
 
 #ifdef DEBUG
@@ -556,8 +463,6 @@ llvmpipe_resource_from_handle(struct pipe_screen *screen,
 
    return &lpr->base;
 
-no_layout_0:
-   winsys->displaytarget_destroy(winsys, lpr->dt);
 no_dt:
    FREE(lpr);
 no_lpr:
@@ -731,10 +636,18 @@ llvmpipe_transfer_map( struct pipe_context *pipe,
    lpr = llvmpipe_resource(transfer->resource);
    format = lpr->base.format;
 
+   /* Write out any fast cleared tiles, unless the whole contents are going
+    * to be replaced anyway.
+    */
+   if (transfer->usage & PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE)
+      llvmpipe_discard_tile_clears(lpr, transfer->level);
+   else
+      llvmpipe_resolve_tile_clears(lpr, transfer->level);
+
    map = llvmpipe_resource_map(transfer->resource,
                                transfer->level,
                                transfer->box.z,
-                               tex_usage, LP_TEX_LAYOUT_LINEAR);
+                               tex_usage);
 
 
    /* May want to do different things here depending on read/write nature
@@ -817,30 +730,10 @@ llvmpipe_user_buffer_create(struct pipe_screen *screen,
  * for just one cube face or one 3D texture slice
  */
 static unsigned
-tex_image_face_size(const struct llvmpipe_resource *lpr, unsigned level,
-                    enum lp_texture_layout layout)
+tex_image_face_size(const struct llvmpipe_resource *lpr, unsigned level)
 {
-   const unsigned width = u_minify(lpr->base.width0, level);
-   const unsigned height = u_minify(lpr->base.height0, level);
-
-   assert(layout == LP_TEX_LAYOUT_TILED ||
-          layout == LP_TEX_LAYOUT_LINEAR);
-
-   if (layout == LP_TEX_LAYOUT_TILED) {
-      /* for tiled layout, force a 32bpp format */
-      const enum pipe_format format = PIPE_FORMAT_B8G8R8A8_UNORM;
-      const unsigned block_size = util_format_get_blocksize(format);
-      const unsigned nblocksy =
-         util_format_get_nblocksy(format, align(height, TILE_SIZE));
-      const unsigned nblocksx =
-         util_format_get_nblocksx(format, align(width, TILE_SIZE));
-      const unsigned buffer_size = block_size * nblocksy * nblocksx;
-      return buffer_size;
-   }
-   else {
-      /* we already computed this */
-      return lpr->img_stride[level];
-   }
+   /* we already computed this */
+   return lpr->img_stride[level];
 }
 
 
@@ -849,95 +742,26 @@ tex_image_face_size(const struct llvmpipe_resource *lpr, unsigned level,
  * including all cube faces or 3D image slices
  */
 static unsigned
-tex_image_size(const struct llvmpipe_resource *lpr, unsigned level,
-               enum lp_texture_layout layout)
+tex_image_size(const struct llvmpipe_resource *lpr, unsigned level)
 {
-   const unsigned buf_size = tex_image_face_size(lpr, level, layout);
+   const unsigned buf_size = tex_image_face_size(lpr, level);
    return buf_size * lpr->num_slices_faces[level];
 }
 
 
-/**
- * This function encapsulates some complicated logic for determining
- * how to convert a tile of image data from linear layout to tiled
- * layout, or vice versa.
- * \param cur_layout  the current tile layout
- * \param target_layout  the desired tile layout
- * \param usage  how the tile will be accessed (R/W vs. read-only, etc)
- * \param new_layout_return  returns the new layout mode
- * \param convert_return  returns TRUE if image conversion is needed
- */
-static void
-layout_logic(enum lp_texture_layout cur_layout,
-             enum lp_texture_layout target_layout,
-             enum lp_texture_usage usage,
-             enum lp_texture_layout *new_layout_return,
-             boolean *convert)
-{
-   enum lp_texture_layout other_layout, new_layout;
-
-   *convert = FALSE;
-
-   new_layout = 99; /* debug check */
-
-   if (target_layout == LP_TEX_LAYOUT_LINEAR) {
-      other_layout = LP_TEX_LAYOUT_TILED;
-   }
-   else {
-      assert(target_layout == LP_TEX_LAYOUT_TILED);
-      other_layout = LP_TEX_LAYOUT_LINEAR;
-   }
-
-   new_layout = target_layout;  /* may get changed below */
-
-   if (cur_layout == LP_TEX_LAYOUT_BOTH) {
-      if (usage == LP_TEX_USAGE_READ) {
-         new_layout = LP_TEX_LAYOUT_BOTH;
-      }
-   }
-   else if (cur_layout == other_layout) {
-      if (usage != LP_TEX_USAGE_WRITE_ALL) {
-         /* need to convert tiled data to linear or vice versa */
-         *convert = TRUE;
-
-         if (usage == LP_TEX_USAGE_READ)
-            new_layout = LP_TEX_LAYOUT_BOTH;
-      }
-   }
-   else {
-      assert(cur_layout == LP_TEX_LAYOUT_NONE ||
-             cur_layout == target_layout);
-   }
-
-   assert(new_layout == LP_TEX_LAYOUT_BOTH ||
-          new_layout == target_layout);
-
-   *new_layout_return = new_layout;
-}
-
-
 /**
  * Return pointer to a 2D texture image/face/slice.
- * No tiled/linear conversion is done.
+ * No storage is allocated.
  */
 ubyte *
 llvmpipe_get_texture_image_address(struct llvmpipe_resource *lpr,
-                                   unsigned face_slice, unsigned level,
-                                   enum lp_texture_layout layout)
+                                   unsigned face_slice, unsigned level)
 {
-   struct llvmpipe_texture_image *img;
+   struct llvmpipe_texture_image *img = &lpr->linear[level];
    unsigned offset;
 
-   if (layout == LP_TEX_LAYOUT_LINEAR) {
-      img = &lpr->linear[level];
-   }
-   else {
-      assert (layout == LP_TEX_LAYOUT_TILED);
-      img = &lpr->tiled[level];
-   }
-
    if (face_slice > 0)
-      offset = face_slice * tex_image_face_size(lpr, level, layout);
+      offset = face_slice * tex_image_face_size(lpr, level);
    else
       offset = 0;
 
@@ -945,94 +769,33 @@ llvmpipe_get_texture_image_address(struct llvmpipe_resource *lpr,
 }
 
 
-static INLINE enum lp_texture_layout
-llvmpipe_get_texture_tile_layout(const struct llvmpipe_resource *lpr,
-                                 unsigned face_slice, unsigned level,
-                                 unsigned x, unsigned y)
-{
-   uint i;
-   assert(resource_is_texture(&lpr->base));
-   assert(x < lpr->tiles_per_row[level]);
-   i = face_slice * lpr->tiles_per_image[level]
-      + y * lpr->tiles_per_row[level] + x;
-   return lpr->layout[level][i];
-}
-
-
-static INLINE void
-llvmpipe_set_texture_tile_layout(struct llvmpipe_resource *lpr,
-                                 unsigned face_slice, unsigned level,
-                                 unsigned x, unsigned y,
-                                 enum lp_texture_layout layout)
-{
-   uint i;
-   assert(resource_is_texture(&lpr->base));
-   assert(x < lpr->tiles_per_row[level]);
-   i = face_slice * lpr->tiles_per_image[level]
-      + y * lpr->tiles_per_row[level] + x;
-   lpr->layout[level][i] = layout;
-}
-
-
-/**
- * Set the layout mode for all tiles in a particular image.
- */
-static INLINE void
-llvmpipe_set_texture_image_layout(struct llvmpipe_resource *lpr,
-                                  unsigned face_slice, unsigned level,
-                                  unsigned width_t, unsigned height_t,
-                                  enum lp_texture_layout layout)
-{
-   const unsigned start = face_slice * lpr->tiles_per_image[level];
-   unsigned i;
-
-   for (i = 0; i < width_t * height_t; i++) {
-      lpr->layout[level][start + i] = layout;
-   }
-}
-
-
 /**
- * Allocate storage for a linear or tile texture image (all cube
- * faces and all 3D slices.
+ * Allocate storage for a texture image (all cube faces and all 3D slices).
  */
 static void
-alloc_image_data(struct llvmpipe_resource *lpr, unsigned level,
-                 enum lp_texture_layout layout)
+alloc_image_data(struct llvmpipe_resource *lpr, unsigned level)
 {
    uint alignment = MAX2(16, util_cpu_caps.cacheline);
 
-   if (lpr->dt)
+   if (lpr->dt) {
+      /* we get the linear memory from the winsys, and it has
+       * already been zeroed
+       */
+      struct llvmpipe_screen *screen = llvmpipe_screen(lpr->base.screen);
+      struct sw_winsys *winsys = screen->winsys;
+
       assert(level == 0);
 
-   if (layout == LP_TEX_LAYOUT_TILED) {
-      /* tiled data is stored in regular memory */
-      uint buffer_size = tex_image_size(lpr, level, layout);
-      lpr->tiled[level].data = align_malloc(buffer_size, alignment);
-      if (lpr->tiled[level].data) {
-         memset(lpr->tiled[level].data, 0, buffer_size);
-      }
+      lpr->linear[0].data =
+         winsys->displaytarget_map(winsys, lpr->dt,
+                                   PIPE_TRANSFER_READ_WRITE);
    }
    else {
-      assert(layout == LP_TEX_LAYOUT_LINEAR);
-      if (lpr->dt) {
-         /* we get the linear memory from the winsys, and it has
-          * already been zeroed
-          */
-         struct llvmpipe_screen *screen = llvmpipe_screen(lpr->base.screen);
-         struct sw_winsys *winsys = screen->winsys;
-
-         lpr->linear[0].data =
-            winsys->displaytarget_map(winsys, lpr->dt,
-                                      PIPE_TRANSFER_READ_WRITE);
-      }
-      else {
-         /* not a display target - allocate regular memory */
-         uint buffer_size = tex_image_size(lpr, level, LP_TEX_LAYOUT_LINEAR);
-         lpr->linear[level].data = align_malloc(buffer_size, alignment);
-         if (lpr->linear[level].data) {
-            memset(lpr->linear[level].data, 0, buffer_size);
-         }
+      /* not a display target - allocate regular memory */
+      uint buffer_size = tex_image_size(lpr, level);
+      lpr->linear[level].data = align_malloc(buffer_size, alignment);
+      if (lpr->linear[level].data) {
+         memset(lpr->linear[level].data, 0, buffer_size);
       }
    }
 }
@@ -1040,286 +803,211 @@ alloc_image_data(struct llvmpipe_resource *lpr, unsigned level,
 
 
 /**
- * Return pointer to texture image data (either linear or tiled layout)
- * for a particular cube face or 3D texture slice.
+ * Return pointer to texture image data for a particular cube face or 3D
+ * texture slice, allocating the image storage if needed.
  *
  * \param face_slice  the cube face or 3D slice of interest
- * \param usage  one of LP_TEX_USAGE_READ/WRITE_ALL/READ_WRITE
- * \param layout  either LP_TEX_LAYOUT_LINEAR or _TILED or _NONE
  */
 void *
 llvmpipe_get_texture_image(struct llvmpipe_resource *lpr,
-                           unsigned face_slice, unsigned level,
-                           enum lp_texture_usage usage,
-                           enum lp_texture_layout layout)
+                           unsigned face_slice, unsigned level)
 {
-   /*
-    * 'target' refers to the image which we're retrieving (either in
-    * tiled or linear layout).
-    * 'other' refers to the same image but in the other layout. (it may
-    *  or may not exist.
-    */
-   struct llvmpipe_texture_image *target_img;
-   struct llvmpipe_texture_image *other_img;
-   void *target_data;
-   void *other_data;
-   const unsigned width = u_minify(lpr->base.width0, level);
-   const unsigned height = u_minify(lpr->base.height0, level);
-   const unsigned width_t = align(width, TILE_SIZE) / TILE_SIZE;
-   const unsigned height_t = align(height, TILE_SIZE) / TILE_SIZE;
-   enum lp_texture_layout other_layout;
-   boolean only_allocate;
-
-   assert(layout == LP_TEX_LAYOUT_NONE ||
-          layout == LP_TEX_LAYOUT_TILED ||
-          layout == LP_TEX_LAYOUT_LINEAR);
-
-   assert(usage == LP_TEX_USAGE_READ ||
-          usage == LP_TEX_USAGE_READ_WRITE ||
-          usage == LP_TEX_USAGE_WRITE_ALL);
-
-   /* check for the special case of layout == LP_TEX_LAYOUT_NONE */
-   if (layout == LP_TEX_LAYOUT_NONE) {
-      only_allocate = TRUE;
-      layout = LP_TEX_LAYOUT_TILED;
-   }
-   else {
-      only_allocate = FALSE;
-   }
-
-   if (lpr->dt) {
-      assert(lpr->linear[level].data);
+   if (!lpr->linear[level].data) {
+      /* allocate memory for the image now */
+      alloc_image_data(lpr, level);
+      if (!lpr->linear[level].data)
+         return NULL;
    }
 
-   /* which is target?  which is other? */
-   if (layout == LP_TEX_LAYOUT_LINEAR) {
-      target_img = &lpr->linear[level];
-      other_img = &lpr->tiled[level];
-      other_layout = LP_TEX_LAYOUT_TILED;
-   }
-   else {
-      target_img = &lpr->tiled[level];
-      other_img = &lpr->linear[level];
-      other_layout = LP_TEX_LAYOUT_LINEAR;
-   }
+   return llvmpipe_get_texture_image_address(lpr, face_slice, level);
+}
 
-   target_data = target_img->data;
-   other_data = other_img->data;
 
-   if (!target_data) {
-      /* allocate memory for the target image now */
-      alloc_image_data(lpr, level, layout);
-      target_data = target_img->data;
-   }
+/**
+ * Return pointer to start of a texture image (1D, 2D, 3D, CUBE).
+ * This is typically used when we're about to sample from a texture.
+ */
+void *
+llvmpipe_get_texture_image_all(struct llvmpipe_resource *lpr,
+                               unsigned level)
+{
+   assert(lpr->num_slices_faces[level] > 0);
 
-   if (face_slice > 0) {
-      unsigned target_offset, other_offset;
+   llvmpipe_resolve_tile_clears(lpr, level);
 
-      target_offset = face_slice * tex_image_face_size(lpr, level, layout);
-      other_offset = face_slice * tex_image_face_size(lpr, level, other_layout);
-      if (target_data) {
-         target_data = (uint8_t *) target_data + target_offset;
-      }
-      if (other_data) {
-         other_data = (uint8_t *) other_data + other_offset;
-      }
-   }
+   return llvmpipe_get_texture_image(lpr, 0, level);
+}
 
-   if (only_allocate) {
-      /* Just allocating tiled memory.  Don't initialize it from the
-       * linear data if it exists.
-       */
-      return target_data;
-   }
 
-   if (other_data) {
-      /* may need to convert other data to the requested layout */
-      enum lp_texture_layout new_layout;
-      unsigned x, y;
-
-      /* loop over all image tiles, doing layout conversion where needed */
-      for (y = 0; y < height_t; y++) {
-         for (x = 0; x < width_t; x++) {
-            enum lp_texture_layout cur_layout =
-               llvmpipe_get_texture_tile_layout(lpr, face_slice, level, x, y);
-            boolean convert;
-
-            layout_logic(cur_layout, layout, usage, &new_layout, &convert);
-
-            if (convert && other_data && target_data) {
-               if (layout == LP_TEX_LAYOUT_TILED) {
-                  lp_linear_to_tiled(other_data, target_data,
-                                     x * TILE_SIZE, y * TILE_SIZE,
-                                     TILE_SIZE, TILE_SIZE,
-                                     lpr->base.format,
-                                     lpr->row_stride[level],
-                                     lpr->tiles_per_row[level]);
-               }
-               else {
-                  assert(layout == LP_TEX_LAYOUT_LINEAR);
-                  lp_tiled_to_linear(other_data, target_data,
-                                     x * TILE_SIZE, y * TILE_SIZE,
-                                     TILE_SIZE, TILE_SIZE,
-                                     lpr->base.format,
-                                     lpr->row_stride[level],
-                                     lpr->tiles_per_row[level]);
-               }
-            }
+/**
+ * Number of tiles in each row of a texture image, for indexing the fast
+ * clear state.
+ */
+static INLINE unsigned
+tile_clear_tiles_x(const struct llvmpipe_resource *lpr, unsigned level)
+{
+   return align(u_minify(lpr->base.width0, level), TILE_SIZE) / TILE_SIZE;
+}
 
-            if (new_layout != cur_layout)
-               llvmpipe_set_texture_tile_layout(lpr, face_slice, level, x, y,
-                                                new_layout);
-         }
-      }
-   }
-   else {
-      /* no other data */
-      llvmpipe_set_texture_image_layout(lpr, face_slice, level,
-                                        width_t, height_t, layout);
-   }
 
-   return target_data;
+static INLINE unsigned
+tile_clear_tiles_y(const struct llvmpipe_resource *lpr, unsigned level)
+{
+   return align(u_minify(lpr->base.height0, level), TILE_SIZE) / TILE_SIZE;
 }
 
 
 /**
- * Return pointer to start of a texture image (1D, 2D, 3D, CUBE).
- * All cube faces and 3D slices will be converted to the requested
- * layout if needed.
- * This is typically used when we're about to sample from a texture.
+ * Return the fast clear state of all the tiles of a texture image, in
+ * row-major order, allocating it if needed.
+ * Called when the image is about to be rendered to.
+ * \return NULL if out of memory, in which case clears must be done
+ *         immediately.
  */
-void *
-llvmpipe_get_texture_image_all(struct llvmpipe_resource *lpr,
-                               unsigned level,
-                               enum lp_texture_usage usage,
-                               enum lp_texture_layout layout)
+struct llvmpipe_tile_clear *
+llvmpipe_get_tile_clear_state(struct llvmpipe_resource *lpr,
+                              unsigned face_slice, unsigned level)
 {
-   const int slices = lpr->num_slices_faces[level];
-   int slice;
-   void *map = NULL;
+   const unsigned tiles_per_image = tile_clear_tiles_x(lpr, level) *
+                                    tile_clear_tiles_y(lpr, level);
 
-   assert(slices > 0);
+   assert(resource_is_texture(&lpr->base));
+   assert(face_slice < lpr->num_slices_faces[level]);
 
-   for (slice = slices - 1; slice >= 0; slice--) {
-      map = llvmpipe_get_texture_image(lpr, slice, level, usage, layout);
+   if (!lpr->tile_clear[level]) {
+      lpr->tile_clear[level] =
+         CALLOC(tiles_per_image * lpr->num_slices_faces[level],
+                sizeof(struct llvmpipe_tile_clear));
+      if (!lpr->tile_clear[level])
+         return NULL;
    }
 
-   return map;
+   /* The rasterizer may now record clears in these tiles */
+   lpr->clear_pending[level] = TRUE;
+
+   return lpr->tile_clear[level] + face_slice * tiles_per_image;
 }
 
 
 /**
- * Get pointer to a linear image (not the tile!) where the tile at (x,y)
- * is known to be in linear layout.
- * Conversion from tiled to linear will be done if necessary.
- * \return pointer to start of image/face (not the tile)
+ * Write the clear value of all fast cleared tiles of a texture image to
+ * memory.  This must be done before the image contents are accessed by
+ * anything other than the rasterizer.
+ *
+ * The rasterizer is shared by the contexts of the screen, so this holds
+ * the screen's rasterizer mutex while touching the fast clear state.
  */
-ubyte *
-llvmpipe_get_texture_tile_linear(struct llvmpipe_resource *lpr,
-                                 unsigned face_slice, unsigned level,
-                                 enum lp_texture_usage usage,
-                                 unsigned x, unsigned y)
+void
+llvmpipe_resolve_tile_clears(struct llvmpipe_resource *lpr,
+                             unsigned level)
 {
-   struct llvmpipe_texture_image *linear_img = &lpr->linear[level];
-   enum lp_texture_layout cur_layout, new_layout;
-   const unsigned tx = x / TILE_SIZE, ty = y / TILE_SIZE;
-   boolean convert;
-   uint8_t *tiled_image, *linear_image;
+   struct llvmpipe_screen *screen = llvmpipe_screen(lpr->base.screen);
+   const enum pipe_format format = lpr->base.format;
+   const unsigned width = u_minify(lpr->base.width0, level);
+   const unsigned height = u_minify(lpr->base.height0, level);
+   const unsigned tiles_x = tile_clear_tiles_x(lpr, level);
+   const unsigned tiles_y = tile_clear_tiles_y(lpr, level);
+   const boolean is_zs = util_format_is_depth_or_stencil(format);
+   struct llvmpipe_tile_clear *tile = lpr->tile_clear[level];
+   unsigned slice, tx, ty;
 
-   assert(resource_is_texture(&lpr->base));
-   assert(x % TILE_SIZE == 0);
-   assert(y % TILE_SIZE == 0);
+   if (!lpr->clear_pending[level])
+      return;
+
+   pipe_mutex_lock(screen->rast_mutex);
 
-   if (!linear_img->data) {
-      /* allocate memory for the linear image now */
-      alloc_image_data(lpr, level, LP_TEX_LAYOUT_LINEAR);
+   if (!lpr->clear_pending[level]) {
+      pipe_mutex_unlock(screen->rast_mutex);
+      return;
    }
 
-   /* compute address of the slice/face of the image that contains the tile */
-   tiled_image = llvmpipe_get_texture_image_address(lpr, face_slice, level,
-                                                    LP_TEX_LAYOUT_TILED);
-   linear_image = llvmpipe_get_texture_image_address(lpr, face_slice, level,
-                                                     LP_TEX_LAYOUT_LINEAR);
+   lpr->clear_pending[level] = FALSE;
 
-   /* get current tile layout and determine if data conversion is needed */
-   cur_layout = llvmpipe_get_texture_tile_layout(lpr, face_slice, level, tx, ty);
+   assert(tile);
 
-   layout_logic(cur_layout, LP_TEX_LAYOUT_LINEAR, usage,
-                &new_layout, &convert);
+   for (slice = 0; slice < lpr->num_slices_faces[level]; slice++) {
+      ubyte *image = NULL;
 
-   if (convert && tiled_image && linear_image) {
-      lp_tiled_to_linear(tiled_image, linear_image,
-                         x, y, TILE_SIZE, TILE_SIZE, lpr->base.format,
-                         lpr->row_stride[level],
-                         lpr->tiles_per_row[level]);
-   }
+      for (ty = 0; ty < tiles_y; ty++) {
+         for (tx = 0; tx < tiles_x; tx++, tile++) {
+            const unsigned x = tx * TILE_SIZE;
+            const unsigned y = ty * TILE_SIZE;
+            union util_color uc;
+
+            if (!tile->cleared)
+               continue;
 
-   if (new_layout != cur_layout)
-      llvmpipe_set_texture_tile_layout(lpr, face_slice, level, tx, ty, new_layout);
+            tile->cleared = FALSE;
 
-   return linear_image;
+            if (!image) {
+               image = llvmpipe_get_texture_image(lpr, slice, level);
+               if (!image)
+                  continue;
+            }
+
+            if (is_zs) {
+               switch (util_format_get_blocksize(format)) {
+               case 1:
+                  uc.ub = (ubyte) tile->zs;
+                  break;
+               case 2:
+                  uc.us = (ushort) tile->zs;
+                  break;
+               default:
+                  uc.ui = tile->zs;
+                  break;
+               }
+            }
+            else {
+               util_pack_color_ub(tile->color[0], tile->color[1],
+                                  tile->color[2], tile->color[3],
+                                  format, &uc);
+            }
+
+            util_fill_rect(image, format, lpr->row_stride[level], x, y,
+                           MIN2(TILE_SIZE, width - x),
+                           MIN2(TILE_SIZE, height - y),
+                           &uc);
+         }
+      }
+   }
+
+   pipe_mutex_unlock(screen->rast_mutex);
 }
 
 
 /**
- * Get pointer to tiled data for rendering.
- * \return pointer to the tiled data at the given tile position
+ * Forget about the fast cleared tiles of a texture image, without writing
+ * their clear value.  Used when the whole image is about to be
+ * overwritten.
  */
-ubyte *
-llvmpipe_get_texture_tile(struct llvmpipe_resource *lpr,
-                          unsigned face_slice, unsigned level,
-                          enum lp_texture_usage usage,
-                          unsigned x, unsigned y)
+void
+llvmpipe_discard_tile_clears(struct llvmpipe_resource *lpr,
+                             unsigned level)
 {
-   struct llvmpipe_texture_image *tiled_img = &lpr->tiled[level];
-   enum lp_texture_layout cur_layout, new_layout;
-   const unsigned tx = x / TILE_SIZE, ty = y / TILE_SIZE;
-   boolean convert;
-   uint8_t *tiled_image, *linear_image;
-   unsigned tile_offset;
+   struct llvmpipe_screen *screen = llvmpipe_screen(lpr->base.screen);
 
-   assert(x % TILE_SIZE == 0);
-   assert(y % TILE_SIZE == 0);
+   if (!lpr->clear_pending[level])
+      return;
 
-   if (!tiled_img->data) {
-      /* allocate memory for the tiled image now */
-      alloc_image_data(lpr, level, LP_TEX_LAYOUT_TILED);
-   }
+   pipe_mutex_lock(screen->rast_mutex);
 
-   /* compute address of the slice/face of the image that contains the tile */
-   tiled_image = llvmpipe_get_texture_image_address(lpr, face_slice, level,
-                                                    LP_TEX_LAYOUT_TILED);
-   linear_image = llvmpipe_get_texture_image_address(lpr, face_slice, level,
-                                                     LP_TEX_LAYOUT_LINEAR);
-
-   /* get current tile layout and see if we need to convert the data */
-   cur_layout = llvmpipe_get_texture_tile_layout(lpr, face_slice, level, tx, ty);
-
-   layout_logic(cur_layout, LP_TEX_LAYOUT_TILED, usage, &new_layout, &convert);
-   if (convert && linear_image && tiled_image) {
-      lp_linear_to_tiled(linear_image, tiled_image,
-                         x, y, TILE_SIZE, TILE_SIZE, lpr->base.format,
-                         lpr->row_stride[level],
-                         lpr->tiles_per_row[level]);
-   }
-
-   if (!tiled_image)
-      return NULL;
-
-   if (new_layout != cur_layout)
-      llvmpipe_set_texture_tile_layout(lpr, face_slice, level, tx, ty, new_layout);
+   if (lpr->clear_pending[level]) {
+      lpr->clear_pending[level] = FALSE;
 
-   /* compute, return address of the 64x64 tile */
-   tile_offset = (ty * lpr->tiles_per_row[level] + tx)
-         * TILE_SIZE * TILE_SIZE * 4;
+      memset(lpr->tile_clear[level], 0,
+             tile_clear_tiles_x(lpr, level) * tile_clear_tiles_y(lpr, level) *
+             lpr->num_slices_faces[level] *
+             sizeof(struct llvmpipe_tile_clear));
+   }
 
-   return (ubyte *) tiled_image + tile_offset;
+   pipe_mutex_unlock(screen->rast_mutex);
 }
 
 
 /**
- * Get pointer to tiled data for rendering.
- * \return pointer to the tiled data at the given tile position
+ * Store a swizzled color tile (see lp_tile_soa.h) back to the linear
+ * image at the given tile position.
  */
 void
 llvmpipe_unswizzle_cbuf_tile(struct llvmpipe_resource *lpr,
@@ -1327,21 +1015,15 @@ llvmpipe_unswizzle_cbuf_tile(struct llvmpipe_resource *lpr,
                              unsigned x, unsigned y,
                              uint8_t *tile)
 {
-   struct llvmpipe_texture_image *linear_img = &lpr->linear[level];
-   const unsigned tx = x / TILE_SIZE, ty = y / TILE_SIZE;
    uint8_t *linear_image;
 
    assert(x % TILE_SIZE == 0);
    assert(y % TILE_SIZE == 0);
 
-   if (!linear_img->data) {
-      /* allocate memory for the linear image now */
-      alloc_image_data(lpr, level, LP_TEX_LAYOUT_LINEAR);
-   }
-
    /* compute address of the slice/face of the image that contains the tile */
-   linear_image = llvmpipe_get_texture_image_address(lpr, face_slice, level,
-                                                     LP_TEX_LAYOUT_LINEAR);
+   linear_image = llvmpipe_get_texture_image(lpr, face_slice, level);
+   if (!linear_image)
+      return;
 
    {
       uint ii = x, jj = y;
@@ -1360,15 +1042,12 @@ llvmpipe_unswizzle_cbuf_tile(struct llvmpipe_resource *lpr,
                          lpr->row_stride[level],
                          1);       /* tiles per row */
    }
-
-   llvmpipe_set_texture_tile_layout(lpr, face_slice, level, tx, ty,
-                                    LP_TEX_LAYOUT_LINEAR);
 }
 
 
 /**
- * Get pointer to tiled data for rendering.
- * \return pointer to the tiled data at the given tile position
+ * Load the linear image data at the given tile position into a swizzled
+ * color tile for rendering.
  */
 void
 llvmpipe_swizzle_cbuf_tile(struct llvmpipe_resource *lpr,
@@ -1382,8 +1061,7 @@ llvmpipe_swizzle_cbuf_tile(struct llvmpipe_resource *lpr,
    assert(y % TILE_SIZE == 0);
 
    /* compute address of the slice/face of the image that contains the tile */
-   linear_image = llvmpipe_get_texture_image_address(lpr, face_slice, level,
-                                                     LP_TEX_LAYOUT_LINEAR);
+   linear_image = llvmpipe_get_texture_image(lpr, face_slice, level);
 
    if (linear_image) {
       uint ii = x, jj = y;
@@ -1416,10 +1094,7 @@ llvmpipe_resource_size(const struct pipe_resource *resource)
 
    for (lvl = 0; lvl <= lpr->base.last_level; lvl++) {
       if (lpr->linear[lvl].data)
-         size += tex_image_size(lpr, lvl, LP_TEX_LAYOUT_LINEAR);
-
-      if (lpr->tiled[lvl].data)
-         size += tex_image_size(lpr, lvl, LP_TEX_LAYOUT_TILED);
+         size += tex_image_size(lpr, lvl);
    }
 
    return size;
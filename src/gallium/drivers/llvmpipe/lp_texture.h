@@ -42,16 +42,6 @@ enum lp_texture_usage
 };
 
 
-/** Per-tile layout mode */
-enum lp_texture_layout
-{
-   LP_TEX_LAYOUT_NONE = 0,  /**< no layout for the tile data yet */
-   LP_TEX_LAYOUT_TILED,     /**< the tile data is in tiled layout */
-   LP_TEX_LAYOUT_LINEAR,    /**< the tile data is in linear layout */
-   LP_TEX_LAYOUT_BOTH       /**< the tile data is in both modes */
-};
-
-
 struct pipe_context;
 struct pipe_screen;
 struct llvmpipe_context;
@@ -60,10 +50,10 @@ struct sw_displaytarget;
 
 
 /**
- * We keep one or two copies of the texture image data:  one in a simple
- * linear layout (for texture sampling) and another in a tiled layout (for
- * render targets).  We keep track of whether each image tile is linear
- * or tiled on a per-tile basis.
+ * Texture image data is kept in a simple linear layout only.  Color
+ * render targets are swizzled into per-thread tiles while rasterizing
+ * (see lp_rast_get_color_tile_pointer), and the fragment shaders read and
+ * write depth/stencil values directly in the linear image.
  */
 
 
@@ -74,12 +64,28 @@ struct llvmpipe_texture_image
 };
 
 
+/**
+ * Fast clear state of one TILE_SIZE x TILE_SIZE region of a render target
+ * image.  Clearing a tile only records the clear value here; while
+ * 'cleared' is set the image memory for the region is stale and the clear
+ * value is what the region really contains.  The value is written out
+ * ("resolved") when the rasterizer first needs the tile contents, or when
+ * the image is accessed in any other way.
+ */
+struct llvmpipe_tile_clear
+{
+   boolean cleared;
+   uint8_t color[4];   /**< clear color, as in lp_rast_cmd_arg::clear_color */
+   uint32_t zs;        /**< packed z/stencil clear value */
+};
+
+
 /**
  * llvmpipe subclass of pipe_resource.  A texture, drawing surface,
  * vertex buffer, const buffer, etc.
  * Textures are stored differently than othere types of objects such as
  * vertex buffers and const buffers.
- * The former are tiled and have per-tile layout flags.
+ * The former have per-level image data (allocated on demand).
  * The later are simple malloc'd blocks of memory.
  */
 struct llvmpipe_resource
@@ -90,8 +96,6 @@ struct llvmpipe_resource
    unsigned row_stride[LP_MAX_TEXTURE_LEVELS];
    /** Image stride (for cube maps or 3D textures) in bytes */
    unsigned img_stride[LP_MAX_TEXTURE_LEVELS];
-   unsigned tiles_per_row[LP_MAX_TEXTURE_LEVELS];
-   unsigned tiles_per_image[LP_MAX_TEXTURE_LEVELS];
    /** Number of 3D slices or cube faces per level */
    unsigned num_slices_faces[LP_MAX_TEXTURE_LEVELS];
 
@@ -104,17 +108,22 @@ struct llvmpipe_resource
    /**
     * Malloc'ed data for regular textures, or a mapping to dt above.
     */
-   struct llvmpipe_texture_image tiled[LP_MAX_TEXTURE_LEVELS];
    struct llvmpipe_texture_image linear[LP_MAX_TEXTURE_LEVELS];
 
+   /**
+    * Per-tile fast clear state of the levels used as render targets
+    * (allocated on demand, one array of tiles for each slice/face).
+    */
+   struct llvmpipe_tile_clear *tile_clear[LP_MAX_TEXTURE_LEVELS];
+
+   /** May any of the level's tiles have an unresolved fast clear? */
+   boolean clear_pending[LP_MAX_TEXTURE_LEVELS];
+
    /**
     * Data for non-texture resources.
     */
    void *data;
 
-   /** array [level][face or slice][tile_y][tile_x] of layout values) */
-   enum lp_texture_layout *layout[LP_MAX_TEXTURE_LEVELS];
-
    boolean userBuffer;  /** Is this a user-space buffer? */
    unsigned timestamp;
 
@@ -174,8 +183,7 @@ void *
 llvmpipe_resource_map(struct pipe_resource *resource,
                       unsigned level,
                       unsigned layer,
-                      enum lp_texture_usage tex_usage,
-                      enum lp_texture_layout layout);
+                      enum lp_texture_usage tex_usage);
 
 void
 llvmpipe_resource_unmap(struct pipe_resource *resource,
@@ -193,32 +201,28 @@ llvmpipe_resource_size(const struct pipe_resource *resource);
 
 ubyte *
 llvmpipe_get_texture_image_address(struct llvmpipe_resource *lpr,
-                                    unsigned face_slice, unsigned level,
-                                    enum lp_texture_layout layout);
+                                    unsigned face_slice, unsigned level);
 
 void *
 llvmpipe_get_texture_image(struct llvmpipe_resource *resource,
-                            unsigned face_slice, unsigned level,
-                            enum lp_texture_usage usage,
-                            enum lp_texture_layout layout);
+                            unsigned face_slice, unsigned level);
 
 void *
 llvmpipe_get_texture_image_all(struct llvmpipe_resource *lpr,
-                               unsigned level,
-                               enum lp_texture_usage usage,
-                               enum lp_texture_layout layout);
+                               unsigned level);
 
-ubyte *
-llvmpipe_get_texture_tile_linear(struct llvmpipe_resource *lpr,
-                                  unsigned face_slice, unsigned level,
-                                  enum lp_texture_usage usage,
-                                  unsigned x, unsigned y);
 
-ubyte *
-llvmpipe_get_texture_tile(struct llvmpipe_resource *lpr,
-                           unsigned face_slice, unsigned level,
-                           enum lp_texture_usage usage,
-                           unsigned x, unsigned y);
+struct llvmpipe_tile_clear *
+llvmpipe_get_tile_clear_state(struct llvmpipe_resource *lpr,
+                              unsigned face_slice, unsigned level);
+
+void
+llvmpipe_resolve_tile_clears(struct llvmpipe_resource *lpr,
+                             unsigned level);
+
+void
+llvmpipe_discard_tile_clears(struct llvmpipe_resource *lpr,
+                             unsigned level);
 
 
 void
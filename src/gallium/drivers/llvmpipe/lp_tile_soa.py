@@ -519,6 +519,156 @@ lp_tile_b8g8r8x8_unorm_unswizzle_4ub_sse2(const uint8_t * restrict src,
 '''
 
 
+def generate_avx2():
+    print '''
+#if defined(U_HAVE_AVX2_INTRINSICS)
+
+/* Same as swz4()/unswz4(), but transposing two horizontally adjacent 4x4
+ * blocks at once, one in each 128-bit lane.
+ */
+static ALWAYS_INLINE U_AVX2_FUNC void
+swz8( __m256i x, __m256i y, __m256i z, __m256i w,
+      __m256i * restrict a, 
+      __m256i * restrict b, 
+      __m256i * restrict c, 
+      __m256i * restrict d)
+{
+   __m256i i, j, k, l;
+   __m256i m, n, o, p;
+   __m256i e, f, g, h;
+
+   m = _mm256_unpacklo_epi8(x,y);
+   n = _mm256_unpackhi_epi8(x,y);
+   o = _mm256_unpacklo_epi8(z,w);
+   p = _mm256_unpackhi_epi8(z,w);
+
+   i = _mm256_unpacklo_epi16(m,n);
+   j = _mm256_unpackhi_epi16(m,n);
+   k = _mm256_unpacklo_epi16(o,p);
+   l = _mm256_unpackhi_epi16(o,p);
+
+   e = _mm256_unpacklo_epi8(i,j);
+   f = _mm256_unpackhi_epi8(i,j);
+   g = _mm256_unpacklo_epi8(k,l);
+   h = _mm256_unpackhi_epi8(k,l);
+
+   *a = _mm256_unpacklo_epi64(e,g);
+   *b = _mm256_unpackhi_epi64(e,g);
+   *c = _mm256_unpacklo_epi64(f,h);
+   *d = _mm256_unpackhi_epi64(f,h);
+}
+
+static ALWAYS_INLINE U_AVX2_FUNC void
+unswz8( __m256i a, __m256i b, __m256i c, __m256i d,
+        __m256i * restrict x, 
+        __m256i * restrict y, 
+        __m256i * restrict z, 
+        __m256i * restrict w)
+{
+   __m256i i, j, k, l;
+   __m256i m, n, o, p;
+
+   i = _mm256_unpacklo_epi8(a,b);
+   j = _mm256_unpackhi_epi8(a,b);
+   k = _mm256_unpacklo_epi8(c,d);
+   l = _mm256_unpackhi_epi8(c,d);
+
+   m = _mm256_unpacklo_epi16(i,k);
+   n = _mm256_unpackhi_epi16(i,k);
+   o = _mm256_unpacklo_epi16(j,l);
+   p = _mm256_unpackhi_epi16(j,l);
+
+   *x = _mm256_unpacklo_epi64(m,n);
+   *y = _mm256_unpackhi_epi64(m,n);
+   *z = _mm256_unpacklo_epi64(o,p);
+   *w = _mm256_unpackhi_epi64(o,p);
+}
+
+static U_AVX2_FUNC void
+lp_tile_b8g8r8a8_unorm_swizzle_4ub_avx2(uint8_t * restrict dst,
+                                        const uint8_t * restrict src, unsigned src_stride,
+                                        unsigned x0, unsigned y0)
+{
+   __m256i *dst256 = (__m256i *) dst;
+   unsigned x, y;
+
+   src += y0 * src_stride;
+   src += x0 * sizeof(uint32_t);
+
+   for (y = 0; y < TILE_SIZE; y += 4) {
+      const uint8_t *src_row = src;
+
+      for (x = 0; x < TILE_SIZE; x += 8) {
+         __m256i b, g, r, a;
+
+         swz8(_mm256_loadu_si256((const __m256i *) (src_row + 0 * src_stride)),
+              _mm256_loadu_si256((const __m256i *) (src_row + 1 * src_stride)),
+              _mm256_loadu_si256((const __m256i *) (src_row + 2 * src_stride)),
+              _mm256_loadu_si256((const __m256i *) (src_row + 3 * src_stride)),
+              &b, &g, &r, &a);
+
+         /* lane 0 holds the left block, lane 1 the right one */
+         _mm256_storeu_si256(dst256 + 0, _mm256_permute2x128_si256(r, g, 0x20));
+         _mm256_storeu_si256(dst256 + 1, _mm256_permute2x128_si256(b, a, 0x20));
+         _mm256_storeu_si256(dst256 + 2, _mm256_permute2x128_si256(r, g, 0x31));
+         _mm256_storeu_si256(dst256 + 3, _mm256_permute2x128_si256(b, a, 0x31));
+
+         dst256 += 4;
+         src_row += sizeof(__m256i);
+      }
+
+      src += 4 * src_stride;
+   }
+}
+
+static U_AVX2_FUNC void
+lp_tile_b8g8r8a8_unorm_unswizzle_4ub_avx2(const uint8_t * restrict src,
+                                          uint8_t * restrict dst, unsigned dst_stride,
+                                          unsigned x0, unsigned y0)
+{
+   unsigned int x, y;
+   const __m256i *src256 = (const __m256i *) src;
+
+   dst += y0 * dst_stride;
+   dst += x0 * sizeof(uint32_t);
+
+   for (y = 0; y < TILE_SIZE; y += 4) {
+      uint8_t *dst_row = dst;
+
+      for (x = 0; x < TILE_SIZE; x += 8) {
+         __m256i rg0 = _mm256_loadu_si256(src256 + 0);
+         __m256i ba0 = _mm256_loadu_si256(src256 + 1);
+         __m256i rg1 = _mm256_loadu_si256(src256 + 2);
+         __m256i ba1 = _mm256_loadu_si256(src256 + 3);
+         __m256i row0, row1, row2, row3;
+
+         unswz8(_mm256_permute2x128_si256(ba0, ba1, 0x20),     /* b */
+                _mm256_permute2x128_si256(rg0, rg1, 0x31),     /* g */
+                _mm256_permute2x128_si256(rg0, rg1, 0x20),     /* r */
+                _mm256_permute2x128_si256(ba0, ba1, 0x31),     /* a */
+                &row0, &row1, &row2, &row3);
+
+         _mm256_storeu_si256((__m256i *) (dst_row + 0 * dst_stride), row0);
+         _mm256_storeu_si256((__m256i *) (dst_row + 1 * dst_stride), row1);
+         _mm256_storeu_si256((__m256i *) (dst_row + 2 * dst_stride), row2);
+         _mm256_storeu_si256((__m256i *) (dst_row + 3 * dst_stride), row3);
+
+         src256 += 4;
+         dst_row += sizeof(__m256i);
+      }
+
+      dst += 4 * dst_stride;
+   }
+}
+
+/* The X channel is swizzled/unswizzled like any other */
+#define lp_tile_b8g8r8x8_unorm_swizzle_4ub_avx2 lp_tile_b8g8r8a8_unorm_swizzle_4ub_avx2
+#define lp_tile_b8g8r8x8_unorm_unswizzle_4ub_avx2 lp_tile_b8g8r8a8_unorm_unswizzle_4ub_avx2
+
+#endif /* U_HAVE_AVX2_INTRINSICS */
+'''
+
+
 def generate_swizzle(formats, dst_channel, dst_native_type, dst_suffix):
     '''Generate the dispatch function to read pixels from any format'''
 
@@ -539,7 +689,10 @@ def generate_swizzle(formats, dst_channel, dst_native_type, dst_suffix):
             print '   case %s:' % format.name
             func_name = 'lp_tile_%s_swizzle_%s' % (format.short_name(), dst_suffix)
             if format.name == 'PIPE_FORMAT_B8G8R8A8_UNORM' or format.name == 'PIPE_FORMAT_B8G8R8X8_UNORM':
-                print '#ifdef PIPE_ARCH_SSE'
+                print '#if defined(U_HAVE_AVX2_INTRINSICS)'
+                print '      func = util_cpu_caps.has_avx2 ? %s_avx2 :' % (func_name,)
+                print '             util_cpu_caps.has_sse2 ? %s_sse2 : %s;' % (func_name, func_name)
+                print '#elif defined(PIPE_ARCH_SSE)'
                 print '      func = util_cpu_caps.has_sse2 ? %s_sse2 : %s;' % (func_name, func_name)
                 print '#else'
                 print '      func = %s;' % (func_name,)
@@ -577,7 +730,10 @@ def generate_unswizzle(formats, src_channel, src_native_type, src_suffix):
             print '   case %s:' % format.name
             func_name = 'lp_tile_%s_unswizzle_%s' % (format.short_name(), src_suffix)
             if format.name == 'PIPE_FORMAT_B8G8R8A8_UNORM' or format.name == 'PIPE_FORMAT_B8G8R8X8_UNORM':
-                print '#ifdef PIPE_ARCH_SSE'
+                print '#if defined(U_HAVE_AVX2_INTRINSICS)'
+                print '      func = util_cpu_caps.has_avx2 ? %s_avx2 :' % (func_name,)
+                print '             util_cpu_caps.has_sse2 ? %s_sse2 : %s;' % (func_name, func_name)
+                print '#elif defined(PIPE_ARCH_SSE)'
                 print '      func = util_cpu_caps.has_sse2 ? %s_sse2 : %s;' % (func_name, func_name)
                 print '#else'
                 print '      func = %s;' % (func_name,)
@@ -641,6 +797,7 @@ def main():
     print
 
     generate_sse2()
+    generate_avx2()
 
     channel = Channel(UNSIGNED, True, False, 8)
     native_type = 'uint8_t'
@@ -53,6 +53,7 @@ C_SOURCES = \
 	sp_tex_sample.c \
 	sp_tex_tile_cache.c \
 	sp_tile_cache.c \
+	sp_tile_threads.c \
 	sp_surface.c
 
 include $(CLEAR_VARS)
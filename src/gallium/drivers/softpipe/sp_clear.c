@@ -38,6 +38,7 @@
 #include "sp_context.h"
 #include "sp_query.h"
 #include "sp_tile_cache.h"
+#include "sp_tile_threads.h"
 
 
 /**
@@ -50,7 +51,7 @@ softpipe_clear(struct pipe_context *pipe, unsigned buffers,
                double depth, unsigned stencil)
 {
    struct softpipe_context *softpipe = softpipe_context(pipe);
-   uint64_t cv;
+   uint64_t cv = 0;
    uint i;
 
    if (softpipe->no_rast)
@@ -77,5 +78,8 @@ softpipe_clear(struct pipe_context *pipe, unsigned buffers,
       sp_tile_cache_clear(softpipe->zsbuf_cache, &zero, cv);
    }
 
+   if (softpipe->tile_threads)
+      sp_tile_threads_clear(softpipe->tile_threads, buffers, color, cv);
+
    softpipe->dirty_render_cache = TRUE;
 }
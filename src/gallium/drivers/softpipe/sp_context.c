@@ -48,6 +48,7 @@
 #include "sp_surface.h"
 #include "sp_tile_cache.h"
 #include "sp_tex_tile_cache.h"
+#include "sp_tile_threads.h"
 #include "sp_texture.h"
 #include "sp_query.h"
 #include "sp_screen.h"
@@ -66,6 +67,9 @@ softpipe_map_transfers(struct softpipe_context *sp)
    }
 
    sp_tile_cache_map_transfers(sp->zsbuf_cache);
+
+   if (sp->tile_threads)
+      sp_tile_threads_map_transfers(sp->tile_threads);
 }
 
 
@@ -82,6 +86,9 @@ softpipe_unmap_transfers(struct softpipe_context *sp)
    }
 
    sp_tile_cache_unmap_transfers(sp->zsbuf_cache);
+
+   if (sp->tile_threads)
+      sp_tile_threads_unmap_transfers(sp->tile_threads);
 }
 
 
@@ -106,6 +113,8 @@ softpipe_destroy( struct pipe_context *pipe )
    if (softpipe->draw)
       draw_destroy( softpipe->draw );
 
+   sp_tile_threads_destroy(softpipe->tile_threads);
+
    if (softpipe->quad.shade)
       softpipe->quad.shade->destroy( softpipe->quad.shade );
 
@@ -277,6 +286,8 @@ softpipe_create_context( struct pipe_screen *screen,
    softpipe->quad.blend = sp_quad_blend_stage(softpipe);
    softpipe->quad.pstipple = sp_quad_polygon_stipple_stage(softpipe);
 
+   softpipe->tile_threads = sp_tile_threads_create(softpipe);
+
 
    /*
     * Create drawing context and plug our rendering stage into it.
@@ -55,6 +55,7 @@ struct sp_fragment_shader;
 struct sp_vertex_shader;
 struct sp_velems_state;
 struct sp_so_state;
+struct sp_tile_threads;
 
 struct softpipe_context {
    struct pipe_context pipe;  /**< base class */
@@ -164,6 +165,9 @@ struct softpipe_context {
 
    struct tgsi_exec_machine *fs_machine;
 
+   /** Fragment processing threads, NULL if single-threaded */
+   struct sp_tile_threads *tile_threads;
+
    /** The primitive drawing context */
    struct draw_context *draw;
 
@@ -38,6 +38,7 @@
 #include "sp_state.h"
 #include "sp_tile_cache.h"
 #include "sp_tex_tile_cache.h"
+#include "sp_tile_threads.h"
 #include "util/u_memory.h"
 
 
@@ -73,6 +74,9 @@ softpipe_flush( struct pipe_context *pipe,
    if (softpipe->zsbuf_cache)
       sp_flush_tile_cache(softpipe->zsbuf_cache);
 
+   if (softpipe->tile_threads)
+      sp_tile_threads_flush(softpipe->tile_threads, flags);
+
    softpipe->dirty_render_cache = FALSE;
 
    /* Need this call for hardware buffers before swapbuffers.
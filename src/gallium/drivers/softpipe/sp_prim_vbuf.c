@@ -39,6 +39,7 @@
 #include "sp_context.h"
 #include "sp_setup.h"
 #include "sp_state.h"
+#include "sp_tile_threads.h"
 #include "sp_prim_vbuf.h"
 #include "draw/draw_context.h"
 #include "draw/draw_vbuf.h"
@@ -345,6 +346,9 @@ sp_vbuf_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
    default:
       assert(0);
    }
+
+   if (softpipe->tile_threads)
+      sp_tile_threads_run(softpipe->tile_threads);
 }
 
 
@@ -539,6 +543,9 @@ sp_vbuf_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
    default:
       assert(0);
    }
+
+   if (softpipe->tile_threads)
+      sp_tile_threads_run(softpipe->tile_threads);
 }
 
 static void
@@ -37,6 +37,7 @@
 #include "sp_quad_pipe.h"
 #include "sp_setup.h"
 #include "sp_state.h"
+#include "sp_tile_threads.h"
 #include "draw/draw_context.h"
 #include "draw/draw_vertex.h"
 #include "pipe/p_shader_tokens.h"
@@ -152,6 +153,35 @@ quad_clip(struct setup_context *setup, struct quad_header *quad)
 }
 
 
+/**
+ * Pass a batch of quads to the quad pipeline, or to the bins of the
+ * rendering threads if there are any.
+ */
+static INLINE void
+emit_quads(struct setup_context *setup, struct quad_header *quads[],
+           unsigned nr)
+{
+   struct softpipe_context *sp = setup->softpipe;
+
+   if (sp->tile_threads)
+      sp_tile_threads_bin_quads(sp->tile_threads, quads, nr);
+   else
+      sp->quad.first->run( sp->quad.first, quads, nr );
+}
+
+
+/**
+ * Tell the rendering threads, if any, that the coefficients now belong to
+ * a new primitive.
+ */
+static INLINE void
+begin_prim(struct setup_context *setup)
+{
+   if (setup->softpipe->tile_threads)
+      sp_tile_threads_begin_prim(setup->softpipe->tile_threads);
+}
+
+
 /**
  * Emit a quad (pass to next stage) with clipping.
  */
@@ -161,13 +191,11 @@ clip_emit_quad(struct setup_context *setup, struct quad_header *quad)
    quad_clip( setup, quad );
 
    if (quad->inout.mask) {
-      struct softpipe_context *sp = setup->softpipe;
-
 #if DEBUG_FRAGS
       setup->numFragsEmitted += util_bitcount(quad->inout.mask);
 #endif
 
-      sp->quad.first->run( sp->quad.first, &quad, 1 );
+      emit_quads( setup, &quad, 1 );
    }
 }
 
@@ -202,7 +230,6 @@ flush_spans(struct setup_context *setup)
    const int xleft1 = setup->span.left[1];
    const int xright0 = setup->span.right[0];
    const int xright1 = setup->span.right[1];
-   struct quad_stage *pipe = setup->softpipe->quad.first;
 
    const int minleft = block_x(MIN2(xleft0, xleft1));
    const int maxright = MAX2(xright0, xright1);
@@ -247,7 +274,7 @@ flush_spans(struct setup_context *setup)
             lx += 2;
          } while (mask0 | mask1);
 
-         pipe->run( pipe, setup->quad_ptrs, q );
+         emit_quads( setup, setup->quad_ptrs, q );
       }
    }
 
@@ -832,6 +859,7 @@ sp_setup_tri(struct setup_context *setup,
 
    setup_tri_coefficients( setup );
    setup_tri_edges( setup );
+   begin_prim( setup );
 
    assert(setup->softpipe->reduced_prim == PIPE_PRIM_TRIANGLES);
 
@@ -1089,6 +1117,8 @@ sp_setup_line(struct setup_context *setup,
    if (!setup_line_coefficients(setup, v0, v1))
       return;
 
+   begin_prim( setup );
+
    assert(v0[0][0] < 1.0e9);
    assert(v0[0][1] < 1.0e9);
    assert(v1[0][0] < 1.0e9);
@@ -1271,6 +1301,7 @@ sp_setup_point(struct setup_context *setup,
       }
    }
 
+   begin_prim( setup );
 
    if (halfSize <= 0.5 && !round) {
       /* special case for 1-pixel points */
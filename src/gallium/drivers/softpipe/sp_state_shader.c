@@ -29,6 +29,7 @@
 #include "sp_state.h"
 #include "sp_fs.h"
 #include "sp_texture.h"
+#include "sp_tile_threads.h"
 
 #include "pipe/p_defines.h"
 #include "util/u_memory.h"
@@ -200,6 +201,9 @@ softpipe_delete_fs_state(struct pipe_context *pipe, void *fs)
       draw_delete_fragment_shader(softpipe->draw, var->draw_shader);
 #endif
 
+      if (softpipe->tile_threads)
+         sp_tile_threads_unbind_shader(softpipe->tile_threads, var->tokens);
+
       var->delete(var);
    }
 
@@ -31,6 +31,7 @@
 #include "sp_context.h"
 #include "sp_state.h"
 #include "sp_tile_cache.h"
+#include "sp_tile_threads.h"
 
 #include "draw/draw_context.h"
 
@@ -102,5 +103,8 @@ softpipe_set_framebuffer_state(struct pipe_context *pipe,
    sp->framebuffer.width = fb->width;
    sp->framebuffer.height = fb->height;
 
+   if (sp->tile_threads)
+      sp_tile_threads_set_framebuffer(sp->tile_threads, &sp->framebuffer);
+
    sp->dirty |= SP_NEW_FRAMEBUFFER;
 }
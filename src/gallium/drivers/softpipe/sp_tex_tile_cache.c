@@ -41,7 +41,9 @@
 #include "sp_texture.h"
 #include "sp_tex_tile_cache.h"
 
-   
+
+DEBUG_GET_ONCE_BOOL_OPTION(tex_cache_stats, "SOFTPIPE_TEX_CACHE_STATS", FALSE)
+
 
 struct softpipe_tex_tile_cache *
 sp_create_tex_tile_cache( struct pipe_context *pipe )
@@ -55,7 +57,7 @@ sp_create_tex_tile_cache( struct pipe_context *pipe )
    tc = CALLOC_STRUCT( softpipe_tex_tile_cache );
    if (tc) {
       tc->pipe = pipe;
-      for (pos = 0; pos < NUM_ENTRIES; pos++) {
+      for (pos = 0; pos < NUM_TEX_TILE_ENTRIES; pos++) {
          tc->entries[pos].addr.bits.invalid = 1;
       }
       tc->last_tile = &tc->entries[0]; /* any tile */
@@ -68,11 +70,11 @@ void
 sp_destroy_tex_tile_cache(struct softpipe_tex_tile_cache *tc)
 {
    if (tc) {
-      uint pos;
-
-      for (pos = 0; pos < NUM_ENTRIES; pos++) {
-         /*assert(tc->entries[pos].x < 0);*/
+      if (debug_get_option_tex_cache_stats() && tc->misses) {
+         debug_printf("softpipe: texture tile cache %p: %u hits, %u misses\n",
+                      (void *) tc, tc->hits, tc->misses);
       }
+
       if (tc->transfer) {
          tc->pipe->transfer_destroy(tc->pipe, tc->transfer);
       }
@@ -116,7 +118,7 @@ sp_tex_tile_cache_validate_texture(struct softpipe_tex_tile_cache *tc)
    assert(tc);
    assert(tc->texture);
 
-   for (i = 0; i < NUM_ENTRIES; i++) {
+   for (i = 0; i < NUM_TEX_TILE_ENTRIES; i++) {
       tc->entries[i].addr.bits.invalid = 1;
    }
 }
@@ -170,7 +172,7 @@ sp_tex_tile_cache_set_sampler_view(struct softpipe_tex_tile_cache *tc,
 
       /* mark as entries as invalid/empty */
       /* XXX we should try to avoid this when the teximage hasn't changed */
-      for (i = 0; i < NUM_ENTRIES; i++) {
+      for (i = 0; i < NUM_TEX_TILE_ENTRIES; i++) {
          tc->entries[i].addr.bits.invalid = 1;
       }
 
@@ -192,7 +194,7 @@ sp_flush_tex_tile_cache(struct softpipe_tex_tile_cache *tc)
 
    if (tc->texture) {
       /* caching a texture, mark all entries as empty */
-      for (pos = 0; pos < NUM_ENTRIES; pos++) {
+      for (pos = 0; pos < NUM_TEX_TILE_ENTRIES; pos++) {
          tc->entries[pos].addr.bits.invalid = 1;
       }
       tc->tex_face = -1;
@@ -203,13 +205,10 @@ sp_flush_tex_tile_cache(struct softpipe_tex_tile_cache *tc)
 
 /**
  * Given the texture face, level, zslice, x and y values, compute
- * the cache entry position/index where we'd hope to find the
- * cached texture tile.
- * This is basically a direct-map cache.
- * XXX There's probably lots of ways in which we can improve this.
+ * the cache set where the texture tile may be cached.
  */
 static INLINE uint
-tex_cache_pos( union tex_tile_address addr )
+tex_cache_set( union tex_tile_address addr )
 {
    uint entry = (addr.bits.x + 
                  addr.bits.y * 9 + 
@@ -217,9 +216,116 @@ tex_cache_pos( union tex_tile_address addr )
                  addr.bits.face + 
                  addr.bits.level * 7);
 
-   return entry % NUM_ENTRIES;
+   return entry % TEX_CACHE_SETS;
+}
+
+
+/**
+ * Get a new transfer (view into the texture) if the tile is in another
+ * face, level or zslice than the current one.
+ */
+static void
+tex_cache_get_transfer(struct softpipe_tex_tile_cache *tc,
+                       union tex_tile_address addr)
+{
+   unsigned width, height, layer;
+
+   if (tc->tex_trans &&
+       tc->tex_face == addr.bits.face &&
+       tc->tex_level == addr.bits.level &&
+       tc->tex_z == addr.bits.z)
+      return;
+
+   if (tc->tex_trans) {
+      if (tc->tex_trans_map) {
+         tc->pipe->transfer_unmap(tc->pipe, tc->tex_trans);
+         tc->tex_trans_map = NULL;
+      }
+
+      tc->pipe->transfer_destroy(tc->pipe, tc->tex_trans);
+      tc->tex_trans = NULL;
+   }
+
+   width = u_minify(tc->texture->width0, addr.bits.level);
+   if (tc->texture->target == PIPE_TEXTURE_1D_ARRAY) {
+      height = tc->texture->array_size;
+      layer = 0;
+   }
+   else {
+      height = u_minify(tc->texture->height0, addr.bits.level);
+      layer = addr.bits.face + addr.bits.z;
+   }
+
+   tc->tex_trans = 
+      pipe_get_transfer(tc->pipe, tc->texture,
+                        addr.bits.level,
+                        layer,
+                        PIPE_TRANSFER_READ | PIPE_TRANSFER_UNSYNCHRONIZED,
+                        0, 0, width, height);
+
+   tc->tex_trans_map = tc->pipe->transfer_map(tc->pipe, tc->tex_trans);
+
+   tc->tex_face = addr.bits.face;
+   tc->tex_level = addr.bits.level;
+   tc->tex_z = addr.bits.z;
+}
+
+
+/**
+ * Decode a tile straight out of the mapped transfer with the format's
+ * unpack function.  This avoids the temporary buffer, the copy and the
+ * map/unmap of the generic pipe_get_tile_*() path.
+ * Returns FALSE for the formats which still need the generic path
+ * (depth/stencil and the ones with blocks larger than one pixel).
+ */
+static boolean
+tex_cache_decode_tile(struct softpipe_tex_tile_cache *tc,
+                      struct softpipe_tex_cached_tile *tile,
+                      union tex_tile_address addr,
+                      boolean zs)
+{
+   const struct util_format_description *desc;
+   struct pipe_transfer *pt = tc->tex_trans;
+   const ubyte *src;
+   unsigned x = addr.bits.x * TILE_SIZE;
+   unsigned y = addr.bits.y * TILE_SIZE;
+   unsigned w = TILE_SIZE, h = TILE_SIZE;
+   const unsigned dst_stride = TILE_SIZE * 4 * sizeof(float);
+
+   if (zs)
+      return FALSE;
+
+   desc = util_format_description(tc->format);
+   if (!desc ||
+       desc->block.width != 1 || desc->block.height != 1 ||
+       desc->block.bits % 8 != 0)
+      return FALSE;
+
+   if (!tc->tex_trans_map)
+      tc->tex_trans_map = tc->pipe->transfer_map(tc->pipe, pt);
+   if (!tc->tex_trans_map)
+      return FALSE;
+
+   if (u_clip_tile(x, y, &w, &h, &pt->box))
+      return TRUE;
+
+   src = (const ubyte *) tc->tex_trans_map
+      + y * pt->stride + x * (desc->block.bits / 8);
+
+   if (util_format_is_pure_uint(tc->format))
+      desc->unpack_rgba_uint((unsigned *) tile->data.colorui, dst_stride,
+                             src, pt->stride, w, h);
+   else if (util_format_is_pure_sint(tc->format))
+      desc->unpack_rgba_sint((int *) tile->data.colori, dst_stride,
+                             src, pt->stride, w, h);
+   else
+      desc->unpack_rgba_float((float *) tile->data.color, dst_stride,
+                              src, pt->stride, w, h);
+
+   return TRUE;
 }
 
+
 /**
  * Similar to sp_get_cached_tile() but for textures.
  * Tiles are read-only and indexed with more params.
@@ -228,100 +334,83 @@ const struct softpipe_tex_cached_tile *
 sp_find_cached_tile_tex(struct softpipe_tex_tile_cache *tc, 
                         union tex_tile_address addr )
 {
-   struct softpipe_tex_cached_tile *tile;
-   boolean zs = util_format_is_depth_or_stencil(tc->format);
-
-   tile = tc->entries + tex_cache_pos( addr );
-
-   if (addr.value != tile->addr.value) {
-
-      /* cache miss.  Most misses are because we've invaldiated the
-       * texture cache previously -- most commonly on binding a new
-       * texture.  Currently we effectively flush the cache on texture
-       * bind.
-       */
-#if 0
-      _debug_printf("miss at %u:  x=%d y=%d z=%d face=%d level=%d\n"
-                    "   tile %u:  x=%d y=%d z=%d face=%d level=%d\n",
-                    pos, x/TILE_SIZE, y/TILE_SIZE, z, face, level,
-                    pos, tile->addr.bits.x, tile->addr.bits.y, tile->z, tile->face, tile->level);
-#endif
-
-      /* check if we need to get a new transfer */
-      if (!tc->tex_trans ||
-          tc->tex_face != addr.bits.face ||
-          tc->tex_level != addr.bits.level ||
-          tc->tex_z != addr.bits.z) {
-         /* get new transfer (view into texture) */
-         unsigned width, height, layer;
-
-         if (tc->tex_trans) {
-            if (tc->tex_trans_map) {
-               tc->pipe->transfer_unmap(tc->pipe, tc->tex_trans);
-               tc->tex_trans_map = NULL;
-            }
-
-            tc->pipe->transfer_destroy(tc->pipe, tc->tex_trans);
-            tc->tex_trans = NULL;
-         }
-
-         width = u_minify(tc->texture->width0, addr.bits.level);
-         if (tc->texture->target == PIPE_TEXTURE_1D_ARRAY) {
-            height = tc->texture->array_size;
-            layer = 0;
-         }
-         else {
-            height = u_minify(tc->texture->height0, addr.bits.level);
-            layer = addr.bits.face + addr.bits.z;
-         }
+   struct softpipe_tex_cached_tile *set, *tile;
+   boolean zs;
+   unsigned i;
 
-         tc->tex_trans = 
-            pipe_get_transfer(tc->pipe, tc->texture,
-                              addr.bits.level,
-                              layer,
-                              PIPE_TRANSFER_READ | PIPE_TRANSFER_UNSYNCHRONIZED,
-                              0, 0, width, height);
+   set = tc->entries + tex_cache_set( addr ) * TEX_CACHE_WAYS;
+   tc->use_count++;
 
-         tc->tex_trans_map = tc->pipe->transfer_map(tc->pipe, tc->tex_trans);
+   for (i = 0; i < TEX_CACHE_WAYS; i++) {
+      if (set[i].addr.value == addr.value) {
+         tile = &set[i];
+         tile->last_used = tc->use_count;
+         tc->last_tile = tile;
+         tc->hits++;
+         return tile;
+      }
+   }
 
-         tc->tex_face = addr.bits.face;
-         tc->tex_level = addr.bits.level;
-         tc->tex_z = addr.bits.z;
+   /* cache miss.  Most misses are because we've invaldiated the
+    * texture cache previously -- most commonly on binding a new
+    * texture.  Currently we effectively flush the cache on texture
+    * bind.
+    *
+    * Replace an invalid way if there is one, the least recently used
+    * one otherwise.
+    */
+   tc->misses++;
+
+   tile = &set[0];
+   for (i = 0; i < TEX_CACHE_WAYS; i++) {
+      if (set[i].addr.bits.invalid) {
+         tile = &set[i];
+         break;
       }
+      /* ages, so that use_count wrapping around is harmless */
+      if (tc->use_count - set[i].last_used > tc->use_count - tile->last_used)
+         tile = &set[i];
+   }
 
-      /* Get tile from the transfer (view into texture), explicitly passing
-       * the image format.
-       */
-      if (!zs && util_format_is_pure_uint(tc->format)) {
-         pipe_get_tile_ui_format(tc->pipe,
-                                 tc->tex_trans,
-                                 addr.bits.x * TILE_SIZE,
-                                 addr.bits.y * TILE_SIZE,
-                                 TILE_SIZE,
-                                 TILE_SIZE,
-                                 tc->format,
-                                 (unsigned *) tile->data.colorui);
-      } else if (!zs && util_format_is_pure_sint(tc->format)) {
-         pipe_get_tile_i_format(tc->pipe,
+   tex_cache_get_transfer(tc, addr);
+
+   zs = util_format_is_depth_or_stencil(tc->format);
+
+   /* Get tile from the transfer (view into texture), explicitly passing
+    * the image format.
+    */
+   if (tex_cache_decode_tile(tc, tile, addr, zs)) {
+      /* done */
+   } else if (!zs && util_format_is_pure_uint(tc->format)) {
+      pipe_get_tile_ui_format(tc->pipe,
+                              tc->tex_trans,
+                              addr.bits.x * TILE_SIZE,
+                              addr.bits.y * TILE_SIZE,
+                              TILE_SIZE,
+                              TILE_SIZE,
+                              tc->format,
+                              (unsigned *) tile->data.colorui);
+   } else if (!zs && util_format_is_pure_sint(tc->format)) {
+      pipe_get_tile_i_format(tc->pipe,
+                             tc->tex_trans,
+                             addr.bits.x * TILE_SIZE,
+                             addr.bits.y * TILE_SIZE,
+                             TILE_SIZE,
+                             TILE_SIZE,
+                             tc->format,
+                             (int *) tile->data.colori);
+   } else {
+      pipe_get_tile_rgba_format(tc->pipe,
                                 tc->tex_trans,
                                 addr.bits.x * TILE_SIZE,
                                 addr.bits.y * TILE_SIZE,
                                 TILE_SIZE,
-                                 TILE_SIZE,
+                                TILE_SIZE,
                                 tc->format,
-                                (int *) tile->data.colori);
-      } else {
-         pipe_get_tile_rgba_format(tc->pipe,
-                                   tc->tex_trans,
-                                   addr.bits.x * TILE_SIZE,
-                                   addr.bits.y * TILE_SIZE,
-                                   TILE_SIZE,
-                                   TILE_SIZE,
-                                   tc->format,
-                                   (float *) tile->data.color);
-      }
-      tile->addr = addr;
+                                (float *) tile->data.color);
    }
+   tile->addr = addr;
+   tile->last_used = tc->use_count;
 
    tc->last_tile = tile;
    return tile;
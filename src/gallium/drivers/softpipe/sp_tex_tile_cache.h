@@ -66,6 +66,7 @@ union tex_tile_address {
 struct softpipe_tex_cached_tile
 {
    union tex_tile_address addr;
+   unsigned last_used;     /**< cache use count at the last lookup, for LRU */
    union {
       float color[TILE_SIZE][TILE_SIZE][4];
       unsigned int colorui[TILE_SIZE][TILE_SIZE][4];
@@ -73,7 +74,14 @@ struct softpipe_tex_cached_tile
    } data;
 };
 
-#define NUM_ENTRIES 50
+/**
+ * The cache is set associative: a tile address hashes to a set and the
+ * tile can live in any of the set's ways.  On a miss the least recently
+ * used way of the set is replaced.
+ */
+#define TEX_CACHE_WAYS 4
+#define TEX_CACHE_SETS 12
+#define NUM_TEX_TILE_ENTRIES (TEX_CACHE_SETS * TEX_CACHE_WAYS)
 
 struct softpipe_tex_tile_cache
 {
@@ -84,7 +92,8 @@ struct softpipe_tex_tile_cache
    struct pipe_resource *texture;  /**< if caching a texture */
    unsigned timestamp;
 
-   struct softpipe_tex_cached_tile entries[NUM_ENTRIES];
+   struct softpipe_tex_cached_tile entries[NUM_TEX_TILE_ENTRIES];
+   unsigned use_count;     /**< bumped on every non-trivial lookup */
 
    struct pipe_transfer *tex_trans;
    void *tex_trans_map;
@@ -97,6 +106,9 @@ struct softpipe_tex_tile_cache
    enum pipe_format format;
 
    struct softpipe_tex_cached_tile *last_tile;  /**< most recently retrieved tile */
+
+   /** Statistics, not counting the hits on last_tile */
+   unsigned hits, misses;
 };
 
 
@@ -469,8 +469,10 @@ softpipe_transfer_unmap(struct pipe_context *pipe,
    }
 
    if (transfer->usage & PIPE_TRANSFER_WRITE) {
-      /* Mark the texture as dirty to expire the tile caches. */
-      spr->timestamp++;
+      /* Mark the texture as dirty to expire the tile caches.
+       * The rendering threads' tile caches unmap concurrently.
+       */
+      p_atomic_inc((int32_t *) &spr->timestamp);
    }
 }
 
@@ -629,3 +629,32 @@ sp_tile_cache_clear(struct softpipe_tile_cache *tc,
    }
    tc->last_tile_addr.bits.invalid = 1;
 }
+
+
+/**
+ * Copy the pending clear (flags and clear values) of a cache to another
+ * cache of the same surface.
+ */
+void
+sp_tile_cache_copy_clear(struct softpipe_tile_cache *dst,
+                         const struct softpipe_tile_cache *src)
+{
+   memcpy(dst->clear_flags, src->clear_flags, sizeof(dst->clear_flags));
+   dst->clear_color = src->clear_color;
+   dst->clear_val = src->clear_val;
+}
+
+
+/**
+ * Mark the tiles which have been cleared in the src cache, since the
+ * flags were copied from dst, as not cleared in dst.
+ */
+void
+sp_tile_cache_merge_clear(struct softpipe_tile_cache *dst,
+                          const struct softpipe_tile_cache *src)
+{
+   uint i;
+
+   for (i = 0; i < Elements(dst->clear_flags); i++)
+      dst->clear_flags[i] &= src->clear_flags[i];
+}
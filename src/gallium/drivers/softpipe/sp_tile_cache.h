@@ -126,6 +126,14 @@ sp_tile_cache_clear(struct softpipe_tile_cache *tc,
                     const union pipe_color_union *color,
                     uint64_t clearValue);
 
+extern void
+sp_tile_cache_copy_clear(struct softpipe_tile_cache *dst,
+                         const struct softpipe_tile_cache *src);
+
+extern void
+sp_tile_cache_merge_clear(struct softpipe_tile_cache *dst,
+                          const struct softpipe_tile_cache *src);
+
 extern struct softpipe_cached_tile *
 sp_find_cached_tile(struct softpipe_tile_cache *tc, 
                     union tile_address addr );
@@ -0,0 +1,681 @@
+/**************************************************************************
+ *
+ * Copyright 2013 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * Binned, multi-threaded fragment processing.
+ *
+ * With SOFTPIPE_NUM_THREADS=n (n > 1) the screen is divided into bands
+ * one tile (TILE_SIZE pixels) high, and band b belongs to thread
+ * b % n.  Setup doesn't run the quad pipeline directly but appends each
+ * batch of quads, along with a copy of its primitive's interpolation
+ * coefficients, to the bin of the thread owning the band.  The bins are
+ * rendered at the end of every vbuf draw call, before any state can
+ * change, and also whenever they fill up.
+ *
+ * Bands rather than square tiles because a batch from setup spans a
+ * single quad row and the depth stage interpolates Z relative to the
+ * first quad of the batch; keeping the batches intact keeps the output
+ * bit-for-bit identical to the single-threaded path.
+ *
+ * Every thread has its own quad stages, fragment shader machine, color
+ * and depth tile caches and texture tile caches, and renders against a
+ * private snapshot of the context state, taken just before the bins are
+ * run, so the quad stages don't need to know about threads at all.
+ * A thread only ever touches the tiles of its own bands, so its tile
+ * caches can hold on to them across draw calls.  The context's own tile
+ * caches keep track of pending clears: their clear flags are copied to
+ * the threads before rendering and the flags of the tiles the threads
+ * cleared are folded back afterwards.
+ */
+
+#include "pipe/p_defines.h"
+#include "os/os_thread.h"
+#include "util/u_debug.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "tgsi/tgsi_exec.h"
+#include "sp_context.h"
+#include "sp_flush.h"
+#include "sp_quad.h"
+#include "sp_quad_pipe.h"
+#include "sp_state.h"
+#include "sp_tex_sample.h"
+#include "sp_tex_tile_cache.h"
+#include "sp_texture.h"
+#include "sp_tile_cache.h"
+#include "sp_tile_threads.h"
+
+
+/** Batch size limit, as in sp_setup.c */
+#define BIN_BATCH_QUADS 16
+
+/** Bin sizes, per thread */
+#define BIN_BATCHES 1024
+#define BIN_QUADS   4096
+
+/** Coefficients stored for all the binned primitives */
+#define BIN_COEFS   (16 * 1024)
+
+
+struct sp_binned_batch
+{
+   const struct tgsi_interp_coef *coef;  /**< posCoef, then the inputs' */
+   unsigned first_quad;
+   unsigned nr_quads;
+};
+
+
+struct sp_binned_quad
+{
+   struct quad_header_input input;
+   unsigned mask;
+};
+
+
+struct sp_tile_thread
+{
+   struct sp_tile_threads *pool;
+   pipe_semaphore work_ready;
+   pipe_semaphore work_done;
+   pipe_thread thread;
+
+   /**
+    * The state the quad stages of this thread see.  A plain copy of the
+    * context, which holds no references, with the caches, the machine
+    * and the fragment samplers replaced by the thread's own.
+    */
+   struct softpipe_context sp;
+
+   struct quad_stage *shade;
+   struct quad_stage *depth_test;
+   struct quad_stage *blend;
+   struct quad_stage *pstipple;
+   struct tgsi_exec_machine *fs_machine;
+
+   struct softpipe_tile_cache *cbuf_cache[PIPE_MAX_COLOR_BUFS];
+   struct softpipe_tile_cache *zsbuf_cache;
+   struct softpipe_tex_tile_cache *tex_cache[PIPE_MAX_SAMPLERS];
+   struct sp_sampler_variant samplers[PIPE_MAX_SAMPLERS];
+
+   struct sp_binned_batch batches[BIN_BATCHES];
+   struct sp_binned_quad quads[BIN_QUADS];
+   unsigned nr_batches;
+   unsigned nr_quads;
+
+   struct quad_header quad[BIN_BATCH_QUADS];
+   struct quad_header *quad_ptrs[BIN_BATCH_QUADS];
+};
+
+
+struct sp_tile_threads
+{
+   struct softpipe_context *softpipe;
+   unsigned num_threads;      /**< including the calling thread */
+   boolean exit_flag;
+
+   struct tgsi_interp_coef *coefs;
+   unsigned nr_coefs;
+
+   /** Coefficients of the current primitive, if binned already */
+   const struct tgsi_interp_coef *prim_coef;
+
+   struct sp_tile_thread *threads[SP_MAX_THREADS];
+};
+
+
+/**
+ * Run all the batches in a thread's bin through its quad pipeline.
+ */
+static void
+render_bin(struct sp_tile_thread *thread)
+{
+   struct quad_stage *first = thread->sp.quad.first;
+   unsigned i, j;
+
+   for (i = 0; i < thread->nr_batches; i++) {
+      const struct sp_binned_batch *batch = &thread->batches[i];
+      const struct sp_binned_quad *binned = &thread->quads[batch->first_quad];
+
+      for (j = 0; j < batch->nr_quads; j++) {
+         struct quad_header *quad = &thread->quad[j];
+
+         quad->input = binned[j].input;
+         quad->inout.mask = binned[j].mask;
+         quad->posCoef = batch->coef;
+         quad->coef = batch->coef + 1;
+         thread->quad_ptrs[j] = quad;
+      }
+
+      first->run(first, thread->quad_ptrs, batch->nr_quads);
+   }
+}
+
+
+static PIPE_THREAD_ROUTINE( thread_function, init_data )
+{
+   struct sp_tile_thread *thread = (struct sp_tile_thread *) init_data;
+   struct sp_tile_threads *pool = thread->pool;
+
+   while (1) {
+      pipe_semaphore_wait(&thread->work_ready);
+
+      if (pool->exit_flag)
+         break;
+
+      render_bin(thread);
+
+      pipe_semaphore_signal(&thread->work_done);
+   }
+
+   return NULL;
+}
+
+
+static void
+destroy_thread(struct sp_tile_thread *thread)
+{
+   unsigned i;
+
+   if (thread->shade)
+      thread->shade->destroy(thread->shade);
+   if (thread->depth_test)
+      thread->depth_test->destroy(thread->depth_test);
+   if (thread->blend)
+      thread->blend->destroy(thread->blend);
+   if (thread->pstipple)
+      thread->pstipple->destroy(thread->pstipple);
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++)
+      sp_destroy_tile_cache(thread->cbuf_cache[i]);
+   sp_destroy_tile_cache(thread->zsbuf_cache);
+
+   for (i = 0; i < PIPE_MAX_SAMPLERS; i++) {
+      if (thread->tex_cache[i]) {
+         sp_tex_tile_cache_set_sampler_view(thread->tex_cache[i], NULL);
+         sp_destroy_tex_tile_cache(thread->tex_cache[i]);
+      }
+   }
+
+   if (thread->fs_machine)
+      tgsi_exec_machine_destroy(thread->fs_machine);
+
+   FREE(thread);
+}
+
+
+static struct sp_tile_thread *
+create_thread(struct sp_tile_threads *pool)
+{
+   struct pipe_context *pipe = &pool->softpipe->pipe;
+   struct sp_tile_thread *thread = CALLOC_STRUCT(sp_tile_thread);
+   unsigned i;
+
+   if (!thread)
+      return NULL;
+
+   thread->pool = pool;
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++) {
+      thread->cbuf_cache[i] = sp_create_tile_cache(pipe);
+      if (!thread->cbuf_cache[i])
+         goto fail;
+   }
+   thread->zsbuf_cache = sp_create_tile_cache(pipe);
+   if (!thread->zsbuf_cache)
+      goto fail;
+
+   thread->fs_machine = tgsi_exec_machine_create();
+   if (!thread->fs_machine)
+      goto fail;
+
+   thread->shade = sp_quad_shade_stage(&thread->sp);
+   thread->depth_test = sp_quad_depth_test_stage(&thread->sp);
+   thread->blend = sp_quad_blend_stage(&thread->sp);
+   thread->pstipple = sp_quad_polygon_stipple_stage(&thread->sp);
+   if (!thread->shade || !thread->depth_test ||
+       !thread->blend || !thread->pstipple)
+      goto fail;
+
+   return thread;
+
+fail:
+   destroy_thread(thread);
+   return NULL;
+}
+
+
+/**
+ * Create the rendering threads.  Returns NULL unless more than one
+ * thread was asked for with SOFTPIPE_NUM_THREADS, in which case
+ * fragments are processed on the calling thread as usual.
+ */
+struct sp_tile_threads *
+sp_tile_threads_create(struct softpipe_context *softpipe)
+{
+   struct sp_tile_threads *pool;
+   unsigned num_threads;
+   unsigned i;
+
+   num_threads = debug_get_num_option("SOFTPIPE_NUM_THREADS", 1);
+   num_threads = MIN2(num_threads, SP_MAX_THREADS);
+   if (num_threads <= 1)
+      return NULL;
+
+   pool = CALLOC_STRUCT(sp_tile_threads);
+   if (!pool)
+      return NULL;
+
+   pool->softpipe = softpipe;
+
+   pool->coefs = MALLOC(BIN_COEFS * sizeof(struct tgsi_interp_coef));
+   if (!pool->coefs) {
+      FREE(pool);
+      return NULL;
+   }
+
+   for (i = 0; i < num_threads; i++) {
+      pool->threads[i] = create_thread(pool);
+      if (!pool->threads[i])
+         break;
+   }
+
+   /* Carry on with whatever could be created, the caller being thread 0 */
+   pool->num_threads = i;
+   if (pool->num_threads <= 1) {
+      sp_tile_threads_destroy(pool);
+      return NULL;
+   }
+
+   for (i = 1; i < pool->num_threads; i++) {
+      struct sp_tile_thread *thread = pool->threads[i];
+
+      pipe_semaphore_init(&thread->work_ready, 0);
+      pipe_semaphore_init(&thread->work_done, 0);
+      thread->thread = pipe_thread_create(thread_function, (void *) thread);
+   }
+
+   return pool;
+}
+
+
+void
+sp_tile_threads_destroy(struct sp_tile_threads *pool)
+{
+   unsigned i;
+
+   if (!pool)
+      return;
+
+   pool->exit_flag = TRUE;
+   for (i = 1; i < pool->num_threads; i++)
+      pipe_semaphore_signal(&pool->threads[i]->work_ready);
+
+   for (i = 1; i < pool->num_threads; i++) {
+      pipe_thread_wait(pool->threads[i]->thread);
+      pipe_semaphore_destroy(&pool->threads[i]->work_ready);
+      pipe_semaphore_destroy(&pool->threads[i]->work_done);
+   }
+
+   for (i = 0; i < SP_MAX_THREADS; i++) {
+      if (pool->threads[i])
+         destroy_thread(pool->threads[i]);
+   }
+
+   FREE(pool->coefs);
+   FREE(pool);
+}
+
+
+/**
+ * Called by setup once the coefficients of a new primitive are known.
+ */
+void
+sp_tile_threads_begin_prim(struct sp_tile_threads *pool)
+{
+   pool->prim_coef = NULL;
+}
+
+
+/**
+ * Add a batch of quads of the current primitive to the bin of the thread
+ * owning the band the batch lies in.
+ */
+void
+sp_tile_threads_bin_quads(struct sp_tile_threads *pool,
+                          struct quad_header *quads[],
+                          unsigned nr)
+{
+   const int band = quads[0]->input.y0 >> TILE_SIZE_LOG2;
+   struct sp_tile_thread *thread;
+   struct sp_binned_batch *batch;
+   unsigned i;
+
+   assert(band >= 0);
+   assert(nr <= BIN_BATCH_QUADS);
+
+   thread = pool->threads[band % pool->num_threads];
+
+   if (thread->nr_batches == BIN_BATCHES ||
+       thread->nr_quads + nr > BIN_QUADS ||
+       (!pool->prim_coef &&
+        pool->nr_coefs + PIPE_MAX_SHADER_INPUTS + 1 > BIN_COEFS)) {
+      sp_tile_threads_run(pool);
+   }
+
+   if (!pool->prim_coef) {
+      const unsigned nr_inputs = pool->softpipe->fs_variant->info.num_inputs;
+      struct tgsi_interp_coef *coef = pool->coefs + pool->nr_coefs;
+
+      coef[0] = *quads[0]->posCoef;
+      memcpy(coef + 1, quads[0]->coef, nr_inputs * sizeof coef[0]);
+
+      pool->nr_coefs += nr_inputs + 1;
+      pool->prim_coef = coef;
+   }
+
+   batch = &thread->batches[thread->nr_batches++];
+   batch->coef = pool->prim_coef;
+   batch->first_quad = thread->nr_quads;
+   batch->nr_quads = nr;
+
+   for (i = 0; i < nr; i++) {
+      struct sp_binned_quad *binned = &thread->quads[thread->nr_quads++];
+
+      binned->input = quads[i]->input;
+      binned->mask = quads[i]->inout.mask;
+   }
+}
+
+
+/**
+ * Take a snapshot of the context state for a thread about to render its
+ * bin, and bring its caches up to date.
+ */
+static void
+prepare_thread(struct sp_tile_threads *pool, struct sp_tile_thread *thread)
+{
+   struct softpipe_context *softpipe = pool->softpipe;
+   struct softpipe_context *sp = &thread->sp;
+   unsigned i;
+
+   memcpy(sp, softpipe, sizeof *sp);
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++)
+      sp->cbuf_cache[i] = thread->cbuf_cache[i];
+   sp->zsbuf_cache = thread->zsbuf_cache;
+
+   for (i = 0; i < softpipe->framebuffer.nr_cbufs; i++)
+      sp_tile_cache_copy_clear(thread->cbuf_cache[i], softpipe->cbuf_cache[i]);
+   if (softpipe->framebuffer.zsbuf)
+      sp_tile_cache_copy_clear(thread->zsbuf_cache, softpipe->zsbuf_cache);
+
+   for (i = 0; i < PIPE_MAX_SAMPLERS; i++) {
+      const struct sp_sampler_variant *samp =
+         softpipe->tgsi.samplers_list[PIPE_SHADER_FRAGMENT][i];
+      struct pipe_sampler_view *view =
+         softpipe->sampler_views[PIPE_SHADER_FRAGMENT][i];
+      struct softpipe_tex_tile_cache *tc;
+
+      sp->tgsi.samplers_list[PIPE_SHADER_FRAGMENT][i] = NULL;
+
+      if (!samp || !view)
+         continue;
+
+      if (!thread->tex_cache[i]) {
+         thread->tex_cache[i] = sp_create_tex_tile_cache(&softpipe->pipe);
+         if (!thread->tex_cache[i])
+            continue;
+      }
+
+      tc = thread->tex_cache[i];
+      sp_tex_tile_cache_set_sampler_view(tc, view);
+      if (softpipe_resource(tc->texture)->timestamp != tc->timestamp) {
+         sp_tex_tile_cache_validate_texture(tc);
+         tc->timestamp = softpipe_resource(tc->texture)->timestamp;
+      }
+
+      thread->samplers[i] = *samp;
+      sp_sampler_variant_bind_view(&thread->samplers[i], tc, view);
+      sp->tgsi.samplers_list[PIPE_SHADER_FRAGMENT][i] = &thread->samplers[i];
+   }
+
+   sp->fs_machine = thread->fs_machine;
+   sp->occlusion_count = 0;
+
+   sp->quad.shade = thread->shade;
+   sp->quad.depth_test = thread->depth_test;
+   sp->quad.blend = thread->blend;
+   sp->quad.pstipple = thread->pstipple;
+   sp_build_quad_pipeline(sp);
+   sp->quad.first->begin(sp->quad.first);
+}
+
+
+/**
+ * Fold the results of a thread's rendering back into the context.
+ */
+static void
+finish_thread(struct sp_tile_threads *pool, struct sp_tile_thread *thread)
+{
+   struct softpipe_context *softpipe = pool->softpipe;
+   unsigned i;
+
+   softpipe->occlusion_count += thread->sp.occlusion_count;
+
+   for (i = 0; i < softpipe->framebuffer.nr_cbufs; i++)
+      sp_tile_cache_merge_clear(softpipe->cbuf_cache[i], thread->cbuf_cache[i]);
+   if (softpipe->framebuffer.zsbuf)
+      sp_tile_cache_merge_clear(softpipe->zsbuf_cache, thread->zsbuf_cache);
+
+   thread->nr_batches = 0;
+   thread->nr_quads = 0;
+}
+
+
+/**
+ * Render everything binned so far, and wait for it.
+ */
+void
+sp_tile_threads_run(struct sp_tile_threads *pool)
+{
+   unsigned i;
+
+   if (!pool->nr_coefs)
+      return;
+
+   for (i = 0; i < pool->num_threads; i++) {
+      if (pool->threads[i]->nr_batches)
+         prepare_thread(pool, pool->threads[i]);
+   }
+
+   for (i = 1; i < pool->num_threads; i++) {
+      if (pool->threads[i]->nr_batches)
+         pipe_semaphore_signal(&pool->threads[i]->work_ready);
+   }
+
+   render_bin(pool->threads[0]);
+
+   for (i = 1; i < pool->num_threads; i++) {
+      if (pool->threads[i]->nr_batches)
+         pipe_semaphore_wait(&pool->threads[i]->work_done);
+   }
+
+   for (i = 0; i < pool->num_threads; i++) {
+      if (pool->threads[i]->nr_batches)
+         finish_thread(pool, pool->threads[i]);
+   }
+
+   pool->nr_coefs = 0;
+   pool->prim_coef = NULL;
+}
+
+
+/**
+ * Mirror softpipe_clear() on the threads' tile caches, which may hold
+ * tiles rendered before the clear.
+ */
+void
+sp_tile_threads_clear(struct sp_tile_threads *pool,
+                      unsigned buffers,
+                      const union pipe_color_union *color,
+                      uint64_t clear_val)
+{
+   static const union pipe_color_union zero;
+   const struct pipe_framebuffer_state *fb = &pool->softpipe->framebuffer;
+   unsigned i, j;
+
+   for (i = 0; i < pool->num_threads; i++) {
+      struct sp_tile_thread *thread = pool->threads[i];
+
+      if (buffers & PIPE_CLEAR_COLOR) {
+         for (j = 0; j < fb->nr_cbufs; j++)
+            sp_tile_cache_clear(thread->cbuf_cache[j], color, 0);
+      }
+
+      if (buffers & PIPE_CLEAR_DEPTHSTENCIL)
+         sp_tile_cache_clear(thread->zsbuf_cache, &zero, clear_val);
+   }
+}
+
+
+/**
+ * Write back a thread's tiles.  The clears still pending are the business
+ * of the context's cache, whose flags are up to date, while the thread's
+ * copy may flag tiles another thread has rendered since.
+ */
+static void
+flush_tile_cache(struct softpipe_tile_cache *tc)
+{
+   memset(tc->clear_flags, 0, sizeof(tc->clear_flags));
+   sp_flush_tile_cache(tc);
+}
+
+
+/**
+ * Mirror softpipe_flush() on the threads' caches.
+ */
+void
+sp_tile_threads_flush(struct sp_tile_threads *pool, unsigned flags)
+{
+   const struct pipe_framebuffer_state *fb = &pool->softpipe->framebuffer;
+   unsigned i, j;
+
+   for (i = 0; i < pool->num_threads; i++) {
+      struct sp_tile_thread *thread = pool->threads[i];
+
+      if (flags & SP_FLUSH_TEXTURE_CACHE) {
+         for (j = 0; j < PIPE_MAX_SAMPLERS; j++) {
+            if (thread->tex_cache[j])
+               sp_flush_tex_tile_cache(thread->tex_cache[j]);
+         }
+      }
+
+      for (j = 0; j < fb->nr_cbufs; j++)
+         flush_tile_cache(thread->cbuf_cache[j]);
+
+      flush_tile_cache(thread->zsbuf_cache);
+   }
+}
+
+
+/**
+ * Point the threads' tile caches at the current framebuffer surfaces,
+ * flushing the ones which change.
+ */
+void
+sp_tile_threads_set_framebuffer(struct sp_tile_threads *pool,
+                                const struct pipe_framebuffer_state *fb)
+{
+   unsigned i, j;
+
+   for (i = 0; i < pool->num_threads; i++) {
+      struct sp_tile_thread *thread = pool->threads[i];
+
+      for (j = 0; j < PIPE_MAX_COLOR_BUFS; j++) {
+         struct pipe_surface *cb = j < fb->nr_cbufs ? fb->cbufs[j] : NULL;
+
+         if (sp_tile_cache_get_surface(thread->cbuf_cache[j]) != cb) {
+            flush_tile_cache(thread->cbuf_cache[j]);
+            sp_tile_cache_set_surface(thread->cbuf_cache[j], cb);
+         }
+      }
+
+      if (sp_tile_cache_get_surface(thread->zsbuf_cache) != fb->zsbuf) {
+         flush_tile_cache(thread->zsbuf_cache);
+         sp_tile_cache_set_surface(thread->zsbuf_cache, fb->zsbuf);
+      }
+   }
+}
+
+
+void
+sp_tile_threads_map_transfers(struct sp_tile_threads *pool)
+{
+   const struct pipe_framebuffer_state *fb = &pool->softpipe->framebuffer;
+   unsigned i, j;
+
+   for (i = 0; i < pool->num_threads; i++) {
+      for (j = 0; j < fb->nr_cbufs; j++)
+         sp_tile_cache_map_transfers(pool->threads[i]->cbuf_cache[j]);
+
+      sp_tile_cache_map_transfers(pool->threads[i]->zsbuf_cache);
+   }
+}
+
+
+void
+sp_tile_threads_unmap_transfers(struct sp_tile_threads *pool)
+{
+   const struct pipe_framebuffer_state *fb = &pool->softpipe->framebuffer;
+   unsigned i, j;
+
+   for (i = 0; i < pool->num_threads; i++) {
+      for (j = 0; j < fb->nr_cbufs; j++)
+         sp_tile_cache_unmap_transfers(pool->threads[i]->cbuf_cache[j]);
+
+      sp_tile_cache_unmap_transfers(pool->threads[i]->zsbuf_cache);
+   }
+}
+
+
+/**
+ * Unbind a fragment shader being deleted from the threads' machines.
+ */
+void
+sp_tile_threads_unbind_shader(struct sp_tile_threads *pool,
+                              const struct tgsi_token *tokens)
+{
+   unsigned i;
+
+   for (i = 0; i < pool->num_threads; i++) {
+      struct tgsi_exec_machine *machine = pool->threads[i]->fs_machine;
+
+      if (machine->Tokens == tokens)
+         tgsi_exec_machine_bind_shader(machine, NULL, 0, NULL);
+   }
+}
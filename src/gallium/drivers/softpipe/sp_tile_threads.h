@@ -0,0 +1,96 @@
+/**************************************************************************
+ *
+ * Copyright 2013 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * Binned, multi-threaded fragment processing for softpipe.
+ *
+ * Setup bins the quads it generates by screen tile row and, at the end
+ * of each vbuf draw call, every thread runs its bin through its own quad
+ * pipeline and tile caches.
+ */
+
+#ifndef SP_TILE_THREADS_H
+#define SP_TILE_THREADS_H
+
+#include "pipe/p_compiler.h"
+
+
+/** Upper bound on the rendering threads, including the caller's */
+#define SP_MAX_THREADS 8
+
+
+struct softpipe_context;
+struct pipe_framebuffer_state;
+struct quad_header;
+struct tgsi_token;
+union pipe_color_union;
+struct sp_tile_threads;
+
+
+struct sp_tile_threads *
+sp_tile_threads_create(struct softpipe_context *softpipe);
+
+void
+sp_tile_threads_destroy(struct sp_tile_threads *threads);
+
+void
+sp_tile_threads_begin_prim(struct sp_tile_threads *threads);
+
+void
+sp_tile_threads_bin_quads(struct sp_tile_threads *threads,
+                          struct quad_header *quads[],
+                          unsigned nr);
+
+void
+sp_tile_threads_run(struct sp_tile_threads *threads);
+
+void
+sp_tile_threads_clear(struct sp_tile_threads *threads,
+                      unsigned buffers,
+                      const union pipe_color_union *color,
+                      uint64_t clear_val);
+
+void
+sp_tile_threads_flush(struct sp_tile_threads *threads, unsigned flags);
+
+void
+sp_tile_threads_set_framebuffer(struct sp_tile_threads *threads,
+                                const struct pipe_framebuffer_state *fb);
+
+void
+sp_tile_threads_map_transfers(struct sp_tile_threads *threads);
+
+void
+sp_tile_threads_unmap_transfers(struct sp_tile_threads *threads);
+
+void
+sp_tile_threads_unbind_shader(struct sp_tile_threads *threads,
+                              const struct tgsi_token *tokens);
+
+
+#endif /* SP_TILE_THREADS_H */
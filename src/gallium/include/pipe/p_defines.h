@@ -390,6 +390,9 @@ enum pipe_transfer_usage {
 #define PIPE_QUERY_PIPELINE_STATISTICS  10
 #define PIPE_QUERY_TYPES                11
 
+/* start of driver queries, see pipe_screen::get_driver_query_info */
+#define PIPE_QUERY_DRIVER_SPECIFIC     256
+
 
 /**
  * Conditional rendering modes
@@ -629,6 +632,17 @@ union pipe_query_result
    struct pipe_query_data_pipeline_statistics pipeline_statistics;
 };
 
+/**
+ * Description of a driver-specific query.
+ */
+struct pipe_driver_query_info
+{
+   const char *name;
+   unsigned query_type;  /**< PIPE_QUERY_DRIVER_SPECIFIC + i */
+   uint64_t max_value;   /**< max value that can be returned */
+   boolean uses_byte_units;  /**< whether the result is in bytes */
+};
+
 union pipe_color_union
 {
    float f[4];
@@ -206,6 +206,19 @@ struct pipe_screen {
                             struct pipe_fence_handle *fence,
                             uint64_t timeout );
 
+   /**
+    * Describe a driver-specific query.
+    *
+    * If \p info is NULL, the number of available queries is returned.
+    * Otherwise, the driver query at the specified \p index is returned
+    * in \p info.  The function returns non-zero on success.
+    * The queries are created with pipe_context::create_query using
+    * pipe_driver_query_info::query_type.
+    */
+   int (*get_driver_query_info)(struct pipe_screen *screen,
+                                unsigned index,
+                                struct pipe_driver_query_info *info);
+
 };
 
 
@@ -442,7 +442,10 @@ struct radeon_winsys *radeon_drm_winsys_create(int fd)
     ws->kman = radeon_bomgr_create(ws);
     if (!ws->kman)
         goto fail;
-    ws->cman = pb_cache_manager_create(ws->kman, 1000000);
+    /* Don't keep more than an eighth of the memory in the cache. */
+    ws->cman = pb_cache_manager_create(ws->kman, 1000000,
+                                       ((uint64_t)ws->info.vram_size +
+                                        ws->info.gart_size) / 8);
     if (!ws->cman)
         goto fail;
 
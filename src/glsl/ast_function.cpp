@@ -25,6 +25,7 @@
 #include "ast.h"
 #include "glsl_types.h"
 #include "ir.h"
+#include "builtin_library.h"
 #include "main/core.h" /* for MIN2 */
 
 static ir_rvalue *
@@ -318,6 +319,7 @@ match_function_by_name(const char *name,
    ir_function *f = state->symbols->get_function(name);
    ir_function_signature *local_sig = NULL;
    ir_function_signature *sig = NULL;
+   gl_shader *builtin_sh = NULL;
 
    /* Is the function hidden by a record type constructor? */
    if (state->symbols->get_type(name))
@@ -361,6 +363,7 @@ match_function_by_name(const char *name,
       /* If the built-in signature is exact, we can stop. */
       if (is_exact) {
 	 sig = builtin_sig;
+	 builtin_sh = state->builtins_to_link[i];
 	 goto done;
       }
 
@@ -369,13 +372,20 @@ match_function_by_name(const char *name,
 	  * we should keep searching for an exact match.
 	  */
 	 sig = builtin_sig;
+	 builtin_sh = state->builtins_to_link[i];
       }
    }
 
 done:
    if (sig != NULL) {
-      /* If the match is from a linked built-in shader, import the prototype. */
+      /* If the match is from a linked built-in shader, import the prototype.
+       * The body of the built-in is needed too, in case the call can be
+       * evaluated as a constant expression.
+       */
       if (sig != local_sig) {
+	 if (builtin_sh != NULL)
+	    load_builtin_function(builtin_sh, sig->function());
+
 	 if (f == NULL) {
 	    f = new(ctx) ir_function(name);
 	    state->symbols->add_global_function(f);
@@ -0,0 +1,242 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file builtin_library.cpp
+ *
+ * A library is laid out as:
+ *
+ * - the declarations of the profile, as written by
+ *   \c serialize_declarations,
+ * - the number of functions in the declarations,
+ * - the offset and size of the bodies of each function, in the order the
+ *   functions appear in the declarations,
+ * - the bodies, as written by \c serialize_function_bodies.
+ */
+
+#include "main/core.h"
+#include "main/shaderobj.h"
+#include "glsl_symbol_table.h"
+#include "builtin_library.h"
+#include "program/hash_table.h"
+#include "glapi/glthread.h"
+
+/**
+ * Serializes the loading of function bodies.  Libraries are shared by all
+ * the shaders being compiled, possibly on several threads.
+ */
+_glthread_DECLARE_STATIC_MUTEX(builtin_library_mutex);
+
+static void
+load_function(gl_shader *sh, const ir_function *f);
+
+struct builtin_function_entry {
+   ir_function *function;
+   uint32_t offset;
+   uint32_t size;
+   bool loaded;
+};
+
+struct builtin_library {
+   /** Map from ir_function to builtin_function_entry */
+   struct hash_table *functions;
+
+   const uint8_t *bodies;
+   size_t bodies_size;
+};
+
+
+bool
+serialize_builtin_library(memory_writer &blob, exec_list *instructions)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   memory_writer bodies(mem_ctx);
+   unsigned num_functions = 0;
+
+   if (!serialize_declarations(blob, instructions)) {
+      ralloc_free(mem_ctx);
+      return false;
+   }
+
+   foreach_list(node, instructions) {
+      if (((ir_instruction *) node)->as_function() != NULL)
+         num_functions++;
+   }
+   blob.write_uint32(num_functions);
+
+   foreach_list(node, instructions) {
+      ir_function *const f = ((ir_instruction *) node)->as_function();
+      if (f == NULL)
+         continue;
+
+      const size_t offset = bodies.size;
+      if (!serialize_function_bodies(bodies, instructions, f)) {
+         ralloc_free(mem_ctx);
+         return false;
+      }
+
+      blob.write_uint32(offset);
+      blob.write_uint32(bodies.size - offset);
+   }
+
+   blob.write(bodies.data, bodies.size);
+
+   ralloc_free(mem_ctx);
+   return true;
+}
+
+
+static void
+destroy_builtin_library(void *ptr)
+{
+   hash_table_dtor(((builtin_library *) ptr)->functions);
+}
+
+gl_shader *
+read_builtin_library(GLenum target, const uint8_t *data, size_t size)
+{
+   gl_shader *sh = _mesa_new_shader(NULL, 0, target);
+   memory_reader blob(data, size);
+
+   sh->ir = new(sh) exec_list;
+   sh->symbols = new(sh) glsl_symbol_table;
+   sh->symbols->language_version = 140;
+
+   if (!deserialize_ir(blob, sh, sh->ir))
+      goto fail;
+
+   builtin_library *lib;
+   lib = ralloc(sh, builtin_library);
+   lib->functions = hash_table_ctor(0, hash_table_pointer_hash,
+                                    hash_table_pointer_compare);
+   ralloc_set_destructor(lib, destroy_builtin_library);
+   sh->builtin_library = lib;
+
+   uint32_t num_functions;
+   num_functions = blob.read_uint32();
+
+   builtin_function_entry *entries;
+   entries = rzalloc_array(lib, builtin_function_entry, num_functions);
+
+   foreach_list(node, sh->ir) {
+      ir_instruction *const ir = (ir_instruction *) node;
+      ir_variable *const var = ir->as_variable();
+      ir_function *const f = ir->as_function();
+
+      if (var != NULL) {
+         sh->symbols->add_variable(var);
+      } else if (f != NULL) {
+         if (num_functions == 0)
+            goto fail;
+
+         entries->function = f;
+         entries->offset = blob.read_uint32();
+         entries->size = blob.read_uint32();
+         hash_table_insert(lib->functions, entries, f);
+         sh->symbols->add_function(f);
+
+         entries++;
+         num_functions--;
+      }
+   }
+
+   if (blob.failed || num_functions != 0)
+      goto fail;
+
+   lib->bodies = blob.current;
+   lib->bodies_size = blob.end - blob.current;
+
+   return sh;
+
+fail:
+   assert(!"Corrupt built-in function library");
+   ralloc_free(sh);
+   return NULL;
+}
+
+
+namespace {
+
+/**
+ * Loads the functions that are called by the instructions it visits.
+ */
+class builtin_call_visitor : public ir_hierarchical_visitor {
+public:
+   builtin_call_visitor(gl_shader *sh)
+      : sh(sh)
+   {
+   }
+
+   virtual ir_visitor_status visit_enter(ir_call *ir)
+   {
+      load_function(this->sh, ir->callee->function());
+      return visit_continue;
+   }
+
+   gl_shader *sh;
+};
+
+} /* anonymous namespace */
+
+void
+load_builtin_function(gl_shader *sh, const ir_function *f)
+{
+   if (sh->builtin_library == NULL)
+      return;
+
+   _glthread_LOCK_MUTEX(builtin_library_mutex);
+   load_function(sh, f);
+   _glthread_UNLOCK_MUTEX(builtin_library_mutex);
+}
+
+static void
+load_function(gl_shader *sh, const ir_function *f)
+{
+   builtin_library *const lib = sh->builtin_library;
+
+   builtin_function_entry *const entry =
+      (builtin_function_entry *) hash_table_find(lib->functions, f);
+   if (entry == NULL || entry->loaded)
+      return;
+
+   /* Mark the function as loaded first, in case it ends up calling itself
+    * through the functions it calls.
+    */
+   entry->loaded = true;
+
+   if (entry->offset > lib->bodies_size
+       || entry->size > lib->bodies_size - entry->offset) {
+      assert(!"Corrupt built-in function library");
+      return;
+   }
+
+   memory_reader blob(lib->bodies + entry->offset, entry->size);
+   if (!deserialize_function_bodies(blob, sh, sh->ir, entry->function)) {
+      assert(!"Corrupt built-in function library");
+      return;
+   }
+
+   builtin_call_visitor v(sh);
+   foreach_list(node, &entry->function->signatures)
+      v.run(&((ir_function_signature *) node)->body);
+}
@@ -0,0 +1,76 @@
+/* -*- c++ -*- */
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+#ifndef BUILTIN_LIBRARY_H
+#define BUILTIN_LIBRARY_H
+
+/**
+ * \file builtin_library.h
+ *
+ * Precompiled libraries of built-in functions.
+ *
+ * builtin_compiler turns each built-in profile into a library of serialized
+ * IR, which generate_builtins.py embeds in builtin_function.cpp.  At run
+ * time, only the declarations of a library are read up front.  The body of a
+ * function is read the first time a shader calls it, by
+ * \c load_builtin_function.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ir.h"
+#include "ir_serialize.h"
+
+struct gl_shader;
+
+/**
+ * Serialize a built-in profile
+ *
+ * \param instructions  The prototypes of the profile, followed by the
+ *                      definitions of its functions, as built by the IR
+ *                      reader.
+ */
+extern bool
+serialize_builtin_library(memory_writer &blob, exec_list *instructions);
+
+/**
+ * Read the declarations of a library written by \c serialize_builtin_library
+ *
+ * \c data must stay around for as long as the returned shader.
+ */
+extern gl_shader *
+read_builtin_library(GLenum target, const uint8_t *data, size_t size);
+
+/**
+ * Make sure the body of function \c f is available
+ *
+ * The bodies of the functions that \c f calls are loaded as well.  Does
+ * nothing if \c sh is not a built-in library, or if the function has already
+ * been loaded.
+ */
+extern void
+load_builtin_function(gl_shader *sh, const ir_function *f);
+
+#endif /* BUILTIN_LIBRARY_H */
@@ -4,7 +4,9 @@
 from __future__ import with_statement
 
 import re
+import shutil
 import sys
+import tempfile
 from glob import glob
 from os import path
 from subprocess import Popen, PIPE
@@ -48,27 +50,19 @@ def get_builtin_definitions():
     read_glsl_files(fs)
     return fs
 
-def stringify(s):
-    # Work around MSVC's 65535 byte limit by outputting an array of characters
-    # rather than actual string literals.
-    if len(s) >= 65535:
-        #t = "/* Warning: length " + repr(len(s)) + " too large */\n"
-        t = ""
-        for c in re.sub('\s\s+', ' ', s):
-            if c == '\n':
-                t += '\n'
-            else:
-                t += "'" + c + "',"
-        return '{' + t[:-1] + '}'
-
-    t = s.replace('\\', '\\\\').replace('"', '\\"').replace('\n', '\\n"\n   "')
-    return '   "' + t + '"\n'
-
-def write_function_definitions():
-    fs = get_builtin_definitions()
-    for k, v in sorted(fs.iteritems()):
-        print 'static const char builtin_' + k + '[] ='
-        print stringify(v), ';'
+# Format binary data as the contents of a C array initializer.
+def bytes_to_c(data):
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append('   ' + ' '.join(['0x%02x,' % ord(c) for c in data[i:i+16]]))
+    return '\n'.join(lines)
+
+# Write each builtin definition to a file in tmpdir, for the compiler to
+# read.
+def write_function_definitions(fs, tmpdir):
+    for k, v in fs.iteritems():
+        with open(path.join(tmpdir, k + '.ir'), 'w') as f:
+            f.write(v)
 
 def run_compiler(args):
     command = [compiler, '--dump-hir'] + args
@@ -96,32 +90,64 @@ def run_compiler(args):
 
     return (output, p.returncode)
 
-def write_profile(filename, profile):
+# Have the compiler build the library of a profile, out of its prototypes and
+# the definitions of the functions they reference.  Returns None on failure.
+def build_library(proto_ir, function_names, tmpdir):
+    protos = path.join(tmpdir, 'prototypes.ir')
+    output = path.join(tmpdir, 'library.bin')
+
+    with open(protos, 'w') as f:
+        f.write(proto_ir)
+
+    command = [compiler, '--serialize-builtins', output, protos]
+    for func in sorted(function_names):
+        command.append(path.join(tmpdir, func + '.ir'))
+
+    p = Popen(command, 1, stdout=PIPE, shell=False)
+    log = p.communicate()[0]
+
+    if (p.returncode):
+        sys.stderr.write("Failed to serialize builtins with command:\n")
+        for arg in command:
+            sys.stderr.write(arg + " ")
+        sys.stderr.write("\n")
+        sys.stderr.write("Result:\n")
+        sys.stderr.write(log)
+        return None
+
+    with open(output, 'rb') as f:
+        return f.read()
+
+def write_profile(filename, profile, tmpdir):
     (proto_ir, returncode) = run_compiler([filename])
 
     if returncode != 0:
         print '#error builtins profile', profile, 'failed to compile'
         return
 
-    print 'static const char prototypes_for_' + profile + '[] ='
-    print stringify(proto_ir), ';'
-
-    # Print a table of all the functions (not signatures) referenced.
-    # This is done so we can avoid bothering with a hash table in the C++ code.
-
     function_names = set()
     for func in re.finditer(r'\(function (.+)\n', proto_ir):
         function_names.add(func.group(1))
 
-    print 'static const char *functions_for_' + profile + ' [] = {'
-    for func in sorted(function_names):
-        print '   builtin_' + func + ','
+    library = build_library(proto_ir, function_names, tmpdir)
+    if library is None:
+        print '#error builtins profile', profile, 'failed to serialize'
+        return
+
+    print 'static const uint8_t library_for_' + profile + '[] = {'
+    print bytes_to_c(library)
     print '};'
 
 def write_profiles():
-    profiles = get_profile_list()
-    for (filename, profile) in profiles:
-        write_profile(filename, profile)
+    tmpdir = tempfile.mkdtemp()
+    try:
+        write_function_definitions(get_builtin_definitions(), tmpdir)
+
+        profiles = get_profile_list()
+        for (filename, profile) in profiles:
+            write_profile(filename, profile, tmpdir)
+    finally:
+        shutil.rmtree(tmpdir)
 
 def get_profile_list():
     profile_files = []
@@ -162,62 +188,10 @@ if __name__ == "__main__":
 #include <stdio.h>
 #include "main/core.h" /* for struct gl_shader */
 #include "glsl_parser_extras.h"
-#include "ir_reader.h"
-#include "program.h"
-#include "ast.h"
-
-extern "C" struct gl_shader *
-_mesa_new_shader(struct gl_context *ctx, GLuint name, GLenum type);
-
-gl_shader *
-read_builtins(GLenum target, const char *protos, const char **functions, unsigned count)
-{
-   struct gl_context fakeCtx;
-   fakeCtx.API = API_OPENGL;
-   fakeCtx.Const.GLSLVersion = 140;
-   fakeCtx.Extensions.ARB_ES2_compatibility = true;
-   fakeCtx.Const.ForceGLSLExtensionsWarn = false;
-   gl_shader *sh = _mesa_new_shader(NULL, 0, target);
-   struct _mesa_glsl_parse_state *st =
-      new(sh) _mesa_glsl_parse_state(&fakeCtx, target, sh);
-
-   st->language_version = 140;
-   st->symbols->language_version = 140;
-   st->ARB_texture_rectangle_enable = true;
-   st->EXT_texture_array_enable = true;
-   st->OES_EGL_image_external_enable = true;
-   st->ARB_shader_bit_encoding_enable = true;
-   _mesa_glsl_initialize_types(st);
-
-   sh->ir = new(sh) exec_list;
-   sh->symbols = st->symbols;
-
-   /* Read the IR containing the prototypes */
-   _mesa_glsl_read_ir(st, sh->ir, protos, true);
-
-   /* Read ALL the function bodies, telling the IR reader not to scan for
-    * prototypes (we've already created them).  The IR reader will skip any
-    * signature that does not already exist as a prototype.
-    */
-   for (unsigned i = 0; i < count; i++) {
-      _mesa_glsl_read_ir(st, sh->ir, functions[i], false);
-
-      if (st->error) {
-         printf("error reading builtin: %.35s ...\\n", functions[i]);
-         printf("Info log:\\n%s\\n", st->info_log);
-         ralloc_free(sh);
-         return NULL;
-      }
-   }
-
-   reparent_ir(sh->ir, sh);
-   delete st;
-
-   return sh;
-}
+#include "builtin_library.h"
+#include "glapi/glthread.h"
 """
 
-    write_function_definitions()
     write_profiles()
 
     profiles = get_profile_list()
@@ -227,25 +201,29 @@ read_builtins(GLenum target, const char *protos, const char **functions, unsigne
     print """
 static void *builtin_mem_ctx = NULL;
 
+/* Shaders may be compiled on several threads at once. */
+_glthread_DECLARE_STATIC_MUTEX(builtins_mutex);
+
 void
 _mesa_glsl_release_functions(void)
 {
+   _glthread_LOCK_MUTEX(builtins_mutex);
    ralloc_free(builtin_mem_ctx);
    builtin_mem_ctx = NULL;
    memset(builtin_profiles, 0, sizeof(builtin_profiles));
+   _glthread_UNLOCK_MUTEX(builtins_mutex);
 }
 
 static void
 _mesa_read_profile(struct _mesa_glsl_parse_state *state,
                    int profile_index,
-		   const char *prototypes,
-		   const char **functions,
-                   int count)
+                   const uint8_t *library,
+                   size_t size)
 {
    gl_shader *sh = builtin_profiles[profile_index];
 
    if (sh == NULL) {
-      sh = read_builtins(GL_VERTEX_SHADER, prototypes, functions, count);
+      sh = read_builtin_library(GL_VERTEX_SHADER, library, size);
       ralloc_steal(builtin_mem_ctx, sh);
       builtin_profiles[profile_index] = sh;
    }
@@ -261,6 +239,8 @@ _mesa_glsl_initialize_functions(struct _mesa_glsl_parse_state *state)
    if (state->num_builtins_to_link > 0)
       return;
 
+   _glthread_LOCK_MUTEX(builtins_mutex);
+
    if (builtin_mem_ctx == NULL) {
       builtin_mem_ctx = ralloc_context(NULL); // "GLSL built-in functions"
       memset(&builtin_profiles, 0, sizeof(builtin_profiles));
@@ -284,11 +264,11 @@ _mesa_glsl_initialize_functions(struct _mesa_glsl_parse_state *state)
 
         print '   if (' + check + ') {'
         print '      _mesa_read_profile(state, %d,' % i
-        print '                         prototypes_for_' + profile + ','
-        print '                         functions_for_' + profile + ','
-        print '                         Elements(functions_for_' + profile + '));'
+        print '                         library_for_' + profile + ','
+        print '                         sizeof(library_for_' + profile + '));'
         print '   }'
         print
         i = i + 1
+    print '   _glthread_UNLOCK_MUTEX(builtins_mutex);'
     print '}'
 
@@ -24,6 +24,7 @@
 #include <stdarg.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
 
 extern "C" {
 #include "main/core.h" /* for struct gl_context */
@@ -1007,6 +1008,179 @@ ast_struct_specifier::ast_struct_specifier(const char *identifier,
    this->declarations.push_degenerate_list_at_head(&declarator_list->link);
 }
 
+namespace {
+
+/**
+ * Bookkeeping for the passes run by do_common_optimization
+ *
+ * Every optimization pass is a function of the IR it is given.  If a pass ran
+ * without making progress, running it again before some other pass changed
+ * the IR is a waste of time.  The IR is versioned by \c generation, which is
+ * bumped each time a pass makes progress, and each pass remembers the
+ * generation at which it last found nothing to do.
+ */
+class common_optimization_state {
+public:
+   common_optimization_state()
+      : generation(1), num_passes(0), current(0), iterations(0)
+   {
+      memset(passes, 0, sizeof(passes));
+   }
+
+   struct pass_info {
+      const char *name;
+      unsigned runs;
+      unsigned skipped;
+      unsigned progress;
+      unsigned clean_generation;
+      clock_t time;
+   };
+
+   /** Start a sweep through the pass list. */
+   void begin_iteration()
+   {
+      current = 0;
+      iterations++;
+   }
+
+   /**
+    * Look up the next pass of the sweep
+    *
+    * Returns \c NULL if the pass can be skipped.
+    */
+   pass_info *begin_pass(const char *name)
+   {
+      assert(current < Elements(passes));
+      pass_info *const p = &passes[current++];
+
+      if (p->name == NULL) {
+         p->name = name;
+         num_passes = current;
+      }
+      assert(p->name == name);
+
+      if (p->clean_generation == generation) {
+         p->skipped++;
+         return NULL;
+      }
+
+      p->runs++;
+      p->time -= clock();
+      return p;
+   }
+
+   bool end_pass(pass_info *p, bool progress)
+   {
+      p->time += clock();
+
+      if (progress) {
+         p->progress++;
+         generation++;
+      } else {
+         p->clean_generation = generation;
+      }
+
+      return progress;
+   }
+
+   void print_stats() const
+   {
+      clock_t total = 0;
+
+      printf("GLSL optimizer: %u iterations\n", iterations);
+      printf("  %-32s %6s %6s %8s %10s\n",
+             "pass", "runs", "skips", "progress", "time (ms)");
+      for (unsigned i = 0; i < num_passes; i++) {
+         const pass_info *const p = &passes[i];
+
+         printf("  %-32s %6u %6u %8u %10.3f\n", p->name, p->runs, p->skipped,
+                p->progress, 1000.0 * p->time / CLOCKS_PER_SEC);
+         total += p->time;
+      }
+      printf("  %-32s %6s %6s %8s %10.3f\n", "total", "", "", "",
+             1000.0 * total / CLOCKS_PER_SEC);
+   }
+
+private:
+   unsigned generation;
+   unsigned num_passes;
+   unsigned current;
+   unsigned iterations;
+   pass_info passes[32];
+};
+
+} /* anonymous namespace */
+
+static bool
+do_loop_optimizations(exec_list *ir, unsigned max_unroll_iterations)
+{
+   bool progress = false;
+
+   loop_state *ls = analyze_loop_variables(ir);
+   if (ls->loop_found) {
+      progress = set_loop_controls(ir, ls) || progress;
+      progress = unroll_loops(ir, ls, max_unroll_iterations) || progress;
+   }
+   delete ls;
+
+   return progress;
+}
+
+static bool
+do_common_optimization_iteration(exec_list *ir, bool linked,
+                                 bool uniform_locations_assigned,
+                                 unsigned max_unroll_iterations,
+                                 common_optimization_state &state)
+{
+   bool progress = false;
+
+#define OPT(PASS, ...) do {                                             \
+      common_optimization_state::pass_info *const p =                  \
+         state.begin_pass(#PASS);                                       \
+      if (p != NULL)                                                    \
+         progress = state.end_pass(p, PASS(__VA_ARGS__)) || progress;   \
+   } while (false)
+
+   state.begin_iteration();
+
+   OPT(lower_instructions, ir, SUB_TO_ADD_NEG);
+
+   if (linked) {
+      OPT(do_function_inlining, ir);
+      OPT(do_dead_functions, ir);
+      OPT(do_structure_splitting, ir);
+   }
+   OPT(do_if_simplification, ir);
+   OPT(do_copy_propagation, ir);
+   OPT(do_copy_propagation_elements, ir);
+   if (linked)
+      OPT(do_dead_code, ir, uniform_locations_assigned);
+   else
+      OPT(do_dead_code_unlinked, ir);
+   OPT(do_dead_code_local, ir);
+   OPT(do_tree_grafting, ir);
+   OPT(do_constant_propagation, ir);
+   if (linked)
+      OPT(do_constant_variable, ir);
+   else
+      OPT(do_constant_variable_unlinked, ir);
+   OPT(do_constant_folding, ir);
+   OPT(do_algebraic, ir);
+   OPT(do_lower_jumps, ir);
+   OPT(do_vec_index_to_swizzle, ir);
+   OPT(do_swizzle_swizzle, ir);
+   OPT(do_noop_swizzle, ir);
+
+   OPT(optimize_split_arrays, ir, linked);
+   OPT(optimize_redundant_jumps, ir);
+
+   OPT(do_loop_optimizations, ir, max_unroll_iterations);
+
+#undef OPT
+
+   return progress;
+}
+
 /**
  * Do the set of common optimizations passes
  *
@@ -1029,45 +1203,43 @@ do_common_optimization(exec_list *ir, bool linked,
 		       bool uniform_locations_assigned,
 		       unsigned max_unroll_iterations)
 {
-   GLboolean progress = GL_FALSE;
+   common_optimization_state state;
 
-   progress = lower_instructions(ir, SUB_TO_ADD_NEG) || progress;
+   return do_common_optimization_iteration(ir, linked,
+                                           uniform_locations_assigned,
+                                           max_unroll_iterations, state);
+}
 
-   if (linked) {
-      progress = do_function_inlining(ir) || progress;
-      progress = do_dead_functions(ir) || progress;
-      progress = do_structure_splitting(ir) || progress;
-   }
-   progress = do_if_simplification(ir) || progress;
-   progress = do_copy_propagation(ir) || progress;
-   progress = do_copy_propagation_elements(ir) || progress;
-   if (linked)
-      progress = do_dead_code(ir, uniform_locations_assigned) || progress;
-   else
-      progress = do_dead_code_unlinked(ir) || progress;
-   progress = do_dead_code_local(ir) || progress;
-   progress = do_tree_grafting(ir) || progress;
-   progress = do_constant_propagation(ir) || progress;
-   if (linked)
-      progress = do_constant_variable(ir) || progress;
-   else
-      progress = do_constant_variable_unlinked(ir) || progress;
-   progress = do_constant_folding(ir) || progress;
-   progress = do_algebraic(ir) || progress;
-   progress = do_lower_jumps(ir) || progress;
-   progress = do_vec_index_to_swizzle(ir) || progress;
-   progress = do_swizzle_swizzle(ir) || progress;
-   progress = do_noop_swizzle(ir) || progress;
+/**
+ * Run the common optimization passes until none of them makes progress
+ *
+ * This gives the same result as calling \c do_common_optimization until it
+ * returns \c false, but the passes that found nothing to do are not run again
+ * until another pass has changed the IR.  Once only a couple of passes still
+ * make progress, each iteration is a lot cheaper than a full sweep.
+ *
+ * \param print_stats  Print the number of iterations and the number of runs,
+ *                     skips and successful runs of each pass, and the time
+ *                     spent in them.
+ *
+ * \return \c true if any progress was made.
+ */
+bool
+do_common_optimization_loop(exec_list *ir, bool linked,
+                            bool uniform_locations_assigned,
+                            unsigned max_unroll_iterations,
+                            bool print_stats)
+{
+   common_optimization_state state;
+   bool progress = false;
 
-   progress = optimize_split_arrays(ir, linked) || progress;
-   progress = optimize_redundant_jumps(ir) || progress;
+   while (do_common_optimization_iteration(ir, linked,
+                                           uniform_locations_assigned,
+                                           max_unroll_iterations, state))
+      progress = true;
 
-   loop_state *ls = analyze_loop_variables(ir);
-   if (ls->loop_found) {
-      progress = set_loop_controls(ir, ls) || progress;
-      progress = unroll_loops(ir, ls, max_unroll_iterations) || progress;
-   }
-   delete ls;
+   if (print_stats)
+      state.print_stats();
 
    return progress;
 }
@@ -31,11 +31,18 @@
 extern "C" {
 #include "program/hash_table.h"
 }
+#include "glapi/glthread.h"
 
 hash_table *glsl_type::array_types = NULL;
 hash_table *glsl_type::record_types = NULL;
 void *glsl_type::mem_ctx = NULL;
 
+/**
+ * Protects the type tables and \c glsl_type::mem_ctx, for shaders compiled
+ * on several threads.
+ */
+_glthread_DECLARE_STATIC_MUTEX(glsl_type_mutex);
+
 void
 glsl_type::init_ralloc_type_ctx(void)
 {
@@ -350,6 +357,8 @@ const glsl_type *glsl_type::get_scalar_type() const
 void
 _mesa_glsl_release_types(void)
 {
+   _glthread_LOCK_MUTEX(glsl_type_mutex);
+
    if (glsl_type::array_types != NULL) {
       hash_table_dtor(glsl_type::array_types);
       glsl_type::array_types = NULL;
@@ -359,6 +368,8 @@ _mesa_glsl_release_types(void)
       hash_table_dtor(glsl_type::record_types);
       glsl_type::record_types = NULL;
    }
+
+   _glthread_UNLOCK_MUTEX(glsl_type_mutex);
 }
 
 
@@ -450,9 +461,50 @@ glsl_type::get_instance(unsigned base_type, unsigned rows, unsigned columns)
 }
 
 
+const glsl_type *
+glsl_type::get_sampler_instance(enum glsl_sampler_dim dim, bool shadow,
+				bool array, unsigned type)
+{
+   static const struct {
+      const glsl_type *types;
+      unsigned count;
+   } lists[] = {
+      { builtin_core_types, Elements(builtin_core_types) },
+      { builtin_110_types, Elements(builtin_110_types) },
+      { &_sampler3D_type, 1 },
+      { builtin_130_types, Elements(builtin_130_types) },
+      { builtin_140_types, Elements(builtin_140_types) },
+      { builtin_ARB_texture_rectangle_types,
+	Elements(builtin_ARB_texture_rectangle_types) },
+      { builtin_EXT_texture_array_types,
+	Elements(builtin_EXT_texture_array_types) },
+      { builtin_EXT_texture_buffer_object_types,
+	Elements(builtin_EXT_texture_buffer_object_types) },
+      { builtin_OES_EGL_image_external_types,
+	Elements(builtin_OES_EGL_image_external_types) },
+   };
+
+   for (unsigned i = 0; i < Elements(lists); i++) {
+      for (unsigned j = 0; j < lists[i].count; j++) {
+	 const glsl_type *const t = &lists[i].types[j];
+
+	 if (t->base_type == GLSL_TYPE_SAMPLER
+	     && t->sampler_dimensionality == unsigned(dim)
+	     && t->sampler_shadow == unsigned(shadow)
+	     && t->sampler_array == unsigned(array)
+	     && t->sampler_type == type)
+	    return t;
+      }
+   }
+
+   return NULL;
+}
+
+
 const glsl_type *
 glsl_type::get_array_instance(const glsl_type *base, unsigned array_size)
 {
+   _glthread_LOCK_MUTEX(glsl_type_mutex);
 
    if (array_types == NULL) {
       array_types = hash_table_ctor(64, hash_table_string_hash,
@@ -474,6 +526,8 @@ glsl_type::get_array_instance(const glsl_type *base, unsigned array_size)
       hash_table_insert(array_types, (void *) t, ralloc_strdup(mem_ctx, key));
    }
 
+   _glthread_UNLOCK_MUTEX(glsl_type_mutex);
+
    assert(t->base_type == GLSL_TYPE_ARRAY);
    assert(t->length == array_size);
    assert(t->fields.array == base);
@@ -535,18 +589,26 @@ glsl_type::get_record_instance(const glsl_struct_field *fields,
 			       unsigned num_fields,
 			       const char *name)
 {
-   const glsl_type key(fields, num_fields, name);
+   const glsl_type *t;
 
-   if (record_types == NULL) {
-      record_types = hash_table_ctor(64, record_key_hash, record_key_compare);
-   }
+   /* Building the key allocates out of mem_ctx too. */
+   _glthread_LOCK_MUTEX(glsl_type_mutex);
+   {
+      const glsl_type key(fields, num_fields, name);
 
-   const glsl_type *t = (glsl_type *) hash_table_find(record_types, & key);
-   if (t == NULL) {
-      t = new glsl_type(fields, num_fields, name);
+      if (record_types == NULL) {
+         record_types = hash_table_ctor(64, record_key_hash,
+                                        record_key_compare);
+      }
 
-      hash_table_insert(record_types, (void *) t, t);
+      t = (glsl_type *) hash_table_find(record_types, & key);
+      if (t == NULL) {
+         t = new glsl_type(fields, num_fields, name);
+
+         hash_table_insert(record_types, (void *) t, t);
+      }
    }
+   _glthread_UNLOCK_MUTEX(glsl_type_mutex);
 
    assert(t->base_type == GLSL_TYPE_STRUCT);
    assert(t->length == num_fields);
@@ -218,6 +218,16 @@ struct glsl_type {
    static const glsl_type *get_instance(unsigned base_type, unsigned rows,
 					unsigned columns);
 
+   /**
+    * Get the instance of a built-in sampler type
+    *
+    * \return
+    * The matching sampler type, or \c NULL if there is no such built-in type.
+    */
+   static const glsl_type *get_sampler_instance(enum glsl_sampler_dim dim,
+						bool shadow, bool array,
+						unsigned type);
+
    /**
     * Get the instance of an array type
     */
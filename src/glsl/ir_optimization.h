@@ -40,6 +40,10 @@
 bool do_common_optimization(exec_list *ir, bool linked,
 			    bool uniform_locations_assigned,
 			    unsigned max_unroll_iterations);
+bool do_common_optimization_loop(exec_list *ir, bool linked,
+                                 bool uniform_locations_assigned,
+                                 unsigned max_unroll_iterations,
+                                 bool print_stats = false);
 
 bool do_algebraic(exec_list *instructions);
 bool do_constant_folding(exec_list *instructions);
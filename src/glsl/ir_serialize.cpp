@@ -0,0 +1,1442 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file ir_serialize.cpp
+ *
+ * The serialized IR starts with a table of all the variables referenced by
+ * the instructions, followed by a table of all the functions and their
+ * signatures.  The instructions come last, in the order of the original
+ * lists.  Variables and signatures are referred to by their (1-based) index
+ * in the tables, so the reader can create them all up front and never has to
+ * patch up forward references.
+ *
+ * Each instruction is written as its \c ir_node_type followed by its fields.
+ * \c ir_type_unset stands for a \c NULL rvalue.
+ */
+
+#include <string.h>
+#include "main/core.h"
+#include "ir_serialize.h"
+#include "ir_hierarchical_visitor.h"
+#include "glsl_types.h"
+#include "program/hash_table.h"
+#include "ralloc.h"
+
+
+memory_writer::memory_writer(void *mem_ctx)
+   : mem_ctx(mem_ctx), data(NULL), size(0), capacity(0)
+{
+}
+
+void
+memory_writer::write(const void *src, size_t n)
+{
+   if (this->size + n > this->capacity) {
+      this->capacity = MAX2(MAX2(this->capacity * 2, this->size + n), 4096);
+      this->data = (uint8_t *) reralloc_size(this->mem_ctx, this->data,
+                                             this->capacity);
+   }
+
+   memcpy(this->data + this->size, src, n);
+   this->size += n;
+}
+
+void
+memory_writer::write_uint(uint32_t value)
+{
+   uint8_t bytes[5];
+   unsigned n = 0;
+
+   while (value >= 0x80) {
+      bytes[n++] = (value & 0x7f) | 0x80;
+      value >>= 7;
+   }
+   bytes[n++] = value;
+
+   write(bytes, n);
+}
+
+void
+memory_writer::write_int(int32_t value)
+{
+   /* Interleave positive and negative values, so that small negative values
+    * are small too.
+    */
+   write_uint(((uint32_t) value << 1) ^ (uint32_t) (value >> 31));
+}
+
+void
+memory_writer::write_string(const char *str)
+{
+   if (str == NULL) {
+      write_uint(0);
+      return;
+   }
+
+   const uint32_t len = strlen(str);
+   write_uint(len + 1);
+   write(str, len);
+}
+
+
+memory_reader::memory_reader(const void *data, size_t size)
+   : current((const uint8_t *) data), end((const uint8_t *) data + size),
+     failed(false)
+{
+}
+
+void
+memory_reader::read(void *dst, size_t n)
+{
+   if (this->failed || (size_t) (this->end - this->current) < n) {
+      this->failed = true;
+      memset(dst, 0, n);
+      return;
+   }
+
+   memcpy(dst, this->current, n);
+   this->current += n;
+}
+
+uint32_t
+memory_reader::read_uint32()
+{
+   uint32_t value;
+   read(&value, sizeof(value));
+   return value;
+}
+
+int32_t
+memory_reader::read_int32()
+{
+   int32_t value;
+   read(&value, sizeof(value));
+   return value;
+}
+
+uint32_t
+memory_reader::read_uint()
+{
+   uint32_t value = 0;
+
+   for (unsigned shift = 0; shift < 35; shift += 7) {
+      if (this->failed || this->current == this->end) {
+         this->failed = true;
+         return 0;
+      }
+
+      const uint8_t byte = *this->current++;
+      value |= (uint32_t) (byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0)
+         return value;
+   }
+
+   this->failed = true;
+   return 0;
+}
+
+int32_t
+memory_reader::read_int()
+{
+   const uint32_t value = read_uint();
+   return (int32_t) ((value >> 1) ^ -(value & 1));
+}
+
+char *
+memory_reader::read_string(void *mem_ctx)
+{
+   uint32_t len = read_uint();
+
+   if (this->failed || len-- == 0)
+      return NULL;
+
+   if ((size_t) (this->end - this->current) < len) {
+      this->failed = true;
+      return NULL;
+   }
+
+   char *str = ralloc_strndup(mem_ctx, (const char *) this->current, len);
+   this->current += len;
+   return str;
+}
+
+
+/**
+ * Check that \c count items of at least \c item_size bytes each can still be
+ * read, before allocating storage for them.
+ */
+static bool
+can_read_items(memory_reader &blob, uint32_t count, size_t item_size)
+{
+   if (blob.failed
+       || (size_t) (blob.end - blob.current) / item_size < count) {
+      blob.failed = true;
+      return false;
+   }
+
+   return true;
+}
+
+
+void
+serialize_glsl_type(memory_writer &blob, const glsl_type *type)
+{
+   blob.write_uint(type->base_type);
+
+   switch (type->base_type) {
+   case GLSL_TYPE_UINT:
+   case GLSL_TYPE_INT:
+   case GLSL_TYPE_FLOAT:
+   case GLSL_TYPE_BOOL:
+      blob.write_uint(type->vector_elements);
+      blob.write_uint(type->matrix_columns);
+      break;
+   case GLSL_TYPE_SAMPLER:
+      blob.write_uint(type->sampler_dimensionality);
+      blob.write_uint(type->sampler_shadow);
+      blob.write_uint(type->sampler_array);
+      blob.write_uint(type->sampler_type);
+      break;
+   case GLSL_TYPE_STRUCT:
+      blob.write_string(type->name);
+      blob.write_uint(type->length);
+      for (unsigned i = 0; i < type->length; i++) {
+         blob.write_string(type->fields.structure[i].name);
+         serialize_glsl_type(blob, type->fields.structure[i].type);
+      }
+      break;
+   case GLSL_TYPE_ARRAY:
+      serialize_glsl_type(blob, type->fields.array);
+      blob.write_uint(type->length);
+      break;
+   case GLSL_TYPE_VOID:
+   case GLSL_TYPE_ERROR:
+      break;
+   }
+}
+
+const glsl_type *
+deserialize_glsl_type(memory_reader &blob)
+{
+   const unsigned base_type = blob.read_uint();
+
+   switch (base_type) {
+   case GLSL_TYPE_UINT:
+   case GLSL_TYPE_INT:
+   case GLSL_TYPE_FLOAT:
+   case GLSL_TYPE_BOOL: {
+      const unsigned rows = blob.read_uint();
+      const unsigned columns = blob.read_uint();
+      const glsl_type *const t =
+         glsl_type::get_instance(base_type, rows, columns);
+
+      if (!blob.failed && t != glsl_type::error_type)
+         return t;
+      break;
+   }
+   case GLSL_TYPE_SAMPLER: {
+      const unsigned dim = blob.read_uint();
+      const unsigned shadow = blob.read_uint();
+      const unsigned array = blob.read_uint();
+      const unsigned type = blob.read_uint();
+      const glsl_type *const t =
+         glsl_type::get_sampler_instance((enum glsl_sampler_dim) dim,
+                                         shadow != 0, array != 0, type);
+
+      if (!blob.failed && t != NULL)
+         return t;
+      break;
+   }
+   case GLSL_TYPE_STRUCT: {
+      void *mem_ctx = ralloc_context(NULL);
+      const char *name = blob.read_string(mem_ctx);
+      const uint32_t length = blob.read_uint();
+
+      if (name == NULL || !can_read_items(blob, length, 2)) {
+         ralloc_free(mem_ctx);
+         break;
+      }
+
+      glsl_struct_field *fields =
+         ralloc_array(mem_ctx, glsl_struct_field, length);
+      for (unsigned i = 0; i < length; i++) {
+         fields[i].name = blob.read_string(mem_ctx);
+         fields[i].type = deserialize_glsl_type(blob);
+
+         if (fields[i].name == NULL || fields[i].type == NULL) {
+            blob.failed = true;
+            break;
+         }
+      }
+
+      const glsl_type *t = NULL;
+      if (!blob.failed)
+         t = glsl_type::get_record_instance(fields, length, name);
+
+      ralloc_free(mem_ctx);
+
+      if (t != NULL)
+         return t;
+      break;
+   }
+   case GLSL_TYPE_ARRAY: {
+      const glsl_type *const element = deserialize_glsl_type(blob);
+      const unsigned length = blob.read_uint();
+
+      if (!blob.failed && element != NULL)
+         return glsl_type::get_array_instance(element, length);
+      break;
+   }
+   case GLSL_TYPE_VOID:
+      return glsl_type::void_type;
+   }
+
+   blob.failed = true;
+   return NULL;
+}
+
+
+namespace {
+
+/**
+ * Assigns indices to all the variables and functions the IR refers to.
+ */
+class ir_serialize_collector : public ir_hierarchical_visitor {
+public:
+   ir_serialize_collector(void *mem_ctx, bool skip_bodies = false)
+      : mem_ctx(mem_ctx), skip_bodies(skip_bodies),
+        variables(NULL), num_variables(0), variables_size(0),
+        functions(NULL), num_functions(0), num_signatures(0)
+   {
+      this->ids = hash_table_ctor(0, hash_table_pointer_hash,
+                                  hash_table_pointer_compare);
+   }
+
+   ~ir_serialize_collector()
+   {
+      hash_table_dtor(this->ids);
+   }
+
+   /** 1-based index of a variable or signature, or 0 if it is unknown. */
+   unsigned get_id(const void *ir)
+   {
+      return (unsigned) (uintptr_t) hash_table_find(this->ids, ir);
+   }
+
+   void add_variable(ir_variable *var)
+   {
+      if (get_id(var) != 0)
+         return;
+
+      if (this->num_variables == this->variables_size) {
+         this->variables_size = MAX2(this->variables_size * 2, 16);
+         this->variables = reralloc(this->mem_ctx, this->variables,
+                                    ir_variable *, this->variables_size);
+      }
+
+      this->variables[this->num_variables++] = var;
+      hash_table_insert(this->ids, (void *) (uintptr_t) this->num_variables,
+                        var);
+   }
+
+   virtual ir_visitor_status visit(ir_variable *ir)
+   {
+      add_variable(ir);
+      return visit_continue;
+   }
+
+   virtual ir_visitor_status visit(ir_dereference_variable *ir)
+   {
+      add_variable(ir->var);
+      return visit_continue;
+   }
+
+   virtual ir_visitor_status visit_enter(ir_function *ir)
+   {
+      this->functions = reralloc(this->mem_ctx, this->functions,
+                                 ir_function *, this->num_functions + 1);
+      this->functions[this->num_functions++] = ir;
+      hash_table_insert(this->ids,
+                        (void *) (uintptr_t) this->num_functions, ir);
+
+      foreach_list(node, &ir->signatures) {
+         ir_function_signature *const sig = (ir_function_signature *) node;
+
+         this->num_signatures++;
+         hash_table_insert(this->ids,
+                           (void *) (uintptr_t) this->num_signatures, sig);
+      }
+
+      return visit_continue;
+   }
+
+   virtual ir_visitor_status visit_enter(ir_function_signature *ir)
+   {
+      if (!this->skip_bodies)
+         return visit_continue;
+
+      foreach_list(node, &ir->parameters)
+         add_variable((ir_variable *) node);
+
+      return visit_continue_with_parent;
+   }
+
+   void *mem_ctx;
+   struct hash_table *ids;
+
+   /** Only collect the declarations, not the contents of function bodies. */
+   bool skip_bodies;
+
+   ir_variable **variables;
+   unsigned num_variables;
+   unsigned variables_size;
+
+   ir_function **functions;
+   unsigned num_functions;
+   unsigned num_signatures;
+};
+
+
+class ir_serializer {
+public:
+   ir_serializer(memory_writer &blob, ir_serialize_collector &refs)
+      : blob(blob), refs(refs), failed(false), bodies(true)
+   {
+   }
+
+   void write_variable(ir_variable *var);
+   void write_function(ir_function *f);
+   void write_list(exec_list *list);
+   void write_instruction(ir_instruction *ir);
+   void write_constant_data(ir_constant *c);
+
+   void write_rvalue(ir_rvalue *ir)
+   {
+      if (ir == NULL)
+         this->blob.write_uint(ir_type_unset);
+      else
+         write_instruction(ir);
+   }
+
+   void write_reference(void *ir)
+   {
+      const unsigned id = this->refs.get_id(ir);
+      if (id == 0)
+         this->failed = true;
+      this->blob.write_uint(id);
+   }
+
+   memory_writer &blob;
+   ir_serialize_collector &refs;
+   bool failed;
+
+   /**
+    * Whether to write function bodies.  If not, functions are written as
+    * prototypes, with empty bodies.
+    */
+   bool bodies;
+};
+
+
+void
+ir_serializer::write_variable(ir_variable *var)
+{
+   this->blob.write_string(var->name);
+   serialize_glsl_type(this->blob, var->type);
+   this->blob.write_uint(var->mode);
+   this->blob.write_uint(var->interpolation);
+   this->blob.write_uint(var->max_array_access);
+   this->blob.write_uint(var->read_only
+                           | (var->centroid << 1)
+                           | (var->invariant << 2)
+                           | (var->used << 3)
+                           | (var->assigned << 4)
+                           | (var->origin_upper_left << 5)
+                           | (var->pixel_center_integer << 6)
+                           | (var->explicit_location << 7)
+                           | (var->explicit_index << 8)
+                           | (var->has_initializer << 9));
+   this->blob.write_uint(var->depth_layout);
+   this->blob.write_int(var->location);
+   this->blob.write_int(var->uniform_block);
+   this->blob.write_int(var->index);
+
+   this->blob.write_uint(var->state_slots ? var->num_state_slots : 0);
+   for (unsigned i = 0; var->state_slots && i < var->num_state_slots; i++) {
+      for (unsigned j = 0; j < Elements(var->state_slots[i].tokens); j++)
+         this->blob.write_int(var->state_slots[i].tokens[j]);
+      this->blob.write_int(var->state_slots[i].swizzle);
+   }
+
+   write_rvalue(var->constant_value);
+   write_rvalue(var->constant_initializer);
+}
+
+void
+ir_serializer::write_function(ir_function *f)
+{
+   this->blob.write_string(f->name);
+
+   unsigned num_signatures = 0;
+   foreach_list(node, &f->signatures)
+      num_signatures++;
+   this->blob.write_uint(num_signatures);
+
+   foreach_list(node, &f->signatures) {
+      ir_function_signature *const sig = (ir_function_signature *) node;
+
+      serialize_glsl_type(this->blob, sig->return_type);
+      this->blob.write_uint(this->bodies && sig->is_defined);
+      this->blob.write_uint(sig->is_builtin);
+
+      unsigned num_parameters = 0;
+      foreach_list(param, &sig->parameters)
+         num_parameters++;
+      this->blob.write_uint(num_parameters);
+
+      foreach_list(param, &sig->parameters)
+         write_reference((ir_variable *) param);
+   }
+}
+
+void
+ir_serializer::write_list(exec_list *list)
+{
+   unsigned count = 0;
+   foreach_list(node, list)
+      count++;
+   this->blob.write_uint(count);
+
+   foreach_list(node, list)
+      write_instruction((ir_instruction *) node);
+}
+
+void
+ir_serializer::write_constant_data(ir_constant *c)
+{
+   switch (c->type->base_type) {
+   case GLSL_TYPE_ARRAY:
+      for (unsigned i = 0; i < c->type->length; i++)
+         write_constant_data(c->array_elements[i]);
+      break;
+   case GLSL_TYPE_STRUCT:
+      foreach_list(node, &c->components)
+         write_constant_data((ir_constant *) node);
+      break;
+   default:
+      this->blob.write(c->value.u, c->type->components() * sizeof(c->value.u[0]));
+      break;
+   }
+}
+
+void
+ir_serializer::write_instruction(ir_instruction *ir)
+{
+   this->blob.write_uint(ir->ir_type);
+
+   switch (ir->ir_type) {
+   case ir_type_variable:
+   case ir_type_function:
+      write_reference(ir);
+      if (ir->ir_type == ir_type_function) {
+         foreach_list(node, &((ir_function *) ir)->signatures) {
+            if (this->bodies)
+               write_list(&((ir_function_signature *) node)->body);
+            else
+               this->blob.write_uint(0);
+         }
+      }
+      break;
+
+   case ir_type_assignment: {
+      ir_assignment *const a = (ir_assignment *) ir;
+      write_rvalue(a->lhs);
+      write_rvalue(a->rhs);
+      write_rvalue(a->condition);
+      this->blob.write_uint(a->write_mask);
+      break;
+   }
+
+   case ir_type_call: {
+      ir_call *const call = (ir_call *) ir;
+      write_reference(call->callee);
+      write_rvalue(call->return_deref);
+      write_list(&call->actual_parameters);
+      this->blob.write_uint(call->use_builtin);
+      break;
+   }
+
+   case ir_type_constant: {
+      ir_constant *const c = (ir_constant *) ir;
+      serialize_glsl_type(this->blob, c->type);
+      write_constant_data(c);
+      break;
+   }
+
+   case ir_type_dereference_array: {
+      ir_dereference_array *const deref = (ir_dereference_array *) ir;
+      write_rvalue(deref->array);
+      write_rvalue(deref->array_index);
+      break;
+   }
+
+   case ir_type_dereference_record: {
+      ir_dereference_record *const deref = (ir_dereference_record *) ir;
+      write_rvalue(deref->record);
+      this->blob.write_string(deref->field);
+      break;
+   }
+
+   case ir_type_dereference_variable:
+      write_reference(((ir_dereference_variable *) ir)->var);
+      break;
+
+   case ir_type_discard:
+      write_rvalue(((ir_discard *) ir)->condition);
+      break;
+
+   case ir_type_expression: {
+      ir_expression *const expr = (ir_expression *) ir;
+      const unsigned num_operands = expr->get_num_operands();
+
+      this->blob.write_uint(expr->operation);
+      serialize_glsl_type(this->blob, expr->type);
+      this->blob.write_uint(num_operands);
+      for (unsigned i = 0; i < num_operands; i++)
+         write_rvalue(expr->operands[i]);
+      break;
+   }
+
+   case ir_type_if: {
+      ir_if *const iif = (ir_if *) ir;
+      write_rvalue(iif->condition);
+      write_list(&iif->then_instructions);
+      write_list(&iif->else_instructions);
+      break;
+   }
+
+   case ir_type_loop: {
+      ir_loop *const loop = (ir_loop *) ir;
+      write_rvalue(loop->from);
+      write_rvalue(loop->to);
+      write_rvalue(loop->increment);
+      /* The counter is only a hint from loop analysis, so drop it rather
+       * than failing if it isn't declared anywhere.
+       */
+      this->blob.write_uint(loop->counter ? this->refs.get_id(loop->counter)
+                                            : 0);
+      this->blob.write_int(loop->cmp);
+      write_list(&loop->body_instructions);
+      break;
+   }
+
+   case ir_type_loop_jump:
+      this->blob.write_uint(((ir_loop_jump *) ir)->mode);
+      break;
+
+   case ir_type_return:
+      write_rvalue(((ir_return *) ir)->value);
+      break;
+
+   case ir_type_swizzle: {
+      ir_swizzle *const swiz = (ir_swizzle *) ir;
+      write_rvalue(swiz->val);
+      this->blob.write_uint(swiz->mask.x
+                              | (swiz->mask.y << 2)
+                              | (swiz->mask.z << 4)
+                              | (swiz->mask.w << 6)
+                              | (swiz->mask.num_components << 8));
+      break;
+   }
+
+   case ir_type_texture: {
+      ir_texture *const tex = (ir_texture *) ir;
+
+      this->blob.write_uint(tex->op);
+      serialize_glsl_type(this->blob, tex->type);
+      write_rvalue(tex->sampler);
+      write_rvalue(tex->coordinate);
+      write_rvalue(tex->projector);
+      write_rvalue(tex->shadow_comparitor);
+      write_rvalue(tex->offset);
+
+      switch (tex->op) {
+      case ir_tex:
+         break;
+      case ir_txb:
+         write_rvalue(tex->lod_info.bias);
+         break;
+      case ir_txl:
+      case ir_txf:
+      case ir_txs:
+         write_rvalue(tex->lod_info.lod);
+         break;
+      case ir_txd:
+         write_rvalue(tex->lod_info.grad.dPdx);
+         write_rvalue(tex->lod_info.grad.dPdy);
+         break;
+      }
+      break;
+   }
+
+   default:
+      assert(!"Should not get here.");
+      this->failed = true;
+      break;
+   }
+}
+
+
+class ir_deserializer {
+public:
+   ir_deserializer(memory_reader &blob, void *mem_ctx)
+      : blob(blob), mem_ctx(mem_ctx),
+        variables(NULL), num_variables(0),
+        functions(NULL), num_functions(0),
+        signatures(NULL), num_signatures(0)
+   {
+   }
+
+   bool read_tables();
+   void use_tables(ir_serialize_collector &refs);
+   ir_variable *read_variable();
+   bool read_list(exec_list *list);
+   ir_instruction *read_instruction();
+   ir_constant *read_constant_data(const glsl_type *type);
+
+   ir_rvalue *read_rvalue()
+   {
+      ir_instruction *const ir = read_instruction();
+      ir_rvalue *const rv = ir ? ir->as_rvalue() : NULL;
+
+      if (ir != NULL && rv == NULL)
+         this->blob.failed = true;
+      return rv;
+   }
+
+   /** Read an rvalue that is not allowed to be \c NULL. */
+   ir_rvalue *read_operand()
+   {
+      ir_rvalue *const rv = read_rvalue();
+
+      if (rv == NULL)
+         this->blob.failed = true;
+      return this->blob.failed ? NULL : rv;
+   }
+
+   ir_variable *read_variable_reference()
+   {
+      const uint32_t id = this->blob.read_uint();
+
+      if (id == 0 || id > this->num_variables) {
+         this->blob.failed = true;
+         return NULL;
+      }
+      return this->variables[id - 1];
+   }
+
+   memory_reader &blob;
+   void *mem_ctx;
+
+   ir_variable **variables;
+   unsigned num_variables;
+
+   ir_function **functions;
+   unsigned num_functions;
+
+   ir_function_signature **signatures;
+   unsigned num_signatures;
+};
+
+
+ir_variable *
+ir_deserializer::read_variable()
+{
+   const char *name = this->blob.read_string(this->mem_ctx);
+   const glsl_type *type = deserialize_glsl_type(this->blob);
+   const unsigned mode = this->blob.read_uint();
+
+   if (this->blob.failed || mode > ir_var_temporary)
+      return NULL;
+
+   ir_variable *var =
+      new(this->mem_ctx) ir_variable(type, name, (ir_variable_mode) mode);
+   ralloc_free((void *) name);
+
+   var->interpolation = this->blob.read_uint();
+   var->max_array_access = this->blob.read_uint();
+   if (type->array_size() > 0
+       && var->max_array_access >= (unsigned) type->array_size())
+      this->blob.failed = true;
+
+   const unsigned flags = this->blob.read_uint();
+   var->read_only = (flags >> 0) & 1;
+   var->centroid = (flags >> 1) & 1;
+   var->invariant = (flags >> 2) & 1;
+   var->used = (flags >> 3) & 1;
+   var->assigned = (flags >> 4) & 1;
+   var->origin_upper_left = (flags >> 5) & 1;
+   var->pixel_center_integer = (flags >> 6) & 1;
+   var->explicit_location = (flags >> 7) & 1;
+   var->explicit_index = (flags >> 8) & 1;
+   var->has_initializer = (flags >> 9) & 1;
+
+   var->depth_layout = (ir_depth_layout) this->blob.read_uint();
+   var->location = this->blob.read_int();
+   var->uniform_block = this->blob.read_int();
+   var->index = this->blob.read_int();
+
+   const uint32_t num_state_slots = this->blob.read_uint();
+   if (num_state_slots != 0) {
+      if (!can_read_items(this->blob, num_state_slots,
+                          Elements(var->state_slots[0].tokens) + 1))
+         return NULL;
+
+      var->num_state_slots = num_state_slots;
+      var->state_slots = ralloc_array(var, ir_state_slot, num_state_slots);
+      for (unsigned i = 0; i < num_state_slots; i++) {
+         for (unsigned j = 0; j < Elements(var->state_slots[i].tokens); j++)
+            var->state_slots[i].tokens[j] = this->blob.read_int();
+         var->state_slots[i].swizzle = this->blob.read_int();
+      }
+   }
+
+   ir_rvalue *const value = read_rvalue();
+   ir_rvalue *const initializer = read_rvalue();
+   if ((value != NULL && value->as_constant() == NULL)
+       || (initializer != NULL && initializer->as_constant() == NULL))
+      this->blob.failed = true;
+
+   var->constant_value = value ? value->as_constant() : NULL;
+   var->constant_initializer = initializer ? initializer->as_constant() : NULL;
+
+   return this->blob.failed ? NULL : var;
+}
+
+bool
+ir_deserializer::read_tables()
+{
+   const uint32_t num_variables = this->blob.read_uint();
+   if (!can_read_items(this->blob, num_variables, 13))
+      return false;
+
+   this->variables = ralloc_array(this->mem_ctx, ir_variable *, num_variables);
+   for (unsigned i = 0; i < num_variables; i++) {
+      this->variables[i] = read_variable();
+      if (this->variables[i] == NULL)
+         return false;
+   }
+   this->num_variables = num_variables;
+
+   const uint32_t num_functions = this->blob.read_uint();
+   if (!can_read_items(this->blob, num_functions, 2))
+      return false;
+
+   this->functions = ralloc_array(this->mem_ctx, ir_function *, num_functions);
+   for (unsigned i = 0; i < num_functions; i++) {
+      const char *name = this->blob.read_string(this->mem_ctx);
+      const uint32_t count = this->blob.read_uint();
+
+      if (name == NULL || !can_read_items(this->blob, count, 4))
+         return false;
+
+      ir_function *const f = new(this->mem_ctx) ir_function(name);
+      this->functions[i] = f;
+      this->num_functions = i + 1;
+
+      this->signatures = reralloc(this->mem_ctx, this->signatures,
+                                  ir_function_signature *,
+                                  this->num_signatures + count);
+
+      for (unsigned j = 0; j < count; j++) {
+         const glsl_type *const return_type = deserialize_glsl_type(this->blob);
+         if (return_type == NULL)
+            return false;
+
+         ir_function_signature *const sig =
+            new(this->mem_ctx) ir_function_signature(return_type);
+         sig->is_defined = this->blob.read_uint() != 0;
+         sig->is_builtin = this->blob.read_uint() != 0;
+         f->add_signature(sig);
+         this->signatures[this->num_signatures++] = sig;
+
+         const uint32_t num_parameters = this->blob.read_uint();
+         if (!can_read_items(this->blob, num_parameters, 1))
+            return false;
+
+         for (unsigned k = 0; k < num_parameters; k++) {
+            ir_variable *const param = read_variable_reference();
+
+            /* Each variable can only be in a single list. */
+            if (param == NULL || param->next != NULL) {
+               this->blob.failed = true;
+               return false;
+            }
+            sig->parameters.push_tail(param);
+         }
+      }
+   }
+
+   return !this->blob.failed;
+}
+
+/**
+ * Refer to the declarations collected from existing IR, rather than to ones
+ * read from the data.
+ */
+void
+ir_deserializer::use_tables(ir_serialize_collector &refs)
+{
+   this->variables = ralloc_array(this->mem_ctx, ir_variable *,
+                                  refs.num_variables);
+   memcpy(this->variables, refs.variables,
+          refs.num_variables * sizeof(ir_variable *));
+   this->num_variables = refs.num_variables;
+
+   this->functions = ralloc_array(this->mem_ctx, ir_function *,
+                                  refs.num_functions);
+   memcpy(this->functions, refs.functions,
+          refs.num_functions * sizeof(ir_function *));
+   this->num_functions = refs.num_functions;
+
+   this->signatures = ralloc_array(this->mem_ctx, ir_function_signature *,
+                                   refs.num_signatures);
+   this->num_signatures = 0;
+   for (unsigned i = 0; i < refs.num_functions; i++) {
+      foreach_list(node, &refs.functions[i]->signatures) {
+         this->signatures[this->num_signatures++] =
+            (ir_function_signature *) node;
+      }
+   }
+}
+
+bool
+ir_deserializer::read_list(exec_list *list)
+{
+   const uint32_t count = this->blob.read_uint();
+   if (!can_read_items(this->blob, count, 1))
+      return false;
+
+   for (unsigned i = 0; i < count; i++) {
+      ir_instruction *const ir = read_instruction();
+
+      if (ir == NULL || ir->next != NULL) {
+         this->blob.failed = true;
+         return false;
+      }
+      list->push_tail(ir);
+   }
+
+   return true;
+}
+
+ir_constant *
+ir_deserializer::read_constant_data(const glsl_type *type)
+{
+   exec_list values;
+
+   switch (type->base_type) {
+   case GLSL_TYPE_UINT:
+   case GLSL_TYPE_INT:
+   case GLSL_TYPE_FLOAT:
+   case GLSL_TYPE_BOOL: {
+      ir_constant_data data;
+
+      memset(&data, 0, sizeof(data));
+      this->blob.read(data.u, type->components() * sizeof(data.u[0]));
+      if (this->blob.failed)
+         return NULL;
+      return new(this->mem_ctx) ir_constant(type, &data);
+   }
+
+   case GLSL_TYPE_ARRAY:
+      if (!can_read_items(this->blob, type->length, 4))
+         return NULL;
+
+      for (unsigned i = 0; i < type->length; i++) {
+         ir_constant *const c = read_constant_data(type->fields.array);
+         if (c == NULL)
+            return NULL;
+         values.push_tail(c);
+      }
+      return new(this->mem_ctx) ir_constant(type, &values);
+
+   case GLSL_TYPE_STRUCT:
+      for (unsigned i = 0; i < type->length; i++) {
+         ir_constant *const c =
+            read_constant_data(type->fields.structure[i].type);
+         if (c == NULL)
+            return NULL;
+         values.push_tail(c);
+      }
+      return new(this->mem_ctx) ir_constant(type, &values);
+
+   default:
+      this->blob.failed = true;
+      return NULL;
+   }
+}
+
+ir_instruction *
+ir_deserializer::read_instruction()
+{
+   void *const mem_ctx = this->mem_ctx;
+   const uint32_t ir_type = this->blob.read_uint();
+
+   if (this->blob.failed)
+      return NULL;
+
+   switch (ir_type) {
+   case ir_type_unset:
+      return NULL;
+
+   case ir_type_variable:
+      return read_variable_reference();
+
+   case ir_type_function: {
+      const uint32_t id = this->blob.read_uint();
+      if (id == 0 || id > this->num_functions)
+         break;
+
+      ir_function *const f = this->functions[id - 1];
+      foreach_list(node, &f->signatures) {
+         if (!read_list(&((ir_function_signature *) node)->body))
+            return NULL;
+      }
+      return f;
+   }
+
+   case ir_type_assignment: {
+      ir_rvalue *const lhs = read_operand();
+      ir_rvalue *const rhs = read_operand();
+      ir_rvalue *const condition = read_rvalue();
+      const unsigned write_mask = this->blob.read_uint();
+
+      if (this->blob.failed || lhs->as_dereference() == NULL)
+         break;
+
+      if (lhs->type->is_scalar() || lhs->type->is_vector()) {
+         unsigned lhs_components = 0;
+         for (unsigned i = 0; i < 4; i++) {
+            if (write_mask & (1 << i))
+               lhs_components++;
+         }
+
+         if (lhs_components != rhs->type->vector_elements)
+            break;
+      }
+
+      return new(mem_ctx) ir_assignment(lhs->as_dereference(), rhs, condition,
+                                        write_mask);
+   }
+
+   case ir_type_call: {
+      const uint32_t id = this->blob.read_uint();
+      ir_rvalue *const return_deref = read_rvalue();
+      exec_list parameters;
+
+      if (id == 0 || id > this->num_signatures)
+         break;
+
+      if (return_deref != NULL
+          && return_deref->as_dereference_variable() == NULL)
+         break;
+
+      if (!read_list(&parameters))
+         return NULL;
+
+      foreach_list(node, &parameters) {
+         if (((ir_instruction *) node)->as_rvalue() == NULL)
+            this->blob.failed = true;
+      }
+
+      const bool use_builtin = this->blob.read_uint() != 0;
+      if (this->blob.failed)
+         return NULL;
+
+      ir_call *const call =
+         new(mem_ctx) ir_call(this->signatures[id - 1],
+                              return_deref ?
+                              return_deref->as_dereference_variable() : NULL,
+                              &parameters);
+      call->use_builtin = use_builtin;
+      return call;
+   }
+
+   case ir_type_constant: {
+      const glsl_type *const type = deserialize_glsl_type(this->blob);
+      if (type == NULL)
+         return NULL;
+
+      return read_constant_data(type);
+   }
+
+   case ir_type_dereference_array: {
+      ir_rvalue *const array = read_operand();
+      ir_rvalue *const index = read_operand();
+      if (this->blob.failed)
+         return NULL;
+
+      ir_dereference_array *const deref =
+         new(mem_ctx) ir_dereference_array(array, index);
+      if (deref->type->is_error())
+         break;
+      return deref;
+   }
+
+   case ir_type_dereference_record: {
+      ir_rvalue *const record = read_operand();
+      const char *field = this->blob.read_string(mem_ctx);
+      if (this->blob.failed || field == NULL || !record->type->is_record())
+         break;
+
+      ir_dereference_record *const deref =
+         new(mem_ctx) ir_dereference_record(record, field);
+      if (deref->type->is_error())
+         break;
+      return deref;
+   }
+
+   case ir_type_dereference_variable: {
+      ir_variable *const var = read_variable_reference();
+      if (var == NULL)
+         return NULL;
+      return new(mem_ctx) ir_dereference_variable(var);
+   }
+
+   case ir_type_discard: {
+      ir_rvalue *const condition = read_rvalue();
+      if (this->blob.failed)
+         return NULL;
+      return new(mem_ctx) ir_discard(condition);
+   }
+
+   case ir_type_expression: {
+      const unsigned operation = this->blob.read_uint();
+      const glsl_type *const type = deserialize_glsl_type(this->blob);
+      const unsigned num_operands = this->blob.read_uint();
+      ir_rvalue *operands[4] = { NULL, NULL, NULL, NULL };
+
+      if (this->blob.failed || operation > ir_last_opcode || num_operands > 4)
+         break;
+
+      const unsigned expected_operands = operation == ir_quadop_vector
+         ? type->vector_elements
+         : ir_expression::get_num_operands((ir_expression_operation) operation);
+      if (num_operands != expected_operands)
+         break;
+
+      for (unsigned i = 0; i < num_operands; i++)
+         operands[i] = read_operand();
+      if (this->blob.failed)
+         return NULL;
+
+      return new(mem_ctx) ir_expression(operation, type,
+                                        operands[0], operands[1],
+                                        operands[2], operands[3]);
+   }
+
+   case ir_type_if: {
+      ir_rvalue *const condition = read_operand();
+      if (condition == NULL)
+         return NULL;
+
+      ir_if *const iif = new(mem_ctx) ir_if(condition);
+      if (!read_list(&iif->then_instructions)
+          || !read_list(&iif->else_instructions))
+         return NULL;
+      return iif;
+   }
+
+   case ir_type_loop: {
+      ir_loop *const loop = new(mem_ctx) ir_loop();
+
+      loop->from = read_rvalue();
+      loop->to = read_rvalue();
+      loop->increment = read_rvalue();
+
+      const uint32_t counter = this->blob.read_uint();
+      if (counter > this->num_variables)
+         break;
+      loop->counter = counter ? this->variables[counter - 1] : NULL;
+
+      loop->cmp = this->blob.read_int();
+      if (!read_list(&loop->body_instructions))
+         return NULL;
+      return loop;
+   }
+
+   case ir_type_loop_jump: {
+      const uint32_t mode = this->blob.read_uint();
+      if (mode != ir_loop_jump::jump_break
+          && mode != ir_loop_jump::jump_continue)
+         break;
+      return new(mem_ctx) ir_loop_jump((ir_loop_jump::jump_mode) mode);
+   }
+
+   case ir_type_return: {
+      ir_rvalue *const value = read_rvalue();
+      if (this->blob.failed)
+         return NULL;
+      return new(mem_ctx) ir_return(value);
+   }
+
+   case ir_type_swizzle: {
+      ir_rvalue *const val = read_operand();
+      const uint32_t mask = this->blob.read_uint();
+      const unsigned components[4] = {
+         mask & 3, (mask >> 2) & 3, (mask >> 4) & 3, (mask >> 6) & 3
+      };
+      const unsigned count = (mask >> 8) & 7;
+
+      if (this->blob.failed || count < 1 || count > 4)
+         break;
+
+      for (unsigned i = 0; i < count; i++) {
+         if (components[i] >= val->type->vector_elements)
+            this->blob.failed = true;
+      }
+      if (this->blob.failed)
+         return NULL;
+
+      return new(mem_ctx) ir_swizzle(val, components, count);
+   }
+
+   case ir_type_texture: {
+      const uint32_t op = this->blob.read_uint();
+      if (op > ir_txs)
+         break;
+
+      ir_texture *const tex = new(mem_ctx) ir_texture((ir_texture_opcode) op);
+      const glsl_type *const type = deserialize_glsl_type(this->blob);
+      ir_rvalue *const sampler = read_operand();
+      if (this->blob.failed || sampler->as_dereference() == NULL
+          || sampler->type->base_type != GLSL_TYPE_SAMPLER)
+         break;
+
+      /* Enforce what ir_texture::set_sampler asserts. */
+      if (tex->op == ir_txs) {
+         if (type->base_type != GLSL_TYPE_INT)
+            break;
+      } else {
+         if (sampler->type->sampler_type != (int) type->base_type)
+            break;
+         if (type->vector_elements != 4
+             && !(sampler->type->sampler_shadow && type->vector_elements == 1))
+            break;
+      }
+
+      tex->set_sampler(sampler->as_dereference(), type);
+      tex->coordinate = read_rvalue();
+      tex->projector = read_rvalue();
+      tex->shadow_comparitor = read_rvalue();
+      tex->offset = read_rvalue();
+
+      switch (tex->op) {
+      case ir_tex:
+         break;
+      case ir_txb:
+         tex->lod_info.bias = read_operand();
+         break;
+      case ir_txl:
+      case ir_txf:
+      case ir_txs:
+         tex->lod_info.lod = read_operand();
+         break;
+      case ir_txd:
+         tex->lod_info.grad.dPdx = read_operand();
+         tex->lod_info.grad.dPdy = read_operand();
+         break;
+      }
+
+      if (this->blob.failed)
+         return NULL;
+      return tex;
+   }
+   }
+
+   this->blob.failed = true;
+   return NULL;
+}
+
+} /* anonymous namespace */
+
+
+bool
+serialize_ir(memory_writer &blob, exec_list *instructions)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   ir_serialize_collector refs(mem_ctx);
+   ir_serializer v(blob, refs);
+
+   refs.run(instructions);
+
+   blob.write_uint(refs.num_variables);
+   for (unsigned i = 0; i < refs.num_variables; i++)
+      v.write_variable(refs.variables[i]);
+
+   blob.write_uint(refs.num_functions);
+   for (unsigned i = 0; i < refs.num_functions; i++)
+      v.write_function(refs.functions[i]);
+
+   v.write_list(instructions);
+
+   ralloc_free(mem_ctx);
+   return !v.failed;
+}
+
+bool
+deserialize_ir(memory_reader &blob, void *mem_ctx, exec_list *instructions)
+{
+   ir_deserializer v(blob, mem_ctx);
+
+   if (!v.read_tables())
+      return false;
+
+   exec_list list;
+   if (!v.read_list(&list))
+      return false;
+
+   list.move_nodes_to(instructions);
+   return true;
+}
+
+bool
+serialize_declarations(memory_writer &blob, exec_list *instructions)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   ir_serialize_collector refs(mem_ctx, true);
+   ir_serializer v(blob, refs);
+
+   refs.run(instructions);
+   v.bodies = false;
+
+   blob.write_uint(refs.num_variables);
+   for (unsigned i = 0; i < refs.num_variables; i++)
+      v.write_variable(refs.variables[i]);
+
+   blob.write_uint(refs.num_functions);
+   for (unsigned i = 0; i < refs.num_functions; i++)
+      v.write_function(refs.functions[i]);
+
+   v.write_list(instructions);
+
+   ralloc_free(mem_ctx);
+   return !v.failed;
+}
+
+bool
+serialize_function_bodies(memory_writer &blob, exec_list *declarations,
+                          ir_function *f)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   ir_serialize_collector refs(mem_ctx, true);
+   ir_serializer v(blob, refs);
+
+   refs.run(declarations);
+
+   /* Collect the local variables of the bodies, which follow the
+    * declarations.
+    */
+   const unsigned first_local = refs.num_variables;
+   refs.skip_bodies = false;
+   foreach_list(node, &f->signatures)
+      refs.run(&((ir_function_signature *) node)->body);
+
+   blob.write_uint(refs.num_variables - first_local);
+   for (unsigned i = first_local; i < refs.num_variables; i++)
+      v.write_variable(refs.variables[i]);
+
+   foreach_list(node, &f->signatures) {
+      ir_function_signature *const sig = (ir_function_signature *) node;
+
+      blob.write_uint(sig->is_defined);
+      v.write_list(&sig->body);
+   }
+
+   ralloc_free(mem_ctx);
+   return !v.failed;
+}
+
+bool
+deserialize_function_bodies(memory_reader &blob, void *mem_ctx,
+                            exec_list *declarations, ir_function *f)
+{
+   void *tmp_ctx = ralloc_context(NULL);
+   ir_serialize_collector refs(tmp_ctx, true);
+   ir_deserializer v(blob, tmp_ctx);
+
+   refs.run(declarations);
+   v.use_tables(refs);
+
+   const uint32_t num_locals = blob.read_uint();
+   if (!can_read_items(blob, num_locals, 13)) {
+      ralloc_free(tmp_ctx);
+      return false;
+   }
+
+   v.variables = reralloc(tmp_ctx, v.variables, ir_variable *,
+                          v.num_variables + num_locals);
+   v.mem_ctx = mem_ctx;
+   for (unsigned i = 0; i < num_locals; i++) {
+      ir_variable *const var = v.read_variable();
+      if (var == NULL) {
+         ralloc_free(tmp_ctx);
+         return false;
+      }
+      v.variables[v.num_variables++] = var;
+   }
+
+   /* Read all the bodies before attaching any of them, so that the function
+    * is left alone if the data is damaged.
+    */
+   unsigned num_signatures = 0;
+   foreach_list(node, &f->signatures)
+      num_signatures++;
+
+   exec_list *bodies = ralloc_array(tmp_ctx, exec_list, num_signatures);
+   bool *defined = ralloc_array(tmp_ctx, bool, num_signatures);
+   for (unsigned i = 0; i < num_signatures; i++) {
+      bodies[i].make_empty();
+      defined[i] = blob.read_uint() != 0;
+      if (!v.read_list(&bodies[i])) {
+         ralloc_free(tmp_ctx);
+         return false;
+      }
+   }
+
+   unsigned i = 0;
+   foreach_list(node, &f->signatures) {
+      ir_function_signature *const sig = (ir_function_signature *) node;
+
+      if (!sig->is_defined) {
+         bodies[i].move_nodes_to(&sig->body);
+         sig->is_defined = defined[i];
+      }
+      i++;
+   }
+
+   ralloc_free(tmp_ctx);
+   return true;
+}
@@ -0,0 +1,184 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+#ifndef IR_SERIALIZE_H
+#define IR_SERIALIZE_H
+
+/**
+ * \file ir_serialize.h
+ *
+ * Compact binary encoding of GLSL IR.
+ *
+ * Unlike the s-expression form produced by \c ir_print_visitor, the binary
+ * encoding keeps every field of the IR that later stages depend on (variable
+ * locations, uniform block indices, state slots, ...), so that a linked
+ * shader can be rebuilt exactly without running the front end or the linker
+ * again.
+ *
+ * The encoding is only meant to be read back by the same build of Mesa
+ * running the same driver.  Callers are expected to guard the data with a
+ * suitable header; the reader only makes sure that damaged data cannot make
+ * it read out of bounds.
+ */
+
+#include <stdint.h>
+#include "ir.h"
+
+/**
+ * Version of the encoding.  Bump it with any change to what
+ * ir_serialize.cpp writes, so that data written before the change is
+ * rejected instead of being decoded the wrong way.
+ */
+#define IR_SERIALIZE_VERSION 1
+
+/**
+ * Growable buffer that serialized data is appended to.
+ */
+class memory_writer {
+public:
+   memory_writer(void *mem_ctx);
+
+   void write(const void *data, size_t size);
+
+   void write_uint32(uint32_t value)
+   {
+      write(&value, sizeof(value));
+   }
+
+   void write_int32(int32_t value)
+   {
+      write(&value, sizeof(value));
+   }
+
+   /**
+    * Write an integer in as few bytes as its value allows, which saves a lot
+    * of space for the many small values in serialized IR.
+    */
+   void write_uint(uint32_t value);
+   void write_int(int32_t value);
+
+   /** Write a string, which may be \c NULL. */
+   void write_string(const char *str);
+
+   void *mem_ctx;
+   uint8_t *data;     /**< ralloc'ed out of \c mem_ctx */
+   size_t size;
+   size_t capacity;
+};
+
+/**
+ * Cursor over serialized data.
+ *
+ * Reading past the end of the data yields zeroes and sets \c failed, so that
+ * readers only need to check for errors at points where using a bogus value
+ * would be harmful.  Readers also set \c failed when they find a value they
+ * cannot make sense of.
+ */
+class memory_reader {
+public:
+   memory_reader(const void *data, size_t size);
+
+   void read(void *dst, size_t size);
+   uint32_t read_uint32();
+   int32_t read_int32();
+   uint32_t read_uint();
+   int32_t read_int();
+
+   /** Read a string, allocated out of \c mem_ctx, which may be \c NULL. */
+   char *read_string(void *mem_ctx);
+
+   const uint8_t *current;
+   const uint8_t *end;
+   bool failed;
+};
+
+extern void
+serialize_glsl_type(memory_writer &blob, const glsl_type *type);
+
+extern const glsl_type *
+deserialize_glsl_type(memory_reader &blob);
+
+/**
+ * Serialize a list of IR instructions
+ *
+ * Every variable and function signature referenced by the instructions must
+ * be declared in the list itself, as is the case for a linked shader.
+ *
+ * \return
+ * \c false if the IR references something that is not part of the list.  The
+ * contents of \c blob are undefined in that case.
+ */
+extern bool
+serialize_ir(memory_writer &blob, exec_list *instructions);
+
+/**
+ * Rebuild a list of IR instructions written by \c serialize_ir
+ *
+ * The new instructions are allocated out of \c mem_ctx and appended to
+ * \c instructions.
+ */
+extern bool
+deserialize_ir(memory_reader &blob, void *mem_ctx, exec_list *instructions);
+
+/**
+ * \name Function libraries
+ *
+ * A library of functions can be serialized as its declarations -- global
+ * variables, and functions with their parameters but no bodies -- followed
+ * by the bodies of each function on their own, so that only the functions
+ * that are actually used need to be read back.
+ */
+/*@{*/
+
+/**
+ * Serialize a list of IR instructions as declarations
+ *
+ * The result is read back by \c deserialize_ir, with every function
+ * signature left undefined.
+ */
+extern bool
+serialize_declarations(memory_writer &blob, exec_list *instructions);
+
+/**
+ * Serialize the bodies of the signatures of \c f, which is one of the
+ * functions in \c declarations
+ */
+extern bool
+serialize_function_bodies(memory_writer &blob, exec_list *declarations,
+                          ir_function *f);
+
+/**
+ * Read back the bodies written by \c serialize_function_bodies
+ *
+ * \c declarations must be the list read back from the data written by
+ * \c serialize_declarations, which is only used to resolve references.
+ * Signatures that are already defined are left alone.
+ */
+extern bool
+deserialize_function_bodies(memory_reader &blob, void *mem_ctx,
+                            exec_list *declarations, ir_function *f);
+
+/*@}*/
+
+#endif /* IR_SERIALIZE_H */
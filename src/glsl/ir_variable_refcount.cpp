@@ -50,15 +50,28 @@ ir_variable_refcount_entry *
 ir_variable_refcount_visitor::get_variable_entry(ir_variable *var)
 {
    assert(var);
-   foreach_iter(exec_list_iterator, iter, this->variable_list) {
-      ir_variable_refcount_entry *entry = (ir_variable_refcount_entry *)iter.get();
-      if (entry->var == var)
-	 return entry;
-   }
+   ir_variable_refcount_entry *entry =
+      (ir_variable_refcount_entry *) hash_table_find(this->ht, var);
+   if (entry)
+      return entry;
 
-   ir_variable_refcount_entry *entry = new(mem_ctx) ir_variable_refcount_entry(var);
+   entry = new(mem_ctx) ir_variable_refcount_entry(var);
    assert(entry->referenced_count == 0);
    this->variable_list.push_tail(entry);
+
+   if (++this->num_variables > 4 * this->num_buckets) {
+      hash_table_dtor(this->ht);
+      this->num_buckets *= 8;
+      this->ht = hash_table_ctor(this->num_buckets, hash_table_pointer_hash,
+                                 hash_table_pointer_compare);
+      foreach_list(node, &this->variable_list) {
+         ir_variable_refcount_entry *e = (ir_variable_refcount_entry *) node;
+         hash_table_insert(this->ht, e, e->var);
+      }
+   } else {
+      hash_table_insert(this->ht, entry, var);
+   }
+
    return entry;
 }
 
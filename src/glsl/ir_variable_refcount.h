@@ -32,6 +32,7 @@
 #include "ir.h"
 #include "ir_visitor.h"
 #include "glsl_types.h"
+#include "program/hash_table.h"
 
 class ir_variable_refcount_entry : public exec_node
 {
@@ -56,10 +57,15 @@ public:
    {
       this->mem_ctx = ralloc_context(NULL);
       this->variable_list.make_empty();
+      this->num_variables = 0;
+      this->num_buckets = 64;
+      this->ht = hash_table_ctor(this->num_buckets, hash_table_pointer_hash,
+                                 hash_table_pointer_compare);
    }
 
    ~ir_variable_refcount_visitor(void)
    {
+      hash_table_dtor(this->ht);
       ralloc_free(this->mem_ctx);
    }
 
@@ -74,5 +80,15 @@ public:
    /* List of ir_variable_refcount_entry */
    exec_list variable_list;
 
+   /**
+    * Map from ir_variable to its ir_variable_refcount_entry
+    *
+    * The table is rebuilt with more buckets as the number of variables
+    * grows, so that looking up an entry stays cheap in large shaders.
+    */
+   struct hash_table *ht;
+   unsigned num_variables;
+   unsigned num_buckets;
+
    void *mem_ctx;
 };
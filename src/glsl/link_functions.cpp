@@ -28,6 +28,7 @@
 #include "program.h"
 #include "program/hash_table.h"
 #include "linker.h"
+#include "builtin_library.h"
 
 static ir_function_signature *
 find_matching_signature(const char *name, const exec_list *actual_parameters,
@@ -258,6 +259,12 @@ find_matching_signature(const char *name, const exec_list *actual_parameters,
 
       ir_function_signature *sig = f->matching_signature(actual_parameters);
 
+      /* Don't trust is_defined before the library has been asked: another
+       * thread may be loading the body of a built-in right now.
+       */
+      if (sig != NULL)
+	 load_builtin_function(shader_list[i], f);
+
       if ((sig == NULL) || !sig->is_defined)
 	 continue;
 
@@ -35,6 +35,8 @@
 #include "glsl_parser_extras.h"
 #include "ir_optimization.h"
 #include "ir_print_visitor.h"
+#include "ir_reader.h"
+#include "builtin_library.h"
 #include "program.h"
 #include "loop_analysis.h"
 #include "standalone_scaffolding.h"
@@ -107,14 +109,18 @@ int glsl_es = 0;
 int dump_ast = 0;
 int dump_hir = 0;
 int dump_lir = 0;
+int opt_stats = 0;
 int do_link = 0;
+int serialize_builtins = 0;
 
 const struct option compiler_opts[] = {
    { "glsl-es",  0, &glsl_es,  1 },
    { "dump-ast", 0, &dump_ast, 1 },
    { "dump-hir", 0, &dump_hir, 1 },
    { "dump-lir", 0, &dump_lir, 1 },
+   { "opt-stats", 0, &opt_stats, 1 },
    { "link",     0, &do_link,  1 },
+   { "serialize-builtins", 0, &serialize_builtins, 1 },
    { NULL, 0, NULL, 0 }
 };
 
@@ -133,10 +139,95 @@ usage_fail(const char *name)
    for (const struct option *o = compiler_opts; o->name != 0; ++o) {
       printf("    --%s\n", o->name);
    }
+   printf("\n"
+          "With --serialize-builtins, the arguments are instead:\n"
+          "    <output> <prototypes.ir> <functions.ir>...\n");
    exit(EXIT_FAILURE);
 }
 
 
+/**
+ * Build the built-in function library of a profile, for
+ * generate_builtins.py.
+ *
+ * The prototypes of the profile are read along with the definitions of its
+ * functions, which are then optimized, so that the work doesn't have to be
+ * done again each time the library is used.
+ */
+static int
+write_builtin_library(struct gl_context *ctx, const char *output,
+                      const char *prototypes, char **functions,
+                      unsigned count)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   gl_shader *sh = rzalloc(mem_ctx, gl_shader);
+   sh->Type = GL_VERTEX_SHADER;
+
+   struct _mesa_glsl_parse_state *st =
+      new(sh) _mesa_glsl_parse_state(ctx, sh->Type, sh);
+
+   st->language_version = 140;
+   st->symbols->language_version = 140;
+   st->ARB_texture_rectangle_enable = true;
+   st->EXT_texture_array_enable = true;
+   st->OES_EGL_image_external_enable = true;
+   st->ARB_shader_bit_encoding_enable = true;
+   _mesa_glsl_initialize_types(st);
+
+   sh->ir = new(sh) exec_list;
+
+   const char *text = load_text_file(mem_ctx, prototypes);
+   if (text == NULL) {
+      printf("File \"%s\" does not exist.\n", prototypes);
+      return EXIT_FAILURE;
+   }
+   _mesa_glsl_read_ir(st, sh->ir, text, true);
+
+   /* Read the function bodies, telling the IR reader not to scan for
+    * prototypes (we've already created them).  The IR reader will skip any
+    * signature that does not already exist as a prototype.
+    */
+   for (unsigned i = 0; i < count && !st->error; i++) {
+      text = load_text_file(mem_ctx, functions[i]);
+      if (text == NULL) {
+         printf("File \"%s\" does not exist.\n", functions[i]);
+         return EXIT_FAILURE;
+      }
+      _mesa_glsl_read_ir(st, sh->ir, text, false);
+   }
+
+   if (st->error) {
+      printf("Info log:\n%s\n", st->info_log);
+      return EXIT_FAILURE;
+   }
+
+   do_common_optimization_loop(sh->ir, false, false, 32);
+   validate_ir_tree(sh->ir);
+
+   memory_writer blob(mem_ctx);
+   if (!serialize_builtin_library(blob, sh->ir)) {
+      printf("Failed to serialize the built-in functions\n");
+      return EXIT_FAILURE;
+   }
+
+   FILE *fp = fopen(output, "wb");
+   if (fp == NULL) {
+      printf("Cannot open \"%s\" for writing.\n", output);
+      return EXIT_FAILURE;
+   }
+
+   const bool written = fwrite(blob.data, 1, blob.size, fp) == blob.size;
+   if (fclose(fp) != 0 || !written) {
+      printf("Failed to write \"%s\".\n", output);
+      return EXIT_FAILURE;
+   }
+
+   delete st;
+   ralloc_free(mem_ctx);
+   return EXIT_SUCCESS;
+}
+
+
 void
 compile_shader(struct gl_context *ctx, struct gl_shader *shader)
 {
@@ -173,10 +264,7 @@ compile_shader(struct gl_context *ctx, struct gl_shader *shader)
 
    /* Optimization passes */
    if (!state->error && !shader->ir->is_empty()) {
-      bool progress;
-      do {
-	 progress = do_common_optimization(shader->ir, false, false, 32);
-      } while (progress);
+      do_common_optimization_loop(shader->ir, false, false, 32, opt_stats);
 
       validate_ir_tree(shader->ir);
    }
@@ -225,6 +313,16 @@ main(int argc, char **argv)
 
    initialize_context(ctx, (glsl_es) ? API_OPENGLES2 : API_OPENGL);
 
+   if (serialize_builtins) {
+      if (argc - optind < 2)
+         usage_fail(argv[0]);
+
+      status = write_builtin_library(ctx, argv[optind], argv[optind + 1],
+                                     &argv[optind + 2], argc - optind - 2);
+      _mesa_glsl_release_types();
+      return status;
+   }
+
    struct gl_shader_program *whole_program;
 
    whole_program = rzalloc (NULL, struct gl_shader_program);
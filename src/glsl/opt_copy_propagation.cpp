@@ -37,6 +37,7 @@
 #include "ir_basic_block.h"
 #include "ir_optimization.h"
 #include "glsl_types.h"
+#include "program/hash_table.h"
 
 namespace {
 
@@ -56,6 +57,189 @@ public:
 };
 
 
+class acp_ref : public exec_node
+{
+public:
+   acp_ref(acp_entry *entry)
+      : entry(entry)
+   {
+   }
+
+   acp_entry *entry;
+};
+
+
+/**
+ * The available copies to propagate
+ *
+ * There is at most one copy per LHS variable, since an assignment kills the
+ * previous copy to its LHS before adding its own.  Small tables are searched
+ * linearly.  Once a table grows past \c index_threshold entries, the copies
+ * are also indexed by LHS and RHS variable, so that looking up the copy for
+ * a dereference and killing the copies involving a variable no longer depend
+ * on the number of available copies.  The index is rebuilt with 8 times as
+ * many buckets whenever it averages more than 4 copies per bucket, like
+ * ir_variable_refcount_visitor's table.  Long basic blocks used to make the
+ * pass quadratic.
+ */
+class acp_table
+{
+public:
+   acp_table(void *mem_ctx)
+      : mem_ctx(mem_ctx), count(0), num_buckets(0), by_lhs(NULL), by_rhs(NULL)
+   {
+   }
+
+   ~acp_table()
+   {
+      drop_index();
+   }
+
+   acp_entry *find(ir_variable *lhs)
+   {
+      if (by_lhs != NULL)
+         return (acp_entry *) hash_table_find(by_lhs, lhs);
+
+      foreach_list(node, &entries) {
+         acp_entry *entry = (acp_entry *) node;
+
+         if (entry->lhs == lhs)
+            return entry;
+      }
+
+      return NULL;
+   }
+
+   void add(ir_variable *lhs, ir_variable *rhs)
+   {
+      assert(find(lhs) == NULL);
+
+      acp_entry *entry = new(mem_ctx) acp_entry(lhs, rhs);
+      entries.push_tail(entry);
+      count++;
+
+      if (by_lhs == NULL) {
+         if (count > index_threshold)
+            build_index();
+      } else if (count > 4 * num_buckets) {
+         drop_index();
+         build_index();
+      } else {
+         index(entry);
+      }
+   }
+
+   /** Remove the copies to or from \c var. */
+   void kill(ir_variable *var)
+   {
+      if (by_lhs == NULL) {
+         foreach_list_safe(node, &entries) {
+            acp_entry *entry = (acp_entry *) node;
+
+            if (entry->lhs == var || entry->rhs == var)
+               remove(entry);
+         }
+         return;
+      }
+
+      acp_entry *entry = find(var);
+      if (entry != NULL)
+         remove(entry);
+
+      /* The list of uses of an RHS may refer to copies that have since been
+       * killed through their LHS.  Only remove the ones that are still live.
+       */
+      exec_list *uses = (exec_list *) hash_table_find(by_rhs, var);
+      if (uses != NULL) {
+         foreach_list(node, uses) {
+            acp_entry *use = ((acp_ref *) node)->entry;
+
+            if (find(use->lhs) == use)
+               remove(use);
+         }
+         uses->make_empty();
+      }
+   }
+
+   void make_empty()
+   {
+      entries.make_empty();
+      count = 0;
+      drop_index();
+   }
+
+   void copy_from(acp_table *other)
+   {
+      foreach_list(node, &other->entries) {
+         acp_entry *entry = (acp_entry *) node;
+         add(entry->lhs, entry->rhs);
+      }
+   }
+
+private:
+   static const unsigned index_threshold = 16;
+
+   void remove(acp_entry *entry)
+   {
+      entry->remove();
+      count--;
+
+      if (by_lhs != NULL)
+         hash_table_remove(by_lhs, entry->lhs);
+   }
+
+   void index(acp_entry *entry)
+   {
+      hash_table_insert(by_lhs, entry, entry->lhs);
+
+      exec_list *uses = (exec_list *) hash_table_find(by_rhs, entry->rhs);
+      if (uses == NULL) {
+         uses = new(mem_ctx) exec_list;
+         hash_table_insert(by_rhs, uses, entry->rhs);
+      }
+      uses->push_tail(new(mem_ctx) acp_ref(entry));
+   }
+
+   /** Index all the entries, with two buckets per entry. */
+   void build_index()
+   {
+      num_buckets = count * 2;
+      by_lhs = hash_table_ctor(num_buckets, hash_table_pointer_hash,
+                               hash_table_pointer_compare);
+      by_rhs = hash_table_ctor(num_buckets, hash_table_pointer_hash,
+                               hash_table_pointer_compare);
+
+      foreach_list(node, &entries)
+         index((acp_entry *) node);
+   }
+
+   void drop_index()
+   {
+      if (by_lhs != NULL) {
+         hash_table_dtor(by_lhs);
+         hash_table_dtor(by_rhs);
+         by_lhs = NULL;
+         by_rhs = NULL;
+      }
+   }
+
+   void *mem_ctx;
+   unsigned count;
+
+   /** Number of buckets of each of the index tables */
+   unsigned num_buckets;
+
+   /** List of acp_entry */
+   exec_list entries;
+
+   /** Map from LHS variable to its acp_entry, or NULL if not indexed */
+   struct hash_table *by_lhs;
+
+   /** Map from RHS variable to a list of acp_ref, or NULL if not indexed */
+   struct hash_table *by_rhs;
+};
+
+
 class kill_entry : public exec_node
 {
 public:
@@ -73,12 +257,14 @@ public:
    ir_copy_propagation_visitor()
    {
       progress = false;
+      killed_all = false;
       mem_ctx = ralloc_context(0);
-      this->acp = new(mem_ctx) exec_list;
+      this->acp = new acp_table(mem_ctx);
       this->kills = new(mem_ctx) exec_list;
    }
    ~ir_copy_propagation_visitor()
    {
+      delete this->acp;
       ralloc_free(mem_ctx);
    }
 
@@ -94,8 +280,8 @@ public:
    void kill(ir_variable *ir);
    void handle_if_block(exec_list *instructions);
 
-   /** List of acp_entry: The available copies to propagate */
-   exec_list *acp;
+   /** The available copies to propagate */
+   acp_table *acp;
    /**
     * List of kill_entry: The variables whose values were killed in this
     * block.
@@ -118,16 +304,17 @@ ir_copy_propagation_visitor::visit_enter(ir_function_signature *ir)
     * block.  Any instructions at global scope will be shuffled into
     * main() at link time, so they're irrelevant to us.
     */
-   exec_list *orig_acp = this->acp;
+   acp_table *orig_acp = this->acp;
    exec_list *orig_kills = this->kills;
    bool orig_killed_all = this->killed_all;
 
-   this->acp = new(mem_ctx) exec_list;
+   this->acp = new acp_table(mem_ctx);
    this->kills = new(mem_ctx) exec_list;
    this->killed_all = false;
 
    visit_list_elements(this, &ir->body);
 
+   delete this->acp;
    this->kills = orig_kills;
    this->acp = orig_acp;
    this->killed_all = orig_killed_all;
@@ -165,16 +352,10 @@ ir_copy_propagation_visitor::visit(ir_dereference_variable *ir)
    if (this->in_assignee)
       return visit_continue;
 
-   ir_variable *var = ir->var;
-
-   foreach_iter(exec_list_iterator, iter, *this->acp) {
-      acp_entry *entry = (acp_entry *)iter.get();
-
-      if (var == entry->lhs) {
-	 ir->var = entry->rhs;
-	 this->progress = true;
-	 break;
-      }
+   acp_entry *entry = this->acp->find(ir->var);
+   if (entry != NULL) {
+      ir->var = entry->rhs;
+      this->progress = true;
    }
 
    return visit_continue;
@@ -207,21 +388,19 @@ ir_copy_propagation_visitor::visit_enter(ir_call *ir)
 void
 ir_copy_propagation_visitor::handle_if_block(exec_list *instructions)
 {
-   exec_list *orig_acp = this->acp;
+   acp_table *orig_acp = this->acp;
    exec_list *orig_kills = this->kills;
    bool orig_killed_all = this->killed_all;
 
-   this->acp = new(mem_ctx) exec_list;
+   this->acp = new acp_table(mem_ctx);
    this->kills = new(mem_ctx) exec_list;
    this->killed_all = false;
 
    /* Populate the initial acp with a copy of the original */
-   foreach_iter(exec_list_iterator, iter, *orig_acp) {
-      acp_entry *a = (acp_entry *)iter.get();
-      this->acp->push_tail(new(this->mem_ctx) acp_entry(a->lhs, a->rhs));
-   }
+   this->acp->copy_from(orig_acp);
 
    visit_list_elements(this, instructions);
+   delete this->acp;
 
    if (this->killed_all) {
       orig_acp->make_empty();
@@ -253,7 +432,7 @@ ir_copy_propagation_visitor::visit_enter(ir_if *ir)
 ir_visitor_status
 ir_copy_propagation_visitor::visit_enter(ir_loop *ir)
 {
-   exec_list *orig_acp = this->acp;
+   acp_table *orig_acp = this->acp;
    exec_list *orig_kills = this->kills;
    bool orig_killed_all = this->killed_all;
 
@@ -261,11 +440,12 @@ ir_copy_propagation_visitor::visit_enter(ir_loop *ir)
     * We could go through once, then go through again with the acp
     * cloned minus the killed entries after the first run through.
     */
-   this->acp = new(mem_ctx) exec_list;
+   this->acp = new acp_table(mem_ctx);
    this->kills = new(mem_ctx) exec_list;
    this->killed_all = false;
 
    visit_list_elements(this, &ir->body_instructions);
+   delete this->acp;
 
    if (this->killed_all) {
       orig_acp->make_empty();
@@ -291,13 +471,7 @@ ir_copy_propagation_visitor::kill(ir_variable *var)
    assert(var != NULL);
 
    /* Remove any entries currently in the ACP for this kill. */
-   foreach_iter(exec_list_iterator, iter, *acp) {
-      acp_entry *entry = (acp_entry *)iter.get();
-
-      if (entry->lhs == var || entry->rhs == var) {
-	 entry->remove();
-      }
-   }
+   this->acp->kill(var);
 
    /* Add the LHS variable to the list of killed variables in this block.
     */
@@ -311,8 +485,6 @@ ir_copy_propagation_visitor::kill(ir_variable *var)
 void
 ir_copy_propagation_visitor::add_copy(ir_assignment *ir)
 {
-   acp_entry *entry;
-
    if (ir->condition)
       return;
 
@@ -329,8 +501,7 @@ ir_copy_propagation_visitor::add_copy(ir_assignment *ir)
 	 ir->condition = new(ralloc_parent(ir)) ir_constant(false);
 	 this->progress = true;
       } else {
-	 entry = new(this->mem_ctx) acp_entry(lhs_var, rhs_var);
-	 this->acp->push_tail(entry);
+	 this->acp->add(lhs_var, rhs_var);
       }
    }
 }
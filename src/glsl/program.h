@@ -33,3 +33,11 @@ linker_error(gl_shader_program *prog, const char *fmt, ...)
 extern void
 linker_warning(gl_shader_program *prog, const char *fmt, ...)
    PRINTFLIKE(2, 3);
+
+extern void *
+serialize_program(struct gl_context *ctx, struct gl_shader_program *prog,
+                  void *mem_ctx, size_t *size);
+
+extern void
+load_program_binary(struct gl_context *ctx, struct gl_shader_program *prog,
+                    const void *binary, size_t size);
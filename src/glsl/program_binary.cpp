@@ -0,0 +1,479 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file program_binary.cpp
+ *
+ * Program binaries for GL_ARB_get_program_binary.
+ *
+ * A program binary holds the state produced by \c link_shaders: the IR of
+ * each linked shader, including all the locations assigned by the linker,
+ * and the program-wide link results that cannot be derived from the IR
+ * (uniform blocks, transform feedback outputs, ...).  Loading a binary
+ * restores that state, so that the driver's \c LinkShader hook can run
+ * without parsing, linking or optimizing the shaders again.
+ *
+ * Uniform storage is not part of the binary.  It is rebuilt from the IR by
+ * \c link_assign_uniform_locations, which also resets the uniforms to their
+ * initial values, as required by the extension.
+ *
+ * The IR is the one produced for a particular driver, so the binary starts
+ * with a hash identifying the driver, its configuration, and the versions
+ * of Mesa and of the encoding, along with a checksum of the rest of the
+ * data.
+ */
+
+#include <limits.h>
+#include <stddef.h>
+#include <string.h>
+#include "main/core.h"
+#include "main/shaderobj.h"
+#include "main/version.h"
+#include "ir.h"
+#include "ir_serialize.h"
+#include "linker.h"
+#include "program.h"
+
+#define PROGRAM_BINARY_MAGIC   0x4153454d   /* "MESA" */
+#define PROGRAM_BINARY_VERSION 2
+
+/** magic, version, driver hash, payload size, payload checksum */
+#define PROGRAM_BINARY_HEADER_SIZE (5 * sizeof(uint32_t))
+
+
+/**
+ * 32-bit FNV-1a
+ */
+static uint32_t
+hash_data(uint32_t hash, const void *data, size_t size)
+{
+   const uint8_t *bytes = (const uint8_t *) data;
+
+   for (size_t i = 0; i < size; i++) {
+      hash ^= bytes[i];
+      hash *= 16777619;
+   }
+
+   return hash;
+}
+
+
+/**
+ * Identify the driver and the version of Mesa and of the encoding that a
+ * binary can be used with.
+ *
+ * The extensions and constants of the context are part of it, since the
+ * compiler's output depends on them.  Their structs have no pointers
+ * before the extension string, and contexts are zero-allocated, so the
+ * padding doesn't vary.
+ */
+static uint32_t
+driver_hash(struct gl_context *ctx)
+{
+   static const char version[] = MESA_VERSION_STRING;
+   const unsigned encoding_versions[] = {
+      PROGRAM_BINARY_VERSION, IR_SERIALIZE_VERSION, sizeof(void *)
+   };
+   uint32_t hash = 2166136261u;
+
+   hash = hash_data(hash, version, sizeof(version));
+   hash = hash_data(hash, encoding_versions, sizeof(encoding_versions));
+   hash = hash_data(hash, &ctx->API, sizeof(ctx->API));
+   hash = hash_data(hash, ctx->ShaderCompilerOptions,
+                    sizeof(ctx->ShaderCompilerOptions));
+   hash = hash_data(hash, &ctx->Extensions,
+                    offsetof(struct gl_extensions, String));
+   hash = hash_data(hash, &ctx->Const, sizeof(ctx->Const));
+
+   if (ctx->Driver.GetString) {
+      const char *renderer =
+         (const char *) ctx->Driver.GetString(ctx, GL_RENDERER);
+
+      if (renderer)
+         hash = hash_data(hash, renderer, strlen(renderer));
+   }
+
+   return hash;
+}
+
+
+static void
+write_uniform_blocks(memory_writer &blob,
+                     const struct gl_uniform_block *blocks,
+                     unsigned num_blocks)
+{
+   blob.write_uint32(num_blocks);
+
+   for (unsigned i = 0; i < num_blocks; i++) {
+      const struct gl_uniform_block *const block = &blocks[i];
+
+      blob.write_string(block->Name);
+      blob.write_uint32(block->Binding);
+      blob.write_uint32(block->UniformBufferSize);
+      blob.write_uint32(block->NumUniforms);
+
+      for (unsigned j = 0; j < block->NumUniforms; j++) {
+         const struct gl_uniform_buffer_variable *const var =
+            &block->Uniforms[j];
+
+         blob.write_string(var->Name);
+         serialize_glsl_type(blob, var->Type);
+         blob.write_uint32(var->Buffer);
+         blob.write_uint32(var->Offset);
+         blob.write_uint32(var->RowMajor);
+      }
+   }
+}
+
+static void
+read_uniform_blocks(memory_reader &blob, void *mem_ctx,
+                    struct gl_uniform_block **blocks_out,
+                    unsigned *num_blocks_out)
+{
+   const uint32_t num_blocks = blob.read_uint32();
+
+   *blocks_out = NULL;
+   *num_blocks_out = 0;
+
+   if (num_blocks == 0 || blob.failed)
+      return;
+
+   if ((size_t) (blob.end - blob.current) / 16 < num_blocks) {
+      blob.failed = true;
+      return;
+   }
+
+   struct gl_uniform_block *blocks =
+      rzalloc_array(mem_ctx, struct gl_uniform_block, num_blocks);
+
+   for (unsigned i = 0; i < num_blocks; i++) {
+      struct gl_uniform_block *const block = &blocks[i];
+
+      block->Name = blob.read_string(blocks);
+      block->Binding = blob.read_uint32();
+      block->UniformBufferSize = blob.read_uint32();
+
+      const uint32_t num_uniforms = blob.read_uint32();
+      if (block->Name == NULL
+          || (size_t) (blob.end - blob.current) / 20 < num_uniforms) {
+         blob.failed = true;
+         return;
+      }
+
+      block->Uniforms = rzalloc_array(blocks,
+                                      struct gl_uniform_buffer_variable,
+                                      num_uniforms);
+      block->NumUniforms = num_uniforms;
+
+      for (unsigned j = 0; j < num_uniforms; j++) {
+         struct gl_uniform_buffer_variable *const var = &block->Uniforms[j];
+
+         var->Name = blob.read_string(blocks);
+         var->Type = deserialize_glsl_type(blob);
+         var->Buffer = blob.read_uint32();
+         var->Offset = blob.read_uint32();
+         var->RowMajor = blob.read_uint32() != 0;
+
+         if (var->Name == NULL || var->Type == NULL) {
+            blob.failed = true;
+            return;
+         }
+      }
+   }
+
+   *blocks_out = blocks;
+   *num_blocks_out = num_blocks;
+}
+
+
+static void
+write_transform_feedback_info(memory_writer &blob,
+                              const struct gl_transform_feedback_info *info)
+{
+   blob.write_uint32(info->NumBuffers);
+   for (unsigned i = 0; i < Elements(info->BufferStride); i++)
+      blob.write_uint32(info->BufferStride[i]);
+
+   blob.write_uint32(info->NumOutputs);
+   for (unsigned i = 0; i < info->NumOutputs; i++) {
+      const struct gl_transform_feedback_output *const output =
+         &info->Outputs[i];
+
+      blob.write_uint32(output->OutputRegister);
+      blob.write_uint32(output->OutputBuffer);
+      blob.write_uint32(output->NumComponents);
+      blob.write_uint32(output->DstOffset);
+      blob.write_uint32(output->ComponentOffset);
+   }
+
+   blob.write_uint32(info->NumVarying);
+   for (int i = 0; i < info->NumVarying; i++) {
+      blob.write_string(info->Varyings[i].Name);
+      blob.write_uint32(info->Varyings[i].Type);
+      blob.write_int32(info->Varyings[i].Size);
+   }
+}
+
+static void
+read_transform_feedback_info(memory_reader &blob,
+                             struct gl_shader_program *prog)
+{
+   struct gl_transform_feedback_info *const info =
+      &prog->LinkedTransformFeedback;
+
+   info->NumBuffers = blob.read_uint32();
+   for (unsigned i = 0; i < Elements(info->BufferStride); i++)
+      info->BufferStride[i] = blob.read_uint32();
+
+   const uint32_t num_outputs = blob.read_uint32();
+   if (blob.failed
+       || (size_t) (blob.end - blob.current) / 20 < num_outputs) {
+      blob.failed = true;
+      return;
+   }
+
+   info->Outputs = rzalloc_array(prog, struct gl_transform_feedback_output,
+                                 num_outputs);
+   info->NumOutputs = num_outputs;
+   for (unsigned i = 0; i < num_outputs; i++) {
+      struct gl_transform_feedback_output *const output = &info->Outputs[i];
+
+      output->OutputRegister = blob.read_uint32();
+      output->OutputBuffer = blob.read_uint32();
+      output->NumComponents = blob.read_uint32();
+      output->DstOffset = blob.read_uint32();
+      output->ComponentOffset = blob.read_uint32();
+   }
+
+   const uint32_t num_varyings = blob.read_uint32();
+   if (blob.failed || num_varyings > INT_MAX
+       || (size_t) (blob.end - blob.current) / 12 < num_varyings) {
+      blob.failed = true;
+      return;
+   }
+
+   info->Varyings = rzalloc_array(prog,
+                                  struct gl_transform_feedback_varying_info,
+                                  num_varyings);
+   info->NumVarying = num_varyings;
+   for (unsigned i = 0; i < num_varyings; i++) {
+      info->Varyings[i].Name = blob.read_string(info->Varyings);
+      info->Varyings[i].Type = blob.read_uint32();
+      info->Varyings[i].Size = blob.read_int32();
+
+      if (info->Varyings[i].Name == NULL)
+         blob.failed = true;
+   }
+}
+
+
+/**
+ * Serialize the results of linking \c prog
+ *
+ * \return
+ * The binary, allocated out of \c mem_ctx, or \c NULL if the program cannot
+ * be serialized.
+ */
+void *
+serialize_program(struct gl_context *ctx, struct gl_shader_program *prog,
+                  void *mem_ctx, size_t *size)
+{
+   memory_writer blob(mem_ctx);
+
+   if (!prog->LinkStatus)
+      return NULL;
+
+   /* The payload size and checksum get filled in at the end. */
+   blob.write_uint32(PROGRAM_BINARY_MAGIC);
+   blob.write_uint32(PROGRAM_BINARY_VERSION);
+   blob.write_uint32(driver_hash(ctx));
+   blob.write_uint32(0);
+   blob.write_uint32(0);
+
+   blob.write_uint32(prog->Version);
+   blob.write_uint32(prog->FragDepthLayout);
+   blob.write_uint32(prog->Vert.UsesClipDistance);
+   blob.write_uint32(prog->Vert.ClipDistanceArraySize);
+
+   write_transform_feedback_info(blob, &prog->LinkedTransformFeedback);
+
+   write_uniform_blocks(blob, prog->UniformBlocks, prog->NumUniformBlocks);
+   for (unsigned i = 0; i < MESA_SHADER_TYPES; i++) {
+      const int *const stage_index = prog->UniformBlockStageIndex[i];
+
+      blob.write_uint32(stage_index != NULL);
+      for (unsigned j = 0; stage_index && j < prog->NumUniformBlocks; j++)
+         blob.write_int32(stage_index[j]);
+   }
+
+   for (unsigned i = 0; i < MESA_SHADER_TYPES; i++) {
+      struct gl_shader *const sh = prog->_LinkedShaders[i];
+
+      blob.write_uint32(sh != NULL);
+      if (sh == NULL)
+         continue;
+
+      blob.write_uint32(sh->Version);
+      write_uniform_blocks(blob, sh->UniformBlocks, sh->NumUniformBlocks);
+
+      if (!serialize_ir(blob, sh->ir)) {
+         ralloc_free(blob.data);
+         return NULL;
+      }
+   }
+
+   const uint32_t payload_size = blob.size - PROGRAM_BINARY_HEADER_SIZE;
+   const uint32_t checksum =
+      hash_data(2166136261u, blob.data + PROGRAM_BINARY_HEADER_SIZE,
+                payload_size);
+   memcpy(blob.data + 3 * sizeof(uint32_t), &payload_size, sizeof(uint32_t));
+   memcpy(blob.data + 4 * sizeof(uint32_t), &checksum, sizeof(uint32_t));
+
+   *size = blob.size;
+   return blob.data;
+}
+
+
+/**
+ * Restore the results of linking \c prog from a program binary
+ *
+ * This takes the place of \c link_shaders: \c prog->LinkStatus is set if the
+ * binary could be loaded, and the info log explains why it couldn't
+ * otherwise.
+ */
+void
+load_program_binary(struct gl_context *ctx, struct gl_shader_program *prog,
+                    const void *binary, size_t size)
+{
+   prog->LinkStatus = false;
+   prog->Validated = false;
+   prog->_Used = false;
+
+   ralloc_free(prog->InfoLog);
+   prog->InfoLog = ralloc_strdup(NULL, "");
+
+   ralloc_free(prog->UniformBlocks);
+   prog->UniformBlocks = NULL;
+   prog->NumUniformBlocks = 0;
+   for (int i = 0; i < MESA_SHADER_TYPES; i++) {
+      ralloc_free(prog->UniformBlockStageIndex[i]);
+      prog->UniformBlockStageIndex[i] = NULL;
+   }
+
+   ralloc_free(prog->LinkedTransformFeedback.Varyings);
+   ralloc_free(prog->LinkedTransformFeedback.Outputs);
+   memset(&prog->LinkedTransformFeedback, 0,
+          sizeof(prog->LinkedTransformFeedback));
+
+   for (unsigned i = 0; i < MESA_SHADER_TYPES; i++) {
+      if (prog->_LinkedShaders[i] != NULL)
+	 ctx->Driver.DeleteShader(ctx, prog->_LinkedShaders[i]);
+
+      prog->_LinkedShaders[i] = NULL;
+   }
+
+   uint32_t header[PROGRAM_BINARY_HEADER_SIZE / sizeof(uint32_t)];
+   if (size < sizeof(header)) {
+      linker_error(prog, "program binary is too short\n");
+      return;
+   }
+
+   memcpy(header, binary, sizeof(header));
+   if (header[0] != PROGRAM_BINARY_MAGIC
+       || header[1] != PROGRAM_BINARY_VERSION
+       || header[2] != driver_hash(ctx)) {
+      linker_error(prog, "program binary was created by a different driver "
+                   "or version of Mesa\n");
+      return;
+   }
+
+   const uint8_t *const payload = (const uint8_t *) binary + sizeof(header);
+   if (header[3] != size - sizeof(header)
+       || header[4] != hash_data(2166136261u, payload, header[3])) {
+      linker_error(prog, "program binary is corrupt\n");
+      return;
+   }
+
+   memory_reader blob(payload, header[3]);
+
+   prog->Version = blob.read_uint32();
+   prog->FragDepthLayout = (gl_frag_depth_layout) blob.read_uint32();
+   prog->Vert.UsesClipDistance = blob.read_uint32() != 0;
+   prog->Vert.ClipDistanceArraySize = blob.read_uint32();
+
+   read_transform_feedback_info(blob, prog);
+
+   read_uniform_blocks(blob, prog, &prog->UniformBlocks,
+                       &prog->NumUniformBlocks);
+   for (unsigned i = 0; i < MESA_SHADER_TYPES; i++) {
+      if (blob.read_uint32() == 0)
+         continue;
+
+      prog->UniformBlockStageIndex[i] =
+         ralloc_array(prog, int, MAX2(prog->NumUniformBlocks, 1));
+      for (unsigned j = 0; j < prog->NumUniformBlocks; j++)
+         prog->UniformBlockStageIndex[i][j] = blob.read_int32();
+   }
+
+   for (unsigned i = 0; i < MESA_SHADER_TYPES && !blob.failed; i++) {
+      if (blob.read_uint32() == 0)
+         continue;
+
+      gl_shader *const sh =
+         ctx->Driver.NewShader(NULL, 0, _mesa_shader_index_to_type(i));
+
+      sh->Version = blob.read_uint32();
+      read_uniform_blocks(blob, sh, &sh->UniformBlocks, &sh->NumUniformBlocks);
+
+      sh->ir = new(sh) exec_list;
+      if (!blob.failed)
+         deserialize_ir(blob, sh, sh->ir);
+
+      _mesa_reference_shader(ctx, &prog->_LinkedShaders[i], sh);
+
+      /* The rest of the linker assumes that global variables have names,
+       * and that only uniforms belong to uniform blocks.
+       */
+      foreach_list(node, sh->ir) {
+         ir_variable *const var = ((ir_instruction *) node)->as_variable();
+
+         if (var == NULL)
+            continue;
+
+         if (var->name == NULL
+             || (var->uniform_block != -1
+                 && (var->mode != ir_var_uniform
+                     || var->uniform_block < 0
+                     || var->uniform_block >= (int) sh->NumUniformBlocks)))
+            blob.failed = true;
+      }
+   }
+
+   if (blob.failed || blob.current != blob.end) {
+      linker_error(prog, "program binary is corrupt\n");
+      return;
+   }
+
+   link_assign_uniform_locations(prog);
+   prog->LinkStatus = true;
+}
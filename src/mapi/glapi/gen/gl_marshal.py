@@ -0,0 +1,461 @@
+#!/usr/bin/python2
+
+# Copyright (C) 2013 VMware, Inc.
+# All Rights Reserved.
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# on the rights to use, copy, modify, merge, publish, distribute, sub
+# license, and/or sell copies of the Software, and to permit persons to whom
+# the Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice (including the next
+# paragraph) shall be included in all copies or substantial portions of the
+# Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.  IN NO EVENT SHALL
+# VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+
+# Generates main/marshal_generated.c: the dispatch stubs installed for the
+# application thread when GL commands are executed on a separate thread (see
+# main/glthread.h), and the code that executes the recorded commands.
+
+import gl_XML
+import license
+import sys, getopt
+
+
+# Functions that must not be deferred although they return nothing and
+# take no pointers.
+sync_functions = [
+	'Finish',
+	'PopClientAttrib',
+]
+
+# Functions that set a vertex array pointer.  The pointer is an offset when
+# a buffer object is bound to GL_ARRAY_BUFFER.  Otherwise it points to
+# client memory that later draw calls read, and the thread is disabled for
+# good.
+vertex_pointer_functions = [
+	'VertexPointer',
+	'NormalPointer',
+	'ColorPointer',
+	'IndexPointer',
+	'TexCoordPointer',
+	'EdgeFlagPointer',
+	'FogCoordPointerEXT',
+	'SecondaryColorPointerEXT',
+	'VertexAttribPointerARB',
+	'VertexAttribPointerNV',
+	'VertexAttribIPointerEXT',
+	'InterleavedArrays',
+	'VertexPointerEXT',
+	'NormalPointerEXT',
+	'ColorPointerEXT',
+	'IndexPointerEXT',
+	'TexCoordPointerEXT',
+	'EdgeFlagPointerEXT',
+]
+
+# Functions whose indices are an offset when a buffer object is bound to
+# GL_ELEMENT_ARRAY_BUFFER.
+draw_elements_functions = [
+	'DrawElements',
+	'DrawRangeElements',
+	'DrawElementsInstancedARB',
+	'DrawElementsBaseVertex',
+	'DrawRangeElementsBaseVertex',
+	'DrawElementsInstancedBaseVertex',
+	'DrawElementsInstancedBaseInstance',
+	'DrawElementsInstancedBaseVertexBaseInstance',
+]
+
+# Functions that read or write pixel data through the pixel unpack or pack
+# buffer, on top of those with an image parameter.
+pixel_functions = [
+	'SeparableFilter2D',
+	'GetSeparableFilter',
+	'PixelMapfv',
+	'PixelMapuiv',
+	'PixelMapusv',
+	'GetPixelMapfv',
+	'GetPixelMapuiv',
+	'GetPixelMapusv',
+	'CompressedTexImage1DARB',
+	'CompressedTexImage2DARB',
+	'CompressedTexImage3DARB',
+	'CompressedTexSubImage1DARB',
+	'CompressedTexSubImage2DARB',
+	'CompressedTexSubImage3DARB',
+	'GetCompressedTexImageARB',
+	'ReadnPixelsARB',
+	'GetnTexImageARB',
+	'GetnCompressedTexImageARB',
+]
+
+# Functions that update the state tracked by the application thread.  They
+# call _mesa_glthread_<name> once the command is recorded or executed.
+tracked_functions = [
+	'BindBufferARB',
+	'DeleteBuffersARB',
+	'BindVertexArray',
+	'BindVertexArrayAPPLE',
+	'DeleteVertexArraysAPPLE',
+	'PopClientAttrib',
+]
+
+
+def marshal_params(f):
+	return [p for p in f.parameterIterator() if not p.is_padding]
+
+
+def is_const_pointer(p):
+	t = p.type_string()
+	return t.startswith('const ') and t.count('*') == 1
+
+
+def element_type(p):
+	"""Type of what a pointer parameter points to."""
+	t = p.type_string()
+	return t[len('const '):t.rindex('*')].strip()
+
+
+def is_fixed_array(p):
+	return p.count and not p.count_parameter_list
+
+
+def is_variable_array(p):
+	return p.counter and not p.count_parameter_list
+
+
+def variable_size(p, prefix = ''):
+	"""C expression of the size in bytes of a variable-length array, or -1
+	if it is larger than INT_MAX.  The counter isn't narrowed, since it may
+	be a GLsizeiptr."""
+	t = element_type(p)
+	if t == 'GLvoid' or t == 'void':
+		unit = '1'
+	else:
+		unit = 'sizeof(%s)' % t
+
+	if p.count_scale > 1:
+		unit = '%d * %s' % (p.count_scale, unit)
+
+	return 'safe_mul(%s%s, %s)' % (prefix, p.counter, unit)
+
+
+class PrintCode(gl_XML.gl_print_base):
+	def __init__(self):
+		gl_XML.gl_print_base.__init__(self)
+
+		self.name = 'gl_marshal.py (from Mesa)'
+		self.license = license.bsd_license_template % ( \
+"""Copyright (C) 2013 VMware, Inc.
+All Rights Reserved.""", "VMWARE")
+		return
+
+
+	def printRealHeader(self):
+		print '#include "main/api_exec.h"'
+		print '#include "main/context.h"'
+		print '#include "main/dispatch.h"'
+		print '#include "main/glthread.h"'
+		print '#include "main/marshal.h"'
+		print ''
+		print '#ifdef HAVE_PTHREAD'
+		print ''
+		return
+
+
+	def printRealFooter(self):
+		print '#endif /* HAVE_PTHREAD */'
+		return
+
+
+	def kind(self, f):
+		"""How calls to f are marshalled.
+
+		'sync' calls are executed on the application thread, once the
+		commands recorded before them have been executed.  'async' calls
+		are recorded along with a copy of the data their pointers point
+		to.  'vertex_pointer', 'draw_elements' and 'pixels' calls are
+		recorded with the value of their pointers when a buffer object
+		makes them offsets, and are executed synchronously otherwise.
+		"""
+		if f.name in sync_functions or f.return_type != 'void':
+			return 'sync'
+
+		if f.name in vertex_pointer_functions:
+			return 'vertex_pointer'
+		if f.name in draw_elements_functions:
+			return 'draw_elements'
+
+		pointers = [p for p in marshal_params(f) if p.is_pointer()]
+		if f.name in pixel_functions or [p for p in pointers if p.is_image()]:
+			return 'pixels'
+
+		for p in pointers:
+			if p.is_output or not is_const_pointer(p):
+				return 'sync'
+			if not is_fixed_array(p) and not is_variable_array(p):
+				return 'sync'
+
+		return 'async'
+
+
+	def is_pack(self, f):
+		for p in marshal_params(f):
+			if p.is_pointer() and (p.is_output or not is_const_pointer(p)):
+				return 1
+		return 0
+
+
+	def call(self, f, disp, args):
+		return 'CALL_%s(%s, (%s));' % (f.name, disp, ', '.join(args))
+
+
+	def print_sync_call(self, f, indent):
+		args = [p.name for p in marshal_params(f)]
+		print '%s_mesa_glthread_begin_sync(ctx);' % (indent)
+		if f.return_type != 'void':
+			print '%sresult = %s' % (indent, self.call(f, 'ctx->CurrentDispatch', args))
+		else:
+			print '%s%s' % (indent, self.call(f, 'ctx->CurrentDispatch', args))
+		print '%s_mesa_glthread_end_sync(ctx);' % (indent)
+		if f.name in tracked_functions:
+			print '%s_mesa_glthread_%s(%s);' % (indent, f.name, ', '.join(['ctx'] + args))
+		if f.return_type != 'void':
+			print '%sreturn result;' % (indent)
+		else:
+			print '%sreturn;' % (indent)
+		return
+
+
+	def print_struct(self, f, copy):
+		print 'struct marshal_cmd_%s' % (f.name)
+		print '{'
+		print '   struct marshal_cmd_base cmd_base;'
+		variable = []
+		for p in marshal_params(f):
+			if not p.is_pointer() or not copy:
+				print '   %s %s;' % (p.type_string(), p.name)
+			elif is_fixed_array(p):
+				print '   %s %s[%d];' % (element_type(p), p.name, p.count * p.count_scale)
+			else:
+				print '   GLboolean %s_null;' % (p.name)
+				variable.append(p)
+
+		for p in variable:
+			print '   /* Next %s bytes are %s %s[%s%s], unless %s_null */' \
+				% (variable_size(p), element_type(p), p.name, p.counter,
+				   p.count_scale > 1 and ' * %d' % p.count_scale or '',
+				   p.name)
+		print '};'
+		return variable
+
+
+	def print_unmarshal(self, f, copy, variable):
+		print 'static inline void'
+		print '_mesa_unmarshal_%s(struct gl_context *ctx, const struct marshal_cmd_%s *cmd)' % (f.name, f.name)
+		print '{'
+		if variable:
+			print '   const char *variable_data = (const char *) cmd + marshal_align(sizeof(*cmd));'
+			for p in variable:
+				print '   %s %s;' % (p.type_string(), p.name)
+			for p in variable:
+				print '   if (cmd->%s_null) {' % (p.name)
+				print '      %s = NULL;' % (p.name)
+				print '   }'
+				print '   else {'
+				print '      %s = (%s) variable_data;' % (p.name, p.type_string())
+				print '      variable_data += marshal_align(%s);' % (variable_size(p, 'cmd->'))
+				print '   }'
+		args = []
+		for p in marshal_params(f):
+			if p in variable:
+				args.append(p.name)
+			else:
+				args.append('cmd->' + p.name)
+		print '   %s' % (self.call(f, 'ctx->CurrentDispatch', args))
+		print '}'
+		return
+
+
+	def print_async_declarations(self, f, variable):
+		if marshal_params(f):
+			print '   struct marshal_cmd_%s *cmd;' % (f.name)
+		if variable:
+			for p in variable:
+				print '   GLsizeiptr %s_size = %s;' % (p.name, variable_size(p))
+			print '   size_t cmd_size = marshal_align(sizeof(struct marshal_cmd_%s));' % (f.name)
+		else:
+			print '   const size_t cmd_size = sizeof(struct marshal_cmd_%s);' % (f.name)
+		return
+
+
+	def print_async_body(self, f, copy, variable):
+		if variable:
+			print '   if (unlikely(%s)) {' % (' || '.join(['%s_size < 0' % p.name for p in variable]))
+			self.print_sync_call(f, '      ')
+			print '   }'
+			for p in variable:
+				print '   if (%s)' % (p.name)
+				print '      cmd_size += marshal_align(%s_size);' % (p.name)
+			print '   if (unlikely(cmd_size > MARSHAL_MAX_CMD_SIZE)) {'
+			self.print_sync_call(f, '      ')
+			print '   }'
+
+		if marshal_params(f):
+			print '   cmd = _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_%s, cmd_size);' % (f.name)
+		else:
+			print '   _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_%s, cmd_size);' % (f.name)
+		for p in marshal_params(f):
+			if not p.is_pointer() or not copy:
+				print '   cmd->%s = %s;' % (p.name, p.name)
+			elif is_fixed_array(p):
+				print '   memcpy(cmd->%s, %s, sizeof(cmd->%s));' % (p.name, p.name, p.name)
+
+		if variable:
+			print '   {'
+			print '      char *variable_data = (char *) cmd + marshal_align(sizeof(*cmd));'
+			for p in variable:
+				print '      cmd->%s_null = !%s;' % (p.name, p.name)
+				print '      if (%s) {' % (p.name)
+				print '         memcpy(variable_data, %s, %s_size);' % (p.name, p.name)
+				print '         variable_data += marshal_align(%s_size);' % (p.name)
+				print '      }'
+			print '   }'
+
+		if f.name == 'Flush':
+			print '   _mesa_glthread_flush_batch(ctx);'
+		elif f.name in tracked_functions:
+			args = [p.name for p in marshal_params(f)]
+			print '   _mesa_glthread_%s(%s);' % (f.name, ', '.join(['ctx'] + args))
+		return
+
+
+	def print_marshal(self, f, kind, copy, variable):
+		print 'static %s GLAPIENTRY' % (f.return_type)
+		print '_mesa_marshal_%s(%s)' % (f.name, f.get_parameter_string())
+		print '{'
+		print '   GET_CURRENT_CONTEXT(ctx);'
+		if kind == 'sync':
+			if f.return_type != 'void':
+				print '   %s result;' % (f.return_type)
+			self.print_sync_call(f, '   ')
+			print '}'
+			return
+
+		self.print_async_declarations(f, variable)
+		if kind == 'vertex_pointer':
+			print '   if (!ctx->GLThread->ArrayBuffer) {'
+			print '      _mesa_glthread_disable(ctx, "%s");' % (f.name)
+			print '      %s' % (self.call(f, 'ctx->CurrentDispatch', [p.name for p in marshal_params(f)]))
+			print '      return;'
+			print '   }'
+		elif kind == 'draw_elements':
+			print '   if (!ctx->GLThread->ElementArrayBuffer) {'
+			self.print_sync_call(f, '      ')
+			print '   }'
+		elif kind == 'pixels':
+			if self.is_pack(f):
+				print '   if (!ctx->GLThread->PixelPackBuffer) {'
+			else:
+				print '   if (!ctx->GLThread->PixelUnpackBuffer) {'
+			self.print_sync_call(f, '      ')
+			print '   }'
+
+		self.print_async_body(f, copy, variable)
+		print '}'
+		return
+
+
+	def printBody(self, api):
+		marshalled = []
+		for f in api.functionIterateByOffset():
+			if self.kind(f) != 'sync':
+				marshalled.append(f)
+
+		print 'enum marshal_dispatch_cmd_id'
+		print '{'
+		for f in marshalled:
+			print '   DISPATCH_CMD_%s,' % (f.name)
+		print '};'
+		print ''
+		print ''
+
+		for f in api.functionIterateByOffset():
+			kind = self.kind(f)
+			copy = kind == 'async'
+
+			print '/* %s: marshalled %s */' % (f.name, kind == 'sync' and 'synchronously' or 'asynchronously')
+			if kind != 'sync':
+				variable = self.print_struct(f, copy)
+				self.print_unmarshal(f, copy, variable)
+			else:
+				variable = []
+			self.print_marshal(f, kind, copy, variable)
+			print ''
+
+		print ''
+		print 'size_t'
+		print '_mesa_unmarshal_dispatch_cmd(struct gl_context *ctx, const void *cmd)'
+		print '{'
+		print '   const struct marshal_cmd_base *cmd_base = cmd;'
+		print '   switch (cmd_base->cmd_id) {'
+		for f in marshalled:
+			print '   case DISPATCH_CMD_%s:' % (f.name)
+			print '      _mesa_unmarshal_%s(ctx, (const struct marshal_cmd_%s *) cmd);' % (f.name, f.name)
+			print '      break;'
+		print '   default:'
+		print '      assert(!"Invalid marshalled command");'
+		print '      break;'
+		print '   }'
+		print '   return cmd_base->cmd_size;'
+		print '}'
+		print ''
+		print ''
+		print 'struct _glapi_table *'
+		print '_mesa_create_marshal_table(const struct gl_context *ctx)'
+		print '{'
+		print '   struct _glapi_table *table;'
+		print ''
+		print '   table = _mesa_alloc_dispatch_table(_gloffset_COUNT);'
+		print '   if (table == NULL)'
+		print '      return NULL;'
+		print ''
+		for f in api.functionIterateByOffset():
+			print '   SET_%s(table, _mesa_marshal_%s);' % (f.name, f.name)
+		print ''
+		print '   return table;'
+		print '}'
+		print ''
+		return
+
+
+def show_usage():
+	print "Usage: %s [-f input_file_name]" % sys.argv[0]
+	sys.exit(1)
+
+if __name__ == '__main__':
+	file_name = "gl_API.xml"
+
+	try:
+		(args, trail) = getopt.getopt(sys.argv[1:], "f:")
+	except Exception,e:
+		show_usage()
+
+	for (arg,val) in args:
+		if arg == "-f":
+			file_name = val
+
+	printer = PrintCode()
+
+	api = gl_XML.parse_GL_API( file_name )
+	printer.Print( api )
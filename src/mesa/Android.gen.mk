@@ -32,6 +32,7 @@ intermediates := $(call local-intermediates-dir)
 # This is the list of auto-generated files: sources and headers
 sources := \
 	main/enums.c \
+	main/marshal_generated.c \
 	main/api_exec_es1.c \
 	main/api_exec_es1_dispatch.h \
 	main/api_exec_es1_remap_helper.h \
@@ -146,3 +147,9 @@ $(intermediates)/main/enums.c: PRIVATE_XML := -f $(glapi)/gl_and_es_API.xml
 
 $(intermediates)/main/enums.c: $(es_src_deps)
 	$(call es-gen)
+
+$(intermediates)/main/marshal_generated.c: PRIVATE_SCRIPT :=$(MESA_PYTHON2) $(glapi)/gl_marshal.py
+$(intermediates)/main/marshal_generated.c: PRIVATE_XML := -f $(glapi)/gl_API.xml
+
+$(intermediates)/main/marshal_generated.c: $(es_hdr_deps)
+	$(call es-gen)
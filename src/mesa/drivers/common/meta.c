@@ -927,8 +927,8 @@ _mesa_meta_end(struct gl_context *ctx)
 	 _mesa_use_shader_program(ctx, GL_FRAGMENT_SHADER,
 				  save->FragmentShader);
 
-      _mesa_reference_shader_program(ctx, &ctx->Shader.ActiveProgram,
-				     save->ActiveShader);
+      _mesa_reference_current_program(ctx, &ctx->Shader.ActiveProgram,
+				      save->ActiveShader);
 
       _mesa_reference_shader_program(ctx, &save->VertexShader, NULL);
       _mesa_reference_shader_program(ctx, &save->GeometryShader, NULL);
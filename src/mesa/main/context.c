@@ -96,8 +96,10 @@
 #include "fbobject.h"
 #include "feedback.h"
 #include "fog.h"
+#include "format_simd.h"
 #include "formats.h"
 #include "framebuffer.h"
+#include "glthread.h"
 #include "hint.h"
 #include "hash.h"
 #include "light.h"
@@ -403,6 +405,7 @@ one_time_init( struct gl_context *ctx )
       assert( sizeof(GLuint) == 4 );
 
       _mesa_get_cpu_features();
+      _mesa_init_simd_conversions();
 
       /* context dependence is never a one-time thing... */
       _mesa_init_get_hash(ctx);
@@ -1090,6 +1093,8 @@ _mesa_create_context(gl_api api,
 void
 _mesa_free_context_data( struct gl_context *ctx )
 {
+   _mesa_glthread_destroy(ctx);
+
    if (!_mesa_get_current_context()){
       /* No current context, but we may need one in order to delete
        * texture objs, etc.  So temporarily bind the context now.
@@ -1426,6 +1431,10 @@ _mesa_make_current( struct gl_context *newCtx,
       }
    }
 
+   /* The commands recorded so far apply to the old bindings. */
+   if (curCtx)
+      _mesa_glthread_finish(curCtx);
+
    if (curCtx && 
       (curCtx->WinSysDrawBuffer || curCtx->WinSysReadBuffer) &&
        /* make sure this context is valid for flushing */
@@ -1440,7 +1449,10 @@ _mesa_make_current( struct gl_context *newCtx,
       _glapi_set_dispatch(NULL);  /* none current */
    }
    else {
-      _glapi_set_dispatch(newCtx->CurrentDispatch);
+      if (newCtx->GLThread)
+         _glapi_set_dispatch(newCtx->MarshalExec);
+      else
+         _glapi_set_dispatch(newCtx->CurrentDispatch);
 
       if (drawBuffer && readBuffer) {
          ASSERT(_mesa_is_winsys_fbo(drawBuffer));
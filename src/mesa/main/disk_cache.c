@@ -0,0 +1,597 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2013  VMware, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * \file disk_cache.c
+ * Persistent cache of blobs keyed by SHA-1, shared between processes.
+ *
+ * Every entry is a file named after its key, in one of 256 subdirectories
+ * of the cache directory.  Entries are written to a temporary file which is
+ * then renamed into place, so readers in other processes never see a
+ * partial entry, and each entry carries its key and a checksum of its data
+ * so that a damaged file is detected and dropped rather than used.
+ *
+ * Entries are mapped rather than read.  Reading an entry updates its
+ * modification time, and when the total size of the cache exceeds its
+ * limit, the least recently used entry of a randomly chosen subdirectory is
+ * removed, which approximates LRU eviction without any global bookkeeping
+ * besides the total size.  That size lives in a small index file that all
+ * the processes using the cache map and update atomically.
+ *
+ * The cache is controlled by these environment variables:
+ *
+ * MESA_GLSL_CACHE_DISABLE - disable the cache
+ * MESA_GLSL_CACHE_DIR - cache directory, by default $XDG_CACHE_HOME/mesa
+ *                       or $HOME/.cache/mesa
+ * MESA_GLSL_CACHE_MAX_SIZE - size limit, with an optional K, M or G
+ *                            suffix, 1G by default
+ */
+
+
+#include "imports.h"
+#include "disk_cache.h"
+
+
+#if defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__) || \
+    defined(__OpenBSD__) || defined(__NetBSD__) || defined(__sun)
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#define CACHE_ENTRY_MAGIC 0x4353454d   /* "MESC" */
+
+/** Evictions done by a single _mesa_disk_cache_put(), at most */
+#define MAX_EVICTIONS 16
+
+/** Age after which a leftover temporary file is removed, in seconds */
+#define STALE_TMP_AGE (60 * 60)
+
+
+struct cache_entry_header
+{
+   uint32_t magic;
+   uint32_t size;                      /**< size of the data */
+   uint32_t checksum;                  /**< checksum of the data */
+   uint8_t key[SHA1_DIGEST_LENGTH];
+};
+
+
+struct disk_cache
+{
+   char *path;
+
+   /** Total size of the entries, in the index file shared by all users */
+   uint64_t *size;
+   void *index_mmap;
+   size_t index_mmap_size;
+
+   uint64_t max_size;
+   unsigned seed;                      /**< for picking eviction victims */
+};
+
+
+#if defined(__GNUC__)
+#define size_add(cache, value) __sync_add_and_fetch((cache)->size, (value))
+#else
+#define size_add(cache, value) (*(cache)->size += (value))
+#endif
+
+
+static void
+size_sub(struct disk_cache *cache, uint64_t value)
+{
+   /* Entries created before the index may get evicted, so don't let the
+    * size wrap around.
+    */
+   if (size_add(cache, (uint64_t) 0 - value) > ((uint64_t) 1 << 62))
+      *cache->size = 0;
+}
+
+
+static uint32_t
+checksum(const void *data, size_t size)
+{
+   const uint8_t *bytes = (const uint8_t *) data;
+   uint32_t hash = 2166136261u;
+   size_t i;
+
+   for (i = 0; i < size; i++) {
+      hash ^= bytes[i];
+      hash *= 16777619;
+   }
+
+   return hash;
+}
+
+
+/**
+ * Create a directory and its missing parents.
+ */
+static GLboolean
+make_dirs(char *path)
+{
+   struct stat st;
+   char *p;
+
+   for (p = path + 1; ; p++) {
+      if (*p != '/' && *p != '\0')
+         continue;
+
+      if (p[-1] != '/') {
+         const char c = *p;
+
+         *p = '\0';
+         if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+            *p = c;
+            return GL_FALSE;
+         }
+         *p = c;
+      }
+
+      if (*p == '\0')
+         break;
+   }
+
+   return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+
+static char *
+get_cache_path(void)
+{
+   const char *dir = _mesa_getenv("MESA_GLSL_CACHE_DIR");
+   char buf[4096];
+
+   if (dir && dir[0]) {
+      _mesa_snprintf(buf, sizeof(buf), "%s", dir);
+   }
+   else if ((dir = _mesa_getenv("XDG_CACHE_HOME")) && dir[0] == '/') {
+      _mesa_snprintf(buf, sizeof(buf), "%s/mesa", dir);
+   }
+   else if ((dir = _mesa_getenv("HOME")) && dir[0] == '/') {
+      _mesa_snprintf(buf, sizeof(buf), "%s/.cache/mesa", dir);
+   }
+   else {
+      return NULL;
+   }
+
+   if (!make_dirs(buf))
+      return NULL;
+
+   return _mesa_strdup(buf);
+}
+
+
+static uint64_t
+get_max_size(void)
+{
+   const char *str = _mesa_getenv("MESA_GLSL_CACHE_MAX_SIZE");
+   uint64_t size;
+   char *end;
+
+   if (!str)
+      return (uint64_t) 1 << 30;
+
+   size = strtoull(str, &end, 10);
+   switch (*end) {
+   case 'g':
+   case 'G':
+      size <<= 10;
+      /* fallthrough */
+   case 'm':
+   case 'M':
+      size <<= 10;
+      /* fallthrough */
+   case 'k':
+   case 'K':
+      size <<= 10;
+      break;
+   default:
+      break;
+   }
+
+   return size;
+}
+
+
+/**
+ * Open the cache, or return NULL if it is disabled or unusable.
+ */
+struct disk_cache *
+_mesa_disk_cache_create(void)
+{
+   struct disk_cache *cache;
+   char index_path[4096];
+   struct stat st;
+   int fd;
+
+   if (_mesa_getenv("MESA_GLSL_CACHE_DISABLE"))
+      return NULL;
+
+   /* Don't let setuid programs write into the user's cache. */
+   if (geteuid() != getuid())
+      return NULL;
+
+   cache = CALLOC_STRUCT(disk_cache);
+   if (!cache)
+      return NULL;
+
+   cache->max_size = get_max_size();
+   cache->seed = (unsigned) getpid() ^ (unsigned) time(NULL);
+   cache->path = get_cache_path();
+   if (!cache->path || cache->max_size == 0)
+      goto fail;
+
+   _mesa_snprintf(index_path, sizeof(index_path), "%s/index", cache->path);
+   fd = open(index_path, O_RDWR | O_CREAT, 0644);
+   if (fd < 0)
+      goto fail;
+
+   /* Several processes may do this at the same time, which is fine since
+    * they all grow the file to the same size.
+    */
+   if (fstat(fd, &st) != 0 ||
+       (st.st_size < (off_t) sizeof(uint64_t) &&
+        ftruncate(fd, sizeof(uint64_t)) != 0)) {
+      close(fd);
+      goto fail;
+   }
+
+   cache->index_mmap_size = sizeof(uint64_t);
+   cache->index_mmap = mmap(NULL, cache->index_mmap_size,
+                            PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+   if (cache->index_mmap == MAP_FAILED)
+      goto fail;
+
+   cache->size = (uint64_t *) cache->index_mmap;
+
+   return cache;
+
+fail:
+   free(cache->path);
+   free(cache);
+   return NULL;
+}
+
+
+void
+_mesa_disk_cache_destroy(struct disk_cache *cache)
+{
+   if (!cache)
+      return;
+
+   munmap(cache->index_mmap, cache->index_mmap_size);
+   free(cache->path);
+   free(cache);
+}
+
+
+static void
+get_entry_path(const struct disk_cache *cache,
+               const uint8_t key[SHA1_DIGEST_LENGTH],
+               char *dir, size_t dir_size, char *path, size_t path_size)
+{
+   char name[2 * SHA1_DIGEST_LENGTH + 1];
+
+   _mesa_sha1_format(name, key);
+   _mesa_snprintf(dir, dir_size, "%s/%c%c", cache->path, name[0], name[1]);
+   _mesa_snprintf(path, path_size, "%s/%s", dir, name + 2);
+}
+
+
+/**
+ * Look up an entry.
+ *
+ * \return  a read-only mapping of the entry's data, to be released with
+ *          _mesa_disk_cache_release(), or NULL if there is no valid entry
+ *          for the key
+ */
+void *
+_mesa_disk_cache_get(struct disk_cache *cache,
+                     const uint8_t key[SHA1_DIGEST_LENGTH], size_t *size)
+{
+   const struct cache_entry_header *header;
+   char dir[4096], path[4096];
+   struct stat st;
+   uint8_t *map;
+   int fd;
+
+   if (!cache)
+      return NULL;
+
+   get_entry_path(cache, key, dir, sizeof(dir), path, sizeof(path));
+
+   fd = open(path, O_RDONLY);
+   if (fd < 0)
+      return NULL;
+
+   if (fstat(fd, &st) != 0 ||
+       st.st_size < (off_t) sizeof(*header) ||
+       st.st_size - sizeof(*header) > UINT32_MAX) {
+      close(fd);
+      return NULL;
+   }
+
+   map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   if (map == MAP_FAILED) {
+      close(fd);
+      return NULL;
+   }
+
+   header = (const struct cache_entry_header *) map;
+   if (header->magic != CACHE_ENTRY_MAGIC ||
+       header->size != st.st_size - sizeof(*header) ||
+       memcmp(header->key, key, SHA1_DIGEST_LENGTH) != 0 ||
+       header->checksum != checksum(map + sizeof(*header), header->size)) {
+      munmap(map, st.st_size);
+      close(fd);
+
+      /* Entries are renamed into place when complete, so this one is
+       * damaged for good.
+       */
+      if (unlink(path) == 0)
+         size_sub(cache, st.st_size);
+      return NULL;
+   }
+
+   /* Mark the entry as recently used. */
+   futimens(fd, NULL);
+   close(fd);
+
+   *size = header->size;
+   return map + sizeof(*header);
+}
+
+
+void
+_mesa_disk_cache_release(void *data, size_t size)
+{
+   const size_t header_size = sizeof(struct cache_entry_header);
+
+   munmap((uint8_t *) data - header_size, size + header_size);
+}
+
+
+/**
+ * Remove the least recently used entry of a random subdirectory.
+ */
+static GLboolean
+evict_one(struct disk_cache *cache)
+{
+   const unsigned start = cache->seed = cache->seed * 1103515245 + 12345;
+   const time_t now = time(NULL);
+   unsigned i;
+
+   for (i = 0; i < 256; i++) {
+      char dir_path[4096], path[4096], victim[4096];
+      struct dirent *entry;
+      time_t victim_mtime = 0;
+      off_t victim_size = 0;
+      DIR *dir;
+
+      _mesa_snprintf(dir_path, sizeof(dir_path), "%s/%02x", cache->path,
+                     (start + i) & 0xff);
+      dir = opendir(dir_path);
+      if (!dir)
+         continue;
+
+      victim[0] = '\0';
+      while ((entry = readdir(dir)) != NULL) {
+         struct stat st;
+
+         if (entry->d_name[0] == '.')
+            continue;
+
+         _mesa_snprintf(path, sizeof(path), "%s/%s", dir_path,
+                        entry->d_name);
+         if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+            continue;
+
+         /* Temporary files are not accounted for.  Remove the ones left
+          * behind by processes that died while writing them.
+          */
+         if (strchr(entry->d_name, '.')) {
+            if (now - st.st_mtime > STALE_TMP_AGE)
+               unlink(path);
+            continue;
+         }
+
+         if (!victim[0] || st.st_mtime < victim_mtime) {
+            memcpy(victim, path, sizeof(victim));
+            victim_mtime = st.st_mtime;
+            victim_size = st.st_size;
+         }
+      }
+      closedir(dir);
+
+      if (victim[0]) {
+         if (unlink(victim) == 0)
+            size_sub(cache, victim_size);
+         return GL_TRUE;
+      }
+   }
+
+   /* The cache is empty, whatever the index says. */
+   *cache->size = 0;
+   return GL_FALSE;
+}
+
+
+static GLboolean
+write_all(int fd, const void *data, size_t size)
+{
+   const uint8_t *p = (const uint8_t *) data;
+
+   while (size) {
+      const ssize_t n = write(fd, p, size);
+
+      if (n < 0) {
+         if (errno == EINTR)
+            continue;
+         return GL_FALSE;
+      }
+
+      p += n;
+      size -= n;
+   }
+
+   return GL_TRUE;
+}
+
+
+/**
+ * Store an entry, unless there is one for the key already.
+ *
+ * Failures are silently ignored: the cache is only an optimization.
+ */
+void
+_mesa_disk_cache_put(struct disk_cache *cache,
+                     const uint8_t key[SHA1_DIGEST_LENGTH],
+                     const void *data, size_t size)
+{
+   static unsigned tmp_count = 0;
+   struct cache_entry_header header;
+   char dir[4096], path[4096], tmp_path[4096];
+   unsigned i;
+   int fd;
+
+   if (!cache || size > UINT32_MAX || size + sizeof(header) > cache->max_size)
+      return;
+
+   get_entry_path(cache, key, dir, sizeof(dir), path, sizeof(path));
+
+   if (access(path, F_OK) == 0)
+      return;
+
+   if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+      return;
+
+   /* The temporary file name must be unique among all the writers, in all
+    * processes.  It contains a dot, which entry names never do.
+    */
+#if defined(__GNUC__)
+   i = __sync_add_and_fetch(&tmp_count, 1);
+#else
+   i = ++tmp_count;
+#endif
+   _mesa_snprintf(tmp_path, sizeof(tmp_path), "%s.%d.%u", path,
+                  (int) getpid(), i);
+
+   fd = open(tmp_path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+   if (fd < 0)
+      return;
+
+   header.magic = CACHE_ENTRY_MAGIC;
+   header.size = (uint32_t) size;
+   header.checksum = checksum(data, size);
+   memcpy(header.key, key, SHA1_DIGEST_LENGTH);
+
+   if (!write_all(fd, &header, sizeof(header)) ||
+       !write_all(fd, data, size)) {
+      close(fd);
+      unlink(tmp_path);
+      return;
+   }
+   close(fd);
+
+   /* Unlike rename(), link() doesn't replace an entry written by another
+    * process in the meantime, which would then be accounted for twice.
+    */
+   if (link(tmp_path, path) != 0) {
+      if (errno == EEXIST || rename(tmp_path, path) != 0) {
+         unlink(tmp_path);
+         return;
+      }
+   }
+   else {
+      unlink(tmp_path);
+   }
+
+   if (size_add(cache, size + sizeof(header)) > cache->max_size) {
+      for (i = 0; i < MAX_EVICTIONS && *cache->size > cache->max_size; i++) {
+         if (!evict_one(cache))
+            break;
+      }
+   }
+}
+
+
+#else /* no POSIX file mapping */
+
+
+struct disk_cache *
+_mesa_disk_cache_create(void)
+{
+   return NULL;
+}
+
+
+void
+_mesa_disk_cache_destroy(struct disk_cache *cache)
+{
+   (void) cache;
+}
+
+
+void *
+_mesa_disk_cache_get(struct disk_cache *cache,
+                     const uint8_t key[SHA1_DIGEST_LENGTH], size_t *size)
+{
+   (void) cache;
+   (void) key;
+   (void) size;
+   return NULL;
+}
+
+
+void
+_mesa_disk_cache_release(void *data, size_t size)
+{
+   (void) data;
+   (void) size;
+}
+
+
+void
+_mesa_disk_cache_put(struct disk_cache *cache,
+                     const uint8_t key[SHA1_DIGEST_LENGTH],
+                     const void *data, size_t size)
+{
+   (void) cache;
+   (void) key;
+   (void) data;
+   (void) size;
+}
+
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2013  VMware, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * \file disk_cache.h
+ * Persistent cache of blobs keyed by SHA-1, shared between processes.
+ */
+
+
+#ifndef DISK_CACHE_H
+#define DISK_CACHE_H
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sha1.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+struct disk_cache;
+
+
+extern struct disk_cache *
+_mesa_disk_cache_create(void);
+
+extern void
+_mesa_disk_cache_destroy(struct disk_cache *cache);
+
+extern void *
+_mesa_disk_cache_get(struct disk_cache *cache,
+                     const uint8_t key[SHA1_DIGEST_LENGTH], size_t *size);
+
+extern void
+_mesa_disk_cache_release(void *data, size_t size);
+
+extern void
+_mesa_disk_cache_put(struct disk_cache *cache,
+                     const uint8_t key[SHA1_DIGEST_LENGTH],
+                     const void *data, size_t size);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DISK_CACHE_H */
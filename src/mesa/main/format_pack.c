@@ -37,6 +37,7 @@
 
 #include "colormac.h"
 #include "format_pack.h"
+#include "format_simd.h"
 #include "macros.h"
 #include "../../gallium/auxiliary/util/u_format_rgb9e5.h"
 #include "../../gallium/auxiliary/util/u_format_r11g11b10f.h"
@@ -2030,8 +2031,13 @@ void
 _mesa_pack_float_rgba_row(gl_format format, GLuint n,
                           const GLfloat src[][4], void *dst)
 {
+   const struct simd_conversion *conv =
+      _mesa_get_simd_conversion(MESA_FORMAT_RGBA_FLOAT32, format);
    pack_float_rgba_row_func packrow = get_pack_float_rgba_row_function(format);
-   if (packrow) {
+   if (conv) {
+      _mesa_simd_convert_row(conv, src, dst, n);
+   }
+   else if (packrow) {
       /* use "fast" function */
       packrow(n, src, dst);
    }
@@ -2061,8 +2067,13 @@ void
 _mesa_pack_ubyte_rgba_row(gl_format format, GLuint n,
                           const GLubyte src[][4], void *dst)
 {
+   const struct simd_conversion *conv =
+      _mesa_get_simd_conversion(MESA_FORMAT_RGBA8888_REV, format);
    pack_ubyte_rgba_row_func packrow = get_pack_ubyte_rgba_row_function(format);
-   if (packrow) {
+   if (conv) {
+      _mesa_simd_convert_row(conv, src, dst, n);
+   }
+   else if (packrow) {
       /* use "fast" function */
       packrow(n, src, dst);
    }
@@ -2095,11 +2106,20 @@ _mesa_pack_ubyte_rgba_rect(gl_format format, GLuint width, GLuint height,
                            const GLubyte *src, GLint srcRowStride,
                            void *dst, GLint dstRowStride)
 {
+   const struct simd_conversion *conv =
+      _mesa_get_simd_conversion(MESA_FORMAT_RGBA8888_REV, format);
    pack_ubyte_rgba_row_func packrow = get_pack_ubyte_rgba_row_function(format);
    GLubyte *dstUB = (GLubyte *) dst;
    GLuint i;
 
-   if (packrow) {
+   if (conv) {
+      for (i = 0; i < height; i++) {
+         _mesa_simd_convert_row(conv, src, dstUB, width);
+         src += srcRowStride;
+         dstUB += dstRowStride;
+      }
+   }
+   else if (packrow) {
       if (srcRowStride == width * 4 * sizeof(GLubyte) &&
           dstRowStride == _mesa_format_row_stride(format, width)) {
          /* do whole image at once */
@@ -2557,12 +2577,19 @@ _mesa_pack_uint_24_8_depth_stencil_row(gl_format format, GLuint n,
       break;
    case MESA_FORMAT_S8_Z24:
       {
+         const struct simd_conversion *conv =
+            _mesa_get_simd_conversion(MESA_FORMAT_Z24_S8, format);
          GLuint *d = ((GLuint *) dst);
          GLuint i;
-         for (i = 0; i < n; i++) {
-            GLuint s = src[i] << 24;
-            GLuint z = src[i] >> 8;
-            d[i] = s | z;
+         if (conv) {
+            _mesa_simd_convert_row(conv, src, dst, n);
+         }
+         else {
+            for (i = 0; i < n; i++) {
+               GLuint s = src[i] << 24;
+               GLuint z = src[i] >> 8;
+               d[i] = s | z;
+            }
          }
       }
       break;
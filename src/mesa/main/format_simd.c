@@ -0,0 +1,565 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2013  VMware, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+ * AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * \file format_simd.c
+ * SSE2/SSSE3 conversions between pixel formats.
+ *
+ * The kernels give exactly the same results as the per-pixel code in
+ * format_pack.c, format_unpack.c and imports.c.  They are compiled in when
+ * the compiler targets SSE2 (always the case on x86-64); the byte swizzles
+ * use pshufb when it also targets SSSE3.  Elsewhere there are no
+ * conversions and callers keep using their generic paths.
+ *
+ * GLubyte[4] RGBA arrays are MESA_FORMAT_RGBA8888_REV pixels, and GLfloat[4]
+ * arrays MESA_FORMAT_RGBA_FLOAT32 pixels, on the little-endian CPUs these
+ * kernels run on.
+ */
+
+
+#include "glheader.h"
+#include "colormac.h"
+#include "format_simd.h"
+#include "imports.h"
+#include "macros.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+
+typedef void (*simd_convert_row_func)(const struct simd_conversion *conv,
+                                      const void *src, void *dst, GLuint n);
+
+struct simd_conversion
+{
+   gl_format SrcFormat;
+   gl_format DstFormat;
+   simd_convert_row_func ConvertRow;
+
+   /** For conversions between 32-bit RGBA formats: the byte swizzle */
+   GLubyte Map[4];
+
+   /** Next conversion from the same source format */
+   const struct simd_conversion *Next;
+};
+
+
+/**
+ * Swizzle four GLubyte components per pixel.
+ * \param map  map[i] is the source byte that destination byte i comes from,
+ *             or SIMD_SWIZZLE_ZERO/ONE.
+ */
+void
+_mesa_simd_swizzle_ubyte4(const GLubyte map[4], const GLubyte *src,
+                          GLubyte *dst, GLuint n)
+{
+   GLuint i = 0, j;
+
+#if defined(__SSSE3__)
+   {
+      GLubyte shuffle[16], one[16];
+      __m128i shuffle_mask, one_mask;
+
+      for (j = 0; j < 16; j++) {
+         const GLubyte m = map[j % 4];
+         shuffle[j] = m < 4 ? (j & ~3) + m : 0x80;
+         one[j] = m == SIMD_SWIZZLE_ONE ? 0xff : 0x00;
+      }
+      shuffle_mask = _mm_loadu_si128((const __m128i *) shuffle);
+      one_mask = _mm_loadu_si128((const __m128i *) one);
+
+      for (; i + 4 <= n; i += 4) {
+         __m128i p = _mm_loadu_si128((const __m128i *) (src + i * 4));
+         p = _mm_or_si128(_mm_shuffle_epi8(p, shuffle_mask), one_mask);
+         _mm_storeu_si128((__m128i *) (dst + i * 4), p);
+      }
+   }
+#elif defined(__SSE2__)
+   {
+      /* Move each byte into place with a shift and a mask. */
+      __m128i src_shift[4], dst_shift[4], one_mask;
+      const __m128i byte_mask = _mm_set1_epi32(0xff);
+      GLuint one = 0;
+
+      for (j = 0; j < 4; j++) {
+         src_shift[j] = _mm_cvtsi32_si128(map[j] < 4 ? map[j] * 8 : 32);
+         dst_shift[j] = _mm_cvtsi32_si128(j * 8);
+         if (map[j] == SIMD_SWIZZLE_ONE)
+            one |= 0xff << (j * 8);
+      }
+      one_mask = _mm_set1_epi32(one);
+
+      for (; i + 4 <= n; i += 4) {
+         const __m128i p = _mm_loadu_si128((const __m128i *) (src + i * 4));
+         __m128i d = one_mask;
+
+         for (j = 0; j < 4; j++) {
+            __m128i c = _mm_and_si128(_mm_srl_epi32(p, src_shift[j]),
+                                      byte_mask);
+            d = _mm_or_si128(d, _mm_sll_epi32(c, dst_shift[j]));
+         }
+         _mm_storeu_si128((__m128i *) (dst + i * 4), d);
+      }
+   }
+#endif
+
+   for (; i < n; i++) {
+      GLubyte tmp[6];
+
+      COPY_4UBV(tmp, src + i * 4);
+      tmp[SIMD_SWIZZLE_ZERO] = 0x00;
+      tmp[SIMD_SWIZZLE_ONE] = 0xff;
+      for (j = 0; j < 4; j++)
+         dst[i * 4 + j] = tmp[map[j]];
+   }
+}
+
+
+/**
+ * Convert floats to half floats, like _mesa_float_to_half().
+ */
+void
+_mesa_simd_float_to_half(const GLfloat *src, GLhalfARB *dst, GLuint n)
+{
+   GLuint i = 0;
+
+#ifdef __SSE2__
+   const __m128i abs_mask = _mm_set1_epi32(0x7fffffff);
+   const __m128i min_normal = _mm_set1_epi32(0x38800000 - 1); /* 2^-14 */
+   const __m128i max_normal = _mm_set1_epi32(0x47800000 - 1); /* 2^16 */
+   const __m128i infinity = _mm_set1_epi32(0x7f800000);
+   const __m128i exp_bias = _mm_set1_epi32(112 << 10);
+   const __m128 denorm_scale = _mm_set1_ps(16777216.0f); /* 2^24 */
+
+   for (; i + 8 <= n; i += 8) {
+      __m128i h[2];
+      int k;
+
+      for (k = 0; k < 2; k++) {
+         const __m128i f =
+            _mm_castps_si128(_mm_loadu_ps(src + i + k * 4));
+         const __m128i a = _mm_and_si128(f, abs_mask);
+         const __m128i sign = _mm_srli_epi32(_mm_andnot_si128(abs_mask, f),
+                                             16);
+         /* Normal halves just drop mantissa bits and rebias the exponent.
+          * Smaller values become denorms, or zero: their mantissa is the
+          * value in units of 2^-24, truncated.
+          */
+         const __m128i normal =
+            _mm_sub_epi32(_mm_srli_epi32(a, 13), exp_bias);
+         const __m128i denorm = _mm_cvttps_epi32(
+            _mm_mul_ps(_mm_castsi128_ps(a), denorm_scale));
+         const __m128i is_normal = _mm_cmpgt_epi32(a, min_normal);
+         const __m128i is_inf = _mm_cmpgt_epi32(a, max_normal);
+         const __m128i is_nan = _mm_cmpgt_epi32(a, infinity);
+         __m128i r;
+
+         r = _mm_or_si128(_mm_and_si128(is_normal, normal),
+                          _mm_andnot_si128(is_normal, denorm));
+         r = _mm_or_si128(_mm_andnot_si128(is_inf, r),
+                          _mm_and_si128(is_inf, _mm_set1_epi32(0x7c00)));
+         r = _mm_or_si128(r, _mm_and_si128(is_nan, _mm_set1_epi32(1)));
+         r = _mm_or_si128(r, sign);
+
+         /* sign extend, so that packing doesn't saturate */
+         h[k] = _mm_srai_epi32(_mm_slli_epi32(r, 16), 16);
+      }
+      _mm_storeu_si128((__m128i *) (dst + i), _mm_packs_epi32(h[0], h[1]));
+   }
+#endif
+
+   for (; i < n; i++)
+      dst[i] = _mesa_float_to_half(src[i]);
+}
+
+
+/**
+ * Convert half floats to floats, like _mesa_half_to_float().
+ */
+void
+_mesa_simd_half_to_float(const GLhalfARB *src, GLfloat *dst, GLuint n)
+{
+   GLuint i = 0;
+
+#ifdef __SSE2__
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i abs_mask = _mm_set1_epi32(0x7fff);
+   const __m128i min_normal = _mm_set1_epi32(0x400);
+   const __m128i max_normal = _mm_set1_epi32(0x7c00 - 1);
+   const __m128i infinity = _mm_set1_epi32(0x7c00);
+   const __m128i exp_bias = _mm_set1_epi32(112 << 23);
+   const __m128 denorm_scale = _mm_set1_ps(1.0f / 16777216.0f); /* 2^-24 */
+
+   for (; i + 8 <= n; i += 8) {
+      const __m128i h8 = _mm_loadu_si128((const __m128i *) (src + i));
+      int k;
+
+      for (k = 0; k < 2; k++) {
+         const __m128i h = k == 0 ? _mm_unpacklo_epi16(h8, zero)
+                                  : _mm_unpackhi_epi16(h8, zero);
+         const __m128i a = _mm_and_si128(h, abs_mask);
+         const __m128i sign = _mm_slli_epi32(_mm_andnot_si128(abs_mask, h),
+                                             16);
+         const __m128i normal =
+            _mm_add_epi32(_mm_slli_epi32(a, 13), exp_bias);
+         const __m128i denorm = _mm_castps_si128(
+            _mm_mul_ps(_mm_cvtepi32_ps(a), denorm_scale));
+         const __m128i is_denorm = _mm_cmpgt_epi32(min_normal, a);
+         const __m128i is_inf = _mm_cmpgt_epi32(a, max_normal);
+         const __m128i is_nan = _mm_cmpgt_epi32(a, infinity);
+         __m128i r;
+
+         r = _mm_or_si128(_mm_andnot_si128(is_denorm, normal),
+                          _mm_and_si128(is_denorm, denorm));
+         r = _mm_or_si128(_mm_andnot_si128(is_inf, r),
+                          _mm_and_si128(is_inf, _mm_set1_epi32(0x7f800000)));
+         r = _mm_or_si128(r, _mm_and_si128(is_nan, _mm_set1_epi32(1)));
+         r = _mm_or_si128(r, sign);
+
+         _mm_storeu_ps(dst + i + k * 4, _mm_castsi128_ps(r));
+      }
+   }
+#endif
+
+   for (; i < n; i++)
+      dst[i] = _mesa_half_to_float(src[i]);
+}
+
+
+#ifdef __SSE2__
+
+static void
+convert_swizzle_8888(const struct simd_conversion *conv,
+                     const void *src, void *dst, GLuint n)
+{
+   _mesa_simd_swizzle_ubyte4(conv->Map, (const GLubyte *) src,
+                             (GLubyte *) dst, n);
+}
+
+
+/**
+ * MESA_FORMAT_RGB565 to RGBA8888_REV (or ARGB8888, when red and blue are
+ * swapped), expanding the components like format_unpack.c does.
+ */
+static inline void
+unpack_565(const GLushort *src, GLuint *dst, GLuint n, GLboolean swap_rb)
+{
+   const __m128i mask5 = _mm_set1_epi16(0x1f);
+   const __m128i mask6 = _mm_set1_epi16(0x3f);
+   const __m128i alpha = _mm_set1_epi16((short) 0xff00);
+   GLuint i = 0;
+
+   for (; i + 8 <= n; i += 8) {
+      const __m128i p = _mm_loadu_si128((const __m128i *) (src + i));
+      const __m128i r5 = _mm_srli_epi16(p, 11);
+      const __m128i g6 = _mm_and_si128(_mm_srli_epi16(p, 5), mask6);
+      const __m128i b5 = _mm_and_si128(p, mask5);
+      const __m128i r = _mm_or_si128(_mm_slli_epi16(r5, 3),
+                                     _mm_srli_epi16(r5, 2));
+      const __m128i g = _mm_or_si128(_mm_slli_epi16(g6, 2),
+                                     _mm_srli_epi16(g6, 4));
+      const __m128i b = _mm_or_si128(_mm_slli_epi16(b5, 3),
+                                     _mm_srli_epi16(b5, 2));
+      const __m128i lo = _mm_or_si128(swap_rb ? b : r, _mm_slli_epi16(g, 8));
+      const __m128i hi = _mm_or_si128(swap_rb ? r : b, alpha);
+
+      _mm_storeu_si128((__m128i *) (dst + i), _mm_unpacklo_epi16(lo, hi));
+      _mm_storeu_si128((__m128i *) (dst + i + 4), _mm_unpackhi_epi16(lo, hi));
+   }
+
+   for (; i < n; i++) {
+      const GLuint r5 = src[i] >> 11;
+      const GLuint g6 = (src[i] >> 5) & 0x3f;
+      const GLuint b5 = src[i] & 0x1f;
+      const GLuint r = (r5 << 3) | (r5 >> 2);
+      const GLuint g = (g6 << 2) | (g6 >> 4);
+      const GLuint b = (b5 << 3) | (b5 >> 2);
+
+      dst[i] = swap_rb ? PACK_COLOR_8888(0xff, r, g, b)
+                       : PACK_COLOR_8888(0xff, b, g, r);
+   }
+}
+
+static void
+convert_565_to_rgba8888_rev(const struct simd_conversion *conv,
+                            const void *src, void *dst, GLuint n)
+{
+   unpack_565((const GLushort *) src, (GLuint *) dst, n, GL_FALSE);
+}
+
+static void
+convert_565_to_argb8888(const struct simd_conversion *conv,
+                        const void *src, void *dst, GLuint n)
+{
+   unpack_565((const GLushort *) src, (GLuint *) dst, n, GL_TRUE);
+}
+
+
+/**
+ * RGBA8888_REV (or ARGB8888, when red and blue are swapped) to
+ * MESA_FORMAT_RGB565, like PACK_COLOR_565.
+ */
+static inline void
+pack_565(const GLuint *src, GLushort *dst, GLuint n, GLboolean swap_rb)
+{
+   const __m128i mask_r = _mm_set1_epi32(0xf8 << 8);
+   const __m128i mask_g = _mm_set1_epi32(0xfc << 3);
+   const __m128i mask_b = _mm_set1_epi32(0xf8 >> 3);
+   GLuint i = 0;
+
+   for (; i + 8 <= n; i += 8) {
+      __m128i v[2];
+      int k;
+
+      for (k = 0; k < 2; k++) {
+         const __m128i p =
+            _mm_loadu_si128((const __m128i *) (src + i + k * 4));
+         const __m128i c0 = _mm_slli_epi32(p, 8);   /* byte 0 to bits 15:8 */
+         const __m128i c1 = _mm_srli_epi32(p, 5);   /* byte 1 to bits 10:3 */
+         const __m128i c2 = _mm_srli_epi32(p, 19);  /* byte 2 to bits 4:0 */
+         const __m128i r = swap_rb ? _mm_srli_epi32(p, 8) : c0;
+         const __m128i b = swap_rb ? _mm_srli_epi32(p, 3) : c2;
+         __m128i d;
+
+         d = _mm_or_si128(_mm_and_si128(r, mask_r),
+                          _mm_and_si128(c1, mask_g));
+         d = _mm_or_si128(d, _mm_and_si128(b, mask_b));
+         v[k] = _mm_srai_epi32(_mm_slli_epi32(d, 16), 16);
+      }
+      _mm_storeu_si128((__m128i *) (dst + i), _mm_packs_epi32(v[0], v[1]));
+   }
+
+   for (; i < n; i++) {
+      const GLubyte *p = (const GLubyte *) (src + i);
+
+      dst[i] = swap_rb ? PACK_COLOR_565(p[2], p[1], p[0])
+                       : PACK_COLOR_565(p[0], p[1], p[2]);
+   }
+}
+
+static void
+convert_rgba8888_rev_to_565(const struct simd_conversion *conv,
+                            const void *src, void *dst, GLuint n)
+{
+   pack_565((const GLuint *) src, (GLushort *) dst, n, GL_FALSE);
+}
+
+static void
+convert_argb8888_to_565(const struct simd_conversion *conv,
+                        const void *src, void *dst, GLuint n)
+{
+   pack_565((const GLuint *) src, (GLushort *) dst, n, GL_TRUE);
+}
+
+
+static void
+convert_rgba_float32_to_float16(const struct simd_conversion *conv,
+                                const void *src, void *dst, GLuint n)
+{
+   _mesa_simd_float_to_half((const GLfloat *) src, (GLhalfARB *) dst, n * 4);
+}
+
+static void
+convert_rgba_float16_to_float32(const struct simd_conversion *conv,
+                                const void *src, void *dst, GLuint n)
+{
+   _mesa_simd_half_to_float((const GLhalfARB *) src, (GLfloat *) dst, n * 4);
+}
+
+
+/**
+ * Swap depth/stencil between MESA_FORMAT_Z24_S8 (the GL_UNSIGNED_INT_24_8
+ * layout) and MESA_FORMAT_S8_Z24, by rotating each pixel.
+ */
+static inline void
+rotate_24_8(const GLuint *src, GLuint *dst, GLuint n, int left)
+{
+   GLuint i = 0;
+
+   for (; i + 4 <= n; i += 4) {
+      const __m128i p = _mm_loadu_si128((const __m128i *) (src + i));
+      const __m128i d = left == 8 ?
+         _mm_or_si128(_mm_slli_epi32(p, 8), _mm_srli_epi32(p, 24)) :
+         _mm_or_si128(_mm_slli_epi32(p, 24), _mm_srli_epi32(p, 8));
+
+      _mm_storeu_si128((__m128i *) (dst + i), d);
+   }
+
+   for (; i < n; i++)
+      dst[i] = (src[i] << left) | (src[i] >> (32 - left));
+}
+
+static void
+convert_z24_s8_to_s8_z24(const struct simd_conversion *conv,
+                         const void *src, void *dst, GLuint n)
+{
+   rotate_24_8((const GLuint *) src, (GLuint *) dst, n, 24);
+}
+
+static void
+convert_s8_z24_to_z24_s8(const struct simd_conversion *conv,
+                         const void *src, void *dst, GLuint n)
+{
+   rotate_24_8((const GLuint *) src, (GLuint *) dst, n, 8);
+}
+
+
+/**
+ * Byte offsets of R, G, B and A in the 32-bit RGBA formats, in memory on a
+ * little-endian CPU.  The X formats have no alpha byte.
+ */
+static const struct {
+   gl_format Format;
+   GLubyte Offset[4];
+   GLboolean HasAlpha;
+} formats_8888[] = {
+   { MESA_FORMAT_RGBA8888,     { 3, 2, 1, 0 }, GL_TRUE },
+   { MESA_FORMAT_RGBA8888_REV, { 0, 1, 2, 3 }, GL_TRUE },
+   { MESA_FORMAT_ARGB8888,     { 2, 1, 0, 3 }, GL_TRUE },
+   { MESA_FORMAT_ARGB8888_REV, { 1, 2, 3, 0 }, GL_TRUE },
+   { MESA_FORMAT_RGBX8888,     { 3, 2, 1, 0 }, GL_FALSE },
+   { MESA_FORMAT_RGBX8888_REV, { 0, 1, 2, 3 }, GL_FALSE },
+   { MESA_FORMAT_XRGB8888,     { 2, 1, 0, 3 }, GL_FALSE },
+   { MESA_FORMAT_XRGB8888_REV, { 1, 2, 3, 0 }, GL_FALSE },
+};
+
+#define MAX_SIMD_CONVERSIONS 64
+
+static struct simd_conversion conversions[MAX_SIMD_CONVERSIONS];
+static GLuint num_conversions;
+static const struct simd_conversion *first_conversion[MESA_FORMAT_COUNT];
+
+
+static struct simd_conversion *
+add_conversion(gl_format srcFormat, gl_format dstFormat,
+               simd_convert_row_func convertRow)
+{
+   struct simd_conversion *conv;
+
+   assert(num_conversions < MAX_SIMD_CONVERSIONS);
+   if (num_conversions >= MAX_SIMD_CONVERSIONS)
+      return NULL;
+
+   conv = &conversions[num_conversions++];
+   conv->SrcFormat = srcFormat;
+   conv->DstFormat = dstFormat;
+   conv->ConvertRow = convertRow;
+   conv->Next = first_conversion[srcFormat];
+   first_conversion[srcFormat] = conv;
+   return conv;
+}
+
+#endif /* __SSE2__ */
+
+
+/**
+ * Set up the table of conversions.  Called once, from one_time_init().
+ */
+void
+_mesa_init_simd_conversions(void)
+{
+#ifdef __SSE2__
+   GLuint i, j, c;
+
+   if (num_conversions)
+      return;
+
+   /* Swizzles between the 32-bit RGBA formats.  The X byte of the
+    * destination formats isn't the same in all the pack functions, so
+    * there are no conversions to them.
+    */
+   for (i = 0; i < Elements(formats_8888); i++) {
+      for (j = 0; j < Elements(formats_8888); j++) {
+         struct simd_conversion *conv;
+
+         if (i == j || !formats_8888[j].HasAlpha)
+            continue;
+
+         conv = add_conversion(formats_8888[i].Format, formats_8888[j].Format,
+                               convert_swizzle_8888);
+         if (!conv)
+            return;
+
+         for (c = 0; c < 4; c++) {
+            conv->Map[formats_8888[j].Offset[c]] =
+               c == ACOMP && !formats_8888[i].HasAlpha ?
+               SIMD_SWIZZLE_ONE : formats_8888[i].Offset[c];
+         }
+      }
+   }
+
+   add_conversion(MESA_FORMAT_RGB565, MESA_FORMAT_RGBA8888_REV,
+                  convert_565_to_rgba8888_rev);
+   add_conversion(MESA_FORMAT_RGB565, MESA_FORMAT_ARGB8888,
+                  convert_565_to_argb8888);
+   add_conversion(MESA_FORMAT_RGBA8888_REV, MESA_FORMAT_RGB565,
+                  convert_rgba8888_rev_to_565);
+   add_conversion(MESA_FORMAT_ARGB8888, MESA_FORMAT_RGB565,
+                  convert_argb8888_to_565);
+
+   add_conversion(MESA_FORMAT_RGBA_FLOAT32, MESA_FORMAT_RGBA_FLOAT16,
+                  convert_rgba_float32_to_float16);
+   add_conversion(MESA_FORMAT_RGBA_FLOAT16, MESA_FORMAT_RGBA_FLOAT32,
+                  convert_rgba_float16_to_float32);
+
+   add_conversion(MESA_FORMAT_Z24_S8, MESA_FORMAT_S8_Z24,
+                  convert_z24_s8_to_s8_z24);
+   add_conversion(MESA_FORMAT_S8_Z24, MESA_FORMAT_Z24_S8,
+                  convert_s8_z24_to_z24_s8);
+#endif
+}
+
+
+/**
+ * Find the SIMD conversion from srcFormat to dstFormat.
+ * \return NULL if there is none.
+ */
+const struct simd_conversion *
+_mesa_get_simd_conversion(gl_format srcFormat, gl_format dstFormat)
+{
+#ifdef __SSE2__
+   const struct simd_conversion *conv;
+
+   for (conv = first_conversion[srcFormat]; conv; conv = conv->Next) {
+      if (conv->DstFormat == dstFormat)
+         return conv;
+   }
+#endif
+   return NULL;
+}
+
+
+/**
+ * Convert a row of n pixels.
+ */
+void
+_mesa_simd_convert_row(const struct simd_conversion *conv,
+                       const void *src, void *dst, GLuint n)
+{
+   conv->ConvertRow(conv, src, dst, n);
+}
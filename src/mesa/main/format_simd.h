@@ -0,0 +1,72 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2013  VMware, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+ * AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * \file format_simd.h
+ * SSE2/SSSE3 conversions between pixel formats.
+ *
+ * The format pack/unpack, texstore and readpixels code look up a
+ * conversion for the pair of formats they convert between, and fall back
+ * to their generic per-pixel paths when there is none.
+ */
+
+
+#ifndef FORMAT_SIMD_H
+#define FORMAT_SIMD_H
+
+
+#include "formats.h"
+
+
+/** Swizzle map entries selecting 0x00 and 0xff, as in texstore.c */
+#define SIMD_SWIZZLE_ZERO 4
+#define SIMD_SWIZZLE_ONE  5
+
+
+struct simd_conversion;
+
+
+extern void
+_mesa_init_simd_conversions(void);
+
+extern const struct simd_conversion *
+_mesa_get_simd_conversion(gl_format srcFormat, gl_format dstFormat);
+
+extern void
+_mesa_simd_convert_row(const struct simd_conversion *conv,
+                       const void *src, void *dst, GLuint n);
+
+
+extern void
+_mesa_simd_swizzle_ubyte4(const GLubyte map[4], const GLubyte *src,
+                          GLubyte *dst, GLuint n);
+
+extern void
+_mesa_simd_float_to_half(const GLfloat *src, GLhalfARB *dst, GLuint n);
+
+extern void
+_mesa_simd_half_to_float(const GLhalfARB *src, GLfloat *dst, GLuint n);
+
+
+#endif /* FORMAT_SIMD_H */
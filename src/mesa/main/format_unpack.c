@@ -23,6 +23,7 @@
 
 
 #include "colormac.h"
+#include "format_simd.h"
 #include "format_unpack.h"
 #include "macros.h"
 #include "../../gallium/auxiliary/util/u_format_rgb9e5.h"
@@ -1620,7 +1621,16 @@ void
 _mesa_unpack_rgba_row(gl_format format, GLuint n,
                       const void *src, GLfloat dst[][4])
 {
-   unpack_rgba_func unpack = get_unpack_rgba_function(format);
+   const struct simd_conversion *conv =
+      _mesa_get_simd_conversion(format, MESA_FORMAT_RGBA_FLOAT32);
+   unpack_rgba_func unpack;
+
+   if (conv) {
+      _mesa_simd_convert_row(conv, src, dst, n);
+      return;
+   }
+
+   unpack = get_unpack_rgba_function(format);
    unpack(src, dst, n);
 }
 
@@ -1993,6 +2003,14 @@ void
 _mesa_unpack_ubyte_rgba_row(gl_format format, GLuint n,
                             const void *src, GLubyte dst[][4])
 {
+   const struct simd_conversion *conv =
+      _mesa_get_simd_conversion(format, MESA_FORMAT_RGBA8888_REV);
+
+   if (conv) {
+      _mesa_simd_convert_row(conv, src, dst, n);
+      return;
+   }
+
    switch (format) {
    case MESA_FORMAT_RGBA8888:
       unpack_ubyte_RGBA8888(src, dst, n);
@@ -3141,6 +3159,14 @@ void
 _mesa_unpack_uint_24_8_depth_stencil_row(gl_format format, GLuint n,
 					 const void *src, GLuint *dst)
 {
+   const struct simd_conversion *conv =
+      _mesa_get_simd_conversion(format, MESA_FORMAT_Z24_S8);
+
+   if (conv) {
+      _mesa_simd_convert_row(conv, src, dst, n);
+      return;
+   }
+
    switch (format) {
    case MESA_FORMAT_Z24_S8:
       unpack_uint_24_8_depth_stencil_Z24_S8(src, dst, n);
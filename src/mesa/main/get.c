@@ -1366,6 +1366,10 @@ static const struct value_desc values[] = {
 
    { GL_UNIFORM_BUFFER_BINDING, LOC_CUSTOM, TYPE_INT, 0, extra_ARB_uniform_buffer_object },
 
+   /* GL_ARB_get_program_binary */
+   { GL_NUM_PROGRAM_BINARY_FORMATS, CONST(1), NO_EXTRA },
+   { GL_PROGRAM_BINARY_FORMATS, CONST(GL_PROGRAM_BINARY_FORMAT_MESA), NO_EXTRA },
+
    /* GL_ARB_timer_query */
    { GL_TIMESTAMP, LOC_CUSTOM, TYPE_INT64, 0, extra_ARB_timer_query }
 
@@ -97,6 +97,11 @@ typedef void *GLeglImageOES;
 #define GL_PROGRAM_BINARY_LENGTH_OES 0x8741
 #endif
 
+/* Mesa's own GL_ARB_get_program_binary format */
+#ifndef GL_MESA_program_binary_formats
+#define GL_PROGRAM_BINARY_FORMAT_MESA 0x875F
+#endif
+
 /* GLES 2.0 tokens */
 #ifndef GL_RGB565
 #define GL_RGB565 0x8D62
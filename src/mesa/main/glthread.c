@@ -0,0 +1,450 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2013  VMware, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * \file glthread.c
+ * Executing GL commands on a separate thread.
+ *
+ * The application thread records commands in one of MARSHAL_MAX_BATCHES
+ * batches, and queues it when it is full or on glFlush.  The GL thread
+ * executes the queued batches in order.  Everything that looks at the
+ * context from the outside (MakeCurrent, SwapBuffers, destroying the
+ * context...) must call _mesa_glthread_finish first.
+ */
+
+
+#include "glheader.h"
+#include "context.h"
+#include "glthread.h"
+#include "hash.h"
+#include "imports.h"
+#include "marshal.h"
+#include "mtypes.h"
+#include "glapi/glapi.h"
+
+
+#ifdef HAVE_PTHREAD
+
+
+static void
+glthread_execute_batch(struct gl_context *ctx, struct glthread_batch *batch)
+{
+   size_t pos = 0;
+
+   /* The dispatch may have been changed by a synchronous call. */
+   _glapi_set_dispatch(ctx->CurrentDispatch);
+
+   while (pos < batch->Used)
+      pos += _mesa_unmarshal_dispatch_cmd(ctx, (uint8_t *) batch->Buffer + pos);
+
+   assert(pos == batch->Used);
+   batch->Used = 0;
+}
+
+
+static void *
+glthread_worker(void *data)
+{
+   struct gl_context *ctx = data;
+   struct glthread_state *glthread = ctx->GLThread;
+
+   _glapi_set_context(ctx);
+
+   pthread_mutex_lock(&glthread->Mutex);
+
+   for (;;) {
+      struct glthread_batch *batch = &glthread->Batches[glthread->Last];
+
+      while (!batch->Pending && !glthread->Shutdown)
+         pthread_cond_wait(&glthread->NewWork, &glthread->Mutex);
+
+      if (!batch->Pending)
+         break;
+
+      pthread_mutex_unlock(&glthread->Mutex);
+      glthread_execute_batch(ctx, batch);
+      pthread_mutex_lock(&glthread->Mutex);
+
+      batch->Pending = GL_FALSE;
+      glthread->Last = (glthread->Last + 1) % MARSHAL_MAX_BATCHES;
+      pthread_cond_broadcast(&glthread->WorkDone);
+   }
+
+   pthread_mutex_unlock(&glthread->Mutex);
+   return NULL;
+}
+
+
+/**
+ * Read the tracked bindings from the context.  The GL thread must be idle.
+ */
+static void
+glthread_restore_bindings(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   const struct gl_array_object *arrayObj = ctx->Array.ArrayObj;
+
+   glthread->ArrayBuffer = ctx->Array.ArrayBufferObj->Name;
+   glthread->ElementArrayBuffer = arrayObj->ElementArrayBufferObj->Name;
+   glthread->PixelPackBuffer = ctx->Pack.BufferObj->Name;
+   glthread->PixelUnpackBuffer = ctx->Unpack.BufferObj->Name;
+   glthread->CurrentVAO = arrayObj->Name;
+
+   if (arrayObj->Name) {
+      _mesa_HashInsert(glthread->VAOElementArrayBuffers, arrayObj->Name,
+                       (void *) (uintptr_t) glthread->ElementArrayBuffer);
+   }
+   else {
+      glthread->DefaultElementArrayBuffer = glthread->ElementArrayBuffer;
+   }
+}
+
+
+/**
+ * Start executing the commands of a context on a separate thread.  Only
+ * desktop GL contexts are supported.  Does nothing if the thread can't be
+ * created.
+ */
+void
+_mesa_glthread_init(struct gl_context *ctx)
+{
+   struct glthread_state *glthread;
+
+   if (ctx->GLThread)
+      return;
+
+   if (ctx->API != API_OPENGL && ctx->API != API_OPENGL_CORE)
+      return;
+
+   glthread = calloc(1, sizeof(*glthread));
+   if (!glthread)
+      return;
+
+   ctx->MarshalExec = _mesa_create_marshal_table(ctx);
+   glthread->VAOElementArrayBuffers = _mesa_NewHashTable();
+   if (!ctx->MarshalExec || !glthread->VAOElementArrayBuffers)
+      goto fail;
+
+   pthread_mutex_init(&glthread->Mutex, NULL);
+   pthread_cond_init(&glthread->NewWork, NULL);
+   pthread_cond_init(&glthread->WorkDone, NULL);
+
+   ctx->GLThread = glthread;
+   glthread_restore_bindings(ctx);
+
+   if (pthread_create(&glthread->Thread, NULL, glthread_worker, ctx) != 0) {
+      ctx->GLThread = NULL;
+      pthread_mutex_destroy(&glthread->Mutex);
+      pthread_cond_destroy(&glthread->NewWork);
+      pthread_cond_destroy(&glthread->WorkDone);
+      goto fail;
+   }
+
+   /* Start recording if the context is already current. */
+   if (_mesa_get_current_context() == ctx)
+      _glapi_set_dispatch(ctx->MarshalExec);
+   return;
+
+fail:
+   if (glthread->VAOElementArrayBuffers)
+      _mesa_DeleteHashTable(glthread->VAOElementArrayBuffers);
+   free(ctx->MarshalExec);
+   ctx->MarshalExec = NULL;
+   free(glthread);
+}
+
+
+static void
+glthread_forget_vao(GLuint key, void *data, void *userData)
+{
+   (void) key;
+   (void) data;
+   (void) userData;
+}
+
+
+/**
+ * Execute the pending commands and stop the thread.  The context goes on
+ * executing commands directly.
+ */
+void
+_mesa_glthread_destroy(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (!glthread)
+      return;
+
+   _mesa_glthread_finish(ctx);
+
+   pthread_mutex_lock(&glthread->Mutex);
+   glthread->Shutdown = GL_TRUE;
+   pthread_cond_broadcast(&glthread->NewWork);
+   pthread_mutex_unlock(&glthread->Mutex);
+
+   pthread_join(glthread->Thread, NULL);
+
+   pthread_mutex_destroy(&glthread->Mutex);
+   pthread_cond_destroy(&glthread->NewWork);
+   pthread_cond_destroy(&glthread->WorkDone);
+
+   _mesa_HashDeleteAll(glthread->VAOElementArrayBuffers,
+                       glthread_forget_vao, NULL);
+   _mesa_DeleteHashTable(glthread->VAOElementArrayBuffers);
+
+   ctx->GLThread = NULL;
+   free(glthread);
+
+   if (_mesa_get_current_context() == ctx)
+      _glapi_set_dispatch(ctx->CurrentDispatch);
+
+   free(ctx->MarshalExec);
+   ctx->MarshalExec = NULL;
+}
+
+
+/**
+ * Queue the batch being recorded, and wait for the next one to be free.
+ */
+void
+_mesa_glthread_flush_batch(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_batch *batch;
+
+   if (!glthread)
+      return;
+
+   batch = &glthread->Batches[glthread->Next];
+   if (batch->Used == 0)
+      return;
+
+   pthread_mutex_lock(&glthread->Mutex);
+
+   batch->Pending = GL_TRUE;
+   pthread_cond_signal(&glthread->NewWork);
+
+   glthread->Next = (glthread->Next + 1) % MARSHAL_MAX_BATCHES;
+   while (glthread->Batches[glthread->Next].Pending)
+      pthread_cond_wait(&glthread->WorkDone, &glthread->Mutex);
+
+   pthread_mutex_unlock(&glthread->Mutex);
+}
+
+
+/**
+ * Wait for all the commands recorded so far to be executed.
+ */
+void
+_mesa_glthread_finish(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_batch *last;
+
+   if (!glthread)
+      return;
+
+   /* Nothing to wait for when called from a command being executed. */
+   if (pthread_equal(pthread_self(), glthread->Thread))
+      return;
+
+   _mesa_glthread_flush_batch(ctx);
+
+   /* Batches are executed in order, so waiting for the last queued one is
+    * enough.
+    */
+   last = &glthread->Batches[(glthread->Next + MARSHAL_MAX_BATCHES - 1) %
+                             MARSHAL_MAX_BATCHES];
+
+   pthread_mutex_lock(&glthread->Mutex);
+   while (last->Pending)
+      pthread_cond_wait(&glthread->WorkDone, &glthread->Mutex);
+   pthread_mutex_unlock(&glthread->Mutex);
+}
+
+
+/**
+ * Stop using the GL thread for good, for a call that can't be marshalled.
+ */
+void
+_mesa_glthread_disable(struct gl_context *ctx, const char *func)
+{
+   _mesa_debug(ctx, "glthread disabled by %s\n", func);
+   _mesa_glthread_destroy(ctx);
+}
+
+
+/**
+ * Prepare for executing a call on the application thread.
+ */
+void
+_mesa_glthread_begin_sync(struct gl_context *ctx)
+{
+   _mesa_glthread_finish(ctx);
+
+   /* The call may dispatch other calls through the current table. */
+   _glapi_set_dispatch(ctx->CurrentDispatch);
+}
+
+
+/**
+ * Go back to recording commands after a call executed by the application
+ * thread.
+ */
+void
+_mesa_glthread_end_sync(struct gl_context *ctx)
+{
+   if (ctx->GLThread)
+      _glapi_set_dispatch(ctx->MarshalExec);
+}
+
+
+static void
+glthread_set_element_array_buffer(struct glthread_state *glthread,
+                                  GLuint buffer)
+{
+   glthread->ElementArrayBuffer = buffer;
+
+   if (glthread->CurrentVAO) {
+      _mesa_HashInsert(glthread->VAOElementArrayBuffers, glthread->CurrentVAO,
+                       (void *) (uintptr_t) buffer);
+   }
+   else {
+      glthread->DefaultElementArrayBuffer = buffer;
+   }
+}
+
+
+void
+_mesa_glthread_BindBufferARB(struct gl_context *ctx,
+                             GLenum target, GLuint buffer)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   switch (target) {
+   case GL_ARRAY_BUFFER:
+      glthread->ArrayBuffer = buffer;
+      break;
+   case GL_ELEMENT_ARRAY_BUFFER:
+      glthread_set_element_array_buffer(glthread, buffer);
+      break;
+   case GL_PIXEL_PACK_BUFFER:
+      glthread->PixelPackBuffer = buffer;
+      break;
+   case GL_PIXEL_UNPACK_BUFFER:
+      glthread->PixelUnpackBuffer = buffer;
+      break;
+   default:
+      break;
+   }
+}
+
+
+void
+_mesa_glthread_DeleteBuffersARB(struct gl_context *ctx,
+                                GLsizei n, const GLuint *buffers)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   GLsizei i;
+
+   if (!buffers)
+      return;
+
+   /* Deleting a buffer unbinds it from the context, and from the current
+    * vertex array object only.
+    */
+   for (i = 0; i < n; i++) {
+      const GLuint buffer = buffers[i];
+
+      if (buffer == 0)
+         continue;
+
+      if (glthread->ArrayBuffer == buffer)
+         glthread->ArrayBuffer = 0;
+      if (glthread->ElementArrayBuffer == buffer)
+         glthread_set_element_array_buffer(glthread, 0);
+      if (glthread->PixelPackBuffer == buffer)
+         glthread->PixelPackBuffer = 0;
+      if (glthread->PixelUnpackBuffer == buffer)
+         glthread->PixelUnpackBuffer = 0;
+   }
+}
+
+
+void
+_mesa_glthread_BindVertexArray(struct gl_context *ctx, GLuint array)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   glthread->CurrentVAO = array;
+   if (array) {
+      glthread->ElementArrayBuffer = (GLuint) (uintptr_t)
+         _mesa_HashLookup(glthread->VAOElementArrayBuffers, array);
+   }
+   else {
+      glthread->ElementArrayBuffer = glthread->DefaultElementArrayBuffer;
+   }
+}
+
+
+void
+_mesa_glthread_BindVertexArrayAPPLE(struct gl_context *ctx, GLuint array)
+{
+   _mesa_glthread_BindVertexArray(ctx, array);
+}
+
+
+void
+_mesa_glthread_DeleteVertexArraysAPPLE(struct gl_context *ctx,
+                                       GLsizei n, const GLuint *arrays)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   GLsizei i;
+
+   if (!arrays)
+      return;
+
+   for (i = 0; i < n; i++) {
+      const GLuint array = arrays[i];
+
+      if (array == 0)
+         continue;
+
+      if (glthread->CurrentVAO == array)
+         _mesa_glthread_BindVertexArray(ctx, 0);
+      _mesa_HashRemove(glthread->VAOElementArrayBuffers, array);
+   }
+}
+
+
+void
+_mesa_glthread_PopClientAttrib(struct gl_context *ctx)
+{
+   if (ctx->GLThread)
+      glthread_restore_bindings(ctx);
+}
+
+
+#endif /* HAVE_PTHREAD */
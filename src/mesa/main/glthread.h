@@ -0,0 +1,181 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2013  VMware, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * \file glthread.h
+ * Executing GL commands on a separate thread.
+ *
+ * When a context has a GL thread, the application thread dispatches to
+ * ctx->MarshalExec, whose functions (generated by gl_marshal.py) record the
+ * commands in a batch.  Full batches are executed by the GL thread through
+ * ctx->CurrentDispatch.  Commands that return data, or whose pointers can't
+ * be followed later, wait for the GL thread to go idle and are executed on
+ * the application thread.
+ *
+ * The application thread keeps track of the few bindings that decide
+ * whether a pointer is an offset into a buffer object.  Setting a vertex
+ * array pointer to client memory disables the GL thread for good.
+ */
+
+
+#ifndef _GLTHREAD_H
+#define _GLTHREAD_H
+
+
+#include "main/mtypes.h"
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+
+/** Size of a batch, in bytes */
+#define MARSHAL_MAX_BATCH_SIZE (64 * 1024)
+
+/**
+ * Number of batches.  The application thread waits when all of them are
+ * queued.
+ */
+#define MARSHAL_MAX_BATCHES 4
+
+
+#ifdef HAVE_PTHREAD
+
+struct glthread_batch
+{
+   /** Whether the batch is queued or being executed, protected by the mutex */
+   GLboolean Pending;
+
+   /** Number of bytes used in Buffer */
+   size_t Used;
+
+   uint64_t Buffer[MARSHAL_MAX_BATCH_SIZE / sizeof(uint64_t)];
+};
+
+
+struct glthread_state
+{
+   pthread_t Thread;
+   pthread_mutex_t Mutex;
+
+   /** Signaled when a batch is queued, or when the thread must exit */
+   pthread_cond_t NewWork;
+
+   /** Signaled when a batch has been executed */
+   pthread_cond_t WorkDone;
+
+   GLboolean Shutdown;
+
+   struct glthread_batch Batches[MARSHAL_MAX_BATCHES];
+
+   /** Batch the application thread records commands in */
+   unsigned Next;
+
+   /** Next batch the GL thread executes */
+   unsigned Last;
+
+   /**
+    * \name Bindings tracked by the application thread
+    */
+   /*@{*/
+   GLuint ArrayBuffer;
+   GLuint ElementArrayBuffer;
+   GLuint PixelPackBuffer;
+   GLuint PixelUnpackBuffer;
+   GLuint CurrentVAO;
+
+   /** Element array buffer of the default vertex array object */
+   GLuint DefaultElementArrayBuffer;
+
+   /** Map from vertex array object names to element array buffer names */
+   struct _mesa_HashTable *VAOElementArrayBuffers;
+   /*@}*/
+};
+
+
+extern void
+_mesa_glthread_init(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_destroy(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_finish(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_flush_batch(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_disable(struct gl_context *ctx, const char *func);
+
+extern void
+_mesa_glthread_begin_sync(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_end_sync(struct gl_context *ctx);
+
+
+extern void
+_mesa_glthread_BindBufferARB(struct gl_context *ctx,
+                             GLenum target, GLuint buffer);
+
+extern void
+_mesa_glthread_DeleteBuffersARB(struct gl_context *ctx,
+                                GLsizei n, const GLuint *buffers);
+
+extern void
+_mesa_glthread_BindVertexArray(struct gl_context *ctx, GLuint array);
+
+extern void
+_mesa_glthread_BindVertexArrayAPPLE(struct gl_context *ctx, GLuint array);
+
+extern void
+_mesa_glthread_DeleteVertexArraysAPPLE(struct gl_context *ctx,
+                                       GLsizei n, const GLuint *arrays);
+
+extern void
+_mesa_glthread_PopClientAttrib(struct gl_context *ctx);
+
+#else /* HAVE_PTHREAD */
+
+static inline void
+_mesa_glthread_init(struct gl_context *ctx)
+{
+}
+
+static inline void
+_mesa_glthread_destroy(struct gl_context *ctx)
+{
+}
+
+static inline void
+_mesa_glthread_finish(struct gl_context *ctx)
+{
+}
+
+#endif /* HAVE_PTHREAD */
+
+
+#endif /* _GLTHREAD_H */
@@ -4,7 +4,20 @@
  *
  * Used for display lists, texture objects, vertex/fragment programs,
  * buffer objects, etc.  The hash functions are thread-safe.
- * 
+ *
+ * Keys below a limit that grows with the number of entries are kept in a
+ * dense array indexed by key, which is where the names handed out by
+ * glGen*() end up.  Other keys go to an open-addressed table with linear
+ * probing.  Both grow as needed.
+ *
+ * Lookups don't take the lock.  Writers are serialized by the mutex and
+ * update the arrays in an order that lets a concurrent reader see either
+ * the old or the new state of an entry.  The sparse table is rehashed in
+ * place, under a sequence count that makes lookups running meanwhile start
+ * over.  Arrays that are replaced when the table grows may still be read by
+ * another thread, so they are only freed along with the table; since the
+ * arrays never shrink, that's less memory than the final arrays take.
+ *
  * \note key=0 is illegal.
  *
  * \author Brian Paul
@@ -37,22 +50,69 @@
 
 #include "glheader.h"
 #include "imports.h"
+#include "macros.h"
 #include "glapi/glthread.h"
 #include "hash.h"
 
 
-#define TABLE_SIZE 1023  /**< Size of lookup table/array */
+/**
+ * Memory barriers for the lock-less lookups.  HASH_WRITE_BARRIER orders
+ * the stores of a writer, HASH_READ_BARRIER the loads of a reader.
+ */
+#if defined(__GNUC__)
+#define HASH_WRITE_BARRIER() __sync_synchronize()
+#if defined(__i386__) || defined(__x86_64__)
+#define HASH_READ_BARRIER() __asm__ __volatile__("" : : : "memory")
+#else
+#define HASH_READ_BARRIER() __sync_synchronize()
+#endif
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#define HASH_WRITE_BARRIER() _ReadWriteBarrier()
+#define HASH_READ_BARRIER() _ReadWriteBarrier()
+#else
+/* Lookups take the lock. */
+#define HASH_LOCKED_LOOKUP 1
+#define HASH_WRITE_BARRIER()
+#define HASH_READ_BARRIER()
+#endif
+
 
-#define HASH_FUNC(K)  ((K) % TABLE_SIZE)
+#define MIN_DENSE_SIZE 64          /**< first size of the dense array */
+#define MAX_DENSE_SIZE (1 << 20)   /**< keys above never go to the array */
+#define MIN_SPARSE_SIZE 16         /**< first size of the sparse table */
 
 
 /**
- * An entry in the hash table.  
+ * An entry of the sparse table.
+ *
+ * Key is 0 if the slot has never been used.  A removed entry keeps its key
+ * and gets NULL data, so that the probe sequences going through it still
+ * work.  The slot is reused by the next new key that hashes there.
  */
 struct HashEntry {
    GLuint Key;             /**< the entry's key */
    void *Data;             /**< the entry's data */
-   struct HashEntry *Next; /**< pointer to next entry */
+};
+
+
+/**
+ * The dense array, for keys in [1, Size).  NULL data means no entry.
+ */
+struct HashDense {
+   struct HashDense *Prev; /**< the array this one replaced */
+   GLuint Size;            /**< number of elements in Data */
+   void *Data[1];
+};
+
+
+/**
+ * The open-addressed table, for keys that are not in the dense array.
+ */
+struct HashSparse {
+   struct HashSparse *Prev;       /**< the table this one replaced */
+   GLuint Mask;                   /**< number of entries minus one */
+   struct HashEntry Entries[1];
 };
 
 
@@ -60,14 +120,36 @@ struct HashEntry {
  * The hash table data structure.  
  */
 struct _mesa_HashTable {
-   struct HashEntry *Table[TABLE_SIZE];  /**< the lookup table */
+   struct HashDense * volatile Dense;   /**< keys below Dense->Size */
+   struct HashSparse * volatile Sparse; /**< all the other keys */
+   GLuint NumEntries;                   /**< entries with non-NULL data */
+   GLuint SparseUsed;        /**< sparse slots with a non-zero key */
+   GLuint SparseLive;        /**< sparse slots with non-NULL data */
+   GLuint SparseMinKey;      /**< no sparse entry has a key below this */
+   volatile GLuint SparseSeq; /**< odd while rehashing the sparse table */
    GLuint MaxKey;                        /**< highest key inserted so far */
+   GLuint FreeHint;          /**< all the keys below this are in use */
+   GLuint Walking;           /**< number of _mesa_HashWalk() in progress */
    _glthread_Mutex Mutex;                /**< mutual exclusion lock */
    _glthread_Mutex WalkMutex;            /**< for _mesa_HashWalk() */
    GLboolean InDeleteAll;                /**< Debug check */
 };
 
 
+/** Shared by all the tables until they get their first entries. */
+static struct HashDense EmptyDense = { NULL, 0, { NULL } };
+static struct HashSparse EmptySparse = { NULL, 0, { { 0, NULL } } };
+
+
+static inline GLuint
+hash_key(GLuint key)
+{
+   /* Names are mostly sequential; spread them over the table. */
+   key *= 0x9e3779b1;
+   return key ^ (key >> 16);
+}
+
+
 
 /**
  * Create a new hash table.
@@ -79,6 +161,10 @@ _mesa_NewHashTable(void)
 {
    struct _mesa_HashTable *table = CALLOC_STRUCT(_mesa_HashTable);
    if (table) {
+      table->Dense = &EmptyDense;
+      table->Sparse = &EmptySparse;
+      table->SparseMinKey = ~0u;
+      table->FreeHint = 1;
       _glthread_INIT_MUTEX(table->Mutex);
       _glthread_INIT_MUTEX(table->WalkMutex);
    }
@@ -89,7 +175,8 @@ _mesa_NewHashTable(void)
 
 /**
  * Delete a hash table.
- * Frees each entry on the hash table and then the hash table structure itself.
+ * Frees the arrays of the hash table and then the hash table structure
+ * itself.
  * Note that the caller should have already traversed the table and deleted
  * the objects in the table (i.e. We don't free the entries' data pointer).
  *
@@ -98,19 +185,21 @@ _mesa_NewHashTable(void)
 void
 _mesa_DeleteHashTable(struct _mesa_HashTable *table)
 {
-   GLuint pos;
+   struct HashDense *dense;
+   struct HashSparse *sparse;
    assert(table);
-   for (pos = 0; pos < TABLE_SIZE; pos++) {
-      struct HashEntry *entry = table->Table[pos];
-      while (entry) {
-	 struct HashEntry *next = entry->Next;
-         if (entry->Data) {
-            _mesa_problem(NULL,
-                          "In _mesa_DeleteHashTable, found non-freed data");
-         }
-	 free(entry);
-	 entry = next;
-      }
+   if (table->NumEntries) {
+      _mesa_problem(NULL, "In _mesa_DeleteHashTable, found non-freed data");
+   }
+   for (dense = table->Dense; dense != &EmptyDense; ) {
+      struct HashDense *prev = dense->Prev;
+      free(dense);
+      dense = prev;
+   }
+   for (sparse = table->Sparse; sparse != &EmptySparse; ) {
+      struct HashSparse *prev = sparse->Prev;
+      free(sparse);
+      sparse = prev;
    }
    _glthread_DESTROY_MUTEX(table->Mutex);
    _glthread_DESTROY_MUTEX(table->WalkMutex);
@@ -119,28 +208,75 @@ _mesa_DeleteHashTable(struct _mesa_HashTable *table)
 
 
 
+/**
+ * Find the sparse entry of a key, removed or not, with the lock held.
+ */
+static struct HashEntry *
+find_sparse_entry(const struct HashSparse *sparse, GLuint key)
+{
+   GLuint pos = hash_key(key) & sparse->Mask;
+
+   for (;;) {
+      const struct HashEntry *entry = &sparse->Entries[pos];
+      if (entry->Key == key)
+         return (struct HashEntry *) entry;
+      if (entry->Key == 0)
+         return NULL;
+      pos = (pos + 1) & sparse->Mask;
+   }
+}
+
+
 /**
  * Lookup an entry in the hash table, without locking.
  * \sa _mesa_HashLookup
+ *
+ * Writers may be changing the table meanwhile.  The key of a sparse entry
+ * is read again after its data, in case the slot has been reused, and the
+ * lookup starts over if the sparse table was rehashed in the meantime.
  */
 static inline void *
-_mesa_HashLookup_unlocked(struct _mesa_HashTable *table, GLuint key)
+_mesa_HashLookup_unlocked(const struct _mesa_HashTable *table, GLuint key)
 {
-   GLuint pos;
-   const struct HashEntry *entry;
+   const struct HashDense *dense;
+   const struct HashSparse *sparse;
+   GLuint seq, pos;
+   void *data;
 
    assert(table);
    assert(key);
 
-   pos = HASH_FUNC(key);
-   entry = table->Table[pos];
-   while (entry) {
-      if (entry->Key == key) {
-         return entry->Data;
+   dense = table->Dense;
+   if (key < dense->Size)
+      return dense->Data[key];
+
+retry:
+   seq = table->SparseSeq;
+   HASH_READ_BARRIER();
+   sparse = table->Sparse;
+   pos = hash_key(key) & sparse->Mask;
+   data = NULL;
+   for (;;) {
+      const volatile struct HashEntry *entry = &sparse->Entries[pos];
+      const GLuint k = entry->Key;
+
+      if (k == key) {
+         HASH_READ_BARRIER();
+         data = entry->Data;
+         HASH_READ_BARRIER();
+         if (entry->Key != key)
+            goto retry;
+         break;
       }
-      entry = entry->Next;
+      if (k == 0)
+         break;
+      pos = (pos + 1) & sparse->Mask;
    }
-   return NULL;
+
+   HASH_READ_BARRIER();
+   if ((seq & 1) || table->SparseSeq != seq)
+      goto retry;
+   return data;
 }
 
 
@@ -157,16 +293,248 @@ _mesa_HashLookup(struct _mesa_HashTable *table, GLuint key)
 {
    void *res;
    assert(table);
+#ifdef HASH_LOCKED_LOOKUP
    _glthread_LOCK_MUTEX(table->Mutex);
    res = _mesa_HashLookup_unlocked(table, key);
    _glthread_UNLOCK_MUTEX(table->Mutex);
+#else
+   res = _mesa_HashLookup_unlocked(table, key);
+#endif
    return res;
 }
 
 
+/**
+ * Grow the dense array so that it covers \c key, if the array would still
+ * be reasonably full.  Called with the lock held.
+ */
+static void
+grow_dense(struct _mesa_HashTable *table, GLuint key)
+{
+   struct HashDense *old = table->Dense;
+   struct HashDense *dense;
+   GLuint size;
+
+   if (key >= MAX_DENSE_SIZE)
+      return;
+
+   size = MAX2(old->Size * 2, MIN_DENSE_SIZE);
+   while (size <= key)
+      size *= 2;
+
+   /* Keys below the new size must not be in the sparse table already,
+    * since lookups of those keys only look at the array.
+    */
+   if (size > table->SparseMinKey)
+      return;
+
+   /* Keep at least a quarter of the array used. */
+   if (size > MIN_DENSE_SIZE && size / 4 > table->NumEntries + 1)
+      return;
+
+   dense = calloc(1, sizeof(struct HashDense) + (size - 1) * sizeof(void *));
+   if (!dense)
+      return;
+
+   dense->Prev = old;
+   dense->Size = size;
+   memcpy(dense->Data, old->Data, old->Size * sizeof(void *));
+
+   HASH_WRITE_BARRIER();
+   table->Dense = dense;
+}
+
+
+/**
+ * Put an entry in the first free slot of its probe sequence.
+ */
+static void
+place_sparse_entry(struct HashSparse *sparse, const struct HashEntry *entry)
+{
+   GLuint pos = hash_key(entry->Key) & sparse->Mask;
+   while (sparse->Entries[pos].Key)
+      pos = (pos + 1) & sparse->Mask;
+   sparse->Entries[pos] = *entry;
+}
+
+
+/**
+ * Drop the removed entries of the sparse table without reallocating it.
+ * Called with the lock held.
+ *
+ * Lookups running meanwhile see SparseSeq change and start over.  They
+ * always find a slot with a zero key, since at least a quarter of the
+ * slots are empty before the table is cleared.
+ */
+static GLboolean
+rehash_sparse_in_place(struct _mesa_HashTable *table)
+{
+   struct HashSparse *sparse = table->Sparse;
+   struct HashEntry *live;
+   GLuint i, n = 0;
+
+   live = malloc(MAX2(table->SparseLive, 1) * sizeof(struct HashEntry));
+   if (!live)
+      return GL_FALSE;
+
+   for (i = 0; i <= sparse->Mask; i++) {
+      if (sparse->Entries[i].Data)
+         live[n++] = sparse->Entries[i];
+   }
+   assert(n == table->SparseLive);
+
+   table->SparseSeq++;
+   HASH_WRITE_BARRIER();
+
+   memset(sparse->Entries, 0, (sparse->Mask + 1) * sizeof(struct HashEntry));
+   for (i = 0; i < n; i++)
+      place_sparse_entry(sparse, &live[i]);
+
+   HASH_WRITE_BARRIER();
+   table->SparseSeq++;
+
+   free(live);
+   table->SparseUsed = table->SparseLive;
+   return GL_TRUE;
+}
+
+
+/**
+ * Rebuild the sparse table without its removed entries, with room for at
+ * least one more entry.  Called with the lock held.
+ *
+ * The table never shrinks, and is rebuilt in place unless it must grow, so
+ * that tables full of removed entries don't pile up when objects are
+ * created and deleted all the time.  A _mesa_HashWalk() in progress would
+ * miss entries moved under it, so a new table is made then.
+ *
+ * \return GL_FALSE if out of memory.
+ */
+static GLboolean
+rehash_sparse(struct _mesa_HashTable *table)
+{
+   struct HashSparse *old = table->Sparse;
+   struct HashSparse *sparse;
+   GLuint size = MIN_SPARSE_SIZE;
+   GLuint i;
+
+   while (size < (table->SparseLive + 1) * 2)
+      size *= 2;
+
+   if (old != &EmptySparse && size <= old->Mask + 1) {
+      if (!table->Walking)
+         return rehash_sparse_in_place(table);
+      size = old->Mask + 1;
+   }
+
+   sparse = calloc(1, sizeof(struct HashSparse) +
+                   (size - 1) * sizeof(struct HashEntry));
+   if (!sparse)
+      return GL_FALSE;
+
+   sparse->Prev = old;
+   sparse->Mask = size - 1;
+
+   for (i = 0; i <= old->Mask; i++) {
+      if (old->Entries[i].Data)
+         place_sparse_entry(sparse, &old->Entries[i]);
+   }
+
+   HASH_WRITE_BARRIER();
+   table->Sparse = sparse;
+   table->SparseUsed = table->SparseLive;
+   return GL_TRUE;
+}
+
+
+/**
+ * Add an entry to the sparse table, or replace its data.  Called with the
+ * lock held.
+ */
+static void
+insert_sparse(struct _mesa_HashTable *table, GLuint key, void *data)
+{
+   struct HashSparse *sparse = table->Sparse;
+   struct HashEntry *entry = find_sparse_entry(sparse, key);
+   GLuint pos = hash_key(key) & sparse->Mask;
+
+   if (entry) {
+      /* replace entry's data, or bring a removed entry back */
+      if (!entry->Data)
+         goto insert;
+      entry->Data = data;
+      return;
+   }
+
+   /* Reuse the first removed entry on the way, if any. */
+   while (sparse->Entries[pos].Key) {
+      if (!entry && !sparse->Entries[pos].Data)
+         entry = &sparse->Entries[pos];
+      pos = (pos + 1) & sparse->Mask;
+   }
+
+   if (!entry) {
+      /* Keep a quarter of the slots empty, so that probe sequences stay
+       * short and always end.
+       */
+      if (table->SparseUsed + 1 > (sparse->Mask + 1) / 4 * 3) {
+         if (!rehash_sparse(table))
+            return;
+         sparse = table->Sparse;
+         pos = hash_key(key) & sparse->Mask;
+         while (sparse->Entries[pos].Key)
+            pos = (pos + 1) & sparse->Mask;
+      }
+      entry = &sparse->Entries[pos];
+      table->SparseUsed++;
+   }
+
+insert:
+   /* Readers that find the key before the data is set see no entry. */
+   entry->Key = key;
+   HASH_WRITE_BARRIER();
+   entry->Data = data;
+
+   table->NumEntries++;
+   table->SparseLive++;
+   if (key < table->SparseMinKey)
+      table->SparseMinKey = key;
+}
+
+
+/**
+ * Remove an entry, with the lock held.
+ */
+static void
+remove_entry(struct _mesa_HashTable *table, GLuint key)
+{
+   struct HashDense *dense = table->Dense;
+
+   if (key < table->FreeHint)
+      table->FreeHint = key;
+
+   if (key < dense->Size) {
+      if (dense->Data[key]) {
+         dense->Data[key] = NULL;
+         table->NumEntries--;
+      }
+   }
+   else {
+      struct HashEntry *entry = find_sparse_entry(table->Sparse, key);
+      if (entry && entry->Data) {
+         entry->Data = NULL;
+         table->NumEntries--;
+         if (--table->SparseLive == 0)
+            table->SparseMinKey = ~0u;
+      }
+   }
+}
+
+
 /**
  * Insert a key/pointer pair into the hash table.  
  * If an entry with this key already exists we'll replace the existing entry.
+ * Inserting NULL data is the same as removing the entry.
  * 
  * \param table the hash table.
  * \param key the key (not zero).
@@ -175,9 +543,7 @@ _mesa_HashLookup(struct _mesa_HashTable *table, GLuint key)
 void
 _mesa_HashInsert(struct _mesa_HashTable *table, GLuint key, void *data)
 {
-   /* search for existing entry with this key */
-   GLuint pos;
-   struct HashEntry *entry;
+   struct HashDense *dense;
 
    assert(table);
    assert(key);
@@ -187,30 +553,25 @@ _mesa_HashInsert(struct _mesa_HashTable *table, GLuint key, void *data)
    if (key > table->MaxKey)
       table->MaxKey = key;
 
-   pos = HASH_FUNC(key);
-
-   /* check if replacing an existing entry with same key */
-   for (entry = table->Table[pos]; entry; entry = entry->Next) {
-      if (entry->Key == key) {
-         /* replace entry's data */
-#if 0 /* not sure this check is always valid */
-         if (entry->Data) {
-            _mesa_problem(NULL, "Memory leak detected in _mesa_HashInsert");
-         }
-#endif
-	 entry->Data = data;
-         _glthread_UNLOCK_MUTEX(table->Mutex);
-	 return;
-      }
+   if (!data) {
+      remove_entry(table, key);
+      _glthread_UNLOCK_MUTEX(table->Mutex);
+      return;
    }
 
-   /* alloc and insert new table entry */
-   entry = MALLOC_STRUCT(HashEntry);
-   if (entry) {
-      entry->Key = key;
-      entry->Data = data;
-      entry->Next = table->Table[pos];
-      table->Table[pos] = entry;
+   if (key >= table->Dense->Size)
+      grow_dense(table, key);
+
+   dense = table->Dense;
+   if (key < dense->Size) {
+      if (!dense->Data[key])
+         table->NumEntries++;
+      /* Readers that find the data see the object initialized. */
+      HASH_WRITE_BARRIER();
+      dense->Data[key] = data;
+   }
+   else {
+      insert_sparse(table, key, data);
    }
 
    _glthread_UNLOCK_MUTEX(table->Mutex);
@@ -225,14 +586,11 @@ _mesa_HashInsert(struct _mesa_HashTable *table, GLuint key, void *data)
  * \param key key of entry to remove.
  *
  * While holding the hash table's lock, searches the entry with the matching
- * key and unlinks it.
+ * key and clears its data.
  */
 void
 _mesa_HashRemove(struct _mesa_HashTable *table, GLuint key)
 {
-   GLuint pos;
-   struct HashEntry *entry, *prev;
-
    assert(table);
    assert(key);
 
@@ -244,27 +602,7 @@ _mesa_HashRemove(struct _mesa_HashTable *table, GLuint key)
    }
 
    _glthread_LOCK_MUTEX(table->Mutex);
-
-   pos = HASH_FUNC(key);
-   prev = NULL;
-   entry = table->Table[pos];
-   while (entry) {
-      if (entry->Key == key) {
-         /* found it! */
-         if (prev) {
-            prev->Next = entry->Next;
-         }
-         else {
-            table->Table[pos] = entry->Next;
-         }
-         free(entry);
-         _glthread_UNLOCK_MUTEX(table->Mutex);
-	 return;
-      }
-      prev = entry;
-      entry = entry->Next;
-   }
-
+   remove_entry(table, key);
    _glthread_UNLOCK_MUTEX(table->Mutex);
 }
 
@@ -284,20 +622,37 @@ _mesa_HashDeleteAll(struct _mesa_HashTable *table,
                     void (*callback)(GLuint key, void *data, void *userData),
                     void *userData)
 {
+   struct HashDense *dense;
+   struct HashSparse *sparse;
    GLuint pos;
    ASSERT(table);
    ASSERT(callback);
    _glthread_LOCK_MUTEX(table->Mutex);
    table->InDeleteAll = GL_TRUE;
-   for (pos = 0; pos < TABLE_SIZE; pos++) {
-      struct HashEntry *entry, *next;
-      for (entry = table->Table[pos]; entry; entry = next) {
+   dense = table->Dense;
+   for (pos = 0; pos < dense->Size; pos++) {
+      void *data = dense->Data[pos];
+      if (data) {
+         callback(pos, data, userData);
+         dense->Data[pos] = NULL;
+      }
+   }
+   sparse = table->Sparse;
+   for (pos = 0; pos <= sparse->Mask; pos++) {
+      struct HashEntry *entry = &sparse->Entries[pos];
+      if (entry->Data) {
          callback(entry->Key, entry->Data, userData);
-         next = entry->Next;
-         free(entry);
+         entry->Data = NULL;
       }
-      table->Table[pos] = NULL;
    }
+   /* Drop the removed entries too. */
+   if (sparse != &EmptySparse)
+      memset(sparse->Entries, 0, (sparse->Mask + 1) * sizeof(struct HashEntry));
+   table->NumEntries = 0;
+   table->SparseUsed = 0;
+   table->SparseLive = 0;
+   table->SparseMinKey = ~0u;
+   table->FreeHint = 1;
    table->InDeleteAll = GL_FALSE;
    _glthread_UNLOCK_MUTEX(table->Mutex);
 }
@@ -322,26 +677,66 @@ _mesa_HashWalk(const struct _mesa_HashTable *table,
 {
    /* cast-away const */
    struct _mesa_HashTable *table2 = (struct _mesa_HashTable *) table;
+   const struct HashDense *dense;
+   const struct HashSparse *sparse;
    GLuint pos;
    ASSERT(table);
    ASSERT(callback);
    _glthread_LOCK_MUTEX(table2->WalkMutex);
-   for (pos = 0; pos < TABLE_SIZE; pos++) {
-      struct HashEntry *entry, *next;
-      for (entry = table->Table[pos]; entry; entry = next) {
-         /* save 'next' pointer now in case the callback deletes the entry */
-         next = entry->Next;
-         callback(entry->Key, entry->Data, userData);
-      }
+   /* The arrays stay valid if the callback makes the table grow, and they
+    * aren't rehashed in place while Walking is set.
+    */
+   _glthread_LOCK_MUTEX(table2->Mutex);
+   table2->Walking++;
+   dense = table->Dense;
+   sparse = table->Sparse;
+   _glthread_UNLOCK_MUTEX(table2->Mutex);
+   for (pos = 0; pos < dense->Size; pos++) {
+      void *data = dense->Data[pos];
+      if (data)
+         callback(pos, data, userData);
    }
+   for (pos = 0; pos <= sparse->Mask; pos++) {
+      const struct HashEntry *entry = &sparse->Entries[pos];
+      void *data = entry->Data;
+      if (data)
+         callback(entry->Key, data, userData);
+   }
+   _glthread_LOCK_MUTEX(table2->Mutex);
+   table2->Walking--;
+   _glthread_UNLOCK_MUTEX(table2->Mutex);
    _glthread_UNLOCK_MUTEX(table2->WalkMutex);
 }
 
 
+/**
+ * Return the key of the first entry at or after position \c pos, where
+ * the dense array comes first, followed by the slots of the sparse table.
+ *
+ * \return the key, or 0 if there are no more entries.
+ */
+static GLuint
+find_entry_from(const struct _mesa_HashTable *table, GLuint pos)
+{
+   const struct HashDense *dense = table->Dense;
+   const struct HashSparse *sparse = table->Sparse;
+
+   for (; pos < dense->Size; pos++) {
+      if (dense->Data[pos])
+         return pos;
+   }
+   for (pos -= dense->Size; pos <= sparse->Mask; pos++) {
+      if (sparse->Entries[pos].Data)
+         return sparse->Entries[pos].Key;
+   }
+   return 0;
+}
+
+
 /**
  * Return the key of the "first" entry in the hash table.
  * While holding the lock, walks through all table positions until finding
- * the first entry of the first non-empty one.
+ * the first non-empty one.
  * 
  * \param table  the hash table
  * \return key for the "first" entry in the hash table.
@@ -349,17 +744,12 @@ _mesa_HashWalk(const struct _mesa_HashTable *table,
 GLuint
 _mesa_HashFirstEntry(struct _mesa_HashTable *table)
 {
-   GLuint pos;
+   GLuint key;
    assert(table);
    _glthread_LOCK_MUTEX(table->Mutex);
-   for (pos = 0; pos < TABLE_SIZE; pos++) {
-      if (table->Table[pos]) {
-         _glthread_UNLOCK_MUTEX(table->Mutex);
-         return table->Table[pos]->Key;
-      }
-   }
+   key = find_entry_from(table, 0);
    _glthread_UNLOCK_MUTEX(table->Mutex);
-   return 0;
+   return key;
 }
 
 
@@ -372,40 +762,32 @@ _mesa_HashFirstEntry(struct _mesa_HashTable *table)
 GLuint
 _mesa_HashNextEntry(const struct _mesa_HashTable *table, GLuint key)
 {
+   const struct HashDense *dense = table->Dense;
+   const struct HashSparse *sparse = table->Sparse;
    const struct HashEntry *entry;
-   GLuint pos;
 
    assert(table);
    assert(key);
 
-   /* Find the entry with given key */
-   pos = HASH_FUNC(key);
-   for (entry = table->Table[pos]; entry ; entry = entry->Next) {
-      if (entry->Key == key) {
-         break;
-      }
-   }
+   if (key < dense->Size)
+      return find_entry_from(table, key + 1);
 
+   /* Find the entry with given key */
+   entry = find_sparse_entry(sparse, key);
    if (!entry) {
       /* the given key was not found, so we can't find the next entry */
       return 0;
    }
 
-   if (entry->Next) {
-      /* return next in linked list */
-      return entry->Next->Key;
-   }
-   else {
-      /* look for next non-empty table slot */
-      pos++;
-      while (pos < TABLE_SIZE) {
-         if (table->Table[pos]) {
-            return table->Table[pos]->Key;
-         }
-         pos++;
-      }
-      return 0;
-   }
+   return find_entry_from(table, dense->Size + (entry - sparse->Entries) + 1);
+}
+
+
+static void
+print_entry(GLuint key, void *data, void *userData)
+{
+   (void) userData;
+   _mesa_debug(NULL, "%u %p\n", key, data);
 }
 
 
@@ -417,19 +799,11 @@ _mesa_HashNextEntry(const struct _mesa_HashTable *table, GLuint key)
 void
 _mesa_HashPrint(const struct _mesa_HashTable *table)
 {
-   GLuint pos;
    assert(table);
-   for (pos = 0; pos < TABLE_SIZE; pos++) {
-      const struct HashEntry *entry = table->Table[pos];
-      while (entry) {
-	 _mesa_debug(NULL, "%u %p\n", entry->Key, entry->Data);
-	 entry = entry->Next;
-      }
-   }
+   _mesa_HashWalk(table, print_entry, NULL);
 }
 
 
-
 /**
  * Find a block of adjacent unused hash keys.
  * 
@@ -440,8 +814,10 @@ _mesa_HashPrint(const struct _mesa_HashTable *table)
  *
  * If there are enough free keys between the maximum key existing in the table
  * (_mesa_HashTable::MaxKey) and the maximum key possible, then simply return
- * the adjacent key. Otherwise do a full search for a free key block in the
- * allowable key range.
+ * the adjacent key. Otherwise look for a large enough gap from
+ * _mesa_HashTable::FreeHint on, below which all the keys are in use.  The
+ * hint moves past the keys found in use, and back to keys as they're
+ * removed, so the keys that are in use are mostly skipped.
  */
 GLuint
 _mesa_HashFindFreeKeyBlock(struct _mesa_HashTable *table, GLuint numKeys)
@@ -455,24 +831,31 @@ _mesa_HashFindFreeKeyBlock(struct _mesa_HashTable *table, GLuint numKeys)
    }
    else {
       /* the slow solution */
+      GLboolean foundFree = GL_FALSE;
       GLuint freeCount = 0;
-      GLuint freeStart = 1;
+      GLuint freeStart = 0;
       GLuint key;
-      for (key = 1; key != maxKey; key++) {
-	 if (_mesa_HashLookup_unlocked(table, key)) {
-	    /* darn, this key is already in use */
-	    freeCount = 0;
-	    freeStart = key+1;
-	 }
-	 else {
-	    /* this key not in use, check if we've found enough */
-	    freeCount++;
-	    if (freeCount == numKeys) {
-               _glthread_UNLOCK_MUTEX(table->Mutex);
-	       return freeStart;
-	    }
-	 }
+
+      for (key = table->FreeHint; key != maxKey; key++) {
+         if (_mesa_HashLookup_unlocked(table, key)) {
+            /* this key is in use */
+            freeCount = 0;
+            continue;
+         }
+
+         if (!foundFree) {
+            /* all the keys before this one are in use */
+            table->FreeHint = key;
+            foundFree = GL_TRUE;
+         }
+         if (freeCount == 0)
+            freeStart = key;
+         if (++freeCount == numKeys) {
+            _glthread_UNLOCK_MUTEX(table->Mutex);
+            return freeStart;
+         }
       }
+
       /* cannot allocate a block of numKeys consecutive keys */
       _glthread_UNLOCK_MUTEX(table->Mutex);
       return 0;
@@ -486,16 +869,7 @@ _mesa_HashFindFreeKeyBlock(struct _mesa_HashTable *table, GLuint numKeys)
 GLuint
 _mesa_HashNumEntries(const struct _mesa_HashTable *table)
 {
-   GLuint pos, count = 0;
-
-   for (pos = 0; pos < TABLE_SIZE; pos++) {
-      const struct HashEntry *entry;
-      for (entry = table->Table[pos]; entry; entry = entry->Next) {
-         count++;
-      }
-   }
-
-   return count;
+   return table->NumEntries;
 }
 
 
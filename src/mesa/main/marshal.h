@@ -0,0 +1,137 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2013  VMware, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * \file marshal.h
+ * Recording GL commands in the batches of a GL thread.
+ *
+ * A command is a struct marshal_cmd_base, followed by the parameters of
+ * the call and the data its pointers point to.  The functions that record
+ * and execute commands are generated in marshal_generated.c.
+ */
+
+
+#ifndef MARSHAL_H
+#define MARSHAL_H
+
+
+#include <limits.h>
+#include "main/glthread.h"
+#include "main/imports.h"
+#include "main/macros.h"
+
+#ifdef HAVE_PTHREAD
+
+
+/**
+ * Largest command.  The data of larger calls is not copied; they are
+ * executed synchronously instead.
+ */
+#define MARSHAL_MAX_CMD_SIZE (8 * 1024)
+
+
+struct marshal_cmd_base
+{
+   /** Type of the command */
+   uint16_t cmd_id;
+
+   /** Size of the command, in bytes, a multiple of 8 */
+   uint16_t cmd_size;
+};
+
+
+/** Round a size up to keep the commands and their data 8-byte aligned */
+static inline size_t
+marshal_align(size_t size)
+{
+   return (size + 7) & ~(size_t) 7;
+}
+
+
+/**
+ * Multiply an element count by an element size, returning -1 if the count
+ * is negative or the result does not fit in an int.  The count is taken
+ * as a GLsizeiptr so that the sizes of buffer data aren't truncated.
+ */
+static inline GLsizeiptr
+safe_mul(GLsizeiptr a, GLsizeiptr b)
+{
+   if (a < 0 || b < 0)
+      return -1;
+   if (a == 0 || b == 0)
+      return 0;
+   if (a > INT_MAX / b)
+      return -1;
+   return a * b;
+}
+
+
+/**
+ * Reserve room for a command in the current batch, submitting the batch
+ * first if it is full.
+ */
+static inline void *
+_mesa_glthread_allocate_command(struct gl_context *ctx,
+                                uint16_t cmd_id, size_t size)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_batch *batch = &glthread->Batches[glthread->Next];
+   struct marshal_cmd_base *cmd_base;
+   const size_t aligned_size = marshal_align(size);
+
+   assert(aligned_size <= MARSHAL_MAX_CMD_SIZE);
+
+   if (unlikely(batch->Used + aligned_size > MARSHAL_MAX_BATCH_SIZE)) {
+      _mesa_glthread_flush_batch(ctx);
+      batch = &glthread->Batches[glthread->Next];
+   }
+
+   cmd_base = (struct marshal_cmd_base *)
+      ((uint8_t *) batch->Buffer + batch->Used);
+   batch->Used += aligned_size;
+   cmd_base->cmd_id = cmd_id;
+   cmd_base->cmd_size = aligned_size;
+   return cmd_base;
+}
+
+
+/**
+ * Execute the command at \c cmd.
+ *
+ * \return the size of the command.
+ */
+extern size_t
+_mesa_unmarshal_dispatch_cmd(struct gl_context *ctx, const void *cmd);
+
+/**
+ * Create the dispatch table of the application thread.
+ */
+extern struct _glapi_table *
+_mesa_create_marshal_table(const struct gl_context *ctx);
+
+
+#endif /* HAVE_PTHREAD */
+
+#endif /* MARSHAL_H */
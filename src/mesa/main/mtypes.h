@@ -75,6 +75,7 @@ struct gl_meta_state;
 struct gl_program_cache;
 struct gl_texture_object;
 struct gl_context;
+struct glthread_state;
 struct st_context;
 struct gl_uniform_storage;
 struct prog_instruction;
@@ -2178,6 +2179,41 @@ struct gl_sl_pragmas
 };
 
 
+/**
+ * Compilation or linking of a shader object on the shader compiler threads.
+ * See shaderqueue.c.
+ */
+struct gl_shader_job
+{
+   void (*Execute)(struct gl_shader_job *job);
+   void *Object;                 /**< gl_shader or gl_shader_program */
+   struct gl_context *Context;   /**< Context the job was submitted from */
+   struct gl_shader_job *Next;   /**< Next job in the queue */
+
+   /** Queued or running.  Protected by the queue mutex. */
+   GLboolean Pending;
+
+   /**
+    * Number of pending jobs that read the object.  Protected by the queue
+    * mutex.
+    */
+   GLuint Users;
+
+   /**
+    * Read by a link.  The linker writes to the variables of the shaders
+    * it links, so a shader is only linked into one program at a time.
+    * Protected by the queue mutex.
+    */
+   GLboolean Linking;
+
+   /**
+    * Submitted, but the results haven't been picked up by a GL thread yet.
+    * Only accessed by GL threads.
+    */
+   GLboolean Unfinished;
+};
+
+
 /**
  * A GLSL vertex or fragment shader object.
  */
@@ -2190,6 +2226,22 @@ struct gl_shader
    GLboolean CompileStatus;
    const GLchar *Source;  /**< Source code string */
    GLuint SourceChecksum;       /**< for debug/logging purposes */
+
+   /**
+    * Shader cache key of the source and compile-time state, or all zeroes
+    * if the shader was not compiled with the shader cache enabled.
+    */
+   GLubyte SourceHash[20];
+
+   /**
+    * The shader cache showed that the source compiles, so compilation was
+    * put off until the shader is needed for linking a program that is not
+    * in the cache.  \c ir is \c NULL until then.
+    */
+   GLboolean CompileDeferred;
+
+   struct gl_shader_job Job;    /**< Background compilation */
+
    struct gl_program *Program;  /**< Post-compile assembly code */
    GLchar *InfoLog;
    struct gl_sl_pragmas Pragmas;
@@ -2229,6 +2281,12 @@ struct gl_shader
    /** Shaders containing built-in functions that are used for linking. */
    struct gl_shader *builtins_to_link[16];
    unsigned num_builtins_to_link;
+
+   /**
+    * For the shaders containing built-in functions, where the bodies of the
+    * functions are loaded from when they are first needed.
+    */
+   struct builtin_library *builtin_library;
 };
 
 
@@ -2398,6 +2456,33 @@ struct gl_shader_program
 
    unsigned Version;       /**< GLSL version used for linking */
 
+   /**
+    * Program binary for GL_ARB_get_program_binary
+    *
+    * Built from the linked program the first time the application asks for
+    * it, and freed when the program is linked again.  Allocated out of the
+    * program.
+    */
+   GLvoid *Binary;
+   GLsizei BinaryLength;
+   GLboolean BinaryRetrievableHint; /**< GL_PROGRAM_BINARY_RETRIEVABLE_HINT */
+
+   /**
+    * Shader cache key of the program being linked, if \c Cacheable.  Kept
+    * between the parts of the link done by different threads.
+    */
+   GLubyte CacheKey[20];
+   GLboolean Cacheable;
+
+   struct gl_shader_job Job;    /**< Background linking */
+
+   /**
+    * Number of binding points of all the contexts the program is current
+    * at (see _mesa_reference_current_program).  Protected by the shared
+    * state mutex.
+    */
+   GLuint CurrentCount;
+
    /**
     * Per-stage shaders resulting from the first stage of linking.
     *
@@ -2418,6 +2503,7 @@ struct gl_shader_program
 #define GLSL_NOP_FRAG 0x40  /**< Force no-op fragment shaders */
 #define GLSL_USE_PROG 0x80  /**< Log glUseProgram calls */
 #define GLSL_REPORT_ERRORS 0x100  /**< Print compilation errors */
+#define GLSL_OPT_STATS 0x200  /**< Print optimization pass statistics */
 
 
 /**
@@ -2446,6 +2532,10 @@ struct gl_shader_state
    struct gl_shader_program *ActiveProgram;
 
    GLbitfield Flags;                    /**< Mask of GLSL_x flags */
+
+   /** On-disk shader cache, NULL if disabled.  Opened on first use. */
+   struct disk_cache *Cache;
+   GLboolean CacheInitialized;
 };
 
 
@@ -3390,8 +3480,12 @@ struct gl_context
    struct _glapi_table *Save;	/**< Display list save functions */
    struct _glapi_table *Exec;	/**< Execute functions */
    struct _glapi_table *CurrentDispatch;  /**< == Save or Exec !! */
+   struct _glapi_table *MarshalExec;      /**< Functions recording commands */
    /*@}*/
 
+   /** Set while commands are executed on a separate thread */
+   struct glthread_state *GLThread;
+
    struct gl_config Visual;
    struct gl_framebuffer *DrawBuffer;	/**< buffer for writing */
    struct gl_framebuffer *ReadBuffer;	/**< buffer for reading */
@@ -30,6 +30,7 @@
 #include "readpix.h"
 #include "framebuffer.h"
 #include "formats.h"
+#include "format_simd.h"
 #include "format_unpack.h"
 #include "image.h"
 #include "mtypes.h"
@@ -211,6 +212,37 @@ read_stencil_pixels( struct gl_context *ctx,
 }
 
 
+/**
+ * Find a SIMD swizzle from a 32-bit RGBA renderbuffer format to the
+ * 32-bit RGBA format that matches format and type.
+ */
+static const struct simd_conversion *
+get_simd_read_conversion(gl_format rbFormat, GLenum format, GLenum type,
+                         GLboolean swapBytes)
+{
+   static const gl_format dstFormats[] = {
+      MESA_FORMAT_RGBA8888,
+      MESA_FORMAT_RGBA8888_REV,
+      MESA_FORMAT_ARGB8888,
+      MESA_FORMAT_ARGB8888_REV
+   };
+   GLuint i;
+
+   /* The conversions from 565 replicate the high bits, where the slow
+    * path rounds.
+    */
+   if (_mesa_get_format_bytes(rbFormat) != 4)
+      return NULL;
+
+   for (i = 0; i < Elements(dstFormats); i++) {
+      if (_mesa_format_matches_format_and_type(dstFormats[i], format, type,
+                                               swapBytes))
+         return _mesa_get_simd_conversion(rbFormat, dstFormats[i]);
+   }
+   return NULL;
+}
+
+
 /**
  * Try to do glReadPixels of RGBA data using a simple memcpy or swizzle.
  * \return GL_TRUE if successful, GL_FALSE otherwise (use the slow path)
@@ -228,6 +260,10 @@ fast_read_rgba_pixels_memcpy( struct gl_context *ctx,
    GLubyte *dst, *map;
    int dstStride, stride, j, texelBytes;
    GLboolean swizzle_rb = GL_FALSE, copy_xrgb = GL_FALSE;
+   const struct simd_conversion *conv;
+
+   conv = get_simd_read_conversion(rb->Format, format, type,
+                                   ctx->Pack.SwapBytes);
 
    /* XXX we could check for other swizzle/special cases here as needed */
    if (rb->Format == MESA_FORMAT_RGBA8888_REV &&
@@ -242,7 +278,8 @@ fast_read_rgba_pixels_memcpy( struct gl_context *ctx,
        !ctx->Pack.SwapBytes) {
       copy_xrgb = GL_TRUE;
    }
-   else if (!_mesa_format_matches_format_and_type(rb->Format, format, type,
+   else if (!conv &&
+            !_mesa_format_matches_format_and_type(rb->Format, format, type,
                                                   ctx->Pack.SwapBytes))
       return GL_FALSE;
 
@@ -269,7 +306,13 @@ fast_read_rgba_pixels_memcpy( struct gl_context *ctx,
 
    texelBytes = _mesa_get_format_bytes(rb->Format);
 
-   if (swizzle_rb) {
+   if (conv) {
+      for (j = 0; j < height; j++) {
+         _mesa_simd_convert_row(conv, map, dst, width);
+         dst += dstStride;
+         map += stride;
+      }
+   } else if (swizzle_rb) {
       /* swap R/B */
       for (j = 0; j < height; j++) {
          int i;
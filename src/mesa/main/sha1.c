@@ -0,0 +1,173 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2013  VMware, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * \file sha1.c
+ * SHA-1 message digest, as described in FIPS 180-1.
+ */
+
+
+#include <string.h>
+#include "sha1.h"
+
+
+#define ROL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+
+static void
+sha1_transform(uint32_t state[5], const uint8_t block[64])
+{
+   uint32_t w[80];
+   uint32_t a, b, c, d, e;
+   unsigned i;
+
+   for (i = 0; i < 16; i++) {
+      w[i] = ((uint32_t) block[i * 4 + 0] << 24) |
+             ((uint32_t) block[i * 4 + 1] << 16) |
+             ((uint32_t) block[i * 4 + 2] << 8) |
+             ((uint32_t) block[i * 4 + 3]);
+   }
+   for (i = 16; i < 80; i++)
+      w[i] = ROL32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+   a = state[0];
+   b = state[1];
+   c = state[2];
+   d = state[3];
+   e = state[4];
+
+   for (i = 0; i < 80; i++) {
+      uint32_t f, k, t;
+
+      if (i < 20) {
+         f = (b & c) | (~b & d);
+         k = 0x5a827999;
+      }
+      else if (i < 40) {
+         f = b ^ c ^ d;
+         k = 0x6ed9eba1;
+      }
+      else if (i < 60) {
+         f = (b & c) | (b & d) | (c & d);
+         k = 0x8f1bbcdc;
+      }
+      else {
+         f = b ^ c ^ d;
+         k = 0xca62c1d6;
+      }
+
+      t = ROL32(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = ROL32(b, 30);
+      b = a;
+      a = t;
+   }
+
+   state[0] += a;
+   state[1] += b;
+   state[2] += c;
+   state[3] += d;
+   state[4] += e;
+}
+
+
+void
+_mesa_sha1_init(struct mesa_sha1 *ctx)
+{
+   ctx->state[0] = 0x67452301;
+   ctx->state[1] = 0xefcdab89;
+   ctx->state[2] = 0x98badcfe;
+   ctx->state[3] = 0x10325476;
+   ctx->state[4] = 0xc3d2e1f0;
+   ctx->count = 0;
+}
+
+
+void
+_mesa_sha1_update(struct mesa_sha1 *ctx, const void *data, size_t size)
+{
+   const uint8_t *bytes = (const uint8_t *) data;
+   unsigned used = (unsigned) (ctx->count & 63);
+
+   ctx->count += size;
+
+   if (used) {
+      const unsigned n = size < 64 - used ? (unsigned) size : 64 - used;
+
+      memcpy(ctx->buffer + used, bytes, n);
+      bytes += n;
+      size -= n;
+      if (used + n < 64)
+         return;
+
+      sha1_transform(ctx->state, ctx->buffer);
+   }
+
+   while (size >= 64) {
+      sha1_transform(ctx->state, bytes);
+      bytes += 64;
+      size -= 64;
+   }
+
+   memcpy(ctx->buffer, bytes, size);
+}
+
+
+void
+_mesa_sha1_final(struct mesa_sha1 *ctx, uint8_t digest[SHA1_DIGEST_LENGTH])
+{
+   const uint64_t bits = ctx->count * 8;
+   static const uint8_t pad[64] = { 0x80 };
+   uint8_t length[8];
+   unsigned i;
+
+   for (i = 0; i < 8; i++)
+      length[i] = (uint8_t) (bits >> (56 - i * 8));
+
+   /* Pad to 56 bytes mod 64, then append the length in bits. */
+   _mesa_sha1_update(ctx, pad, 1 + ((119 - (ctx->count & 63)) & 63));
+   _mesa_sha1_update(ctx, length, 8);
+
+   for (i = 0; i < SHA1_DIGEST_LENGTH; i++)
+      digest[i] = (uint8_t) (ctx->state[i / 4] >> (24 - (i % 4) * 8));
+}
+
+
+/**
+ * Write the digest as 40 hex digits and a terminating zero.
+ */
+void
+_mesa_sha1_format(char *buf, const uint8_t digest[SHA1_DIGEST_LENGTH])
+{
+   static const char hex[] = "0123456789abcdef";
+   unsigned i;
+
+   for (i = 0; i < SHA1_DIGEST_LENGTH; i++) {
+      buf[i * 2] = hex[digest[i] >> 4];
+      buf[i * 2 + 1] = hex[digest[i] & 15];
+   }
+   buf[i * 2] = '\0';
+}
@@ -0,0 +1,72 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2013  VMware, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * \file sha1.h
+ * SHA-1 message digest, for naming cached data after its inputs.
+ */
+
+
+#ifndef SHA1_H
+#define SHA1_H
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#define SHA1_DIGEST_LENGTH 20
+
+
+struct mesa_sha1
+{
+   uint32_t state[5];
+   uint64_t count;          /**< number of bytes hashed so far */
+   uint8_t buffer[64];      /**< incomplete block */
+};
+
+
+extern void
+_mesa_sha1_init(struct mesa_sha1 *ctx);
+
+extern void
+_mesa_sha1_update(struct mesa_sha1 *ctx, const void *data, size_t size);
+
+extern void
+_mesa_sha1_final(struct mesa_sha1 *ctx, uint8_t digest[SHA1_DIGEST_LENGTH]);
+
+extern void
+_mesa_sha1_format(char *buf, const uint8_t digest[SHA1_DIGEST_LENGTH]);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SHA1_H */
@@ -38,6 +38,7 @@
 
 #include "main/glheader.h"
 #include "main/context.h"
+#include "main/disk_cache.h"
 #include "main/dispatch.h"
 #include "main/enums.h"
 #include "main/hash.h"
@@ -45,6 +46,7 @@
 #include "main/mtypes.h"
 #include "main/shaderapi.h"
 #include "main/shaderobj.h"
+#include "main/shaderqueue.h"
 #include "main/uniforms.h"
 #include "program/program.h"
 #include "program/prog_parameter.h"
@@ -85,6 +87,8 @@ get_shader_flags(void)
          flags |= GLSL_USE_PROG;
       if (strstr(env, "errors"))
          flags |= GLSL_REPORT_ERRORS;
+      if (strstr(env, "stats"))
+         flags |= GLSL_OPT_STATS;
    }
 
    return flags;
@@ -113,6 +117,8 @@ _mesa_init_shader_state(struct gl_context *ctx)
       memcpy(&ctx->ShaderCompilerOptions[sh], &options, sizeof(options));
 
    ctx->Shader.Flags = get_shader_flags();
+
+   _mesa_init_shader_queue();
 }
 
 
@@ -122,14 +128,20 @@ _mesa_init_shader_state(struct gl_context *ctx)
 void
 _mesa_free_shader_state(struct gl_context *ctx)
 {
-   _mesa_reference_shader_program(ctx, &ctx->Shader.CurrentVertexProgram, NULL);
-   _mesa_reference_shader_program(ctx, &ctx->Shader.CurrentGeometryProgram,
-				  NULL);
-   _mesa_reference_shader_program(ctx, &ctx->Shader.CurrentFragmentProgram,
-				  NULL);
+   _mesa_free_shader_queue();
+
+   _mesa_reference_current_program(ctx, &ctx->Shader.CurrentVertexProgram,
+                                   NULL);
+   _mesa_reference_current_program(ctx, &ctx->Shader.CurrentGeometryProgram,
+                                   NULL);
+   _mesa_reference_current_program(ctx, &ctx->Shader.CurrentFragmentProgram,
+                                   NULL);
    _mesa_reference_shader_program(ctx, &ctx->Shader._CurrentFragmentProgram,
 				  NULL);
-   _mesa_reference_shader_program(ctx, &ctx->Shader.ActiveProgram, NULL);
+   _mesa_reference_current_program(ctx, &ctx->Shader.ActiveProgram, NULL);
+
+   _mesa_disk_cache_destroy(ctx->Shader.Cache);
+   ctx->Shader.Cache = NULL;
 }
 
 
@@ -587,6 +599,19 @@ get_programiv(struct gl_context *ctx, GLuint program, GLenum pname, GLint *param
 
       *params = shProg->NumUniformBlocks;
       return;
+   case GL_PROGRAM_BINARY_LENGTH:
+      if (!_mesa_is_desktop_gl(ctx))
+         break;
+
+      _mesa_glsl_get_program_binary(ctx, shProg);
+      *params = shProg->BinaryLength;
+      return;
+   case GL_PROGRAM_BINARY_RETRIEVABLE_HINT:
+      if (!_mesa_is_desktop_gl(ctx))
+         break;
+
+      *params = shProg->BinaryRetrievableHint;
+      return;
    default:
       break;
    }
@@ -688,6 +713,9 @@ shader_source(struct gl_context *ctx, GLuint shader, const GLchar *source)
    if (!sh)
       return;
 
+   /* Programs may still be linking with the old source. */
+   _mesa_wait_shader_job(&sh->Job);
+
    /* free old shader source string and install new one */
    free((void *)sh->Source);
    sh->Source = source;
@@ -711,21 +739,17 @@ compile_shader(struct gl_context *ctx, GLuint shaderObj)
    if (!sh)
       return;
 
+   _mesa_wait_shader_job(&sh->Job);
+
    options = &ctx->ShaderCompilerOptions[_mesa_shader_type_to_index(sh->Type)];
 
    /* set default pragma state for shader */
    sh->Pragmas = options->DefaultPragmas;
 
-   /* this call will set the sh->CompileStatus field to indicate if
-    * compilation was successful.
+   /* This sets the sh->CompileStatus field to indicate if compilation was
+    * successful, possibly later on a compiler thread.
     */
-   _mesa_glsl_compile_shader(ctx, sh);
-
-   if (sh->CompileStatus == GL_FALSE && 
-       (ctx->Shader.Flags & GLSL_REPORT_ERRORS)) {
-      _mesa_debug(ctx, "Error compiling shader %u:\n%s\n",
-                  sh->Name, sh->InfoLog);
-   }
+   _mesa_queue_compile_shader(ctx, sh);
 }
 
 
@@ -754,13 +778,10 @@ link_program(struct gl_context *ctx, GLuint program)
 
    FLUSH_VERTICES(ctx, _NEW_PROGRAM);
 
-   _mesa_glsl_link_shader(ctx, shProg);
-
-   if (shProg->LinkStatus == GL_FALSE && 
-       (ctx->Shader.Flags & GLSL_REPORT_ERRORS)) {
-      _mesa_debug(ctx, "Error linking program %u:\n%s\n",
-                  shProg->Name, shProg->InfoLog);
-   }
+   /* The program may be linked later on a compiler thread.  Looking it up
+    * again waits for the result.
+    */
+   _mesa_queue_link_program(ctx, shProg);
 
    /* debug code */
    if (0) {
@@ -819,6 +840,32 @@ print_shader_info(const struct gl_shader_program *shProg)
 }
 
 
+/**
+ * Set one of the current program binding points of \c ctx, counting the
+ * bindings of the program across all the contexts (see
+ * _mesa_queue_link_program).
+ */
+void
+_mesa_reference_current_program(struct gl_context *ctx,
+                                struct gl_shader_program **ptr,
+                                struct gl_shader_program *shProg)
+{
+   if (*ptr == shProg)
+      return;
+
+   _glthread_LOCK_MUTEX(ctx->Shared->Mutex);
+   if (*ptr) {
+      assert((*ptr)->CurrentCount > 0);
+      (*ptr)->CurrentCount--;
+   }
+   if (shProg)
+      shProg->CurrentCount++;
+   _glthread_UNLOCK_MUTEX(ctx->Shared->Mutex);
+
+   _mesa_reference_shader_program(ctx, ptr, shProg);
+}
+
+
 /**
  * Use the named shader program for subsequent glUniform calls
  */
@@ -833,7 +880,7 @@ _mesa_active_program(struct gl_context *ctx, struct gl_shader_program *shProg,
    }
 
    if (ctx->Shader.ActiveProgram != shProg) {
-      _mesa_reference_shader_program(ctx, &ctx->Shader.ActiveProgram, shProg);
+      _mesa_reference_current_program(ctx, &ctx->Shader.ActiveProgram, shProg);
    }
 }
 
@@ -894,7 +941,7 @@ use_shader_program(struct gl_context *ctx, GLenum type,
 	 break;
       }
 
-      _mesa_reference_shader_program(ctx, target, shProg);
+      _mesa_reference_current_program(ctx, target, shProg);
       return true;
    }
 
@@ -1487,6 +1534,7 @@ _mesa_GetShaderPrecisionFormat(GLenum shadertype, GLenum precisiontype,
 void GLAPIENTRY
 _mesa_ReleaseShaderCompiler(void)
 {
+   _mesa_drain_shader_queue();
    _mesa_destroy_shader_compiler_caches();
 }
 
@@ -1561,6 +1609,19 @@ _mesa_ProgramParameteriARB(GLuint program, GLenum pname, GLint value)
          return;
       }
       break;
+   case GL_PROGRAM_BINARY_RETRIEVABLE_HINT:
+      if (value != GL_FALSE && value != GL_TRUE) {
+         _mesa_error(ctx, GL_INVALID_VALUE,
+                     "glProgramParameteri(GL_PROGRAM_BINARY_RETRIEVABLE_HINT"
+                     "=%d", value);
+         return;
+      }
+      /* The hint only matters to implementations that have to keep
+       * something around to build the binary; Mesa builds it from the
+       * linked IR, which is kept anyway.
+       */
+      shProg->BinaryRetrievableHint = value;
+      break;
    default:
       _mesa_error(ctx, GL_INVALID_ENUM, "glProgramParameteriARB(pname=%s)",
                   _mesa_lookup_enum_by_nr(pname));
@@ -1568,6 +1629,107 @@ _mesa_ProgramParameteriARB(GLuint program, GLenum pname, GLint value)
    }
 }
 
+
+/**
+ * glGetProgramBinary() - GL_ARB_get_program_binary
+ */
+void GLAPIENTRY
+_mesa_GetProgramBinary(GLuint program, GLsizei bufSize, GLsizei *length,
+                       GLenum *binaryFormat, GLvoid *binary)
+{
+   struct gl_shader_program *shProg;
+   GET_CURRENT_CONTEXT(ctx);
+
+   ASSERT_OUTSIDE_BEGIN_END(ctx);
+
+   shProg = _mesa_lookup_shader_program_err(ctx, program,
+                                            "glGetProgramBinary");
+   if (!shProg)
+      return;
+
+   if (bufSize < 0) {
+      _mesa_error(ctx, GL_INVALID_VALUE, "glGetProgramBinary(bufSize < 0)");
+      return;
+   }
+
+   if (!shProg->LinkStatus) {
+      _mesa_error(ctx, GL_INVALID_OPERATION,
+                  "glGetProgramBinary(program not linked)");
+      return;
+   }
+
+   _mesa_glsl_get_program_binary(ctx, shProg);
+   if (!shProg->Binary) {
+      _mesa_error(ctx, GL_OUT_OF_MEMORY, "glGetProgramBinary");
+      return;
+   }
+
+   if (bufSize < shProg->BinaryLength) {
+      _mesa_error(ctx, GL_INVALID_OPERATION,
+                  "glGetProgramBinary(bufSize too small)");
+      return;
+   }
+
+   memcpy(binary, shProg->Binary, shProg->BinaryLength);
+   if (length)
+      *length = shProg->BinaryLength;
+   *binaryFormat = GL_PROGRAM_BINARY_FORMAT_MESA;
+}
+
+
+/**
+ * glProgramBinary() - GL_ARB_get_program_binary
+ *
+ * A binary that cannot be loaded is not an error: the program is simply
+ * left unlinked, and the application is expected to fall back to compiling
+ * the shaders from source.
+ */
+void GLAPIENTRY
+_mesa_ProgramBinary(GLuint program, GLenum binaryFormat,
+                    const GLvoid *binary, GLsizei length)
+{
+   struct gl_shader_program *shProg;
+   struct gl_transform_feedback_object *obj;
+   GET_CURRENT_CONTEXT(ctx);
+
+   ASSERT_OUTSIDE_BEGIN_END(ctx);
+
+   shProg = _mesa_lookup_shader_program_err(ctx, program, "glProgramBinary");
+   if (!shProg)
+      return;
+
+   if (binaryFormat != GL_PROGRAM_BINARY_FORMAT_MESA) {
+      _mesa_error(ctx, GL_INVALID_ENUM, "glProgramBinary(binaryFormat=%s)",
+                  _mesa_lookup_enum_by_nr(binaryFormat));
+      return;
+   }
+
+   if (length < 0) {
+      _mesa_error(ctx, GL_INVALID_VALUE, "glProgramBinary(length < 0)");
+      return;
+   }
+
+   obj = ctx->TransformFeedback.CurrentObject;
+   if (obj->Active
+       && (shProg == ctx->Shader.CurrentVertexProgram
+	   || shProg == ctx->Shader.CurrentGeometryProgram
+	   || shProg == ctx->Shader.CurrentFragmentProgram)) {
+      _mesa_error(ctx, GL_INVALID_OPERATION,
+                  "glProgramBinary(transform feedback active)");
+      return;
+   }
+
+   FLUSH_VERTICES(ctx, _NEW_PROGRAM);
+
+   _mesa_glsl_load_program_binary(ctx, shProg, binary, length);
+
+   if (shProg->LinkStatus == GL_FALSE &&
+       (ctx->Shader.Flags & GLSL_REPORT_ERRORS)) {
+      _mesa_debug(ctx, "Error loading binary of program %u:\n%s\n",
+                  shProg->Name, shProg->InfoLog);
+   }
+}
+
 void
 _mesa_use_shader_program(struct gl_context *ctx, GLenum type,
 			 struct gl_shader_program *shProg)
@@ -1734,6 +1896,10 @@ _mesa_init_shader_dispatch(const struct gl_context *ctx,
    if (ctx->API != API_OPENGLES2) {
       SET_ProgramParameteriARB(exec, _mesa_ProgramParameteriARB);
 
+      /* GL_ARB_get_program_binary */
+      SET_GetProgramBinary(exec, _mesa_GetProgramBinary);
+      SET_ProgramBinary(exec, _mesa_ProgramBinary);
+
       SET_UseShaderProgramEXT(exec, _mesa_UseShaderProgramEXT);
       SET_ActiveProgramEXT(exec, _mesa_ActiveProgramEXT);
       SET_CreateShaderProgramEXT(exec, _mesa_CreateShaderProgramEXT);
@@ -35,6 +35,7 @@
 #include "main/mfeatures.h"
 #include "main/mtypes.h"
 #include "main/shaderobj.h"
+#include "main/shaderqueue.h"
 #include "main/uniforms.h"
 #include "program/program.h"
 #include "program/prog_parameter.h"
@@ -75,6 +76,7 @@ _mesa_reference_shader(struct gl_context *ctx, struct gl_shader **ptr,
       if (deleteFlag) {
 	 if (old->Name != 0)
 	    _mesa_HashRemove(ctx->Shared->ShaderObjects, old->Name);
+         _mesa_wait_shader_job(&old->Job);
          ctx->Driver.DeleteShader(ctx, old);
       }
 
@@ -146,6 +148,8 @@ _mesa_lookup_shader(struct gl_context *ctx, GLuint name)
       if (sh && sh->Type == GL_SHADER_PROGRAM_MESA) {
          return NULL;
       }
+      if (sh)
+         _mesa_wait_shader(ctx, sh);
       return sh;
    }
    return NULL;
@@ -173,6 +177,7 @@ _mesa_lookup_shader_err(struct gl_context *ctx, GLuint name, const char *caller)
          _mesa_error(ctx, GL_INVALID_OPERATION, "%s", caller);
          return NULL;
       }
+      _mesa_wait_shader(ctx, sh);
       return sh;
    }
 }
@@ -216,6 +221,7 @@ _mesa_reference_shader_program(struct gl_context *ctx,
       if (deleteFlag) {
 	 if (old->Name != 0)
 	    _mesa_HashRemove(ctx->Shared->ShaderObjects, old->Name);
+         _mesa_wait_shader_job(&old->Job);
          ctx->Driver.DeleteShaderProgram(ctx, old);
       }
 
@@ -288,6 +294,10 @@ _mesa_clear_shader_program_data(struct gl_context *ctx,
       shProg->UniformHash = NULL;
    }
 
+   ralloc_free(shProg->Binary);
+   shProg->Binary = NULL;
+   shProg->BinaryLength = 0;
+
    assert(shProg->InfoLog != NULL);
    ralloc_free(shProg->InfoLog);
    shProg->InfoLog = ralloc_strdup(shProg, "");
@@ -381,6 +391,8 @@ _mesa_lookup_shader_program(struct gl_context *ctx, GLuint name)
       if (shProg && shProg->Type != GL_SHADER_PROGRAM_MESA) {
          return NULL;
       }
+      if (shProg)
+         _mesa_wait_shader_program(ctx, shProg);
       return shProg;
    }
    return NULL;
@@ -409,6 +421,7 @@ _mesa_lookup_shader_program_err(struct gl_context *ctx, GLuint name,
          _mesa_error(ctx, GL_INVALID_OPERATION, "%s", caller);
          return NULL;
       }
+      _mesa_wait_shader_program(ctx, shProg);
       return shProg;
    }
 }
@@ -0,0 +1,550 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2013  VMware, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * \file shaderqueue.c
+ * Compiling and linking GLSL shaders on background threads.
+ *
+ * glCompileShader and glLinkProgram queue a job and return.  The jobs are
+ * run by a pool of threads shared by all the contexts.  The results are
+ * picked up by the first GL thread that looks the object up again, which
+ * waits for the job if needed.  Picking up the results of a link hands the
+ * program to the driver, which only ever runs on GL threads.
+ *
+ * A link job reads the shaders of the program, so it waits for their
+ * compile jobs, and the shaders can't be changed or deleted until it is
+ * done.  Jobs are started in the order they are queued, so a link job only
+ * waits for jobs that are already running.  The linker also writes to the
+ * variables of the shaders, so links that share a shader, in the
+ * background or not, run one at a time.
+ *
+ * The number of threads is the number of CPUs, up to MAX_SHADER_THREADS.
+ * It can be set with the MESA_GLSL_THREADS environment variable, where 0
+ * means compiling and linking synchronously.  Shaders are always compiled
+ * synchronously when they are dumped or logged with MESA_GLSL.
+ */
+
+
+#include "glheader.h"
+#include "imports.h"
+#include "macros.h"
+#include "mtypes.h"
+#include "shaderqueue.h"
+#include "program/ir_to_mesa.h"
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+
+#define MAX_SHADER_THREADS 8
+
+
+#ifdef HAVE_PTHREAD
+
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Signaled when a job is queued, or when the threads must exit */
+static pthread_cond_t queue_work = PTHREAD_COND_INITIALIZER;
+
+/** Signaled when a job completes, or stops using an object */
+static pthread_cond_t queue_done = PTHREAD_COND_INITIALIZER;
+
+static struct gl_shader_job *queue_head;
+static struct gl_shader_job *queue_tail;
+
+static pthread_t queue_threads[MAX_SHADER_THREADS];
+static int queue_max_threads = -1;
+static unsigned queue_num_threads;
+static unsigned queue_num_running;
+static unsigned queue_num_contexts;
+static GLboolean queue_exit;
+
+
+static void *
+shader_thread(void *data)
+{
+   (void) data;
+
+   pthread_mutex_lock(&queue_mutex);
+
+   for (;;) {
+      struct gl_shader_job *job;
+
+      while (queue_head == NULL && !queue_exit)
+         pthread_cond_wait(&queue_work, &queue_mutex);
+
+      if (queue_head == NULL)
+         break;
+
+      job = queue_head;
+      queue_head = job->Next;
+      if (queue_head == NULL)
+         queue_tail = NULL;
+      queue_num_running++;
+
+      pthread_mutex_unlock(&queue_mutex);
+      job->Execute(job);
+      pthread_mutex_lock(&queue_mutex);
+
+      /* The object may be freed as soon as this is cleared. */
+      job->Pending = GL_FALSE;
+      queue_num_running--;
+      pthread_cond_broadcast(&queue_done);
+   }
+
+   pthread_mutex_unlock(&queue_mutex);
+   return NULL;
+}
+
+
+static int
+get_max_threads(void)
+{
+   const char *env = _mesa_getenv("MESA_GLSL_THREADS");
+   long n = 0;
+
+   if (env) {
+      n = strtol(env, NULL, 10);
+   }
+   else {
+#ifdef _SC_NPROCESSORS_ONLN
+      n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+      /* There is nothing to gain from a single CPU. */
+      if (n < 2)
+         n = 0;
+   }
+
+   return CLAMP(n, 0, MAX_SHADER_THREADS);
+}
+
+
+/**
+ * Start the threads if needed.  Called with the queue mutex held.
+ *
+ * \return whether there are threads to run jobs.
+ */
+static GLboolean
+start_threads(void)
+{
+   if (queue_max_threads < 0)
+      queue_max_threads = get_max_threads();
+
+   while (queue_num_threads < (unsigned) queue_max_threads) {
+      if (pthread_create(&queue_threads[queue_num_threads], NULL,
+                         shader_thread, NULL) != 0) {
+         /* Make do with what we have. */
+         queue_max_threads = queue_num_threads;
+         break;
+      }
+      queue_num_threads++;
+   }
+
+   return queue_num_threads > 0;
+}
+
+
+static void
+stop_threads(void)
+{
+   unsigned i;
+
+   pthread_mutex_lock(&queue_mutex);
+   queue_exit = GL_TRUE;
+   pthread_cond_broadcast(&queue_work);
+   pthread_mutex_unlock(&queue_mutex);
+
+   for (i = 0; i < queue_num_threads; i++)
+      pthread_join(queue_threads[i], NULL);
+
+   queue_num_threads = 0;
+   queue_exit = GL_FALSE;
+}
+
+#endif /* HAVE_PTHREAD */
+
+
+/**
+ * Decide whether a job can be queued, and start the threads if needed.
+ */
+static GLboolean
+use_threads(struct gl_context *ctx)
+{
+#ifdef HAVE_PTHREAD
+   GLboolean ret;
+
+   if (ctx->Shader.Flags & (GLSL_DUMP | GLSL_LOG))
+      return GL_FALSE;
+
+   pthread_mutex_lock(&queue_mutex);
+   ret = start_threads();
+   pthread_mutex_unlock(&queue_mutex);
+
+   return ret;
+#else
+   (void) ctx;
+   return GL_FALSE;
+#endif
+}
+
+
+static void
+submit_job(struct gl_context *ctx, struct gl_shader_job *job,
+           void (*execute)(struct gl_shader_job *job), void *object)
+{
+   job->Execute = execute;
+   job->Object = object;
+   job->Context = ctx;
+   job->Next = NULL;
+   job->Unfinished = GL_TRUE;
+
+#ifdef HAVE_PTHREAD
+   pthread_mutex_lock(&queue_mutex);
+
+   job->Pending = GL_TRUE;
+   if (queue_tail)
+      queue_tail->Next = job;
+   else
+      queue_head = job;
+   queue_tail = job;
+   pthread_cond_signal(&queue_work);
+
+   pthread_mutex_unlock(&queue_mutex);
+#else
+   assert(!"no shader compiler threads");
+#endif
+}
+
+
+/**
+ * Wait until \c job is done, and optionally until no other job uses its
+ * object.
+ */
+static void
+wait_for_job(struct gl_shader_job *job, GLboolean unused)
+{
+#ifdef HAVE_PTHREAD
+   pthread_mutex_lock(&queue_mutex);
+   while (job->Pending || (unused && job->Users > 0))
+      pthread_cond_wait(&queue_done, &queue_mutex);
+   pthread_mutex_unlock(&queue_mutex);
+#else
+   (void) job;
+   (void) unused;
+#endif
+}
+
+
+/**
+ * Count one more (or one less) link job that reads the shaders of \c prog.
+ */
+static void
+use_shaders(struct gl_shader_program *prog, GLboolean use)
+{
+#ifdef HAVE_PTHREAD
+   GLuint i;
+
+   pthread_mutex_lock(&queue_mutex);
+   for (i = 0; i < prog->NumShaders; i++) {
+      if (use)
+         prog->Shaders[i]->Job.Users++;
+      else
+         prog->Shaders[i]->Job.Users--;
+   }
+   if (!use)
+      pthread_cond_broadcast(&queue_done);
+   pthread_mutex_unlock(&queue_mutex);
+#else
+   (void) prog;
+   (void) use;
+#endif
+}
+
+
+/**
+ * Wait until no other link uses the shaders of \c prog, and claim them for
+ * linking \c prog.  Called by _mesa_glsl_link_shader_ir.
+ *
+ * The shaders are claimed all at once, so that links never wait for each
+ * other in a cycle.
+ */
+void
+_mesa_lock_program_shaders(struct gl_shader_program *prog)
+{
+#ifdef HAVE_PTHREAD
+   GLuint i;
+
+   pthread_mutex_lock(&queue_mutex);
+   for (;;) {
+      for (i = 0; i < prog->NumShaders; i++) {
+         if (prog->Shaders[i]->Job.Linking)
+            break;
+      }
+      if (i == prog->NumShaders)
+         break;
+      pthread_cond_wait(&queue_done, &queue_mutex);
+   }
+   for (i = 0; i < prog->NumShaders; i++)
+      prog->Shaders[i]->Job.Linking = GL_TRUE;
+   pthread_mutex_unlock(&queue_mutex);
+#else
+   (void) prog;
+#endif
+}
+
+
+void
+_mesa_unlock_program_shaders(struct gl_shader_program *prog)
+{
+#ifdef HAVE_PTHREAD
+   GLuint i;
+
+   pthread_mutex_lock(&queue_mutex);
+   for (i = 0; i < prog->NumShaders; i++)
+      prog->Shaders[i]->Job.Linking = GL_FALSE;
+   pthread_cond_broadcast(&queue_done);
+   pthread_mutex_unlock(&queue_mutex);
+#else
+   (void) prog;
+#endif
+}
+
+
+/**
+ * Called by each context when it is created.
+ */
+void
+_mesa_init_shader_queue(void)
+{
+#ifdef HAVE_PTHREAD
+   pthread_mutex_lock(&queue_mutex);
+   queue_num_contexts++;
+   pthread_mutex_unlock(&queue_mutex);
+#endif
+}
+
+
+/**
+ * Called by each context when it is destroyed.
+ *
+ * Jobs point at the context they were queued from, so they are all run to
+ * completion.  The threads exit along with the last context.
+ */
+void
+_mesa_free_shader_queue(void)
+{
+#ifdef HAVE_PTHREAD
+   GLboolean last;
+
+   _mesa_drain_shader_queue();
+
+   pthread_mutex_lock(&queue_mutex);
+   assert(queue_num_contexts > 0);
+   last = --queue_num_contexts == 0;
+   pthread_mutex_unlock(&queue_mutex);
+
+   if (last)
+      stop_threads();
+#endif
+}
+
+
+/**
+ * Wait for all the queued jobs to complete.
+ *
+ * Their results are still picked up when the objects are looked up.
+ */
+void
+_mesa_drain_shader_queue(void)
+{
+#ifdef HAVE_PTHREAD
+   pthread_mutex_lock(&queue_mutex);
+   while (queue_head != NULL || queue_num_running > 0)
+      pthread_cond_wait(&queue_done, &queue_mutex);
+   pthread_mutex_unlock(&queue_mutex);
+#endif
+}
+
+
+static void
+finish_compile(struct gl_context *ctx, struct gl_shader *sh)
+{
+   if (sh->CompileStatus == GL_FALSE &&
+       (ctx->Shader.Flags & GLSL_REPORT_ERRORS)) {
+      _mesa_debug(ctx, "Error compiling shader %u:\n%s\n",
+                  sh->Name, sh->InfoLog);
+   }
+}
+
+
+static void
+finish_link(struct gl_context *ctx, struct gl_shader_program *prog)
+{
+   if (prog->LinkStatus == GL_FALSE &&
+       (ctx->Shader.Flags & GLSL_REPORT_ERRORS)) {
+      _mesa_debug(ctx, "Error linking program %u:\n%s\n",
+                  prog->Name, prog->InfoLog);
+   }
+}
+
+
+static void
+compile_job(struct gl_shader_job *job)
+{
+   _mesa_glsl_compile_shader_ir(job->Context, (struct gl_shader *) job->Object);
+}
+
+
+static void
+link_job(struct gl_shader_job *job)
+{
+   struct gl_shader_program *prog = (struct gl_shader_program *) job->Object;
+   GLuint i;
+
+   for (i = 0; i < prog->NumShaders; i++)
+      wait_for_job(&prog->Shaders[i]->Job, GL_FALSE);
+
+   _mesa_glsl_link_shader_ir(job->Context, prog);
+
+   use_shaders(prog, GL_FALSE);
+}
+
+
+/**
+ * Compile a shader, in the background if possible.
+ */
+void
+_mesa_queue_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
+{
+   if (!_mesa_glsl_compile_shader_from_cache(ctx, sh)) {
+      if (use_threads(ctx)) {
+         submit_job(ctx, &sh->Job, compile_job, sh);
+         return;
+      }
+
+      _mesa_glsl_compile_shader_ir(ctx, sh);
+   }
+
+   finish_compile(ctx, sh);
+}
+
+
+/**
+ * Link a program, in the background if possible.
+ *
+ * Programs that are current in any context are linked synchronously, since
+ * they are about to be used for drawing, and contexts other than \c ctx
+ * don't look them up before drawing.
+ */
+void
+_mesa_queue_link_program(struct gl_context *ctx,
+                         struct gl_shader_program *prog)
+{
+   if (!_mesa_glsl_link_shader_from_cache(ctx, prog)) {
+      GLboolean in_use;
+      GLuint i;
+
+      _glthread_LOCK_MUTEX(ctx->Shared->Mutex);
+      in_use = prog->CurrentCount > 0;
+      _glthread_UNLOCK_MUTEX(ctx->Shared->Mutex);
+
+      if (!in_use && use_threads(ctx)) {
+         /* Shaders whose compilation was deferred by the shader cache may
+          * be shared with other programs, so they are compiled by jobs of
+          * their own rather than by the link job.
+          */
+         for (i = 0; i < prog->NumShaders; i++) {
+            struct gl_shader *sh = prog->Shaders[i];
+
+            if (sh->CompileDeferred) {
+               wait_for_job(&sh->Job, GL_TRUE);
+               sh->CompileDeferred = GL_FALSE;
+               submit_job(ctx, &sh->Job, compile_job, sh);
+            }
+         }
+
+         use_shaders(prog, GL_TRUE);
+         submit_job(ctx, &prog->Job, link_job, prog);
+         return;
+      }
+
+      for (i = 0; i < prog->NumShaders; i++)
+         _mesa_wait_shader(ctx, prog->Shaders[i]);
+
+      _mesa_glsl_link_shader_ir(ctx, prog);
+      _mesa_glsl_link_shader_finish(ctx, prog);
+   }
+
+   finish_link(ctx, prog);
+}
+
+
+/**
+ * Wait until a shader is compiled, and pick up the results.
+ *
+ * The shader may still be read by link jobs.  Use \c _mesa_wait_shader_job
+ * before changing it.
+ */
+void
+_mesa_wait_shader(struct gl_context *ctx, struct gl_shader *sh)
+{
+   wait_for_job(&sh->Job, GL_FALSE);
+
+   if (sh->Job.Unfinished) {
+      sh->Job.Unfinished = GL_FALSE;
+      finish_compile(ctx, sh);
+   }
+}
+
+
+/**
+ * Wait until a program can be used, and hand it to the driver if it was
+ * linked in the background.
+ */
+void
+_mesa_wait_shader_program(struct gl_context *ctx,
+                          struct gl_shader_program *prog)
+{
+   if (prog->Job.Unfinished) {
+      wait_for_job(&prog->Job, GL_FALSE);
+      prog->Job.Unfinished = GL_FALSE;
+
+      _mesa_glsl_link_shader_finish(ctx, prog);
+      finish_link(ctx, prog);
+   }
+}
+
+
+/**
+ * Wait until no job uses the object of \c job, before changing or deleting
+ * it.
+ */
+void
+_mesa_wait_shader_job(struct gl_shader_job *job)
+{
+   wait_for_job(job, GL_TRUE);
+}
@@ -0,0 +1,83 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2013  VMware, Inc.   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * \file shaderqueue.h
+ * Compiling and linking GLSL shaders on background threads.
+ */
+
+
+#ifndef SHADERQUEUE_H
+#define SHADERQUEUE_H
+
+
+#include "main/mtypes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+extern void
+_mesa_init_shader_queue(void);
+
+extern void
+_mesa_free_shader_queue(void);
+
+extern void
+_mesa_drain_shader_queue(void);
+
+
+extern void
+_mesa_queue_compile_shader(struct gl_context *ctx, struct gl_shader *sh);
+
+extern void
+_mesa_queue_link_program(struct gl_context *ctx,
+                         struct gl_shader_program *prog);
+
+
+extern void
+_mesa_wait_shader(struct gl_context *ctx, struct gl_shader *sh);
+
+extern void
+_mesa_wait_shader_program(struct gl_context *ctx,
+                          struct gl_shader_program *prog);
+
+extern void
+_mesa_wait_shader_job(struct gl_shader_job *job);
+
+
+extern void
+_mesa_lock_program_shaders(struct gl_shader_program *prog);
+
+extern void
+_mesa_unlock_program_shaders(struct gl_shader_program *prog);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SHADERQUEUE_H */
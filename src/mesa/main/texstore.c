@@ -55,6 +55,7 @@
 #include "bufferobj.h"
 #include "colormac.h"
 #include "format_pack.h"
+#include "format_simd.h"
 #include "image.h"
 #include "macros.h"
 #include "mipmap.h"
@@ -77,8 +78,8 @@
 
 
 enum {
-   ZERO = 4, 
-   ONE = 5
+   ZERO = SIMD_SWIZZLE_ZERO,
+   ONE = SIMD_SWIZZLE_ONE
 };
 
 
@@ -711,7 +712,7 @@ swizzle_copy(GLubyte *dst, GLuint dstComponents, const GLubyte *src,
    case 4:
       switch (srcComponents) {
       case 4:
-         SWZ_CPY(dst, src, count, 4, 4);
+         _mesa_simd_swizzle_ubyte4(map, src, dst, count);
          break;
       case 3:
          SWZ_CPY(dst, src, count, 4, 3);
@@ -2880,6 +2881,30 @@ _mesa_texstore_s8_z24(TEXSTORE_PARAMS)
    ASSERT(srcFormat != GL_DEPTH_STENCIL_EXT ||
           srcType == GL_UNSIGNED_INT_24_8_EXT);
 
+   if (srcFormat == GL_DEPTH_STENCIL && ctx->Pixel.DepthScale == 1.0f &&
+       ctx->Pixel.DepthBias == 0.0f &&
+       !ctx->_ImageTransferState &&
+       !ctx->Pixel.MapStencilFlag &&
+       !srcPacking->SwapBytes) {
+      /* simple path: swap the depth and stencil bits */
+      for (img = 0; img < srcDepth; img++) {
+         GLubyte *dstRow = dstSlices[img];
+         const GLubyte *src
+            = (const GLubyte *) _mesa_image_address(dims, srcPacking, srcAddr,
+                                                    srcWidth, srcHeight,
+                                                    srcFormat, srcType,
+                                                    img, 0, 0);
+         for (row = 0; row < srcHeight; row++) {
+            _mesa_pack_uint_24_8_depth_stencil_row(dstFormat, srcWidth,
+                                                   (const GLuint *) src,
+                                                   dstRow);
+            src += srcRowStride;
+            dstRow += dstRowStride;
+         }
+      }
+      return GL_TRUE;
+   }
+
    depth = malloc(srcWidth * sizeof(GLuint));
    stencil = malloc(srcWidth * sizeof(GLubyte));
 
@@ -3136,10 +3161,7 @@ _mesa_texstore_rgba_float16(TEXSTORE_PARAMS)
          GLubyte *dstRow = dstSlices[img];
          for (row = 0; row < srcHeight; row++) {
             GLhalfARB *dstTexel = (GLhalfARB *) dstRow;
-            GLint i;
-            for (i = 0; i < srcWidth * components; i++) {
-               dstTexel[i] = _mesa_float_to_half(src[i]);
-            }
+            _mesa_simd_float_to_half(src, dstTexel, srcWidth * components);
             dstRow += dstRowStride;
             src += srcWidth * components;
          }
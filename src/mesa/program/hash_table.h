@@ -228,6 +228,19 @@ public:
       hash_table_clear(this->ht);
    }
 
+   /**
+    * Call \c func for each key / value pair in the map
+    *
+    * The pairs are visited in no particular order.
+    */
+   void iterate(void (*func)(const char *key, unsigned value, void *closure),
+                void *closure)
+   {
+      struct iterate_closure c = { func, closure };
+
+      hash_table_call_foreach(this->ht, iterate_callback, &c);
+   }
+
    /**
     * Get the value associated with a particular key
     *
@@ -273,6 +286,19 @@ public:
    }
 
 private:
+   struct iterate_closure {
+      void (*func)(const char *key, unsigned value, void *closure);
+      void *closure;
+   };
+
+   static void iterate_callback(const void *key, void *data, void *closure)
+   {
+      struct iterate_closure *c = (struct iterate_closure *) closure;
+
+      c->func((const char *) key, (unsigned) ((intptr_t) data - 1),
+              c->closure);
+   }
+
    static void delete_key(const void *key, void *data, void *closure)
    {
       (void) data;
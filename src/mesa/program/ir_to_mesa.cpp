@@ -40,15 +40,19 @@
 #include "glsl_parser_extras.h"
 #include "../glsl/program.h"
 #include "ir_optimization.h"
+#include "ir_serialize.h"
 #include "ast.h"
 #include "linker.h"
 
 #include "main/mtypes.h"
+#include "main/disk_cache.h"
 #include "main/shaderobj.h"
+#include "main/version.h"
 #include "program/hash_table.h"
 
 extern "C" {
 #include "main/shaderapi.h"
+#include "main/shaderqueue.h"
 #include "main/uniforms.h"
 #include "program/prog_instruction.h"
 #include "program/prog_optimize.h"
@@ -3043,10 +3047,258 @@ _mesa_ir_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
 
 
 /**
- * Compile a GLSL shader.  Called via glCompileShader().
+ * \name Shader cache
+ *
+ * Programs linked from shaders with source are saved in the on-disk cache,
+ * as program binaries.  The key of a program is built from the keys of its
+ * shaders, which hash their source along with all the context state that
+ * can affect compilation, and from the state that affects linking.
+ *
+ * Each shader of a cached program also gets a small entry of its own,
+ * which records that the shader compiles.  When glCompileShader finds that
+ * entry, it skips compilation: if the shader is then linked into a program
+ * that is in the cache, it never needs to be compiled at all.  Otherwise it
+ * gets compiled when the program is linked.
+ */
+/*@{*/
+
+/** Contents of the cache entry of a shader */
+struct shader_cache_entry {
+   uint32_t version;            /**< gl_shader::Version */
+};
+
+static struct disk_cache *
+get_shader_cache(struct gl_context *ctx)
+{
+   /* Shaders must go through the compiler to be dumped or logged. */
+   if (ctx->Shader.Flags & (GLSL_DUMP | GLSL_LOG))
+      return NULL;
+
+   if (!ctx->Shader.CacheInitialized) {
+      ctx->Shader.Cache = _mesa_disk_cache_create();
+      ctx->Shader.CacheInitialized = GL_TRUE;
+   }
+
+   return ctx->Shader.Cache;
+}
+
+/**
+ * Hash everything about the context that affects the compiler and linker.
+ */
+static void
+hash_context_state(struct mesa_sha1 *sha1, struct gl_context *ctx,
+                   char tag)
+{
+   static const char version[] = MESA_VERSION_STRING;
+   const unsigned encoding_version = IR_SERIALIZE_VERSION;
+   const GLubyte *renderer = ctx->Driver.GetString ?
+      ctx->Driver.GetString(ctx, GL_RENDERER) : NULL;
+
+   _mesa_sha1_update(sha1, &tag, 1);
+   _mesa_sha1_update(sha1, version, sizeof(version));
+   _mesa_sha1_update(sha1, &encoding_version, sizeof(encoding_version));
+   if (renderer)
+      _mesa_sha1_update(sha1, renderer, strlen((const char *) renderer) + 1);
+   _mesa_sha1_update(sha1, &ctx->API, sizeof(ctx->API));
+   /* Stop short of the extension string, which is a pointer. */
+   _mesa_sha1_update(sha1, &ctx->Extensions,
+                     offsetof(struct gl_extensions, String));
+   _mesa_sha1_update(sha1, &ctx->Const, sizeof(ctx->Const));
+   _mesa_sha1_update(sha1, ctx->ShaderCompilerOptions,
+                     sizeof(ctx->ShaderCompilerOptions));
+   _mesa_sha1_update(sha1, &ctx->Shader.Flags, sizeof(ctx->Shader.Flags));
+}
+
+static bool
+shader_has_hash(const struct gl_shader *shader)
+{
+   for (unsigned i = 0; i < sizeof(shader->SourceHash); i++) {
+      if (shader->SourceHash[i] != 0)
+         return true;
+   }
+
+   return false;
+}
+
+static void
+hash_string(struct mesa_sha1 *sha1, const char *str)
+{
+   _mesa_sha1_update(sha1, str, strlen(str) + 1);
+}
+
+struct binding {
+   const char *name;
+   unsigned value;
+};
+
+struct binding_list {
+   struct binding *bindings;
+   unsigned count;
+};
+
+static void
+add_binding(const char *key, unsigned value, void *closure)
+{
+   struct binding_list *list = (struct binding_list *) closure;
+
+   list->bindings = reralloc(NULL, list->bindings, struct binding,
+                             list->count + 1);
+   list->bindings[list->count].name = key;
+   list->bindings[list->count].value = value;
+   list->count++;
+}
+
+static int
+compare_bindings(const void *a, const void *b)
+{
+   return strcmp(((const struct binding *) a)->name,
+                 ((const struct binding *) b)->name);
+}
+
+/**
+ * Hash the contents of a map, which are iterated over in no particular
+ * order.
+ */
+static void
+hash_bindings(struct mesa_sha1 *sha1, struct string_to_uint_map *map)
+{
+   struct binding_list list = { NULL, 0 };
+
+   if (map)
+      map->iterate(add_binding, &list);
+
+   qsort(list.bindings, list.count, sizeof(struct binding), compare_bindings);
+
+   _mesa_sha1_update(sha1, &list.count, sizeof(list.count));
+   for (unsigned i = 0; i < list.count; i++) {
+      hash_string(sha1, list.bindings[i].name);
+      _mesa_sha1_update(sha1, &list.bindings[i].value,
+                        sizeof(list.bindings[i].value));
+   }
+
+   ralloc_free(list.bindings);
+}
+
+/**
+ * Compute the cache key of a program.
+ *
+ * \return \c false if the program cannot be cached.
+ */
+static bool
+compute_program_key(struct gl_context *ctx, struct gl_shader_program *prog,
+                    uint8_t key[SHA1_DIGEST_LENGTH])
+{
+   struct mesa_sha1 sha1;
+
+   if (prog->NumShaders == 0)
+      return false;
+
+   _mesa_sha1_init(&sha1);
+   hash_context_state(&sha1, ctx, 'p');
+
+   _mesa_sha1_update(&sha1, &prog->NumShaders, sizeof(prog->NumShaders));
+   for (unsigned i = 0; i < prog->NumShaders; i++) {
+      const struct gl_shader *const sh = prog->Shaders[i];
+
+      if (!shader_has_hash(sh))
+         return false;
+
+      _mesa_sha1_update(&sha1, &sh->Type, sizeof(sh->Type));
+      _mesa_sha1_update(&sha1, sh->SourceHash, sizeof(sh->SourceHash));
+   }
+
+   _mesa_sha1_update(&sha1, &prog->InternalSeparateShader,
+                     sizeof(prog->InternalSeparateShader));
+
+   hash_bindings(&sha1, prog->AttributeBindings);
+   hash_bindings(&sha1, prog->FragDataBindings);
+   hash_bindings(&sha1, prog->FragDataIndexBindings);
+
+   _mesa_sha1_update(&sha1, &prog->TransformFeedback.BufferMode,
+                     sizeof(prog->TransformFeedback.BufferMode));
+   _mesa_sha1_update(&sha1, &prog->TransformFeedback.NumVarying,
+                     sizeof(prog->TransformFeedback.NumVarying));
+   for (unsigned i = 0; i < prog->TransformFeedback.NumVarying; i++)
+      hash_string(&sha1, prog->TransformFeedback.VaryingNames[i]);
+
+   _mesa_sha1_update(&sha1, &prog->Geom, sizeof(prog->Geom));
+
+   _mesa_sha1_final(&sha1, key);
+   return true;
+}
+
+/**
+ * Link \c prog from its cache entry.
+ *
+ * \return \c false if there is no usable entry, in which case the program
+ * has to be linked from its shaders.
+ */
+static bool
+link_program_from_cache(struct gl_context *ctx, struct disk_cache *cache,
+                        struct gl_shader_program *prog,
+                        const uint8_t key[SHA1_DIGEST_LENGTH])
+{
+   size_t size;
+   void *binary = _mesa_disk_cache_get(cache, key, &size);
+
+   if (binary == NULL)
+      return false;
+
+   load_program_binary(ctx, prog, binary, size);
+   _mesa_disk_cache_release(binary, size);
+
+   if (prog->LinkStatus && !ctx->Driver.LinkShader(ctx, prog))
+      prog->LinkStatus = GL_FALSE;
+
+   if (!prog->LinkStatus) {
+      /* The entry was saved by a different build of Mesa, or the driver
+       * doesn't like it for some reason.  Start over.
+       */
+      _mesa_clear_shader_program_data(ctx, prog);
+      prog->LinkStatus = GL_TRUE;
+      return false;
+   }
+
+   return true;
+}
+
+/**
+ * Save a freshly linked program, and record that its shaders compile.
+ */
+static void
+save_program_to_cache(struct gl_context *ctx, struct disk_cache *cache,
+                      struct gl_shader_program *prog,
+                      const uint8_t key[SHA1_DIGEST_LENGTH])
+{
+   size_t size;
+   void *binary = serialize_program(ctx, prog, NULL, &size);
+
+   if (binary == NULL)
+      return;
+
+   _mesa_disk_cache_put(cache, key, binary, size);
+   ralloc_free(binary);
+
+   for (unsigned i = 0; i < prog->NumShaders; i++) {
+      const struct gl_shader *const sh = prog->Shaders[i];
+      struct shader_cache_entry entry;
+
+      memset(&entry, 0, sizeof(entry));
+      entry.version = sh->Version;
+      _mesa_disk_cache_put(cache, sh->SourceHash, &entry, sizeof(entry));
+   }
+}
+
+/*@}*/
+
+
+/**
+ * Run the compiler on a shader.
+ *
+ * Only reads the context, so this may be called from any thread.
  */
 void
-_mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader)
+_mesa_glsl_compile_shader_ir(struct gl_context *ctx, struct gl_shader *shader)
 {
    struct _mesa_glsl_parse_state *state =
       new(shader) _mesa_glsl_parse_state(ctx, shader->Type, shader);
@@ -3086,8 +3338,8 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader)
       /* Do some optimization at compile time to reduce shader IR size
        * and reduce later work if the same shader is linked multiple times
        */
-      while (do_common_optimization(shader->ir, false, false, 32))
-	 ;
+      do_common_optimization_loop(shader->ir, false, false, 32,
+                                  ctx->Shader.Flags & GLSL_OPT_STATS);
 
       validate_ir_tree(shader->ir);
    }
@@ -3133,17 +3385,116 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader)
 
 
 /**
- * Link a GLSL shader program.  Called via glLinkProgram().
+ * Compile a GLSL shader from the shader cache.
+ *
+ * If the shader cache knows that the source compiles, compilation is
+ * deferred until the shader is linked, where it may not be needed at all.
+ *
+ * \return \c GL_TRUE if there is nothing left to do, otherwise the shader
+ * must be compiled by \c _mesa_glsl_compile_shader_ir.
+ */
+GLboolean
+_mesa_glsl_compile_shader_from_cache(struct gl_context *ctx,
+                                     struct gl_shader *shader)
+{
+   struct disk_cache *cache = get_shader_cache(ctx);
+
+   memset(shader->SourceHash, 0, sizeof(shader->SourceHash));
+   shader->CompileDeferred = GL_FALSE;
+
+   if (cache != NULL && shader->Source != NULL) {
+      struct mesa_sha1 sha1;
+      size_t size;
+
+      _mesa_sha1_init(&sha1);
+      hash_context_state(&sha1, ctx, 's');
+      _mesa_sha1_update(&sha1, &shader->Type, sizeof(shader->Type));
+      _mesa_sha1_update(&sha1, &shader->Pragmas, sizeof(shader->Pragmas));
+      hash_string(&sha1, shader->Source);
+      _mesa_sha1_final(&sha1, shader->SourceHash);
+
+      const struct shader_cache_entry *entry = (const struct shader_cache_entry *)
+         _mesa_disk_cache_get(cache, shader->SourceHash, &size);
+      if (entry != NULL) {
+         const bool valid = size == sizeof(*entry);
+
+         if (valid) {
+            ralloc_free(shader->ir);
+            shader->ir = NULL;
+            shader->symbols = NULL;
+            shader->num_builtins_to_link = 0;
+            ralloc_free(shader->UniformBlocks);
+            shader->UniformBlocks = NULL;
+            shader->NumUniformBlocks = 0;
+
+            shader->Version = entry->version;
+            shader->InfoLog = ralloc_strdup(shader, "");
+            shader->CompileStatus = GL_TRUE;
+            shader->CompileDeferred = GL_TRUE;
+         }
+
+         _mesa_disk_cache_release((void *) entry, size);
+         if (valid)
+            return GL_TRUE;
+      }
+   }
+
+   return GL_FALSE;
+}
+
+
+/**
+ * Compile a GLSL shader.  Called via glCompileShader().
  */
 void
-_mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
+_mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader)
 {
-   unsigned int i;
+   if (!_mesa_glsl_compile_shader_from_cache(ctx, shader))
+      _mesa_glsl_compile_shader_ir(ctx, shader);
+}
+
 
+/**
+ * Start linking a GLSL shader program, and link it from the shader cache
+ * if possible.
+ *
+ * The shaders of the program don't need to be compiled yet.  A cache hit
+ * means that the same sources compiled and linked before.
+ *
+ * \return \c GL_TRUE if the program is linked, otherwise it must be linked
+ * by \c _mesa_glsl_link_shader_ir and \c _mesa_glsl_link_shader_finish.
+ */
+GLboolean
+_mesa_glsl_link_shader_from_cache(struct gl_context *ctx,
+                                  struct gl_shader_program *prog)
+{
    _mesa_clear_shader_program_data(ctx, prog);
 
    prog->LinkStatus = GL_TRUE;
 
+   struct disk_cache *cache = get_shader_cache(ctx);
+   prog->Cacheable = cache != NULL &&
+      compute_program_key(ctx, prog, prog->CacheKey);
+
+   return prog->Cacheable &&
+      link_program_from_cache(ctx, cache, prog, prog->CacheKey);
+}
+
+
+/**
+ * Link the IR of a GLSL shader program.
+ *
+ * The driver is not involved, so this may be called from any thread once
+ * the shaders are compiled.
+ */
+void
+_mesa_glsl_link_shader_ir(struct gl_context *ctx,
+                          struct gl_shader_program *prog)
+{
+   unsigned int i;
+
+   _mesa_lock_program_shaders(prog);
+
    for (i = 0; i < prog->NumShaders; i++) {
       if (!prog->Shaders[i]->CompileStatus) {
 	 linker_error(prog, "linking with uncompiled shader");
@@ -3151,16 +3502,50 @@ _mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
       }
    }
 
+   if (prog->LinkStatus) {
+      for (i = 0; i < prog->NumShaders; i++) {
+         struct gl_shader *const sh = prog->Shaders[i];
+
+         if (sh->CompileDeferred) {
+            sh->CompileDeferred = GL_FALSE;
+            _mesa_glsl_compile_shader_ir(ctx, sh);
+
+            if (!sh->CompileStatus) {
+               linker_error(prog, "linking with uncompiled shader");
+               prog->LinkStatus = GL_FALSE;
+            }
+         }
+      }
+   }
+
    if (prog->LinkStatus) {
       link_shaders(ctx, prog);
    }
 
+   _mesa_unlock_program_shaders(prog);
+}
+
+
+/**
+ * Hand a program linked by \c _mesa_glsl_link_shader_ir to the driver.
+ */
+void
+_mesa_glsl_link_shader_finish(struct gl_context *ctx,
+                              struct gl_shader_program *prog)
+{
    if (prog->LinkStatus) {
       if (!ctx->Driver.LinkShader(ctx, prog)) {
 	 prog->LinkStatus = GL_FALSE;
       }
    }
 
+   if (prog->Cacheable && prog->LinkStatus) {
+      struct disk_cache *cache = get_shader_cache(ctx);
+
+      if (cache != NULL)
+         save_program_to_cache(ctx, cache, prog, prog->CacheKey);
+   }
+
    if (ctx->Shader.Flags & GLSL_DUMP) {
       if (!prog->LinkStatus) {
 	 printf("GLSL shader program %d failed to link\n", prog->Name);
@@ -3173,4 +3558,79 @@ _mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
    }
 }
 
+
+/**
+ * Link a GLSL shader program.  Called via glLinkProgram().
+ */
+void
+_mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
+{
+   if (_mesa_glsl_link_shader_from_cache(ctx, prog))
+      return;
+
+   _mesa_glsl_link_shader_ir(ctx, prog);
+   _mesa_glsl_link_shader_finish(ctx, prog);
+}
+
+/**
+ * Link a program from a binary returned by _mesa_glsl_get_program_binary().
+ *
+ * Failing to load the binary is not an error: it only leaves the program
+ * unlinked, with an explanation in the info log.
+ */
+void
+_mesa_glsl_load_program_binary(struct gl_context *ctx,
+                               struct gl_shader_program *prog,
+                               const GLvoid *binary, GLsizei length)
+{
+   _mesa_clear_shader_program_data(ctx, prog);
+
+   load_program_binary(ctx, prog, binary, length);
+
+   if (prog->LinkStatus) {
+      if (!ctx->Driver.LinkShader(ctx, prog)) {
+	 prog->LinkStatus = GL_FALSE;
+      }
+   }
+
+   if (ctx->Shader.Flags & GLSL_DUMP) {
+      if (!prog->LinkStatus) {
+	 printf("GLSL shader program %d failed to load from binary\n",
+		prog->Name);
+      }
+
+      if (prog->InfoLog && prog->InfoLog[0] != 0) {
+	 printf("GLSL shader program %d info log:\n", prog->Name);
+	 printf("%s\n", prog->InfoLog);
+      }
+   }
+}
+
+/**
+ * Serialize a linked program into prog->Binary, unless already done.
+ *
+ * The binary is only built when the application asks for it, and stays
+ * around until the program is linked again.  prog->Binary is left NULL if
+ * the program cannot be serialized.
+ */
+void
+_mesa_glsl_get_program_binary(struct gl_context *ctx,
+                              struct gl_shader_program *prog)
+{
+   size_t size;
+
+   if (prog->Binary != NULL || !prog->LinkStatus)
+      return;
+
+   prog->Binary = serialize_program(ctx, prog, prog, &size);
+   if (prog->Binary != NULL) {
+      if (size > INT_MAX) {
+         ralloc_free(prog->Binary);
+         prog->Binary = NULL;
+      } else {
+         prog->BinaryLength = size;
+      }
+   }
+}
+
 } /* extern "C" */
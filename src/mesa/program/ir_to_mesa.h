@@ -34,7 +34,21 @@ struct gl_shader;
 struct gl_shader_program;
 
 void _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *sh);
+GLboolean _mesa_glsl_compile_shader_from_cache(struct gl_context *ctx,
+                                               struct gl_shader *sh);
+void _mesa_glsl_compile_shader_ir(struct gl_context *ctx, struct gl_shader *sh);
 void _mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog);
+GLboolean _mesa_glsl_link_shader_from_cache(struct gl_context *ctx,
+                                            struct gl_shader_program *prog);
+void _mesa_glsl_link_shader_ir(struct gl_context *ctx,
+                               struct gl_shader_program *prog);
+void _mesa_glsl_link_shader_finish(struct gl_context *ctx,
+                                   struct gl_shader_program *prog);
+void _mesa_glsl_load_program_binary(struct gl_context *ctx,
+                                    struct gl_shader_program *prog,
+                                    const GLvoid *binary, GLsizei length);
+void _mesa_glsl_get_program_binary(struct gl_context *ctx,
+                                   struct gl_shader_program *prog);
 GLboolean _mesa_ir_compile_shader(struct gl_context *ctx, struct gl_shader *shader);
 GLboolean _mesa_ir_link_shader(struct gl_context *ctx, struct gl_shader_program *prog);
 
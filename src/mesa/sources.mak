@@ -30,6 +30,7 @@ MAIN_FILES = \
 	$(SRCDIR)main/cpuinfo.c \
 	$(SRCDIR)main/debug.c \
 	$(SRCDIR)main/depth.c \
+	$(SRCDIR)main/disk_cache.c \
 	$(SRCDIR)main/dlist.c \
 	$(SRCDIR)main/drawpix.c \
 	$(SRCDIR)main/drawtex.c \
@@ -44,11 +45,13 @@ MAIN_FILES = \
 	$(SRCDIR)main/fog.c \
 	$(SRCDIR)main/formats.c \
 	$(SRCDIR)main/format_pack.c \
+	$(SRCDIR)main/format_simd.c \
 	$(SRCDIR)main/format_unpack.c \
 	$(SRCDIR)main/framebuffer.c \
 	$(SRCDIR)main/get.c \
 	$(SRCDIR)main/getstring.c \
 	$(SRCDIR)main/glformats.c \
+	$(SRCDIR)main/glthread.c \
 	$(SRCDIR)main/hash.c \
 	$(SRCDIR)main/hint.c \
 	$(SRCDIR)main/histogram.c \
@@ -78,6 +81,8 @@ MAIN_FILES = \
 	$(SRCDIR)main/scissor.c \
 	$(SRCDIR)main/shaderapi.c \
 	$(SRCDIR)main/shaderobj.c \
+	$(SRCDIR)main/shaderqueue.c \
+	$(SRCDIR)main/sha1.c \
 	$(SRCDIR)main/shared.c \
 	$(SRCDIR)main/state.c \
 	$(SRCDIR)main/stencil.c \
@@ -106,6 +111,7 @@ MAIN_FILES = \
 	$(SRCDIR)main/viewport.c \
 	$(SRCDIR)main/vtxfmt.c \
 	$(BUILDDIR)main/enums.c \
+	$(BUILDDIR)main/marshal_generated.c \
 	$(MAIN_ES_FILES)
 
 MAIN_CXX_FILES = \
@@ -38,6 +38,7 @@
 
 #include "st_context.h"
 #include "st_cb_bufferobjects.h"
+#include "st_cb_readpixels.h"
 
 #include "pipe/p_context.h"
 #include "pipe/p_defines.h"
@@ -77,6 +78,8 @@ st_bufferobj_free(struct gl_context *ctx, struct gl_buffer_object *obj)
    assert(obj->RefCount == 0);
    assert(st_obj->transfer == NULL);
 
+   st_discard_pbo_readback(st_context(ctx), st_obj);
+
    if (st_obj->buffer) 
       pipe_resource_reference(&st_obj->buffer, NULL);
 
@@ -120,6 +123,8 @@ st_bufferobj_subdata(struct gl_context *ctx,
       return;
    }
 
+   st_finish_pbo_readback(st_context(ctx), st_obj);
+
    /* Now that transfers are per-context, we don't have to figure out
     * flushing here.  Usually drivers won't need to flush in this case
     * even if the buffer is currently referenced by hardware - they
@@ -156,6 +161,8 @@ st_bufferobj_get_subdata(struct gl_context *ctx,
       return;
    }
 
+   st_finish_pbo_readback(st_context(ctx), st_obj);
+
    pipe_buffer_read(st_context(ctx)->pipe, st_obj->buffer,
                     offset, size, data);
 }
@@ -222,6 +229,8 @@ st_bufferobj_data(struct gl_context *ctx,
       pipe_usage = PIPE_USAGE_DEFAULT;
    }
 
+   st_discard_pbo_readback(st, st_obj);
+
    pipe_resource_reference( &st_obj->buffer, NULL );
 
    if (size != 0) {
@@ -251,7 +260,8 @@ st_bufferobj_map_range(struct gl_context *ctx,
                        GLintptr offset, GLsizeiptr length, GLbitfield access,
                        struct gl_buffer_object *obj)
 {
-   struct pipe_context *pipe = st_context(ctx)->pipe;
+   struct st_context *st = st_context(ctx);
+   struct pipe_context *pipe = st->pipe;
    struct st_buffer_object *st_obj = st_buffer_object(obj);
    enum pipe_transfer_usage flags = 0x0;
 
@@ -288,6 +298,20 @@ st_bufferobj_map_range(struct gl_context *ctx,
    assert(offset < obj->Size);
    assert(offset + length <= obj->Size);
 
+   /* store the pixels of a glReadPixels into the buffer first */
+   if (st_obj->readback) {
+      if (access & GL_MAP_INVALIDATE_BUFFER_BIT) {
+         st_discard_pbo_readback(st, st_obj);
+      }
+      else {
+         if ((access & MESA_MAP_NOWAIT_BIT) &&
+             !st_pbo_readback_done(st, st_obj))
+            return NULL;
+
+         st_finish_pbo_readback(st, st_obj);
+      }
+   }
+
    obj->Pointer = pipe_buffer_map_range(pipe,
                                         st_obj->buffer,
                                         offset, length,
@@ -355,7 +379,8 @@ st_copy_buffer_subdata(struct gl_context *ctx,
                        GLintptr readOffset, GLintptr writeOffset,
                        GLsizeiptr size)
 {
-   struct pipe_context *pipe = st_context(ctx)->pipe;
+   struct st_context *st = st_context(ctx);
+   struct pipe_context *pipe = st->pipe;
    struct st_buffer_object *srcObj = st_buffer_object(src);
    struct st_buffer_object *dstObj = st_buffer_object(dst);
    struct pipe_box box;
@@ -367,6 +392,9 @@ st_copy_buffer_subdata(struct gl_context *ctx,
    assert(!src->Pointer);
    assert(!dst->Pointer);
 
+   st_finish_pbo_readback(st, srcObj);
+   st_finish_pbo_readback(st, dstObj);
+
    u_box_1d(readOffset, size, &box);
 
    pipe->resource_copy_region(pipe, dstObj->buffer, 0, writeOffset, 0, 0,
@@ -34,6 +34,7 @@
 struct dd_function_table;
 struct pipe_resource;
 struct st_context;
+struct st_pbo_readback;
 
 /**
  * State_tracker vertex/pixel buffer object, derived from Mesa's
@@ -44,6 +45,7 @@ struct st_buffer_object
    struct gl_buffer_object Base;
    struct pipe_resource *buffer;     /* GPU storage */
    struct pipe_transfer *transfer; /* In-progress map information */
+   struct st_pbo_readback *readback; /* glReadPixels not yet stored */
 };
 
 
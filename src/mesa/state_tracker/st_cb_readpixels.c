@@ -27,18 +27,305 @@
 
 
 #include "main/imports.h"
+#include "main/bufferobj.h"
+#include "main/formats.h"
+#include "main/glformats.h"
+#include "main/image.h"
 #include "main/readpix.h"
 
+#include "pipe/p_context.h"
+#include "pipe/p_defines.h"
+#include "pipe/p_screen.h"
+#include "util/u_atomic.h"
+#include "util/u_format.h"
+#include "util/u_inlines.h"
+
 #include "st_atom.h"
 #include "st_context.h"
 #include "st_cb_bitmap.h"
+#include "st_cb_bufferobjects.h"
+#include "st_cb_fbo.h"
 #include "st_cb_readpixels.h"
+#include "st_format.h"
+
+
+/**
+ * A glReadPixels into a pixel pack buffer which hasn't been stored in the
+ * buffer yet.  The pixels are blitted into a staging texture in the format
+ * they're packed in, and copied into the buffer when it's next used, so
+ * that glReadPixels doesn't wait for rendering to finish.
+ */
+struct st_pbo_readback
+{
+   struct pipe_resource *staging;   /**< the pixels, first row on top */
+   struct pipe_fence_handle *fence; /**< signalled once staging is written */
+   GLintptr offset;                 /**< offset of the first row in the PBO */
+   GLint stride;                    /**< PBO row stride, negative if inverted */
+};
+
+
+/** Number of buffer objects with a pending readback, in all contexts */
+int32_t st_pbo_readbacks_pending = 0;
+
+
+/**
+ * Forget about the pending readback into a buffer object, if any.
+ */
+void
+st_discard_pbo_readback(struct st_context *st, struct st_buffer_object *stobj)
+{
+   struct st_pbo_readback *readback = stobj->readback;
+
+   if (!readback)
+      return;
+
+   pipe_resource_reference(&readback->staging, NULL);
+   if (readback->fence)
+      st->pipe->screen->fence_reference(st->pipe->screen,
+                                        &readback->fence, NULL);
+   free(readback);
+
+   stobj->readback = NULL;
+   p_atomic_dec(&st_pbo_readbacks_pending);
+}
+
+
+/**
+ * Has the GPU finished writing the pixels of the pending readback into
+ * a buffer object?  Used to honor MESA_MAP_NOWAIT_BIT.
+ */
+GLboolean
+st_pbo_readback_done(struct st_context *st, struct st_buffer_object *stobj)
+{
+   struct st_pbo_readback *readback = stobj->readback;
+
+   return !readback || !readback->fence ||
+          st->pipe->screen->fence_signalled(st->pipe->screen,
+                                            readback->fence);
+}
+
+
+/**
+ * Store the pixels of the pending readback into a buffer object, if any.
+ * This must be called before the buffer is accessed by the CPU or the GPU.
+ */
+void
+st_finish_pbo_readback(struct st_context *st, struct st_buffer_object *stobj)
+{
+   struct pipe_context *pipe = st->pipe;
+   struct st_pbo_readback *readback = stobj->readback;
+   struct pipe_resource *staging;
+   struct pipe_transfer *src_trans, *dst_trans = NULL;
+   const GLubyte *src = NULL;
+   GLubyte *dst = NULL;
+   GLintptr first;
+   GLuint row_bytes, size, i;
+
+   if (!readback)
+      return;
+
+   staging = readback->staging;
+   row_bytes = util_format_get_stride(staging->format, staging->width0);
+
+   /* the range of the buffer spanned by the rows */
+   first = readback->offset;
+   if (readback->stride < 0)
+      first += readback->stride * (GLint) (staging->height0 - 1);
+   size = abs(readback->stride) * (staging->height0 - 1) + row_bytes;
+
+   if (readback->fence)
+      pipe->screen->fence_finish(pipe->screen, readback->fence,
+                                 PIPE_TIMEOUT_INFINITE);
+
+   src_trans = pipe_get_transfer(pipe, staging, 0, 0, PIPE_TRANSFER_READ,
+                                 0, 0, staging->width0, staging->height0);
+   if (src_trans)
+      src = pipe_transfer_map(pipe, src_trans);
+
+   if (src)
+      dst = pipe_buffer_map_range(pipe, stobj->buffer, first, size,
+                                  PIPE_TRANSFER_WRITE, &dst_trans);
+
+   if (dst) {
+      dst += readback->offset - first;
+      for (i = 0; i < staging->height0; i++) {
+         memcpy(dst, src, row_bytes);
+         src += src_trans->stride;
+         dst += readback->stride;
+      }
+      pipe_buffer_unmap(pipe, dst_trans);
+   }
+   else {
+      _mesa_problem(st->ctx, "failed to store glReadPixels into PBO");
+   }
+
+   if (src_trans) {
+      if (src)
+         pipe_transfer_unmap(pipe, src_trans);
+      pipe->transfer_destroy(pipe, src_trans);
+   }
+
+   st_discard_pbo_readback(st, stobj);
+}
+
+
+/**
+ * Try to read pixels into the bound pixel pack buffer without waiting
+ * for rendering to finish: blit them into a staging texture of a format
+ * that matches format/type and defer the copy into the buffer.
+ *
+ * The blit must produce the same values as _mesa_readpixels(), so this
+ * is only done for normalized color buffers, and without pixel transfer
+ * operations.
+ *
+ * \return GL_TRUE if done, GL_FALSE if _mesa_readpixels() must be used.
+ */
+static GLboolean
+try_pbo_readpixels(struct st_context *st, GLint x, GLint y,
+                   GLsizei width, GLsizei height,
+                   GLenum format, GLenum type,
+                   const struct gl_pixelstore_attrib *pack,
+                   GLvoid *dest)
+{
+   struct gl_context *ctx = st->ctx;
+   struct pipe_context *pipe = st->pipe;
+   struct pipe_screen *screen = pipe->screen;
+   struct gl_framebuffer *fb = ctx->ReadBuffer;
+   struct gl_renderbuffer *rb = fb->_ColorReadBuffer;
+   struct st_renderbuffer *strb = st_renderbuffer(rb);
+   struct st_buffer_object *stobj = st_buffer_object(pack->BufferObj);
+   struct gl_pixelstore_attrib clippedPacking = *pack;
+   struct st_pbo_readback *readback;
+   struct pipe_resource templ;
+   struct pipe_blit_info blit;
+   enum pipe_format src_format, dst_format;
+   gl_format dst_mesa_format;
+
+   if (ctx->_ImageTransferState ||
+       !rb || !strb->texture || !stobj->buffer)
+      return GL_FALSE;
+
+   /* Luminance/intensity buffers are returned as red by glReadPixels but
+    * would be sampled as gray, and non-normalized values would be clamped
+    * by _mesa_readpixels() but not by the blit.
+    */
+   switch (rb->_BaseFormat) {
+   case GL_RGBA:
+   case GL_RGB:
+   case GL_RG:
+   case GL_RED:
+      break;
+   default:
+      return GL_FALSE;
+   }
+   /* _mesa_readpixels() rebases the channels the storage has beyond the
+    * base format (alpha to one, green and blue to zero), the blit doesn't.
+    */
+   if (_mesa_get_format_base_format(rb->Format) != rb->_BaseFormat)
+      return GL_FALSE;
+   if (_mesa_get_format_datatype(rb->Format) != GL_UNSIGNED_NORMALIZED)
+      return GL_FALSE;
+
+   src_format = util_format_linear(strb->texture->format);
+   if (!screen->is_format_supported(screen, src_format,
+                                    strb->texture->target,
+                                    strb->texture->nr_samples,
+                                    PIPE_BIND_SAMPLER_VIEW))
+      return GL_FALSE;
+
+   dst_format = st_choose_matching_format(screen, PIPE_BIND_RENDER_TARGET,
+                                          format, type, pack->SwapBytes);
+   if (dst_format == PIPE_FORMAT_NONE)
+      return GL_FALSE;
+
+   dst_mesa_format = st_pipe_format_to_mesa_format(dst_format);
+   if (_mesa_get_format_datatype(dst_mesa_format) != GL_UNSIGNED_NORMALIZED)
+      return GL_FALSE;
+
+   switch (_mesa_get_format_base_format(dst_mesa_format)) {
+   case GL_RGBA:
+   case GL_RGB:
+   case GL_RG:
+   case GL_RED:
+   case GL_ALPHA:
+      break;
+   default:
+      return GL_FALSE;
+   }
+
+   if (!_mesa_clip_readpixels(ctx, &x, &y, &width, &height, &clippedPacking))
+      return GL_TRUE; /* nothing to read */
+
+   /* the new pixels may overwrite those of an earlier readback */
+   st_finish_pbo_readback(st, stobj);
+
+   readback = CALLOC_STRUCT(st_pbo_readback);
+   if (!readback)
+      return GL_FALSE;
+
+   memset(&templ, 0, sizeof(templ));
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = dst_format;
+   templ.width0 = width;
+   templ.height0 = height;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.usage = PIPE_USAGE_STAGING;
+   templ.bind = PIPE_BIND_RENDER_TARGET | PIPE_BIND_TRANSFER_READ;
+
+   readback->staging = screen->resource_create(screen, &templ);
+   if (!readback->staging) {
+      free(readback);
+      return GL_FALSE;
+   }
+
+   memset(&blit, 0, sizeof(blit));
+   blit.src.resource = strb->texture;
+   blit.src.level = strb->rtt_level;
+   blit.src.format = src_format;
+   blit.src.box.x = x;
+   blit.src.box.z = strb->rtt_face + strb->rtt_slice;
+   blit.src.box.width = width;
+   blit.src.box.depth = 1;
+   if (st_fb_orientation(fb) == Y_0_TOP) {
+      /* flip, so that the bottom row ends up on top of the staging texture */
+      blit.src.box.y = rb->Height - y;
+      blit.src.box.height = -height;
+   }
+   else {
+      blit.src.box.y = y;
+      blit.src.box.height = height;
+   }
+   blit.dst.resource = readback->staging;
+   blit.dst.level = 0;
+   blit.dst.format = dst_format;
+   blit.dst.box.width = width;
+   blit.dst.box.height = height;
+   blit.dst.box.depth = 1;
+   blit.mask = PIPE_MASK_RGBA;
+   blit.filter = PIPE_TEX_FILTER_NEAREST;
+   blit.scissor_enable = FALSE;
+
+   pipe->blit(pipe, &blit);
+   pipe->flush(pipe, &readback->fence);
+
+   readback->offset = (GLintptr)
+      _mesa_image_address2d(&clippedPacking, dest, width, height,
+                            format, type, 0, 0);
+   readback->stride = _mesa_image_row_stride(&clippedPacking, width,
+                                             format, type);
+
+   stobj->readback = readback;
+   p_atomic_inc(&st_pbo_readbacks_pending);
+   return GL_TRUE;
+}
 
 
 /**
  * The only special thing we need to do for the state tracker's
  * glReadPixels is to validate state (to be sure we have up-to-date
  * framebuffer surfaces) and flush the bitmap cache prior to reading.
+ * Color reads into a pixel pack buffer are done on the GPU when possible.
  */
 static void
 st_readpixels(struct gl_context *ctx, GLint x, GLint y,
@@ -51,6 +338,12 @@ st_readpixels(struct gl_context *ctx, GLint x, GLint y,
 
    st_validate_state(st);
    st_flush_bitmap_cache(st);
+
+   if (_mesa_is_bufferobj(pack->BufferObj) &&
+       _mesa_is_color_format(format) &&
+       try_pbo_readpixels(st, x, y, width, height, format, type, pack, dest))
+      return;
+
    _mesa_readpixels(ctx, x, y, width, height, format, type, pack, dest);
 }
 
@@ -32,6 +32,19 @@
 #include "main/glheader.h"
 
 struct dd_function_table;
+struct st_buffer_object;
+struct st_context;
+
+extern int32_t st_pbo_readbacks_pending;
+
+extern void
+st_finish_pbo_readback(struct st_context *st, struct st_buffer_object *stobj);
+
+extern void
+st_discard_pbo_readback(struct st_context *st, struct st_buffer_object *stobj);
+
+extern GLboolean
+st_pbo_readback_done(struct st_context *st, struct st_buffer_object *stobj);
 
 extern void
 st_init_readpixels_functions(struct dd_function_table *functions);
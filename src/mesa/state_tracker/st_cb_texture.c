@@ -30,6 +30,7 @@
 #include "main/enums.h"
 #include "main/fbobject.h"
 #include "main/formats.h"
+#include "main/glformats.h"
 #include "main/image.h"
 #include "main/imports.h"
 #include "main/macros.h"
@@ -540,6 +541,101 @@ prep_teximage(struct gl_context *ctx, struct gl_texture_image *texImage,
 }
 
 
+/**
+ * Upload an image whose pixels are laid out in memory exactly like the
+ * texels of the texture image with transfer_inline_write, which lets the
+ * driver write the user's memory (or the mapped unpack buffer) straight
+ * into the resource, instead of mapping it and calling texstore.
+ *
+ * \return GL_TRUE if done, GL_FALSE if texstore must be used.
+ */
+static GLboolean
+try_inline_texsubimage(struct gl_context *ctx, GLuint dims,
+                       struct gl_texture_image *texImage,
+                       GLint xoffset, GLint yoffset, GLint zoffset,
+                       GLint width, GLint height, GLint depth,
+                       GLenum format, GLenum type, const void *pixels,
+                       const struct gl_pixelstore_attrib *unpack)
+{
+   struct st_context *st = st_context(ctx);
+   struct pipe_context *pipe = st->pipe;
+   struct st_texture_image *stImage = st_texture_image(texImage);
+   struct st_texture_object *stObj = st_texture_object(texImage->TexObject);
+   const GLubyte *src;
+   GLint stride, layer_stride;
+   struct pipe_box box;
+   GLuint level;
+
+   if (!stImage->pt ||
+       ctx->_ImageTransferState ||
+       unpack->Invert ||
+       !_mesa_is_color_format(format) ||
+       texImage->_BaseFormat !=
+          _mesa_get_format_base_format(texImage->TexFormat) ||
+       !_mesa_format_matches_format_and_type(texImage->TexFormat,
+                                             format, type,
+                                             unpack->SwapBytes))
+      return GL_FALSE;
+
+   pixels = _mesa_validate_pbo_teximage(ctx, dims, width, height, depth,
+                                        format, type, pixels, unpack,
+                                        "glTexSubImage");
+   if (!pixels) {
+      /* no data, or the PBO couldn't be mapped */
+      return GL_TRUE;
+   }
+
+   src = _mesa_image_address(dims, unpack, pixels, width, height,
+                             format, type, 0, 0, 0);
+   stride = _mesa_image_row_stride(unpack, width, format, type);
+   layer_stride = _mesa_image_image_stride(unpack, width, height,
+                                           format, type);
+
+   if (stObj->pt != stImage->pt)
+      level = 0;
+   else
+      level = texImage->Level;
+
+   if (texImage->TexObject->Target == GL_TEXTURE_1D_ARRAY) {
+      /* the rows of the image are the layers of the resource */
+      u_box_3d(xoffset, 0, yoffset, width, 1, height, &box);
+      layer_stride = stride;
+   }
+   else {
+      u_box_3d(xoffset, yoffset, texImage->Face + zoffset,
+               width, height, depth, &box);
+   }
+
+   pipe->transfer_inline_write(pipe, stImage->pt, level,
+                               PIPE_TRANSFER_WRITE |
+                               PIPE_TRANSFER_DISCARD_RANGE,
+                               &box, src, stride, layer_stride);
+
+   _mesa_unmap_teximage_pbo(ctx, unpack);
+   return GL_TRUE;
+}
+
+
+static void
+st_TexSubImage(struct gl_context *ctx, GLuint dims,
+               struct gl_texture_image *texImage,
+               GLint xoffset, GLint yoffset, GLint zoffset,
+               GLint width, GLint height, GLint depth,
+               GLenum format, GLenum type, const void *pixels,
+               const struct gl_pixelstore_attrib *unpack)
+{
+   if (try_inline_texsubimage(ctx, dims, texImage,
+                              xoffset, yoffset, zoffset,
+                              width, height, depth,
+                              format, type, pixels, unpack))
+      return;
+
+   _mesa_store_texsubimage(ctx, dims, texImage,
+                           xoffset, yoffset, zoffset, width, height, depth,
+                           format, type, pixels, unpack);
+}
+
+
 static void
 st_TexImage(struct gl_context * ctx, GLuint dims,
             struct gl_texture_image *texImage,
@@ -547,7 +643,19 @@ st_TexImage(struct gl_context * ctx, GLuint dims,
             const struct gl_pixelstore_attrib *unpack)
 {
    prep_teximage(ctx, texImage, format, type);
-   _mesa_store_teximage(ctx, dims, texImage, format, type, pixels, unpack);
+
+   if (texImage->Width == 0 || texImage->Height == 0 || texImage->Depth == 0)
+      return;
+
+   /* allocate storage for texture data */
+   if (!ctx->Driver.AllocTextureImageBuffer(ctx, texImage)) {
+      _mesa_error(ctx, GL_OUT_OF_MEMORY, "glTexImage%uD", dims);
+      return;
+   }
+
+   st_TexSubImage(ctx, dims, texImage, 0, 0, 0,
+                  texImage->Width, texImage->Height, texImage->Depth,
+                  format, type, pixels, unpack);
 }
 
 
@@ -1403,7 +1511,7 @@ st_init_texture_functions(struct dd_function_table *functions)
 {
    functions->ChooseTextureFormat = st_ChooseTextureFormat;
    functions->TexImage = st_TexImage;
-   functions->TexSubImage = _mesa_store_texsubimage;
+   functions->TexSubImage = st_TexSubImage;
    functions->CompressedTexSubImage = _mesa_store_compressed_texsubimage;
    functions->CopyTexSubImage = st_CopyTexSubImage;
    functions->GenerateMipmap = st_generate_mipmap;
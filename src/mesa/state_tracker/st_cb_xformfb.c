@@ -40,6 +40,7 @@
 #include "main/transformfeedback.h"
 
 #include "st_cb_bufferobjects.h"
+#include "st_cb_readpixels.h"
 #include "st_cb_xformfb.h"
 #include "st_context.h"
 
@@ -123,6 +124,9 @@ st_begin_transform_feedback(struct gl_context *ctx, GLenum mode,
       struct st_buffer_object *bo = st_buffer_object(sobj->base.Buffers[i]);
 
       if (bo) {
+         /* don't let a pending glReadPixels overwrite the output later */
+         st_finish_pbo_readback(st, bo);
+
          /* Check whether we need to recreate the target. */
          if (!sobj->targets[i] ||
              sobj->targets[i] == sobj->draw_count ||
@@ -47,12 +47,14 @@
 #include "st_context.h"
 #include "st_atom.h"
 #include "st_cb_bufferobjects.h"
+#include "st_cb_readpixels.h"
 #include "st_cb_xformfb.h"
 #include "st_draw.h"
 #include "st_program.h"
 
 #include "pipe/p_context.h"
 #include "pipe/p_defines.h"
+#include "util/u_atomic.h"
 #include "util/u_inlines.h"
 #include "util/u_format.h"
 #include "util/u_prim.h"
@@ -171,6 +173,37 @@ translate_prim(const struct gl_context *ctx, unsigned prim)
 }
 
 
+/**
+ * Store the pixels of glReadPixels calls not yet stored into the vertex
+ * and index buffers and the texture buffer objects of a draw, before the
+ * GPU reads them.
+ */
+void
+st_finish_draw_readbacks(struct st_context *st,
+                         const struct gl_client_array **arrays,
+                         const struct _mesa_index_buffer *ib)
+{
+   struct gl_context *ctx = st->ctx;
+   GLuint attr, unit;
+
+   for (attr = 0; attr < VERT_ATTRIB_MAX; attr++) {
+      if (arrays[attr] && _mesa_is_bufferobj(arrays[attr]->BufferObj))
+         st_finish_pbo_readback(st, st_buffer_object(arrays[attr]->BufferObj));
+   }
+
+   if (ib && _mesa_is_bufferobj(ib->obj))
+      st_finish_pbo_readback(st, st_buffer_object(ib->obj));
+
+   for (unit = 0; unit < ctx->Const.MaxCombinedTextureImageUnits; unit++) {
+      const struct gl_texture_object *texObj = ctx->Texture.Unit[unit]._Current;
+
+      if (texObj && texObj->Target == GL_TEXTURE_BUFFER &&
+          _mesa_is_bufferobj(texObj->BufferObject))
+         st_finish_pbo_readback(st, st_buffer_object(texObj->BufferObject));
+   }
+}
+
+
 /**
  * This function gets plugged into the VBO module and is called when
  * we have something to render.
@@ -195,6 +228,9 @@ st_draw_vbo(struct gl_context *ctx,
    /* Mesa core state should have been validated already */
    assert(ctx->NewState == 0x0);
 
+   if (unlikely(p_atomic_read(&st_pbo_readbacks_pending)))
+      st_finish_draw_readbacks(st, arrays, ib);
+
    /* Validate state. */
    if (st->dirty.st || ctx->NewDriverState) {
       st_validate_state(st);
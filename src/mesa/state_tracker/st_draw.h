@@ -67,6 +67,11 @@ st_feedback_draw_vbo(struct gl_context *ctx,
                      GLuint max_index,
                      struct gl_transform_feedback_object *tfb_vertcount);
 
+extern void
+st_finish_draw_readbacks(struct st_context *st,
+                         const struct gl_client_array **arrays,
+                         const struct _mesa_index_buffer *ib);
+
 /**
  * When drawing with VBOs, the addresses specified with
  * glVertex/Color/TexCoordPointer() are really offsets into the VBO, not real
@@ -35,11 +35,13 @@
 #include "st_context.h"
 #include "st_atom.h"
 #include "st_cb_bufferobjects.h"
+#include "st_cb_readpixels.h"
 #include "st_draw.h"
 #include "st_program.h"
 
 #include "pipe/p_context.h"
 #include "pipe/p_defines.h"
+#include "util/u_atomic.h"
 #include "util/u_inlines.h"
 
 #include "draw/draw_private.h"
@@ -114,6 +116,9 @@ st_feedback_draw_vbo(struct gl_context *ctx,
 
    assert(draw);
 
+   if (unlikely(p_atomic_read(&st_pbo_readbacks_pending)))
+      st_finish_draw_readbacks(st, arrays, ib);
+
    st_validate_state(st);
 
    if (!index_bounds_valid)
@@ -358,7 +358,7 @@ st_mesa_format_to_pipe_format(gl_format mesaFormat)
    case MESA_FORMAT_ARGB2101010_UINT:
       return PIPE_FORMAT_B10G10R10A2_UINT;
    default:
-      assert(0);
+      /* not all Mesa formats have a gallium equivalent */
       return PIPE_FORMAT_NONE;
    }
 }
@@ -1642,6 +1642,41 @@ st_ChooseTextureFormat(struct gl_context *ctx, GLenum target,
 }
 
 
+/**
+ * Find a pipe format whose memory layout is exactly that of pixels of the
+ * given format and type, as stored by glReadPixels or read by glTexImage.
+ * sRGB formats are skipped since GL does not convert colors to or from
+ * sRGB when packing or unpacking.
+ *
+ * \param bindings  bitmask of PIPE_BIND_x flags the format must support.
+ * \return  PIPE_FORMAT_NONE if there's no such format.
+ */
+enum pipe_format
+st_choose_matching_format(struct pipe_screen *screen, unsigned bindings,
+                          GLenum format, GLenum type, GLboolean swapBytes)
+{
+   gl_format mesa_format;
+
+   for (mesa_format = 1; mesa_format < MESA_FORMAT_COUNT; mesa_format++) {
+      if (_mesa_get_format_color_encoding(mesa_format) == GL_SRGB) {
+         continue;
+      }
+
+      if (_mesa_format_matches_format_and_type(mesa_format, format, type,
+                                               swapBytes)) {
+         enum pipe_format pformat = st_mesa_format_to_pipe_format(mesa_format);
+
+         if (pformat != PIPE_FORMAT_NONE &&
+             screen->is_format_supported(screen, pformat, PIPE_TEXTURE_2D, 0,
+                                         bindings)) {
+            return pformat;
+         }
+      }
+   }
+   return PIPE_FORMAT_NONE;
+}
+
+
 GLboolean
 st_sampler_compat_formats(enum pipe_format format1, enum pipe_format format2)
 {
@@ -68,6 +68,11 @@ st_ChooseTextureFormat(struct gl_context * ctx, GLenum target,
                        GLenum format, GLenum type);
 
 
+extern enum pipe_format
+st_choose_matching_format(struct pipe_screen *screen, unsigned bindings,
+                          GLenum format, GLenum type, GLboolean swapBytes);
+
+
 /* can we use a sampler view to translate these formats
    only used to make TFP so far */
 extern GLboolean
@@ -34,6 +34,7 @@
 #include "main/texstate.h"
 #include "main/framebuffer.h"
 #include "main/fbobject.h"
+#include "main/glthread.h"
 #include "main/renderbuffer.h"
 #include "main/version.h"
 #include "st_texture.h"
@@ -53,6 +54,10 @@
 #include "util/u_inlines.h"
 #include "util/u_atomic.h"
 #include "util/u_surface.h"
+#include "util/u_debug.h"
+
+
+DEBUG_GET_ONCE_BOOL_OPTION(mesa_glthread, "MESA_GLTHREAD", FALSE)
 
 /**
  * Cast wrapper to convert a struct gl_framebuffer to an st_framebuffer.
@@ -461,6 +466,7 @@ st_context_flush(struct st_context_iface *stctxi, unsigned flags,
                  struct pipe_fence_handle **fence)
 {
    struct st_context *st = (struct st_context *) stctxi;
+   _mesa_glthread_finish(st->ctx);
    st_flush(st, fence);
    if (flags & ST_FLUSH_FRONT)
       st_manager_flush_frontbuffer(st);
@@ -474,7 +480,7 @@ st_context_teximage(struct st_context_iface *stctxi,
 {
    struct st_context *st = (struct st_context *) stctxi;
    struct gl_context *ctx = st->ctx;
-   struct gl_texture_unit *texUnit = _mesa_get_current_tex_unit(ctx);
+   struct gl_texture_unit *texUnit;
    struct gl_texture_object *texObj;
    struct gl_texture_image *texImage;
    struct st_texture_object *stObj;
@@ -483,6 +489,9 @@ st_context_teximage(struct st_context_iface *stctxi,
    GLuint width, height, depth;
    GLenum target;
 
+   _mesa_glthread_finish(ctx);
+   texUnit = _mesa_get_current_tex_unit(ctx);
+
    switch (tex_type) {
    case ST_TEXTURE_1D:
       target = GL_TEXTURE_1D;
@@ -578,6 +587,8 @@ st_context_copy(struct st_context_iface *stctxi,
    struct st_context *st = (struct st_context *) stctxi;
    struct st_context *src = (struct st_context *) stsrci;
 
+   _mesa_glthread_finish(src->ctx);
+   _mesa_glthread_finish(st->ctx);
    _mesa_copy_context(src->ctx, st->ctx, mask);
 }
 
@@ -588,6 +599,7 @@ st_context_share(struct st_context_iface *stctxi,
    struct st_context *st = (struct st_context *) stctxi;
    struct st_context *src = (struct st_context *) stsrci;
 
+   _mesa_glthread_finish(st->ctx);
    return _mesa_share_state(st->ctx, src->ctx);
 }
 
@@ -595,6 +607,7 @@ static void
 st_context_destroy(struct st_context_iface *stctxi)
 {
    struct st_context *st = (struct st_context *) stctxi;
+   _mesa_glthread_destroy(st->ctx);
    st_destroy_context(st);
 }
 
@@ -670,6 +683,11 @@ st_api_create_context(struct st_api *stapi, struct st_manager *smapi,
    st->iface.share = st_context_share;
    st->iface.st_context_private = (void *) smapi;
 
+   /* Debug contexts report errors as the calls are made. */
+   if (debug_get_option_mesa_glthread() &&
+       !(attribs->flags & ST_CONTEXT_FLAG_DEBUG))
+      _mesa_glthread_init(st->ctx);
+
    *error = ST_CONTEXT_SUCCESS;
    return &st->iface;
 }
@@ -714,6 +732,10 @@ st_api_make_current(struct st_api *stapi, struct st_context_iface *stctxi,
 
    _glapi_check_multithread();
 
+   /* The framebuffers are validated before _mesa_make_current is called. */
+   if (st)
+      _mesa_glthread_finish(st->ctx);
+
    if (st) {
       /* reuse or create the draw fb */
       stdraw = st_framebuffer_reuse_or_create(st->ctx->WinSysDrawBuffer,